@@ -42,38 +42,67 @@ abs_build_path = sys.argv[3]
 
 # These are the header files used by gdbwire.
 header_files = [
+    'gdbwire_allocator.h',
+    'gdbwire_atomic.h',
+    'gdbwire_histogram.h',
     'gdbwire_sys.h',
     'gdbwire_string.h',
+    'gdbwire_trace.h',
     'gdbwire_assert.h',
     'gdbwire_result.h',
     'gdbwire_logger.h',
+    'gdbwire_logger_async.h',
     'gdbwire_mi_pt.h',
     'gdbwire_mi_pt_alloc.h',
+    'gdbwire_mi_cache.h',
+    'gdbwire_mi_lexer.h',
     'gdbwire_mi_parser.h',
+    'gdbwire_mi_queue.h',
     'gdbwire_mi_command.h',
+    'gdbwire_mi_diff.h',
+    'gdbwire_mi_binary.h',
+    'gdbwire_mi_json.h',
+    'gdbwire_mi_writer.h',
+    'gdbwire_recorder.h',
+    'gdbwire_lz.h',
+    'gdbwire_transcript.h',
     'gdbwire_mi_grammar.h',
-    'gdbwire.h']
+    'gdbwire.h',
+    'gdbwire_mux.h']
 
 # These are the soruce files used by gdbwire
 source_files = [
     'gdbwire_sys.c',
+    'gdbwire_allocator.c',
+    'gdbwire_histogram.c',
 
     'gdbwire_string.c',
 
     'gdbwire_logger.c',
+    'gdbwire_logger_async.c',
+    'gdbwire_mi_cache.c',
     'gdbwire_mi_parser.c',
+    'gdbwire_mi_queue.c',
     'gdbwire_mi_pt_alloc.c',
     'gdbwire_mi_pt.c',
     'gdbwire_mi_command.c',
+    'gdbwire_mi_diff.c',
+    'gdbwire_mi_binary.c',
+    'gdbwire_mi_json.c',
+    'gdbwire_mi_writer.c',
+    'gdbwire_recorder.c',
+    'gdbwire_lz.c',
+    'gdbwire_transcript.c',
 
     'gdbwire_mi_lexer.c',
     'gdbwire_mi_grammar.c',
 
     'gdbwire.c',
+    'gdbwire_mux.c',
 ]
 
 def comment(out, text):
-    end_stars = '*' * (70 - len(text))
+    end_stars = '*' * max(1, 70 - len(text))
     out.write('/***** ' + text + ' ' + end_stars + '/\n')
 
 # include and line directive regular expressions
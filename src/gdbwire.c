@@ -1,10 +1,21 @@
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "gdbwire_assert.h"
+#include "gdbwire_atomic.h"
 #include "gdbwire.h"
 #include "gdbwire_mi_parser.h"
 
+/* The number of record classes the latency is measured for */
+#define GDBWIRE_LATENCY_CLASSES \
+    (GDBWIRE_MI_LOG + 1 + GDBWIRE_MI_ASYNC_UNSUPPORTED + 1 + \
+     GDBWIRE_MI_UNSUPPORTED + 1 + 2)
+
+/* The number of gdbwire_latency_metric values */
+#define GDBWIRE_LATENCY_METRICS (GDBWIRE_LATENCY_TOTAL + 1)
+
 struct gdbwire
 {
     /* The gdbwire_mi parser. */
@@ -12,8 +23,128 @@ struct gdbwire
 
     /* The client callback functions */
     struct gdbwire_callbacks callbacks;
+
+    /* The function called with each output parsed, or NULL */
+    gdbwire_output_fn output_callback;
+
+    /* The context passed to output_callback */
+    void *output_context;
+
+    /* The allocator gdbwire allocates its memory with */
+    struct gdbwire_allocator allocator;
+
+    /* True if the latency of each record is measured */
+    int timestamps;
+
+    /* The recorder of the output pushed, or NULL if none */
+    struct gdbwire_recorder *recorder;
+
+    /* The latencies of each record class, allocated when first seen */
+    struct gdbwire_histogram *latency[GDBWIRE_LATENCY_CLASSES]
+        [GDBWIRE_LATENCY_METRICS];
 };
 
+/**
+ * Get the index of a record class in the latency histograms.
+ *
+ * @param record
+ * The record.
+ *
+ * @param record_class
+ * The class of the record.
+ *
+ * @return
+ * The index or -1 if the class is out of range.
+ */
+static int
+gdbwire_latency_index(enum gdbwire_latency_record record, int record_class)
+{
+    int base = 0, classes = GDBWIRE_MI_LOG + 1;
+
+    if (record > GDBWIRE_LATENCY_STREAM) {
+        base += classes;
+        classes = GDBWIRE_MI_ASYNC_UNSUPPORTED + 1;
+    }
+    if (record > GDBWIRE_LATENCY_ASYNC) {
+        base += classes;
+        classes = GDBWIRE_MI_UNSUPPORTED + 1;
+    }
+    if (record > GDBWIRE_LATENCY_RESULT) {
+        base += classes + (record - GDBWIRE_LATENCY_PROMPT);
+        classes = 1;
+    }
+
+    if (record_class < 0 || record_class >= classes ||
+            record > GDBWIRE_LATENCY_PARSE_ERROR) {
+        return -1;
+    }
+
+    return base + record_class;
+}
+
+/**
+ * Record the latencies of an output in its class's histograms.
+ *
+ * @param wire
+ * The gdbwire context.
+ *
+ * @param output
+ * The output that is being dispatched.
+ */
+static void
+gdbwire_record_latency(struct gdbwire *wire, struct gdbwire_mi_output *output)
+{
+    enum gdbwire_latency_record record = GDBWIRE_LATENCY_PROMPT;
+    const struct gdbwire_mi_timestamps *times =
+        gdbwire_mi_output_get_timestamps(output);
+    struct gdbwire_histogram **histograms;
+    uint64_t values[GDBWIRE_LATENCY_METRICS];
+    int record_class = 0, index, metric;
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            if (output->variant.oob_record->kind == GDBWIRE_MI_ASYNC) {
+                record = GDBWIRE_LATENCY_ASYNC;
+                record_class = output->variant.oob_record->variant.
+                    async_record->async_class;
+            } else {
+                record = GDBWIRE_LATENCY_STREAM;
+                record_class = output->variant.oob_record->variant.
+                    stream_record->kind;
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            record = GDBWIRE_LATENCY_RESULT;
+            record_class = output->variant.result_record->result_class;
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            record = GDBWIRE_LATENCY_PROMPT;
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            record = GDBWIRE_LATENCY_PARSE_ERROR;
+            break;
+    }
+
+    index = gdbwire_latency_index(record, record_class);
+    if (index == -1) {
+        return;
+    }
+
+    values[GDBWIRE_LATENCY_ARRIVAL] = times->newline - times->first_byte;
+    values[GDBWIRE_LATENCY_PARSE] = times->dispatch - times->newline;
+    values[GDBWIRE_LATENCY_TOTAL] = times->dispatch - times->first_byte;
+
+    /* A class without its histograms is skipped if out of memory */
+    histograms = wire->latency[index];
+    for (metric = 0; metric < GDBWIRE_LATENCY_METRICS; ++metric) {
+        if (!histograms[metric]) {
+            histograms[metric] = gdbwire_histogram_create_with_allocator(
+                &wire->allocator);
+        }
+        gdbwire_histogram_record(histograms[metric], values[metric]);
+    }
+}
+
 static void
 gdbwire_mi_output_callback(void *context, struct gdbwire_mi_output *output) {
     struct gdbwire *wire = (struct gdbwire *)context;
@@ -21,6 +152,14 @@ gdbwire_mi_output_callback(void *context, struct gdbwire_mi_output *output) {
     struct gdbwire_mi_output *cur = output;
 
     while (cur) {
+        if (wire->timestamps) {
+            gdbwire_record_latency(wire, cur);
+        }
+
+        if (wire->output_callback) {
+            wire->output_callback(wire->output_context, cur);
+        }
+
         switch (cur->kind) {
             case GDBWIRE_MI_OUTPUT_OOB: {
                 struct gdbwire_mi_oob_record *oob_record =
@@ -73,17 +212,31 @@ gdbwire_mi_output_callback(void *context, struct gdbwire_mi_output *output) {
 
 struct gdbwire *
 gdbwire_create(struct gdbwire_callbacks callbacks)
+{
+    return gdbwire_create_with_allocator(callbacks, NULL);
+}
+
+struct gdbwire *
+gdbwire_create_with_allocator(struct gdbwire_callbacks callbacks,
+        const struct gdbwire_allocator *allocator)
 {
     struct gdbwire *result = 0;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
     
-    result = malloc(sizeof(struct gdbwire));
+    result = gdbwire_calloc(allocator, 1, sizeof(struct gdbwire));
     if (result) {
         struct gdbwire_mi_parser_callbacks parser_callbacks =
-            { result,gdbwire_mi_output_callback };
+            { result, gdbwire_mi_output_callback };
         result->callbacks = callbacks;
-        result->parser = gdbwire_mi_parser_create(parser_callbacks);
+        result->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
+        result->parser = gdbwire_mi_parser_create_with_allocator(
+            parser_callbacks, &result->allocator);
         if (!result->parser) {
-            free(result);
+            gdbwire_free(allocator, result);
             result = 0;
         }
     }
@@ -95,18 +248,110 @@ void
 gdbwire_destroy(struct gdbwire *gdbwire)
 {
     if (gdbwire) {
+        struct gdbwire_allocator allocator = gdbwire->allocator;
+        int index, metric;
+        for (index = 0; index < GDBWIRE_LATENCY_CLASSES; ++index) {
+            for (metric = 0; metric < GDBWIRE_LATENCY_METRICS; ++metric) {
+                gdbwire_histogram_destroy(gdbwire->latency[index][metric]);
+            }
+        }
         gdbwire_mi_parser_destroy(gdbwire->parser);
-        free(gdbwire);
+        gdbwire_free(&allocator, gdbwire);
     }
 }
 
 enum gdbwire_result
 gdbwire_push_data(struct gdbwire *wire, const char *data, size_t size)
 {
-    enum gdbwire_result result;
+    enum gdbwire_result result, recorded = GDBWIRE_OK;
     GDBWIRE_ASSERT(wire);
+    if (wire->recorder) {
+        recorded = gdbwire_recorder_push_data(wire->recorder, data, size);
+    }
     result = gdbwire_mi_parser_push_data(wire->parser, data, size);
-    return result;
+    return (result == GDBWIRE_OK) ? recorded : result;
+}
+
+enum gdbwire_result
+gdbwire_set_recorder(struct gdbwire *wire, struct gdbwire_recorder *recorder)
+{
+    GDBWIRE_ASSERT(wire);
+    wire->recorder = recorder;
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_set_limits(struct gdbwire *wire,
+        struct gdbwire_mi_parser_limits limits)
+{
+    GDBWIRE_ASSERT(wire);
+    return gdbwire_mi_parser_set_limits(wire->parser, limits);
+}
+
+enum gdbwire_result
+gdbwire_set_oversized_line_callback(struct gdbwire *wire,
+        gdbwire_mi_oversized_line_fn callback, void *context)
+{
+    GDBWIRE_ASSERT(wire);
+    return gdbwire_mi_parser_set_oversized_line_callback(wire->parser,
+        callback, context);
+}
+
+enum gdbwire_result
+gdbwire_set_stream_threshold(struct gdbwire *wire, size_t threshold)
+{
+    GDBWIRE_ASSERT(wire);
+    return gdbwire_mi_parser_set_stream_threshold(wire->parser, threshold);
+}
+
+enum gdbwire_result
+gdbwire_set_stream_chunk_callback(struct gdbwire *wire,
+        gdbwire_mi_stream_chunk_fn callback, void *context)
+{
+    GDBWIRE_ASSERT(wire);
+    return gdbwire_mi_parser_set_stream_chunk_callback(wire->parser,
+        callback, context);
+}
+
+enum gdbwire_result
+gdbwire_set_output_callback(struct gdbwire *wire,
+        gdbwire_output_fn callback, void *context)
+{
+    GDBWIRE_ASSERT(wire);
+
+    wire->output_callback = callback;
+    wire->output_context = context;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_get_stats(struct gdbwire *wire, struct gdbwire_mi_parser_stats *stats)
+{
+    GDBWIRE_ASSERT(wire);
+    return gdbwire_mi_parser_get_stats(wire->parser, stats);
+}
+
+enum gdbwire_result
+gdbwire_set_timestamps(struct gdbwire *wire, int enabled)
+{
+    GDBWIRE_ASSERT(wire);
+    wire->timestamps = enabled;
+    return gdbwire_mi_parser_set_timestamps(wire->parser, enabled);
+}
+
+const struct gdbwire_histogram *
+gdbwire_get_latency(struct gdbwire *wire, enum gdbwire_latency_record record,
+        int record_class, enum gdbwire_latency_metric metric)
+{
+    int index;
+
+    if (!wire || (int)metric < 0 || metric >= GDBWIRE_LATENCY_METRICS) {
+        return NULL;
+    }
+
+    index = gdbwire_latency_index(record, record_class);
+    return (index == -1) ? NULL : wire->latency[index][metric];
 }
 
 struct gdbwire_interpreter_exec_context {
@@ -160,50 +405,280 @@ static void gdbwire_interpreter_exec_parse_error(void *context,
 }
 
 
+struct gdbwire_interpreter_exec_ctx {
+    /* The gdbwire instance reused for each interpreter-exec output */
+    struct gdbwire *wire;
+
+    /* The state of the interpreter-exec output being handled */
+    struct gdbwire_interpreter_exec_context context;
+};
+
+struct gdbwire_interpreter_exec_ctx *
+gdbwire_interpreter_exec_ctx_create(void)
+{
+    return gdbwire_interpreter_exec_ctx_create_with_allocator(NULL);
+}
+
+struct gdbwire_interpreter_exec_ctx *
+gdbwire_interpreter_exec_ctx_create_with_allocator(
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_interpreter_exec_ctx *ctx;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    ctx = gdbwire_calloc(allocator, 1,
+        sizeof(struct gdbwire_interpreter_exec_ctx));
+    if (ctx) {
+        struct gdbwire_callbacks callbacks = {
+            &ctx->context,
+            gdbwire_interpreter_exec_stream_record,
+            gdbwire_interpreter_exec_async_record,
+            gdbwire_interpreter_exec_result_record,
+            gdbwire_interpreter_exec_prompt,
+            gdbwire_interpreter_exec_parse_error
+        };
+
+        ctx->wire = gdbwire_create_with_allocator(callbacks, allocator);
+        if (!ctx->wire) {
+            gdbwire_free(allocator, ctx);
+            ctx = 0;
+        }
+    }
+
+    return ctx;
+}
+
+void
+gdbwire_interpreter_exec_ctx_destroy(struct gdbwire_interpreter_exec_ctx *ctx)
+{
+    if (ctx) {
+        /* The context is freed with the allocator gdbwire holds */
+        struct gdbwire_allocator allocator = ctx->wire->allocator;
+        gdbwire_destroy(ctx->wire);
+        gdbwire_free(&allocator, ctx);
+    }
+}
+
 enum gdbwire_result
-gdbwire_interpreter_exec(
+gdbwire_interpreter_exec_with_ctx(
+        struct gdbwire_interpreter_exec_ctx *ctx,
         const char *interpreter_exec_output,
         enum gdbwire_mi_command_kind kind,
         struct gdbwire_mi_command **out_mi_command)
 {
-    struct gdbwire_interpreter_exec_context context = {
-            GDBWIRE_OK, kind, 0 };
-    size_t len;
+    struct gdbwire_interpreter_exec_context *context;
     enum gdbwire_result result = GDBWIRE_OK;
-    struct gdbwire_callbacks callbacks = {
-        &context,
-        gdbwire_interpreter_exec_stream_record,
-        gdbwire_interpreter_exec_async_record,
-        gdbwire_interpreter_exec_result_record,
-        gdbwire_interpreter_exec_prompt,
-        gdbwire_interpreter_exec_parse_error
-    };
-    struct gdbwire *wire;
+    size_t len;
 
+    GDBWIRE_ASSERT(ctx);
     GDBWIRE_ASSERT(interpreter_exec_output);
     GDBWIRE_ASSERT(out_mi_command);
 
-    len = strlen(interpreter_exec_output);
+    context = &ctx->context;
+    context->result = GDBWIRE_OK;
+    context->kind = kind;
+    context->mi_command = 0;
 
-    wire = gdbwire_create(callbacks);
-    GDBWIRE_ASSERT(wire);
+    len = strlen(interpreter_exec_output);
 
-    result = gdbwire_push_data(wire, interpreter_exec_output, len);
+    result = gdbwire_push_data(ctx->wire, interpreter_exec_output, len);
     if (result == GDBWIRE_OK) {
         /* Honor function documentation,
          * When it returns GDBWIRE_OK - the command will exist.
          * Otherwise it will not. */
-        if (context.result == GDBWIRE_OK && !context.mi_command) {
+        if (context->result == GDBWIRE_OK && !context->mi_command) {
             result = GDBWIRE_LOGIC;
-        } else if (context.result != GDBWIRE_OK && context.mi_command) {
-            result = context.result;
-            gdbwire_mi_command_free(context.mi_command);
+        } else if (context->result != GDBWIRE_OK && context->mi_command) {
+            result = context->result;
+            gdbwire_mi_command_free(context->mi_command);
         } else {
-            result = context.result;
-            *out_mi_command = context.mi_command;
+            result = context->result;
+            *out_mi_command = context->mi_command;
         }
     }
 
-    gdbwire_destroy(wire);
+    /* Drop any incomplete line, it is not part of the next output */
+    gdbwire_mi_parser_reset(ctx->wire->parser);
+
+    return result;
+}
+
+enum gdbwire_result
+gdbwire_interpreter_exec(
+        const char *interpreter_exec_output,
+        enum gdbwire_mi_command_kind kind,
+        struct gdbwire_mi_command **out_mi_command)
+{
+    struct gdbwire_interpreter_exec_ctx *ctx;
+    enum gdbwire_result result;
+
+    GDBWIRE_ASSERT(interpreter_exec_output);
+    GDBWIRE_ASSERT(out_mi_command);
+
+    ctx = gdbwire_interpreter_exec_ctx_create();
+    GDBWIRE_ASSERT(ctx);
+
+    result = gdbwire_interpreter_exec_with_ctx(ctx, interpreter_exec_output,
+        kind, out_mi_command);
+
+    gdbwire_interpreter_exec_ctx_destroy(ctx);
     return result;
 }
+
+/**
+ * The number of outputs a batch worker claims at a time.
+ *
+ * Claiming a few outputs at a time keeps the workers from contending
+ * on the shared counter and from writing to the same cache lines of
+ * the result arrays.
+ */
+#define GDBWIRE_INTERPRETER_EXEC_BATCH_GRAIN 16
+
+/* The outputs of a batch, shared by all of its workers */
+struct gdbwire_interpreter_exec_batch {
+    const char *const *outputs;
+    const enum gdbwire_mi_command_kind *kinds;
+    size_t count;
+    enum gdbwire_result *results;
+    struct gdbwire_mi_command **mi_commands;
+
+    /* The index of the next output not yet claimed by a worker */
+    size_t next;
+};
+
+/* A worker handling its share of a batch */
+struct gdbwire_interpreter_exec_worker {
+    struct gdbwire_interpreter_exec_batch *batch;
+    const struct gdbwire_allocator *allocator;
+    pthread_t thread;
+};
+
+static void *
+gdbwire_interpreter_exec_worker_run(void *arg)
+{
+    struct gdbwire_interpreter_exec_worker *worker =
+        (struct gdbwire_interpreter_exec_worker *)arg;
+    struct gdbwire_interpreter_exec_batch *batch = worker->batch;
+    struct gdbwire_interpreter_exec_ctx *ctx;
+    size_t index, end;
+
+    /**
+     * A worker that can not create a context claims no outputs,
+     * the other workers handle them instead.
+     */
+    ctx = gdbwire_interpreter_exec_ctx_create_with_allocator(
+        worker->allocator);
+    if (!ctx) {
+        return NULL;
+    }
+
+    for (;;) {
+        index = gdbwire_atomic_fetch_add(&batch->next,
+            GDBWIRE_INTERPRETER_EXEC_BATCH_GRAIN);
+        if (index >= batch->count) {
+            break;
+        }
+
+        end = index + GDBWIRE_INTERPRETER_EXEC_BATCH_GRAIN;
+        if (end > batch->count) {
+            end = batch->count;
+        }
+
+        for (; index < end; ++index) {
+            batch->results[index] = gdbwire_interpreter_exec_with_ctx(ctx,
+                batch->outputs[index], batch->kinds[index],
+                    &batch->mi_commands[index]);
+        }
+    }
+
+    gdbwire_interpreter_exec_ctx_destroy(ctx);
+
+    return NULL;
+}
+
+enum gdbwire_result
+gdbwire_interpreter_exec_batch(
+        const char *const *interpreter_exec_outputs,
+        const enum gdbwire_mi_command_kind *kinds,
+        size_t count,
+        size_t threads,
+        const struct gdbwire_allocator *allocators,
+        enum gdbwire_result *out_results,
+        struct gdbwire_mi_command **out_mi_commands)
+{
+    struct gdbwire_interpreter_exec_batch batch;
+    struct gdbwire_interpreter_exec_worker *workers;
+    size_t index, started;
+
+    GDBWIRE_ASSERT(interpreter_exec_outputs || count == 0);
+    GDBWIRE_ASSERT(kinds || count == 0);
+    GDBWIRE_ASSERT(out_results || count == 0);
+    GDBWIRE_ASSERT(out_mi_commands || count == 0);
+    GDBWIRE_ASSERT(threads > 0 || !allocators);
+
+    if (threads == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (processors > 0) ? (size_t)processors : 1;
+    }
+
+    /* There is no point in more workers than groups of outputs */
+    if (!allocators) {
+        size_t groups = (count + GDBWIRE_INTERPRETER_EXEC_BATCH_GRAIN - 1) /
+            GDBWIRE_INTERPRETER_EXEC_BATCH_GRAIN;
+        if (threads > groups) {
+            threads = (groups > 0) ? groups : 1;
+        }
+    }
+
+    /* An output no worker got to is reported as out of memory */
+    for (index = 0; index < count; ++index) {
+        out_results[index] = GDBWIRE_NOMEM;
+        out_mi_commands[index] = 0;
+    }
+
+    batch.outputs = interpreter_exec_outputs;
+    batch.kinds = kinds;
+    batch.count = count;
+    batch.results = out_results;
+    batch.mi_commands = out_mi_commands;
+    batch.next = 0;
+
+    /* The calling thread is the first worker and uses the first allocator */
+    workers = gdbwire_calloc((allocators) ? &allocators[0] : NULL, threads,
+        sizeof(struct gdbwire_interpreter_exec_worker));
+    if (!workers) {
+        return GDBWIRE_NOMEM;
+    }
+
+    for (index = 0; index < threads; ++index) {
+        workers[index].batch = &batch;
+        workers[index].allocator = (allocators) ? &allocators[index] : NULL;
+    }
+
+    /**
+     * The calling thread is the first worker.
+     *
+     * If a thread can not be started, the workers that did start
+     * handle its share of the outputs.
+     */
+    for (started = 1; started < threads; ++started) {
+        if (pthread_create(&workers[started].thread, NULL,
+                gdbwire_interpreter_exec_worker_run,
+                    &workers[started]) != 0) {
+            break;
+        }
+    }
+
+    gdbwire_interpreter_exec_worker_run(&workers[0]);
+
+    for (index = 1; index < started; ++index) {
+        pthread_join(workers[index].thread, NULL);
+    }
+
+    gdbwire_free((allocators) ? &allocators[0] : NULL, workers);
+
+    return GDBWIRE_OK;
+}
@@ -6,13 +6,25 @@ extern "C" {
 #endif 
 
 #include <stdlib.h>
+#include "gdbwire_allocator.h"
 #include "gdbwire_result.h"
 #include "gdbwire_mi_pt.h"
 #include "gdbwire_mi_command.h"
+#include "gdbwire_mi_diff.h"
+#include "gdbwire_mi_binary.h"
+#include "gdbwire_mi_json.h"
+#include "gdbwire_mi_writer.h"
+#include "gdbwire_mi_parser.h"
+#include "gdbwire_histogram.h"
+#include "gdbwire_recorder.h"
+#include "gdbwire_transcript.h"
 
 /* The opaque gdbwire context */
 struct gdbwire;
 
+/* The opaque context reused to handle interpreter-exec commands */
+struct gdbwire_interpreter_exec_ctx;
+
 /**
  * The primary mechanism for gdbwire to send events to the caller.
  *
@@ -102,6 +114,23 @@ struct gdbwire_callbacks {
             const char *token, struct gdbwire_mi_position position);
 };
 
+/**
+ * Handle a GDB/MI output command that was parsed.
+ *
+ * See gdbwire_set_output_callback. This is called for each output,
+ * before the callback of its record. The output is freed after the
+ * call, unless it is retained with gdbwire_mi_output_retain. This lets
+ * the caller hand the output on without copying it, see gdbwire_mux.h.
+ *
+ * @param context
+ * The context given along with the callback.
+ *
+ * @param output
+ * The output parsed from GDB. Its next field should not be followed.
+ */
+typedef void (*gdbwire_output_fn)(void *context,
+        const struct gdbwire_mi_output *output);
+
 /**
  * Create a gdbwire context.
  *
@@ -117,6 +146,27 @@ struct gdbwire_callbacks {
  */
 struct gdbwire *gdbwire_create(struct gdbwire_callbacks callbacks);
 
+/**
+ * Create a gdbwire context that allocates with the given allocator.
+ *
+ * The gdbwire instance and all of the memory it uses while parsing
+ * GDB's output are allocated with the allocator.
+ *
+ * @param callbacks
+ * The callback functions for when events should be sent.
+ * See gdbwire_create for details.
+ *
+ * @param allocator
+ * The allocator to copy and allocate with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new gdbwire instance or NULL on error.
+ */
+struct gdbwire *gdbwire_create_with_allocator(
+        struct gdbwire_callbacks callbacks,
+        const struct gdbwire_allocator *allocator);
+
 /**
  * Destroy a gdbwire context.
  *
@@ -152,6 +202,235 @@ void gdbwire_destroy(struct gdbwire *wire);
 enum gdbwire_result gdbwire_push_data(struct gdbwire *wire, const char *data,
         size_t size);
 
+/**
+ * Set the memory limits of a gdbwire context.
+ *
+ * The limits bound the memory gdbwire uses to buffer and parse the
+ * output of GDB. A GDB that prints a line that never ends, or an
+ * inferior that floods the console, can otherwise make gdbwire buffer
+ * an unbounded amount of data.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param limits
+ * The limits to set. See gdbwire_mi_parser_limits for details.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_set_limits(struct gdbwire *wire,
+        struct gdbwire_mi_parser_limits limits);
+
+/**
+ * Set the function to call with each line of gdb/mi that did not fit
+ * in the hard memory limit.
+ *
+ * See gdbwire_mi_parser_set_oversized_line_callback for details.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param callback
+ * The function to call, or NULL for none.
+ *
+ * @param context
+ * An arbitrary pointer passed to the callback.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_set_oversized_line_callback(struct gdbwire *wire,
+        gdbwire_mi_oversized_line_fn callback, void *context);
+
+/**
+ * Deliver large console, target and log output events in chunks.
+ *
+ * Once the buffered part of a stream record reaches the threshold, it
+ * is delivered through the callback set with
+ * gdbwire_set_stream_chunk_callback as it arrives instead of the
+ * gdbwire_stream_record_fn callback.
+ * See gdbwire_mi_parser_set_stream_threshold for details.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param threshold
+ * The number of buffered bytes at which to start delivering a stream
+ * record in chunks, or 0 to always deliver stream records whole.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_set_stream_threshold(struct gdbwire *wire,
+        size_t threshold);
+
+/**
+ * Set the function to call with the chunks of large console, target
+ * and log output events.
+ *
+ * See gdbwire_mi_parser_set_stream_chunk_callback for details.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param callback
+ * The function to call, or NULL for none.
+ *
+ * @param context
+ * An arbitrary pointer passed to the callback.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_set_stream_chunk_callback(struct gdbwire *wire,
+        gdbwire_mi_stream_chunk_fn callback, void *context);
+
+/**
+ * Set the function to call with each GDB/MI output command parsed.
+ *
+ * The context has no such callback until this function is called.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param callback
+ * The function to call, or NULL for none.
+ *
+ * @param context
+ * An arbitrary pointer passed to the callback.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_set_output_callback(struct gdbwire *wire,
+        gdbwire_output_fn callback, void *context);
+
+/**
+ * Get the memory usage and statistics of a gdbwire context.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param stats
+ * Set to the statistics on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_get_stats(struct gdbwire *wire,
+        struct gdbwire_mi_parser_stats *stats);
+
+/**
+ * Record the output pushed into a gdbwire context.
+ *
+ * Once set, gdbwire_push_data hands each push to the recorder before
+ * parsing it, see gdbwire_recorder.h. The output is parsed even if it
+ * could not be recorded.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param recorder
+ * The recorder to record with, or NULL to stop recording. It belongs
+ * to the caller and must outlive its use by the context.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_set_recorder(struct gdbwire *wire,
+        struct gdbwire_recorder *recorder);
+
+/**
+ * The records the latency is measured for separately.
+ *
+ * Each record is further split by the class given with it to
+ * gdbwire_get_latency.
+ */
+enum gdbwire_latency_record {
+    /** A stream record, the class is its gdbwire_mi_stream_record_kind. */
+    GDBWIRE_LATENCY_STREAM,
+    /** An async record, the class is its gdbwire_mi_async_class. */
+    GDBWIRE_LATENCY_ASYNC,
+    /** A result record, the class is its gdbwire_mi_result_class. */
+    GDBWIRE_LATENCY_RESULT,
+    /** A prompt, the class is 0. */
+    GDBWIRE_LATENCY_PROMPT,
+    /** A line that failed to parse, the class is 0. */
+    GDBWIRE_LATENCY_PARSE_ERROR
+};
+
+/**
+ * The latencies measured for each record, from its timestamps.
+ */
+enum gdbwire_latency_metric {
+    /**
+     * From the first byte to the newline of the line being pushed.
+     *
+     * This is the time GDB took to write the line, along with any
+     * splitting of the line by the pipe and the reads of the caller.
+     */
+    GDBWIRE_LATENCY_ARRIVAL,
+
+    /**
+     * From the newline being pushed to the record being dispatched.
+     *
+     * This is the time gdbwire took to parse the line, along with
+     * the lines before it in the same push.
+     */
+    GDBWIRE_LATENCY_PARSE,
+
+    /** From the first byte being pushed to the record being dispatched. */
+    GDBWIRE_LATENCY_TOTAL
+};
+
+/**
+ * Measure the latency of each record.
+ *
+ * When enabled, the timestamps of each line are taken, see
+ * gdbwire_mi_parser_set_timestamps, and aggregated into a histogram of
+ * each gdbwire_latency_metric for each class of record. For instance,
+ * a slow *stopped record shows up in the GDBWIRE_LATENCY_ASYNC
+ * histograms of the class GDBWIRE_MI_ASYNC_STOPPED. The time GDB took
+ * before writing the first byte of a record is not seen by gdbwire.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param enabled
+ * 1 to measure the latencies or 0 to stop, the default. The
+ * histograms measured so far are kept.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_set_timestamps(struct gdbwire *wire,
+        int enabled);
+
+/**
+ * Get a histogram of the latencies measured for a class of record.
+ *
+ * @param wire
+ * The gdbwire context to operate on.
+ *
+ * @param record
+ * The record to get the latency of.
+ *
+ * @param record_class
+ * The class of the record, see gdbwire_latency_record.
+ *
+ * @param metric
+ * The latency to get.
+ *
+ * @return
+ * The histogram of the latencies in nanoseconds, valid until the
+ * gdbwire context is destroyed, or NULL if no such record was seen
+ * while measuring.
+ */
+const struct gdbwire_histogram *gdbwire_get_latency(struct gdbwire *wire,
+        enum gdbwire_latency_record record, int record_class,
+        enum gdbwire_latency_metric metric);
+
 /**
  * Handle an interpreter-exec command.
  *
@@ -190,6 +469,133 @@ enum gdbwire_result gdbwire_interpreter_exec(
         enum gdbwire_mi_command_kind kind,
         struct gdbwire_mi_command **out_mi_command);
 
+/**
+ * Handle many interpreter-exec commands in parallel.
+ *
+ * The outputs are divided between a pool of worker threads, each of
+ * which handles its share with its own gdbwire_interpreter_exec_ctx.
+ * The workers claim outputs in small groups with an atomic counter and
+ * write each result to its own slot, so they share no locks.
+ *
+ * The result of each output is the same as if it was handled with
+ * gdbwire_interpreter_exec, and is stored at the same index as the
+ * output.
+ *
+ * @param interpreter_exec_outputs
+ * The MI outputs from GDB for the interpreter exec commands.
+ *
+ * @param kinds
+ * The interpreter-exec command kind of each output.
+ *
+ * @param count
+ * The number of outputs and kinds.
+ *
+ * @param threads
+ * The number of worker threads to use, or 0 to use one per online
+ * processor. The calling thread is one of the workers.
+ *
+ * @param allocators
+ * An array of threads allocators, one for each worker's parser, or
+ * NULL for all workers to use the default allocator. Must be NULL if
+ * threads is 0. The calling thread is the first worker and uses the
+ * first allocator. The resulting commands are allocated with the
+ * default allocator, like those of gdbwire_interpreter_exec.
+ *
+ * @param out_results
+ * An array of count results, set to the result of each output.
+ *
+ * @param out_mi_commands
+ * An array of count commands. Each is set to an allocated gdbwire mi
+ * command if its result is GDBWIRE_OK, and to NULL otherwise. You
+ * should free the commands with gdbwire_mi_command_free.
+ *
+ * @return
+ * GDBWIRE_OK if the outputs were handled, in which case out_results
+ * holds the result of each one, or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_interpreter_exec_batch(
+        const char *const *interpreter_exec_outputs,
+        const enum gdbwire_mi_command_kind *kinds,
+        size_t count,
+        size_t threads,
+        const struct gdbwire_allocator *allocators,
+        enum gdbwire_result *out_results,
+        struct gdbwire_mi_command **out_mi_commands);
+
+/**
+ * Create a context to handle many interpreter-exec commands with.
+ *
+ * gdbwire_interpreter_exec creates and destroys a GDB/MI parser each
+ * time it is called. A front end that handles many interpreter-exec
+ * commands can instead create a context once and pass it to
+ * gdbwire_interpreter_exec_with_ctx, which reuses the parser and its
+ * memory. Once warmed up, the only memory allocated is for the
+ * resulting command.
+ *
+ * A context may only be used by one thread at a time.
+ *
+ * @return
+ * A new context or NULL on error.
+ */
+struct gdbwire_interpreter_exec_ctx *gdbwire_interpreter_exec_ctx_create(void);
+
+/**
+ * Create a context to handle many interpreter-exec commands with,
+ * that allocates its parser's memory with the given allocator.
+ *
+ * The resulting commands are allocated with the default allocator,
+ * like those of gdbwire_interpreter_exec.
+ *
+ * @param allocator
+ * The allocator to copy and allocate with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new context or NULL on error.
+ */
+struct gdbwire_interpreter_exec_ctx *
+gdbwire_interpreter_exec_ctx_create_with_allocator(
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy a context created with gdbwire_interpreter_exec_ctx_create.
+ *
+ * This function will do nothing if the context is NULL.
+ *
+ * @param ctx
+ * The context to destroy.
+ */
+void gdbwire_interpreter_exec_ctx_destroy(
+        struct gdbwire_interpreter_exec_ctx *ctx);
+
+/**
+ * Handle an interpreter-exec command with a reusable context.
+ *
+ * This behaves like gdbwire_interpreter_exec.
+ *
+ * @param ctx
+ * The context to handle the command with.
+ *
+ * @param interpreter_exec_output
+ * The MI output from GDB for the interpreter exec command.
+ *
+ * @param kind
+ * The interpreter-exec command kind.
+ *
+ * @param out_mi_command
+ * Will return an allocated gdbwire mi command if GDBWIRE_OK is returned
+ * from this function. You should free this memory with
+ * gdbwire_mi_command_free when you are done with it.
+ *
+ * @return
+ * The result of this function.
+ */
+enum gdbwire_result gdbwire_interpreter_exec_with_ctx(
+        struct gdbwire_interpreter_exec_ctx *ctx,
+        const char *interpreter_exec_output,
+        enum gdbwire_mi_command_kind kind,
+        struct gdbwire_mi_command **out_mi_command);
+
 #ifdef __cplusplus 
 }
 #endif 
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gdbwire_allocator.h"
+
+static void *
+gdbwire_system_malloc(void *context, size_t size)
+{
+    return malloc(size);
+}
+
+static void *
+gdbwire_system_realloc(void *context, void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void
+gdbwire_system_free(void *context, void *ptr)
+{
+    free(ptr);
+}
+
+static const struct gdbwire_allocator gdbwire_system_allocator = {
+    NULL,
+    gdbwire_system_malloc,
+    gdbwire_system_realloc,
+    gdbwire_system_free
+};
+
+static struct gdbwire_allocator gdbwire_default_allocator = {
+    NULL,
+    gdbwire_system_malloc,
+    gdbwire_system_realloc,
+    gdbwire_system_free
+};
+
+int
+gdbwire_set_default_allocator(const struct gdbwire_allocator *allocator)
+{
+    if (!allocator) {
+        gdbwire_default_allocator = gdbwire_system_allocator;
+        return 0;
+    }
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return -1;
+    }
+
+    gdbwire_default_allocator = *allocator;
+
+    return 0;
+}
+
+struct gdbwire_allocator
+gdbwire_get_default_allocator(void)
+{
+    return gdbwire_default_allocator;
+}
+
+int
+gdbwire_allocator_valid(const struct gdbwire_allocator *allocator)
+{
+    return !allocator || (allocator->malloc_fn && allocator->realloc_fn &&
+        allocator->free_fn);
+}
+
+void *
+gdbwire_malloc(const struct gdbwire_allocator *allocator, size_t size)
+{
+    if (!allocator) {
+        allocator = &gdbwire_default_allocator;
+    }
+
+    return allocator->malloc_fn(allocator->context, size);
+}
+
+void *
+gdbwire_calloc(const struct gdbwire_allocator *allocator,
+        size_t nmemb, size_t size)
+{
+    void *result = NULL;
+
+    /* Guard against the multiplication overflowing, like calloc does */
+    if (size == 0 || nmemb <= (size_t)-1 / size) {
+        result = gdbwire_malloc(allocator, nmemb * size);
+        if (result) {
+            memset(result, 0, nmemb * size);
+        }
+    }
+
+    return result;
+}
+
+void *
+gdbwire_realloc(const struct gdbwire_allocator *allocator,
+        void *ptr, size_t size)
+{
+    if (!allocator) {
+        allocator = &gdbwire_default_allocator;
+    }
+
+    if (size == 0) {
+        gdbwire_free(allocator, ptr);
+        return NULL;
+    }
+
+    return allocator->realloc_fn(allocator->context, ptr, size);
+}
+
+void
+gdbwire_free(const struct gdbwire_allocator *allocator, void *ptr)
+{
+    if (!allocator) {
+        allocator = &gdbwire_default_allocator;
+    }
+
+    if (ptr) {
+        allocator->free_fn(allocator->context, ptr);
+    }
+}
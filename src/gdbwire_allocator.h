@@ -0,0 +1,184 @@
+#ifndef GDBWIRE_ALLOCATOR_H
+#define GDBWIRE_ALLOCATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+/**
+ * The memory allocator gdbwire uses.
+ *
+ * Every object that gdbwire allocates on behalf of a gdbwire or
+ * gdbwire_mi_parser instance, including the parse trees it hands out,
+ * is allocated with the allocator that instance was created with.
+ * This allows each session to use a separate heap, a per thread pool
+ * or an allocator that bounds the memory a session may use.
+ *
+ * Allocations that are not tied to an instance, such as the logger's,
+ * the GDB/MI commands created by gdbwire_get_mi_command and the
+ * GDB/MI push parser's state, use the default allocator.
+ */
+struct gdbwire_allocator {
+    /**
+     * An arbitrary pointer to associate with the allocator.
+     *
+     * This pointer is passed back to each of the functions below.
+     */
+    void *context;
+
+    /**
+     * Allocate memory.
+     *
+     * @param context
+     * The context pointer above.
+     *
+     * @param size
+     * The number of bytes to allocate.
+     *
+     * @return
+     * The allocated memory or NULL if out of memory.
+     */
+    void *(*malloc_fn)(void *context, size_t size);
+
+    /**
+     * Resize memory allocated by malloc_fn or realloc_fn.
+     *
+     * @param context
+     * The context pointer above.
+     *
+     * @param ptr
+     * The memory to resize, or NULL to allocate new memory.
+     *
+     * @param size
+     * The number of bytes the memory should have, never 0.
+     *
+     * @return
+     * The resized memory or NULL if out of memory, in which case
+     * ptr is left untouched.
+     */
+    void *(*realloc_fn)(void *context, void *ptr, size_t size);
+
+    /**
+     * Free memory allocated by malloc_fn or realloc_fn.
+     *
+     * @param context
+     * The context pointer above.
+     *
+     * @param ptr
+     * The memory to free, never NULL.
+     */
+    void (*free_fn)(void *context, void *ptr);
+};
+
+/**
+ * Set the default allocator.
+ *
+ * The default allocator is used by instances created without an
+ * allocator and for allocations that are not tied to an instance.
+ * Initially the default allocator is the system's malloc, realloc
+ * and free.
+ *
+ * This is not thread safe. Set the default allocator before
+ * gdbwire is used and do not change it while any memory allocated
+ * with the previous default allocator is still in use.
+ *
+ * @param allocator
+ * The allocator to copy as the new default allocator, or NULL to
+ * restore the system allocator.
+ *
+ * @return
+ * 0 on success or -1 if allocator is missing a function.
+ */
+int gdbwire_set_default_allocator(const struct gdbwire_allocator *allocator);
+
+/**
+ * Get the default allocator.
+ *
+ * @return
+ * The default allocator.
+ */
+struct gdbwire_allocator gdbwire_get_default_allocator(void);
+
+/**
+ * Determine if an allocator has all of its functions.
+ *
+ * @param allocator
+ * The allocator to check, NULL represents the default allocator.
+ *
+ * @return
+ * 1 if the allocator may be used or 0 otherwise.
+ */
+int gdbwire_allocator_valid(const struct gdbwire_allocator *allocator);
+
+/**
+ * Allocate memory with an allocator.
+ *
+ * @param allocator
+ * The allocator to use or NULL for the default allocator.
+ *
+ * @param size
+ * The number of bytes to allocate.
+ *
+ * @return
+ * The allocated memory or NULL if out of memory.
+ */
+void *gdbwire_malloc(const struct gdbwire_allocator *allocator, size_t size);
+
+/**
+ * Allocate zero initialized memory with an allocator.
+ *
+ * @param allocator
+ * The allocator to use or NULL for the default allocator.
+ *
+ * @param nmemb
+ * The number of elements to allocate.
+ *
+ * @param size
+ * The size of each element.
+ *
+ * @return
+ * The allocated memory or NULL if out of memory.
+ */
+void *gdbwire_calloc(const struct gdbwire_allocator *allocator,
+        size_t nmemb, size_t size);
+
+/**
+ * Resize memory with an allocator.
+ *
+ * @param allocator
+ * The allocator the memory was allocated with or NULL for the
+ * default allocator.
+ *
+ * @param ptr
+ * The memory to resize, or NULL to allocate new memory.
+ *
+ * @param size
+ * The number of bytes the memory should have. If 0, ptr is freed
+ * and NULL is returned.
+ *
+ * @return
+ * The resized memory or NULL if out of memory, in which case
+ * ptr is left untouched.
+ */
+void *gdbwire_realloc(const struct gdbwire_allocator *allocator,
+        void *ptr, size_t size);
+
+/**
+ * Free memory with an allocator.
+ *
+ * @param allocator
+ * The allocator the memory was allocated with or NULL for the
+ * default allocator.
+ *
+ * @param ptr
+ * The memory to free, OK to pass in NULL.
+ */
+void gdbwire_free(const struct gdbwire_allocator *allocator, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_ALLOCATOR_H */
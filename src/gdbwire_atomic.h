@@ -0,0 +1,99 @@
+#ifndef GDBWIRE_ATOMIC_H
+#define GDBWIRE_ATOMIC_H
+
+/**
+ * Atomic operations on the integers and pointers shared between threads.
+ *
+ * These wrap the __atomic builtins that GCC and Clang provide, which
+ * work on plain integer and pointer types. This keeps the shared
+ * structures usable from C++ and from compilers in C89 mode, unlike
+ * the _Atomic qualified types of C11.
+ */
+
+/**
+ * Atomically read an integer or pointer.
+ *
+ * The reads and writes made by the thread that stored the value are
+ * visible after the load.
+ *
+ * @param ptr
+ * The integer or pointer to read.
+ *
+ * @return
+ * The value read.
+ */
+#define gdbwire_atomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+
+/**
+ * Atomically write an integer or pointer.
+ *
+ * @param ptr
+ * The integer or pointer to write.
+ *
+ * @param value
+ * The value to write.
+ */
+#define gdbwire_atomic_store(ptr, value) \
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+
+/**
+ * Atomically add to an integer.
+ *
+ * @param ptr
+ * The integer to add to.
+ *
+ * @param value
+ * The value to add.
+ *
+ * @return
+ * The value of the integer before the addition.
+ */
+#define gdbwire_atomic_fetch_add(ptr, value) \
+    __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL)
+
+/**
+ * Atomically replace an integer or pointer if it has an expected value.
+ *
+ * @param ptr
+ * The integer or pointer to replace.
+ *
+ * @param expected
+ * A pointer to the value ptr is expected to have. If ptr has another
+ * value, that value is written here instead.
+ *
+ * @param value
+ * The value to write if ptr has the expected value.
+ *
+ * @return
+ * Nonzero if the value was replaced, 0 otherwise.
+ */
+#define gdbwire_atomic_compare_exchange(ptr, expected, value) \
+    __atomic_compare_exchange_n(ptr, expected, value, 0, \
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+/**
+ * Atomically replace an integer or pointer.
+ *
+ * @param ptr
+ * The integer or pointer to replace.
+ *
+ * @param value
+ * The value to write.
+ *
+ * @return
+ * The value before it was replaced.
+ */
+#define gdbwire_atomic_exchange(ptr, value) \
+    __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL)
+
+/**
+ * Order the atomic stores before the fence with the loads after it.
+ *
+ * The acquire and release operations above do not keep a store from
+ * being reordered with a following load of another variable, which a
+ * thread that publishes a value and then checks whether another
+ * thread needs to be woken up relies on.
+ */
+#define gdbwire_atomic_fence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#endif /* GDBWIRE_ATOMIC_H */
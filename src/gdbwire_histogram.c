@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gdbwire_histogram.h"
+
+/* The number of buckets each power of 2 is split into, a power of 2 */
+#define GDBWIRE_HISTOGRAM_SUB_BUCKETS 16
+
+/* The log2 of GDBWIRE_HISTOGRAM_SUB_BUCKETS */
+#define GDBWIRE_HISTOGRAM_SUB_BUCKET_BITS 4
+
+/**
+ * The number of buckets.
+ *
+ * The values below GDBWIRE_HISTOGRAM_SUB_BUCKETS have a bucket each.
+ * Each power of 2 from there up to 2^63 has GDBWIRE_HISTOGRAM_SUB_BUCKETS.
+ */
+#define GDBWIRE_HISTOGRAM_BUCKETS \
+    (GDBWIRE_HISTOGRAM_SUB_BUCKETS * (64 - GDBWIRE_HISTOGRAM_SUB_BUCKET_BITS + 1))
+
+struct gdbwire_histogram {
+    /* The number of values recorded */
+    uint64_t count;
+    /* The smallest and largest values recorded */
+    uint64_t min;
+    uint64_t max;
+    /* The number of values recorded in each bucket */
+    uint64_t buckets[GDBWIRE_HISTOGRAM_BUCKETS];
+    /* The allocator the histogram is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+/**
+ * Get the bucket a value is counted in.
+ *
+ * @param value
+ * The value.
+ *
+ * @return
+ * The index of the bucket.
+ */
+static size_t
+gdbwire_histogram_index(uint64_t value)
+{
+    int magnitude = GDBWIRE_HISTOGRAM_SUB_BUCKET_BITS;
+    uint64_t top = value >> GDBWIRE_HISTOGRAM_SUB_BUCKET_BITS;
+
+    if (value < GDBWIRE_HISTOGRAM_SUB_BUCKETS) {
+        return (size_t)value;
+    }
+
+    /* Find the power of 2 below the value */
+    while (top > 1) {
+        top >>= 1;
+        ++magnitude;
+    }
+
+    /**
+     * The bucket within the power of 2 comes from the bits below the
+     * highest set bit.
+     */
+    return (size_t)((magnitude - GDBWIRE_HISTOGRAM_SUB_BUCKET_BITS + 1) *
+        GDBWIRE_HISTOGRAM_SUB_BUCKETS) + (size_t)((value >>
+        (magnitude - GDBWIRE_HISTOGRAM_SUB_BUCKET_BITS)) -
+        GDBWIRE_HISTOGRAM_SUB_BUCKETS);
+}
+
+/**
+ * Get the largest value counted in a bucket.
+ *
+ * @param index
+ * The index of the bucket.
+ *
+ * @return
+ * The largest value.
+ */
+static uint64_t
+gdbwire_histogram_highest(size_t index)
+{
+    size_t shift;
+    uint64_t lowest;
+
+    if (index < GDBWIRE_HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+
+    shift = index / GDBWIRE_HISTOGRAM_SUB_BUCKETS - 1;
+    lowest = (uint64_t)(GDBWIRE_HISTOGRAM_SUB_BUCKETS +
+        index % GDBWIRE_HISTOGRAM_SUB_BUCKETS) << shift;
+
+    return lowest + (((uint64_t)1 << shift) - 1);
+}
+
+struct gdbwire_histogram *
+gdbwire_histogram_create(void)
+{
+    return gdbwire_histogram_create_with_allocator(NULL);
+}
+
+struct gdbwire_histogram *
+gdbwire_histogram_create_with_allocator(
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_histogram *histogram;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    histogram = (struct gdbwire_histogram *)gdbwire_calloc(allocator, 1,
+        sizeof (struct gdbwire_histogram));
+    if (histogram) {
+        histogram->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
+    }
+
+    return histogram;
+}
+
+void
+gdbwire_histogram_destroy(struct gdbwire_histogram *histogram)
+{
+    if (histogram) {
+        gdbwire_free(&histogram->allocator, histogram);
+    }
+}
+
+void
+gdbwire_histogram_clear(struct gdbwire_histogram *histogram)
+{
+    if (histogram) {
+        histogram->count = 0;
+        histogram->min = 0;
+        histogram->max = 0;
+        memset(histogram->buckets, 0, sizeof(histogram->buckets));
+    }
+}
+
+void
+gdbwire_histogram_record(struct gdbwire_histogram *histogram, uint64_t value)
+{
+    if (histogram) {
+        if (histogram->count == 0 || value < histogram->min) {
+            histogram->min = value;
+        }
+        if (value > histogram->max) {
+            histogram->max = value;
+        }
+        histogram->count++;
+        histogram->buckets[gdbwire_histogram_index(value)]++;
+    }
+}
+
+uint64_t
+gdbwire_histogram_count(const struct gdbwire_histogram *histogram)
+{
+    return (histogram) ? histogram->count : 0;
+}
+
+uint64_t
+gdbwire_histogram_min(const struct gdbwire_histogram *histogram)
+{
+    return (histogram) ? histogram->min : 0;
+}
+
+uint64_t
+gdbwire_histogram_max(const struct gdbwire_histogram *histogram)
+{
+    return (histogram) ? histogram->max : 0;
+}
+
+uint64_t
+gdbwire_histogram_percentile(const struct gdbwire_histogram *histogram,
+        double percentile)
+{
+    uint64_t rank, seen = 0, value;
+    size_t index;
+
+    if (!histogram || histogram->count == 0) {
+        return 0;
+    }
+
+    if (percentile < 0) {
+        percentile = 0;
+    } else if (percentile > 100) {
+        percentile = 100;
+    }
+
+    /* The number of values at or below the percentile, at least 1 */
+    rank = (uint64_t)(percentile / 100 * (double)histogram->count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    for (index = 0; index < GDBWIRE_HISTOGRAM_BUCKETS; ++index) {
+        seen += histogram->buckets[index];
+        if (seen >= rank) {
+            break;
+        }
+    }
+
+    value = gdbwire_histogram_highest(index);
+    return (value > histogram->max) ? histogram->max : value;
+}
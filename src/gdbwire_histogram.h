@@ -0,0 +1,128 @@
+#ifndef GDBWIRE_HISTOGRAM_H
+#define GDBWIRE_HISTOGRAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "gdbwire_allocator.h"
+
+/**
+ * A histogram of values, like latencies in nanoseconds.
+ *
+ * The histogram covers every uint64_t value with a fixed amount of
+ * memory, in the manner of an HDR histogram. Values below 16 are
+ * counted exactly. Larger values are counted in buckets whose width
+ * is a sixteenth of the power of 2 below them, so a value read back
+ * from the histogram is within 6.25% of the value recorded.
+ *
+ * Recording a value does not allocate memory.
+ */
+struct gdbwire_histogram;
+
+/**
+ * Create a histogram instance.
+ *
+ * @return
+ * A new histogram with no values or NULL on error.
+ */
+struct gdbwire_histogram *gdbwire_histogram_create(void);
+
+/**
+ * Create a histogram instance that allocates with the given allocator.
+ *
+ * @param allocator
+ * The allocator to allocate the histogram with, or NULL for the
+ * default allocator.
+ *
+ * @return
+ * A new histogram with no values or NULL on error.
+ */
+struct gdbwire_histogram *gdbwire_histogram_create_with_allocator(
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the histogram instance.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param histogram
+ * The instance to destroy.
+ */
+void gdbwire_histogram_destroy(struct gdbwire_histogram *histogram);
+
+/**
+ * Remove all of the values from the histogram.
+ *
+ * @param histogram
+ * The histogram to clear.
+ */
+void gdbwire_histogram_clear(struct gdbwire_histogram *histogram);
+
+/**
+ * Record a value in the histogram.
+ *
+ * @param histogram
+ * The histogram to record the value in.
+ *
+ * @param value
+ * The value to record.
+ */
+void gdbwire_histogram_record(struct gdbwire_histogram *histogram,
+        uint64_t value);
+
+/**
+ * Get the number of values recorded in the histogram.
+ *
+ * @param histogram
+ * The histogram.
+ *
+ * @return
+ * The number of values recorded.
+ */
+uint64_t gdbwire_histogram_count(const struct gdbwire_histogram *histogram);
+
+/**
+ * Get the smallest value recorded in the histogram.
+ *
+ * @param histogram
+ * The histogram.
+ *
+ * @return
+ * The smallest value recorded exactly, or 0 if there are no values.
+ */
+uint64_t gdbwire_histogram_min(const struct gdbwire_histogram *histogram);
+
+/**
+ * Get the largest value recorded in the histogram.
+ *
+ * @param histogram
+ * The histogram.
+ *
+ * @return
+ * The largest value recorded exactly, or 0 if there are no values.
+ */
+uint64_t gdbwire_histogram_max(const struct gdbwire_histogram *histogram);
+
+/**
+ * Get the value at a percentile of the recorded values.
+ *
+ * @param histogram
+ * The histogram.
+ *
+ * @param percentile
+ * The percentile from 0 to 100, for instance 99.9.
+ *
+ * @return
+ * The largest value in the bucket holding the percentile, never more
+ * than the largest value recorded, or 0 if there are no values.
+ */
+uint64_t gdbwire_histogram_percentile(
+        const struct gdbwire_histogram *histogram, double percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_HISTOGRAM_H */
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <pthread.h>
 
+#include "gdbwire_atomic.h"
 #include "gdbwire_logger.h"
 
 static const char *gdbwire_logger_level_str[GDBWIRE_LOGGER_ERROR+1] = {
@@ -11,34 +13,104 @@ static const char *gdbwire_logger_level_str[GDBWIRE_LOGGER_ERROR+1] = {
     "ERROR"
 };
 
+static void
+gdbwire_logger_stderr_log(void *context, enum gdbwire_logger_level level,
+        const char *file, int line, const char *message)
+{
+    fprintf(stderr, "gdbwire_logger_log: [%s] %s:%d %s\n",
+        gdbwire_logger_level_str[level], file, line, message);
+}
+
+static const struct gdbwire_logger_sink gdbwire_logger_stderr_sink = {
+    NULL,
+    gdbwire_logger_stderr_log,
+    NULL
+};
+
+/* Initializes the level from the environment exactly once */
+static pthread_once_t gdbwire_logger_once = PTHREAD_ONCE_INIT;
+
+/* The lowest level logged, only accessed atomically */
+static int gdbwire_logger_level = GDBWIRE_LOGGER_OFF;
+
+/* Where the log messages go */
+static struct gdbwire_logger_sink gdbwire_logger_sink = {
+    NULL,
+    gdbwire_logger_stderr_log,
+    NULL
+};
+
+static void
+gdbwire_logger_init(void)
+{
+    if (getenv("GDBWIRE_DEBUG_TO_STDERR")) {
+        gdbwire_atomic_store(&gdbwire_logger_level, GDBWIRE_LOGGER_DEBUG);
+    }
+}
+
 void
-gdbwire_logger_log(const char *file, int line, enum gdbwire_logger_level level,
-        const char *fmt, ...)
+gdbwire_logger_set_level(enum gdbwire_logger_level level)
 {
-    static int checked_env = 0;
-    static int gdbwire_debug_to_stderr;
-    char *buf;
-    int size;
+    pthread_once(&gdbwire_logger_once, gdbwire_logger_init);
+    gdbwire_atomic_store(&gdbwire_logger_level, (int)level);
+}
 
-    va_list ap;
-    va_start(ap, fmt);
+enum gdbwire_logger_level
+gdbwire_logger_get_level(void)
+{
+    pthread_once(&gdbwire_logger_once, gdbwire_logger_init);
+    return (enum gdbwire_logger_level)
+        gdbwire_atomic_load(&gdbwire_logger_level);
+}
 
-    size = vsnprintf(0, 0, fmt, ap);
-    buf = malloc(sizeof(char)*size + 1);
+int
+gdbwire_logger_set_sink(const struct gdbwire_logger_sink *sink)
+{
+    if (!sink) {
+        gdbwire_logger_sink = gdbwire_logger_stderr_sink;
+        return 0;
+    }
 
-    va_start(ap, fmt);
-    size = vsnprintf(buf, size + 1, fmt, ap);
-    va_end(ap);
+    if (!sink->log_fn && !sink->log_args_fn) {
+        return -1;
+    }
+
+    gdbwire_logger_sink = *sink;
+
+    return 0;
+}
+
+int
+gdbwire_logger_enabled(enum gdbwire_logger_level level)
+{
+    return level < GDBWIRE_LOGGER_OFF &&
+        (int)level >= (int)gdbwire_logger_get_level();
+}
+
+void
+gdbwire_logger_log(const char *file, int line, enum gdbwire_logger_level level,
+        const char *fmt, ...)
+{
+    char buf[GDBWIRE_LOGGER_MESSAGE_SIZE];
+    va_list ap;
 
-    if (checked_env == 0) {
-        checked_env = 1;
-        gdbwire_debug_to_stderr = getenv("GDBWIRE_DEBUG_TO_STDERR") != NULL;
+    if (!gdbwire_logger_enabled(level)) {
+        return;
     }
 
-    if (gdbwire_debug_to_stderr) {
-        fprintf(stderr, "gdbwire_logger_log: [%s] %s:%d %s\n",
-            gdbwire_logger_level_str[level], file, line, buf);
+    if (gdbwire_logger_sink.log_args_fn) {
+        va_start(ap, fmt);
+        gdbwire_logger_sink.log_args_fn(gdbwire_logger_sink.context, level,
+            file, line, fmt, ap);
+        va_end(ap);
+        return;
     }
 
-    free(buf);
+    /* A message longer than the buffer is truncated */
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    gdbwire_logger_sink.log_fn(gdbwire_logger_sink.context, level,
+        file, line, buf);
 }
@@ -1,6 +1,7 @@
 #ifndef __GDBWIRE_LOGGER_H__
 #define __GDBWIRE_LOGGER_H__
 
+#include <stdarg.h>
 #include "gdbwire_result.h"
 
 #ifdef __cplusplus 
@@ -11,14 +12,154 @@ enum gdbwire_logger_level {
     GDBWIRE_LOGGER_DEBUG,
     GDBWIRE_LOGGER_INFO,
     GDBWIRE_LOGGER_WARN,
-    GDBWIRE_LOGGER_ERROR
+    GDBWIRE_LOGGER_ERROR,
+
+    /* Not a message level, the level that turns all logging off */
+    GDBWIRE_LOGGER_OFF
+};
+
+/**
+ * The minimum level of the log statements compiled into gdbwire.
+ *
+ * The log statements below this level are removed at compile time,
+ * for instance, define it to 1 to remove the gdbwire_debug statements.
+ * This has to be a plain number for the preprocessor to compare,
+ * 0 for GDBWIRE_LOGGER_DEBUG through 3 for GDBWIRE_LOGGER_ERROR.
+ */
+#ifndef GDBWIRE_LOGGER_MIN_LEVEL
+#define GDBWIRE_LOGGER_MIN_LEVEL 0
+#endif
+
+/**
+ * The largest log message, longer messages are truncated.
+ */
+#define GDBWIRE_LOGGER_MESSAGE_SIZE 512
+
+/**
+ * Where the log messages go.
+ *
+ * By default, the messages are written to stderr.
+ */
+struct gdbwire_logger_sink {
+    /**
+     * An arbitrary pointer to associate with the sink.
+     *
+     * This pointer is passed back to the function below.
+     */
+    void *context;
+
+    /**
+     * Receive a log message.
+     *
+     * This may be called from any thread that uses gdbwire,
+     * including several threads at once.
+     *
+     * @param context
+     * The context pointer above.
+     *
+     * @param level
+     * The level of the message.
+     *
+     * @param file
+     * The filename the message was logged from.
+     *
+     * @param line
+     * The line number the message was logged from.
+     *
+     * @param message
+     * The formatted message, only valid during the call.
+     */
+    void (*log_fn)(void *context, enum gdbwire_logger_level level,
+            const char *file, int line, const char *message);
+
+    /**
+     * Receive a log message before it is formatted.
+     *
+     * This function is optional and may be NULL. If it is set, it is
+     * called instead of log_fn, leaving the formatting to the sink.
+     * This allows a sink to defer the formatting, see
+     * gdbwire_logger_async.h.
+     *
+     * @param context
+     * The context pointer above.
+     *
+     * @param level
+     * The level of the message.
+     *
+     * @param file
+     * The filename the message was logged from.
+     *
+     * @param line
+     * The line number the message was logged from.
+     *
+     * @param fmt
+     * The format string for the message (printf formatting).
+     *
+     * @param ap
+     * The format arguments.
+     */
+    void (*log_args_fn)(void *context, enum gdbwire_logger_level level,
+            const char *file, int line, const char *fmt, va_list ap);
 };
 
+/**
+ * Set the level below which log messages are dropped.
+ *
+ * The level is checked before a message is formatted, so the messages
+ * that are dropped cost no more than the check. This may be called at
+ * any time from any thread.
+ *
+ * Initially the level is GDBWIRE_LOGGER_DEBUG if the environment
+ * variable GDBWIRE_DEBUG_TO_STDERR is set and GDBWIRE_LOGGER_OFF
+ * otherwise.
+ *
+ * @param level
+ * The lowest level to log, or GDBWIRE_LOGGER_OFF to log nothing.
+ */
+void gdbwire_logger_set_level(enum gdbwire_logger_level level);
+
+/**
+ * Get the level below which log messages are dropped.
+ *
+ * @return
+ * The lowest level logged.
+ */
+enum gdbwire_logger_level gdbwire_logger_get_level(void);
+
+/**
+ * Set where the log messages go.
+ *
+ * This is not thread safe. Set the sink before gdbwire is used
+ * from other threads.
+ *
+ * @param sink
+ * The sink to copy, or NULL to restore writing to stderr.
+ *
+ * @return
+ * 0 on success or -1 if the sink has neither log function.
+ */
+int gdbwire_logger_set_sink(const struct gdbwire_logger_sink *sink);
+
+/**
+ * Determine if messages of a level are logged.
+ *
+ * @param level
+ * The level to check.
+ *
+ * @return
+ * 1 if messages of the level are logged, 0 otherwise.
+ */
+int gdbwire_logger_enabled(enum gdbwire_logger_level level);
+
 /**
  * Log a statement to the logger.
  *
  * This is typically not called directly. Use the below macros instead.
- * The macros automatically supply the file, line and level arguments.
+ * The macros automatically supply the file, line and level arguments,
+ * and only evaluate the format arguments if the level is logged.
+ *
+ * The message is formatted into a buffer on the stack, logging does not
+ * allocate memory.
  *
  * @param file
  * The filename the logger was invoked from.
@@ -38,15 +179,39 @@ enum gdbwire_logger_level {
 void gdbwire_logger_log(const char *file, int line,
         enum gdbwire_logger_level level, const char *fmt, ...);
 
+/* Log a statement if its level is logged */
+#define gdbwire_logger_log_enabled(level, fmt, ...) \
+        (gdbwire_logger_enabled(level) ? gdbwire_logger_log(__FILE__, \
+        __LINE__, level, fmt, ##__VA_ARGS__) : (void)0)
+
 /* The macros intended to be used for logging */
-#define gdbwire_debug(fmt, ...)(gdbwire_logger_log(__FILE__, __LINE__, \
-        GDBWIRE_LOGGER_DEBUG, fmt, ##__VA_ARGS__))
-#define gdbwire_info(fmt, ...)(gdbwire_logger_log(__FILE__, __LINE__, \
-        GDBWIRE_LOGGER_INFO, fmt, ##__VA_ARGS__))
-#define gdbwire_warn(fmt, ...)(gdbwire_logger_log(__FILE__, __LINE__, \
-        GDBWIRE_LOGGER_WARN, fmt, ##__VA_ARGS__))
-#define gdbwire_error(fmt, ...)(gdbwire_logger_log(__FILE__, __LINE__, \
-        GDBWIRE_LOGGER_ERROR, fmt, ##__VA_ARGS__))
+#if GDBWIRE_LOGGER_MIN_LEVEL <= 0
+#define gdbwire_debug(fmt, ...) \
+        gdbwire_logger_log_enabled(GDBWIRE_LOGGER_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define gdbwire_debug(fmt, ...) ((void)0)
+#endif
+
+#if GDBWIRE_LOGGER_MIN_LEVEL <= 1
+#define gdbwire_info(fmt, ...) \
+        gdbwire_logger_log_enabled(GDBWIRE_LOGGER_INFO, fmt, ##__VA_ARGS__)
+#else
+#define gdbwire_info(fmt, ...) ((void)0)
+#endif
+
+#if GDBWIRE_LOGGER_MIN_LEVEL <= 2
+#define gdbwire_warn(fmt, ...) \
+        gdbwire_logger_log_enabled(GDBWIRE_LOGGER_WARN, fmt, ##__VA_ARGS__)
+#else
+#define gdbwire_warn(fmt, ...) ((void)0)
+#endif
+
+#if GDBWIRE_LOGGER_MIN_LEVEL <= 3
+#define gdbwire_error(fmt, ...) \
+        gdbwire_logger_log_enabled(GDBWIRE_LOGGER_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define gdbwire_error(fmt, ...) ((void)0)
+#endif
 
 #ifdef __cplusplus 
 }
@@ -0,0 +1,1087 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "gdbwire_allocator.h"
+#include "gdbwire_atomic.h"
+#include "gdbwire_logger_async.h"
+
+/**
+ * The largest record a logging thread writes into its ring.
+ *
+ * A record is built on the logging thread's stack before it is copied
+ * into the ring. A message whose arguments do not fit is formatted
+ * right away and its record holds the formatted message instead.
+ */
+#define GDBWIRE_LOGGER_ASYNC_RECORD_SIZE (2 * GDBWIRE_LOGGER_MESSAGE_SIZE)
+
+/* The largest conversion specification, like %-#08.*lld, supported */
+#define GDBWIRE_LOGGER_ASYNC_SPEC_SIZE 32
+
+/* The record size that tells the background thread to skip to the start */
+#define GDBWIRE_LOGGER_ASYNC_WRAP ((size_t)-1)
+
+/* The string length that stands for a NULL string argument */
+#define GDBWIRE_LOGGER_ASYNC_NULL_STRING ((size_t)-1)
+
+/* What a NULL string argument is formatted as, passing NULL for %s is UB */
+#define GDBWIRE_LOGGER_ASYNC_NULL_TEXT "(null)"
+
+/* The smallest ring, it must fit two of the largest records */
+#define GDBWIRE_LOGGER_ASYNC_MIN_RING_SIZE \
+    (4 * GDBWIRE_LOGGER_ASYNC_RECORD_SIZE)
+
+/**
+ * The type of a format argument, determined by its conversion
+ * specification.
+ */
+enum gdbwire_logger_async_arg {
+    GDBWIRE_LOGGER_ASYNC_ARG_INT,
+    GDBWIRE_LOGGER_ASYNC_ARG_LONG,
+    GDBWIRE_LOGGER_ASYNC_ARG_LLONG,
+    GDBWIRE_LOGGER_ASYNC_ARG_INTMAX,
+    GDBWIRE_LOGGER_ASYNC_ARG_SIZE,
+    GDBWIRE_LOGGER_ASYNC_ARG_PTRDIFF,
+    GDBWIRE_LOGGER_ASYNC_ARG_DOUBLE,
+    GDBWIRE_LOGGER_ASYNC_ARG_LDOUBLE,
+    GDBWIRE_LOGGER_ASYNC_ARG_POINTER,
+    GDBWIRE_LOGGER_ASYNC_ARG_STRING,
+
+    /* The specification is %%, it takes no argument */
+    GDBWIRE_LOGGER_ASYNC_ARG_NONE,
+
+    /* The specification is not supported, like %n, %ls or %1$d */
+    GDBWIRE_LOGGER_ASYNC_ARG_UNSUPPORTED
+};
+
+/**
+ * A conversion specification in a format string.
+ */
+struct gdbwire_logger_async_spec {
+    /* The size of the specification, starting at the % */
+    size_t size;
+
+    /* The number of * widths and precisions, each takes an int */
+    int stars;
+
+    /* The argument the specification takes */
+    enum gdbwire_logger_async_arg arg;
+};
+
+/**
+ * The start of a record in a ring.
+ *
+ * The encoded format arguments follow the record, in the order they
+ * appear in the format string. Each argument is stored as its own type
+ * in a slot padded to 8 bytes. A string argument is stored as its
+ * length, followed by its characters and a NUL terminator.
+ */
+struct gdbwire_logger_async_record {
+    /**
+     * The size of the record and its arguments, a multiple of 8.
+     *
+     * GDBWIRE_LOGGER_ASYNC_WRAP if the rest of the ring is unused
+     * and the next record is at the start of the ring.
+     */
+    size_t size;
+    enum gdbwire_logger_level level;
+    int line;
+    const char *file;
+    const char *fmt;
+    struct timespec time;
+};
+
+/**
+ * A single producer, single consumer ring of records.
+ *
+ * Each logging thread writes to a ring of its own and only the
+ * background thread reads from it. The logging thread advances head
+ * after writing a record, the background thread advances tail after
+ * reading one. Both only ever increase, the position in the ring is
+ * the counter masked by the ring size.
+ */
+struct gdbwire_logger_async_ring {
+    /* The next ring, only changed by the background thread */
+    struct gdbwire_logger_async_ring *next;
+
+    /* The asynchronous sink the ring belongs to */
+    struct gdbwire_logger_async *async;
+
+    char *data;
+    size_t mask;
+
+    /* Where the next record is written, only accessed atomically */
+    size_t head;
+
+    /* Where the next record is read, only accessed atomically */
+    size_t tail;
+
+    /* Nonzero once the logging thread exited, only accessed atomically */
+    int closed;
+};
+
+struct gdbwire_logger_async {
+    /* The size of each ring, a power of 2 */
+    size_t ring_size;
+
+    /* Where the formatted messages go, log_fn is NULL for stderr */
+    struct gdbwire_logger_sink output;
+
+    /* The ring of the calling thread */
+    pthread_key_t key;
+
+    /* The rings of all threads, pushed onto the front atomically */
+    struct gdbwire_logger_async_ring *rings;
+
+    /* The number of dropped messages, only accessed atomically */
+    size_t dropped;
+
+    /* Nonzero when the background thread should exit */
+    int stop;
+
+    /* Nonzero while the background thread waits, accessed atomically */
+    int waiting;
+
+    /* Lets the background thread sleep while the rings are empty */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    pthread_t thread;
+};
+
+static const char *gdbwire_logger_async_level_str[GDBWIRE_LOGGER_ERROR+1] = {
+    "DEBUG",
+    "INFO",
+    "WARN",
+    "ERROR"
+};
+
+/**
+ * Round a size up to the 8 byte slots records are made of.
+ *
+ * @param size
+ * The size to round up.
+ *
+ * @return
+ * The rounded up size.
+ */
+static size_t
+gdbwire_logger_async_align(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+/**
+ * Parse the conversion specification at the start of a string.
+ *
+ * The logging thread and the background thread both parse the format
+ * string with this function, which keeps the order and types of the
+ * stored arguments in agreement.
+ *
+ * @param fmt
+ * The format string, starting at a %.
+ *
+ * @param spec
+ * The parsed specification.
+ */
+static void
+gdbwire_logger_async_parse_spec(const char *fmt,
+        struct gdbwire_logger_async_spec *spec)
+{
+    const char *p = fmt + 1;
+    char modifier = 0;
+
+    spec->stars = 0;
+    spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_UNSUPPORTED;
+
+    /* Flags */
+    while (*p && strchr("-+ #0'", *p)) {
+        ++p;
+    }
+
+    /* Width */
+    if (*p == '*') {
+        spec->stars++;
+        ++p;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            ++p;
+        }
+        if (*p == '$') {
+            /* Positional arguments are not supported */
+            spec->size = p - fmt + 1;
+            return;
+        }
+    }
+
+    /* Precision */
+    if (*p == '.') {
+        ++p;
+        if (*p == '*') {
+            spec->stars++;
+            ++p;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                ++p;
+            }
+        }
+    }
+
+    /* Length modifier */
+    switch (*p) {
+        case 'h':
+            modifier = (p[1] == 'h') ? 'H' : 'h';
+            break;
+        case 'l':
+            modifier = (p[1] == 'l') ? 'q' : 'l';
+            break;
+        case 'j': case 'z': case 't': case 'L': case 'q':
+            modifier = *p;
+            break;
+    }
+    p += (modifier == 'H' || (modifier == 'q' && *p == 'l')) ? 2 :
+        (modifier) ? 1 : 0;
+
+    /* Conversion */
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            switch (modifier) {
+                case 0: case 'h': case 'H':
+                    /* The h and hh arguments are promoted to int */
+                    spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_INT;
+                    break;
+                case 'l':
+                    spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_LONG;
+                    break;
+                case 'q':
+                    spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_LLONG;
+                    break;
+                case 'j':
+                    spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_INTMAX;
+                    break;
+                case 'z':
+                    spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_SIZE;
+                    break;
+                case 't':
+                    spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_PTRDIFF;
+                    break;
+            }
+            break;
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'a': case 'A':
+            if (modifier == 0 || modifier == 'l') {
+                spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_DOUBLE;
+            } else if (modifier == 'L') {
+                spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_LDOUBLE;
+            }
+            break;
+        case 'c':
+            if (modifier == 0) {
+                spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_INT;
+            }
+            break;
+        case 'p':
+            if (modifier == 0) {
+                spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_POINTER;
+            }
+            break;
+        case 's':
+            if (modifier == 0) {
+                spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_STRING;
+            }
+            break;
+        case '%':
+            if (p == fmt + 1) {
+                spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_NONE;
+            }
+            break;
+    }
+
+    spec->size = (*p) ? p - fmt + 1 : p - fmt;
+    if (spec->size >= GDBWIRE_LOGGER_ASYNC_SPEC_SIZE) {
+        spec->arg = GDBWIRE_LOGGER_ASYNC_ARG_UNSUPPORTED;
+    }
+}
+
+/**
+ * Store a value in the next slot of a record.
+ *
+ * @param record
+ * The record being built.
+ *
+ * @param size
+ * The size of the record so far, advanced past the slot.
+ *
+ * @param value
+ * The value to store.
+ *
+ * @param value_size
+ * The size of the value.
+ *
+ * @return
+ * 0 on success or -1 if the value does not fit in the record.
+ */
+static int
+gdbwire_logger_async_put(char *record, size_t *size, const void *value,
+        size_t value_size)
+{
+    size_t slot_size = gdbwire_logger_async_align(value_size);
+
+    if (slot_size > GDBWIRE_LOGGER_ASYNC_RECORD_SIZE - *size) {
+        return -1;
+    }
+
+    memcpy(record + *size, value, value_size);
+    *size += slot_size;
+
+    return 0;
+}
+
+/**
+ * Store a string argument in a record.
+ *
+ * The string is copied, since it may be gone by the time the record
+ * is formatted. Only as much of it as fits in a formatted message is
+ * copied.
+ *
+ * @param record
+ * The record being built.
+ *
+ * @param size
+ * The size of the record so far, advanced past the string.
+ *
+ * @param value
+ * The string to store, may be NULL.
+ *
+ * @return
+ * 0 on success or -1 if the string does not fit in the record.
+ */
+static int
+gdbwire_logger_async_put_string(char *record, size_t *size, const char *value)
+{
+    size_t length = GDBWIRE_LOGGER_ASYNC_NULL_STRING;
+
+    if (value) {
+        for (length = 0; length < GDBWIRE_LOGGER_MESSAGE_SIZE - 1 &&
+                value[length]; ++length) {
+        }
+    }
+
+    if (gdbwire_logger_async_put(record, size, &length, sizeof(length)) == -1) {
+        return -1;
+    }
+
+    if (value) {
+        if (gdbwire_logger_async_align(length + 1) >
+                GDBWIRE_LOGGER_ASYNC_RECORD_SIZE - *size) {
+            return -1;
+        }
+        memcpy(record + *size, value, length);
+        record[*size + length] = 0;
+        *size += gdbwire_logger_async_align(length + 1);
+    }
+
+    return 0;
+}
+
+/**
+ * Store the format arguments of a message in a record.
+ *
+ * @param record
+ * The record being built, its header is already filled in.
+ *
+ * @param size
+ * The size of the record so far, advanced past the arguments.
+ *
+ * @param fmt
+ * The format string.
+ *
+ * @param ap
+ * The format arguments.
+ *
+ * @return
+ * 0 on success or -1 if the format string has a specification that is
+ * not supported or the arguments do not fit in the record.
+ */
+static int
+gdbwire_logger_async_put_args(char *record, size_t *size, const char *fmt,
+        va_list ap)
+{
+    struct gdbwire_logger_async_spec spec;
+    int index, star;
+    int result = 0;
+
+    for (; *fmt && result == 0; ++fmt) {
+        if (*fmt != '%') {
+            continue;
+        }
+
+        gdbwire_logger_async_parse_spec(fmt, &spec);
+        if (spec.arg == GDBWIRE_LOGGER_ASYNC_ARG_UNSUPPORTED) {
+            return -1;
+        }
+        fmt += spec.size - 1;
+
+        for (index = 0; index < spec.stars && result == 0; ++index) {
+            star = va_arg(ap, int);
+            result = gdbwire_logger_async_put(record, size, &star,
+                sizeof(star));
+        }
+        if (result == -1) {
+            break;
+        }
+
+        switch (spec.arg) {
+            case GDBWIRE_LOGGER_ASYNC_ARG_INT: {
+                int value = va_arg(ap, int);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_LONG: {
+                long value = va_arg(ap, long);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_LLONG: {
+                long long value = va_arg(ap, long long);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_INTMAX: {
+                intmax_t value = va_arg(ap, intmax_t);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_SIZE: {
+                size_t value = va_arg(ap, size_t);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_PTRDIFF: {
+                ptrdiff_t value = va_arg(ap, ptrdiff_t);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_DOUBLE: {
+                double value = va_arg(ap, double);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_LDOUBLE: {
+                long double value = va_arg(ap, long double);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_POINTER: {
+                void *value = va_arg(ap, void *);
+                result = gdbwire_logger_async_put(record, size,
+                    &value, sizeof(value));
+                break;
+            }
+            case GDBWIRE_LOGGER_ASYNC_ARG_STRING:
+                result = gdbwire_logger_async_put_string(record, size,
+                    va_arg(ap, const char *));
+                break;
+            default:
+                break;
+        }
+    }
+
+    return result;
+}
+
+/* Format a value with the star arguments of its specification */
+#define GDBWIRE_LOGGER_ASYNC_FORMAT(out, avail, spec, stars, star, value) \
+    ((stars == 0) ? snprintf(out, avail, spec, value) : \
+     (stars == 1) ? snprintf(out, avail, spec, star[0], value) : \
+     snprintf(out, avail, spec, star[0], star[1], value))
+
+/* Read the value in the next slot of a record and format it */
+#define GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(type) \
+    do { \
+        type value; \
+        memcpy(&value, args, sizeof(value)); \
+        args += gdbwire_logger_async_align(sizeof(value)); \
+        written = GDBWIRE_LOGGER_ASYNC_FORMAT(out, avail, spec_str, \
+            spec.stars, star, value); \
+    } while (0)
+
+/**
+ * Format a record into a message.
+ *
+ * @param record
+ * The record to format.
+ *
+ * @param message
+ * The buffer to format into, GDBWIRE_LOGGER_MESSAGE_SIZE bytes.
+ */
+static void
+gdbwire_logger_async_format(const struct gdbwire_logger_async_record *record,
+        char *message)
+{
+    const char *args = (const char *)record +
+        gdbwire_logger_async_align(sizeof(*record));
+    const char *fmt = record->fmt;
+    char *out = message;
+    size_t avail = GDBWIRE_LOGGER_MESSAGE_SIZE;
+    char spec_str[GDBWIRE_LOGGER_ASYNC_SPEC_SIZE];
+    struct gdbwire_logger_async_spec spec;
+    int star[2], index, written;
+    size_t length;
+
+    while (*fmt && avail > 1) {
+        if (*fmt != '%') {
+            *out++ = *fmt++;
+            --avail;
+            continue;
+        }
+
+        gdbwire_logger_async_parse_spec(fmt, &spec);
+        memcpy(spec_str, fmt, spec.size);
+        spec_str[spec.size] = 0;
+        fmt += spec.size;
+
+        for (index = 0; index < spec.stars; ++index) {
+            memcpy(&star[index], args, sizeof(int));
+            args += gdbwire_logger_async_align(sizeof(int));
+        }
+
+        written = 0;
+        switch (spec.arg) {
+            case GDBWIRE_LOGGER_ASYNC_ARG_INT:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(int);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_LONG:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(long);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_LLONG:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(long long);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_INTMAX:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(intmax_t);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_SIZE:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(size_t);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_PTRDIFF:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(ptrdiff_t);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_DOUBLE:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(double);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_LDOUBLE:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(long double);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_POINTER:
+                GDBWIRE_LOGGER_ASYNC_FORMAT_SLOT(void *);
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_STRING:
+                memcpy(&length, args, sizeof(length));
+                args += gdbwire_logger_async_align(sizeof(length));
+                if (length == GDBWIRE_LOGGER_ASYNC_NULL_STRING) {
+                    written = GDBWIRE_LOGGER_ASYNC_FORMAT(out, avail,
+                        spec_str, spec.stars, star,
+                        GDBWIRE_LOGGER_ASYNC_NULL_TEXT);
+                } else {
+                    written = GDBWIRE_LOGGER_ASYNC_FORMAT(out, avail,
+                        spec_str, spec.stars, star, args);
+                    args += gdbwire_logger_async_align(length + 1);
+                }
+                break;
+            case GDBWIRE_LOGGER_ASYNC_ARG_NONE:
+                *out = '%';
+                written = 1;
+                break;
+            default:
+                break;
+        }
+
+        if (written < 0) {
+            written = 0;
+        }
+        if ((size_t)written >= avail) {
+            out += avail - 1;
+            avail = 1;
+        } else {
+            out += written;
+            avail -= written;
+        }
+    }
+
+    *out = 0;
+}
+
+/**
+ * Get the ring of the calling thread, creating it on first use.
+ *
+ * @param async
+ * The asynchronous sink.
+ *
+ * @return
+ * The ring or NULL if out of memory.
+ */
+static struct gdbwire_logger_async_ring *
+gdbwire_logger_async_get_ring(struct gdbwire_logger_async *async)
+{
+    struct gdbwire_logger_async_ring *ring;
+
+    ring = (struct gdbwire_logger_async_ring *)pthread_getspecific(async->key);
+    if (ring) {
+        return ring;
+    }
+
+    ring = (struct gdbwire_logger_async_ring *)gdbwire_calloc(NULL, 1,
+        sizeof(*ring));
+    if (!ring) {
+        return NULL;
+    }
+
+    ring->data = (char *)gdbwire_malloc(NULL, async->ring_size);
+    if (!ring->data || pthread_setspecific(async->key, ring) != 0) {
+        gdbwire_free(NULL, ring->data);
+        gdbwire_free(NULL, ring);
+        return NULL;
+    }
+    ring->mask = async->ring_size - 1;
+    ring->async = async;
+
+    /* Only the front of the list changes concurrently */
+    ring->next = gdbwire_atomic_load(&async->rings);
+    while (!gdbwire_atomic_compare_exchange(&async->rings, &ring->next,
+            ring)) {
+    }
+
+    return ring;
+}
+
+/**
+ * Wake the background thread if it is waiting for a record.
+ *
+ * @param async
+ * The asynchronous sink.
+ */
+static void
+gdbwire_logger_async_wake(struct gdbwire_logger_async *async)
+{
+    /* Either the background thread sees the change or this sees it wait */
+    gdbwire_atomic_fence();
+    if (gdbwire_atomic_load(&async->waiting)) {
+        pthread_mutex_lock(&async->mutex);
+        pthread_cond_signal(&async->cond);
+        pthread_mutex_unlock(&async->mutex);
+    }
+}
+
+/**
+ * Mark the ring of an exiting thread as closed.
+ *
+ * The background thread frees the ring once it is empty.
+ *
+ * @param data
+ * The ring of the exiting thread.
+ */
+static void
+gdbwire_logger_async_close_ring(void *data)
+{
+    struct gdbwire_logger_async_ring *ring =
+        (struct gdbwire_logger_async_ring *)data;
+    struct gdbwire_logger_async *async = ring->async;
+
+    /* The background thread may free the ring once it is closed */
+    gdbwire_atomic_store(&ring->closed, 1);
+    gdbwire_logger_async_wake(async);
+}
+
+/**
+ * Write a record into a ring.
+ *
+ * @param ring
+ * The ring of the calling thread.
+ *
+ * @param record
+ * The record to write.
+ *
+ * @return
+ * 0 on success or -1 if the ring is full.
+ */
+static int
+gdbwire_logger_async_write(struct gdbwire_logger_async_ring *ring,
+        const struct gdbwire_logger_async_record *record)
+{
+    size_t ring_size = ring->mask + 1;
+    size_t head = ring->head;
+    size_t offset = head & ring->mask;
+    size_t contiguous = ring_size - offset;
+    size_t needed = record->size;
+    size_t wrap = GDBWIRE_LOGGER_ASYNC_WRAP;
+
+    /* A record does not wrap around, it starts over at the front */
+    if (contiguous < record->size) {
+        needed += contiguous;
+    }
+
+    if (ring_size - (head - gdbwire_atomic_load(&ring->tail)) < needed) {
+        return -1;
+    }
+
+    if (contiguous < record->size) {
+        memcpy(ring->data + offset, &wrap, sizeof(wrap));
+        head += contiguous;
+        offset = 0;
+    }
+
+    memcpy(ring->data + offset, record, record->size);
+    gdbwire_atomic_store(&ring->head, head + record->size);
+
+    return 0;
+}
+
+/**
+ * Queue a log message, the log_args_fn of the asynchronous sink.
+ */
+static void
+gdbwire_logger_async_log_args(void *context, enum gdbwire_logger_level level,
+        const char *file, int line, const char *fmt, va_list ap)
+{
+    struct gdbwire_logger_async *async =
+        (struct gdbwire_logger_async *)context;
+    struct gdbwire_logger_async_ring *ring;
+    union {
+        struct gdbwire_logger_async_record record;
+        char data[GDBWIRE_LOGGER_ASYNC_RECORD_SIZE];
+    } buffer;
+    char message[GDBWIRE_LOGGER_MESSAGE_SIZE];
+    size_t header_size = gdbwire_logger_async_align(sizeof(buffer.record));
+    size_t size = header_size;
+    va_list args;
+    int result;
+
+    ring = gdbwire_logger_async_get_ring(async);
+    if (!ring) {
+        gdbwire_atomic_fetch_add(&async->dropped, 1);
+        return;
+    }
+
+    buffer.record.level = level;
+    buffer.record.line = line;
+    buffer.record.file = file;
+    buffer.record.fmt = fmt;
+    clock_gettime(CLOCK_REALTIME, &buffer.record.time);
+
+    va_copy(args, ap);
+    result = gdbwire_logger_async_put_args(buffer.data, &size, fmt, args);
+    va_end(args);
+
+    /* Format what can not be deferred now and queue the message */
+    if (result == -1) {
+        vsnprintf(message, sizeof(message), fmt, ap);
+        buffer.record.fmt = "%s";
+        size = header_size;
+        gdbwire_logger_async_put_string(buffer.data, &size, message);
+    }
+
+    buffer.record.size = size;
+    if (gdbwire_logger_async_write(ring, &buffer.record) == -1) {
+        gdbwire_atomic_fetch_add(&async->dropped, 1);
+    } else {
+        gdbwire_logger_async_wake(async);
+    }
+}
+
+/**
+ * Hand a formatted message to the output.
+ *
+ * @param async
+ * The asynchronous sink.
+ *
+ * @param record
+ * The record the message was formatted from.
+ *
+ * @param message
+ * The formatted message.
+ */
+static void
+gdbwire_logger_async_output(struct gdbwire_logger_async *async,
+        const struct gdbwire_logger_async_record *record, const char *message)
+{
+    if (async->output.log_fn) {
+        async->output.log_fn(async->output.context, record->level,
+            record->file, record->line, message);
+    } else {
+        fprintf(stderr, "gdbwire_logger_log: %ld.%09ld [%s] %s:%d %s\n",
+            (long)record->time.tv_sec, (long)record->time.tv_nsec,
+            gdbwire_logger_async_level_str[record->level],
+            record->file, record->line, message);
+    }
+}
+
+/**
+ * Format and output the records in a ring.
+ *
+ * @param async
+ * The asynchronous sink.
+ *
+ * @param ring
+ * The ring to empty.
+ *
+ * @return
+ * The number of records read.
+ */
+static size_t
+gdbwire_logger_async_drain(struct gdbwire_logger_async *async,
+        struct gdbwire_logger_async_ring *ring)
+{
+    union {
+        struct gdbwire_logger_async_record record;
+        char data[GDBWIRE_LOGGER_ASYNC_RECORD_SIZE];
+    } buffer;
+    char message[GDBWIRE_LOGGER_MESSAGE_SIZE];
+    size_t ring_size = ring->mask + 1;
+    size_t tail = ring->tail;
+    size_t head = gdbwire_atomic_load(&ring->head);
+    size_t offset, count = 0;
+
+    while (tail != head) {
+        offset = tail & ring->mask;
+        memcpy(&buffer.record.size, ring->data + offset, sizeof(size_t));
+        if (buffer.record.size == GDBWIRE_LOGGER_ASYNC_WRAP) {
+            tail += ring_size - offset;
+            continue;
+        }
+
+        /* Copy the record out to give the space back right away */
+        memcpy(buffer.data, ring->data + offset, buffer.record.size);
+        tail += buffer.record.size;
+        gdbwire_atomic_store(&ring->tail, tail);
+
+        gdbwire_logger_async_format(&buffer.record, message);
+        gdbwire_logger_async_output(async, &buffer.record, message);
+        ++count;
+    }
+
+    gdbwire_atomic_store(&ring->tail, tail);
+
+    return count;
+}
+
+/**
+ * Empty every ring once, freeing the rings of exited threads.
+ *
+ * @param async
+ * The asynchronous sink.
+ *
+ * @return
+ * The number of records read.
+ */
+static size_t
+gdbwire_logger_async_drain_all(struct gdbwire_logger_async *async)
+{
+    struct gdbwire_logger_async_ring *ring, *prev = NULL, *next, *front;
+    size_t count = 0;
+    int closed;
+
+    for (ring = gdbwire_atomic_load(&async->rings); ring; ring = next) {
+        next = ring->next;
+
+        /* Read closed before draining, nothing is written after it */
+        closed = gdbwire_atomic_load(&ring->closed);
+        count += gdbwire_logger_async_drain(async, ring);
+
+        /**
+         * Logging threads push new rings onto the front of the list
+         * concurrently, so the front is only unlinked if it is still
+         * the front. Otherwise it is unlinked on the next pass.
+         */
+        front = ring;
+        if (closed && (prev || gdbwire_atomic_compare_exchange(
+                &async->rings, &front, next))) {
+            if (prev) {
+                prev->next = next;
+            }
+            gdbwire_free(NULL, ring->data);
+            gdbwire_free(NULL, ring);
+        } else {
+            prev = ring;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Check if the background thread has nothing to do.
+ *
+ * @param async
+ * The asynchronous sink.
+ *
+ * @return
+ * 1 if every ring is empty and open, 0 otherwise.
+ */
+static int
+gdbwire_logger_async_idle(struct gdbwire_logger_async *async)
+{
+    struct gdbwire_logger_async_ring *ring;
+
+    for (ring = gdbwire_atomic_load(&async->rings); ring; ring = ring->next) {
+        if (gdbwire_atomic_load(&ring->closed) ||
+                gdbwire_atomic_load(&ring->head) != ring->tail) {
+            return 0;
+        }
+    }
+
+    return !gdbwire_atomic_load(&async->stop);
+}
+
+/**
+ * The background thread, it formats and outputs the records.
+ *
+ * @param data
+ * The asynchronous sink.
+ *
+ * @return
+ * NULL.
+ */
+static void *
+gdbwire_logger_async_thread(void *data)
+{
+    struct gdbwire_logger_async *async = (struct gdbwire_logger_async *)data;
+
+    while (!gdbwire_atomic_load(&async->stop)) {
+        if (gdbwire_logger_async_drain_all(async) > 0) {
+            continue;
+        }
+
+        /**
+         * Sleep until a record is written or a thread exits. A logging
+         * thread checks for a waiting background thread after either,
+         * so either it sees the wait or the check below sees the change.
+         */
+        pthread_mutex_lock(&async->mutex);
+        gdbwire_atomic_store(&async->waiting, 1);
+        gdbwire_atomic_fence();
+        if (gdbwire_logger_async_idle(async)) {
+            pthread_cond_wait(&async->cond, &async->mutex);
+        }
+        gdbwire_atomic_store(&async->waiting, 0);
+        pthread_mutex_unlock(&async->mutex);
+    }
+
+    /* The messages logged before the stop request */
+    gdbwire_logger_async_drain_all(async);
+
+    return NULL;
+}
+
+struct gdbwire_logger_async *
+gdbwire_logger_async_create(size_t ring_size,
+        const struct gdbwire_logger_sink *output)
+{
+    struct gdbwire_logger_async *async;
+    size_t size = GDBWIRE_LOGGER_ASYNC_MIN_RING_SIZE;
+
+    while (size < ring_size) {
+        if (size > (size_t)-1 / 2) {
+            return NULL;
+        }
+        size *= 2;
+    }
+
+    async = (struct gdbwire_logger_async *)gdbwire_calloc(NULL, 1,
+        sizeof(*async));
+    if (!async) {
+        return NULL;
+    }
+
+    async->ring_size = size;
+    if (output) {
+        async->output = *output;
+    }
+
+    if (pthread_mutex_init(&async->mutex, NULL) != 0) {
+        gdbwire_free(NULL, async);
+        return NULL;
+    }
+
+    if (pthread_cond_init(&async->cond, NULL) != 0) {
+        pthread_mutex_destroy(&async->mutex);
+        gdbwire_free(NULL, async);
+        return NULL;
+    }
+
+    if (pthread_key_create(&async->key,
+            gdbwire_logger_async_close_ring) != 0) {
+        pthread_cond_destroy(&async->cond);
+        pthread_mutex_destroy(&async->mutex);
+        gdbwire_free(NULL, async);
+        return NULL;
+    }
+
+    if (pthread_create(&async->thread, NULL,
+            gdbwire_logger_async_thread, async) != 0) {
+        pthread_key_delete(async->key);
+        pthread_cond_destroy(&async->cond);
+        pthread_mutex_destroy(&async->mutex);
+        gdbwire_free(NULL, async);
+        return NULL;
+    }
+
+    return async;
+}
+
+void
+gdbwire_logger_async_destroy(struct gdbwire_logger_async *async)
+{
+    struct gdbwire_logger_async_ring *ring, *next;
+
+    if (async) {
+        pthread_mutex_lock(&async->mutex);
+        gdbwire_atomic_store(&async->stop, 1);
+        pthread_cond_signal(&async->cond);
+        pthread_mutex_unlock(&async->mutex);
+        pthread_join(async->thread, NULL);
+
+        pthread_key_delete(async->key);
+        pthread_cond_destroy(&async->cond);
+        pthread_mutex_destroy(&async->mutex);
+
+        for (ring = async->rings; ring; ring = next) {
+            next = ring->next;
+            gdbwire_free(NULL, ring->data);
+            gdbwire_free(NULL, ring);
+        }
+
+        gdbwire_free(NULL, async);
+    }
+}
+
+struct gdbwire_logger_sink
+gdbwire_logger_async_get_sink(struct gdbwire_logger_async *async)
+{
+    struct gdbwire_logger_sink sink = { NULL, NULL, NULL };
+    sink.context = async;
+    sink.log_args_fn = gdbwire_logger_async_log_args;
+    return sink;
+}
+
+size_t
+gdbwire_logger_async_get_dropped(struct gdbwire_logger_async *async)
+{
+    return gdbwire_atomic_load(&async->dropped);
+}
@@ -0,0 +1,96 @@
+#ifndef GDBWIRE_LOGGER_ASYNC_H
+#define GDBWIRE_LOGGER_ASYNC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include "gdbwire_logger.h"
+
+/**
+ * An asynchronous log sink.
+ *
+ * Formatting a log message and writing it out is slow compared to
+ * parsing a line of GDB/MI. The asynchronous sink keeps this work off
+ * of the threads that log. A logging thread only copies the format
+ * string pointer, the arguments and a timestamp into a ring buffer of
+ * its own, which it shares with no other logging thread. A background
+ * thread empties the rings, formats the messages and hands them to
+ * the output sink.
+ *
+ * When a thread logs faster than the background thread keeps up with,
+ * its ring fills up and the messages that do not fit are dropped and
+ * counted, rather than making the logging thread wait.
+ *
+ * Usage:
+ *   async = gdbwire_logger_async_create(65536, NULL);
+ *   sink = gdbwire_logger_async_get_sink(async);
+ *   gdbwire_logger_set_sink(&sink);
+ *   ...
+ *   gdbwire_logger_set_sink(NULL);
+ *   gdbwire_logger_async_destroy(async);
+ */
+struct gdbwire_logger_async;
+
+/**
+ * Create an asynchronous log sink and start its background thread.
+ *
+ * @param ring_size
+ * The size in bytes of the ring buffer each logging thread gets,
+ * rounded up to a power of two of at least 4096 bytes.
+ *
+ * @param output
+ * The sink to copy and hand the formatted messages to, from the
+ * background thread, or NULL to write them to stderr with timestamps.
+ * The output's log_fn is used, its log_args_fn is ignored.
+ *
+ * @return
+ * A new asynchronous sink or NULL on error.
+ */
+struct gdbwire_logger_async *gdbwire_logger_async_create(size_t ring_size,
+        const struct gdbwire_logger_sink *output);
+
+/**
+ * Destroy an asynchronous log sink.
+ *
+ * The messages logged before this call are formatted and handed to
+ * the output sink before it returns. No thread may log to the sink
+ * or exit during or after this call, restore another sink with
+ * gdbwire_logger_set_sink and wait for the logging to stop first.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param async
+ * The asynchronous sink to destroy.
+ */
+void gdbwire_logger_async_destroy(struct gdbwire_logger_async *async);
+
+/**
+ * Get the sink to pass to gdbwire_logger_set_sink.
+ *
+ * @param async
+ * The asynchronous sink.
+ *
+ * @return
+ * The sink that logs to the asynchronous sink.
+ */
+struct gdbwire_logger_sink gdbwire_logger_async_get_sink(
+        struct gdbwire_logger_async *async);
+
+/**
+ * Get the number of messages dropped because a ring was full.
+ *
+ * @param async
+ * The asynchronous sink.
+ *
+ * @return
+ * The number of messages dropped so far.
+ */
+size_t gdbwire_logger_async_get_dropped(struct gdbwire_logger_async *async);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_LOGGER_ASYNC_H */
@@ -0,0 +1,275 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "gdbwire_assert.h"
+#include "gdbwire_lz.h"
+
+/* The shortest match worth encoding */
+#define GDBWIRE_LZ_MIN_MATCH 4
+
+/* The farthest back a match may start, the most the offset holds */
+#define GDBWIRE_LZ_MAX_OFFSET 65535
+
+/* The number of bits of the hash that indexes the table of positions */
+#define GDBWIRE_LZ_HASH_BITS 12
+
+/**
+ * How quickly the compressor speeds through data that does not compress.
+ *
+ * After each 2 to this power misses in a row, the compressor skips one
+ * more byte between the positions it looks for a match at.
+ */
+#define GDBWIRE_LZ_SKIP_SHIFT 6
+
+static uint32_t
+gdbwire_lz_read32(const unsigned char *data)
+{
+    uint32_t value;
+
+    memcpy(&value, data, sizeof (value));
+
+    return value;
+}
+
+static uint32_t
+gdbwire_lz_hash(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - GDBWIRE_LZ_HASH_BITS);
+}
+
+/**
+ * Write the continuation of a literal or match length.
+ *
+ * @param out
+ * Where to write the continuation.
+ *
+ * @param length
+ * The length less the 15 held in the sequence's first byte.
+ *
+ * @return
+ * The end of the continuation.
+ */
+static unsigned char *
+gdbwire_lz_put_length(unsigned char *out, size_t length)
+{
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (unsigned char)length;
+
+    return out;
+}
+
+/**
+ * Write a sequence.
+ *
+ * @param out
+ * Where to write the sequence.
+ *
+ * @param literals
+ * The literal bytes.
+ *
+ * @param literal_size
+ * The number of literal bytes.
+ *
+ * @param offset
+ * How far back the match starts.
+ *
+ * @param match_size
+ * The number of bytes of the match, or 0 for the last sequence.
+ *
+ * @return
+ * The end of the sequence.
+ */
+static unsigned char *
+gdbwire_lz_put_sequence(unsigned char *out, const unsigned char *literals,
+        size_t literal_size, size_t offset, size_t match_size)
+{
+    unsigned char *token = out++;
+    size_t match_code = (match_size) ? match_size - GDBWIRE_LZ_MIN_MATCH : 0;
+
+    *token = (unsigned char)(((literal_size < 15) ? literal_size : 15) << 4);
+    if (literal_size >= 15) {
+        out = gdbwire_lz_put_length(out, literal_size - 15);
+    }
+    memcpy(out, literals, literal_size);
+    out += literal_size;
+
+    if (match_size) {
+        *out++ = (unsigned char)(offset & 0xff);
+        *out++ = (unsigned char)(offset >> 8);
+        *token |= (unsigned char)((match_code < 15) ? match_code : 15);
+        if (match_code >= 15) {
+            out = gdbwire_lz_put_length(out, match_code - 15);
+        }
+    }
+
+    return out;
+}
+
+size_t
+gdbwire_lz_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+enum gdbwire_result
+gdbwire_lz_compress(const char *data, size_t size, char *out,
+        size_t capacity, size_t *out_size)
+{
+    /* The last position each hash of 4 bytes was seen at */
+    uint32_t table[1 << GDBWIRE_LZ_HASH_BITS];
+    const unsigned char *in = (const unsigned char *)data;
+    const unsigned char *end = in + size, *anchor = in, *position = in;
+    unsigned char *op = (unsigned char *)out;
+    size_t misses = 0;
+
+    GDBWIRE_ASSERT((data || size == 0) && out && out_size);
+
+    if (capacity < gdbwire_lz_bound(size)) {
+        return GDBWIRE_LOGIC;
+    }
+
+    memset(table, 0, sizeof (table));
+
+    while (size >= GDBWIRE_LZ_MIN_MATCH &&
+            position <= end - GDBWIRE_LZ_MIN_MATCH) {
+        uint32_t sequence = gdbwire_lz_read32(position);
+        uint32_t hash = gdbwire_lz_hash(sequence);
+        const unsigned char *candidate = in + table[hash];
+
+        table[hash] = (uint32_t)(position - in);
+
+        /* The table only suggests a match, the bytes are compared */
+        if (candidate < position &&
+                position - candidate <= GDBWIRE_LZ_MAX_OFFSET &&
+                gdbwire_lz_read32(candidate) == sequence) {
+            const unsigned char *match_end = position + GDBWIRE_LZ_MIN_MATCH;
+
+            candidate += GDBWIRE_LZ_MIN_MATCH;
+            while (match_end < end && *match_end == *candidate) {
+                ++match_end;
+                ++candidate;
+            }
+
+            op = gdbwire_lz_put_sequence(op, anchor,
+                (size_t)(position - anchor),
+                (size_t)(match_end - candidate),
+                (size_t)(match_end - position));
+            position = anchor = match_end;
+            misses = 0;
+        } else {
+            position += 1 + (misses++ >> GDBWIRE_LZ_SKIP_SHIFT);
+        }
+    }
+
+    op = gdbwire_lz_put_sequence(op, anchor, (size_t)(end - anchor), 0, 0);
+    *out_size = (size_t)(op - (unsigned char *)out);
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Read the continuation of a literal or match length.
+ *
+ * @param data
+ * The position of the continuation, moved past it.
+ *
+ * @param end
+ * The end of the compressed data.
+ *
+ * @param length
+ * The length, added to.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_LOGIC if the data is cut short.
+ */
+static enum gdbwire_result
+gdbwire_lz_get_length(const unsigned char **data, const unsigned char *end,
+        size_t *length)
+{
+    unsigned char byte;
+
+    do {
+        if (*data == end || *length > SIZE_MAX - 255) {
+            return GDBWIRE_LOGIC;
+        }
+        byte = *(*data)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_lz_decompress(const char *data, size_t size, char *out,
+        size_t capacity, size_t *out_size)
+{
+    const unsigned char *in = (const unsigned char *)data, *end = in + size;
+    unsigned char *start = (unsigned char *)out, *op = start;
+    unsigned char *out_end = start + capacity;
+    size_t literal_size, match_size, offset;
+    unsigned char token;
+
+    GDBWIRE_ASSERT((data || size == 0) && (out || capacity == 0) && out_size);
+
+    for (;;) {
+        if (in == end) {
+            return GDBWIRE_LOGIC;
+        }
+        token = *in++;
+
+        literal_size = token >> 4;
+        if (literal_size == 15 &&
+                gdbwire_lz_get_length(&in, end, &literal_size) != GDBWIRE_OK) {
+            return GDBWIRE_LOGIC;
+        }
+        if (literal_size > (size_t)(end - in) ||
+                literal_size > (size_t)(out_end - op)) {
+            return GDBWIRE_LOGIC;
+        }
+        memcpy(op, in, literal_size);
+        op += literal_size;
+        in += literal_size;
+
+        /* The last sequence has no match */
+        if (in == end) {
+            break;
+        }
+
+        if (end - in < 2) {
+            return GDBWIRE_LOGIC;
+        }
+        offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > (size_t)(op - start)) {
+            return GDBWIRE_LOGIC;
+        }
+
+        match_size = token & 15;
+        if (match_size == 15 &&
+                gdbwire_lz_get_length(&in, end, &match_size) != GDBWIRE_OK) {
+            return GDBWIRE_LOGIC;
+        }
+        match_size += GDBWIRE_LZ_MIN_MATCH;
+        if (match_size > (size_t)(out_end - op)) {
+            return GDBWIRE_LOGIC;
+        }
+
+        /* A match may overlap the bytes it is copying, to repeat them */
+        if (offset >= match_size) {
+            memcpy(op, op - offset, match_size);
+            op += match_size;
+        } else {
+            const unsigned char *from = op - offset;
+            while (match_size-- > 0) {
+                *op++ = *from++;
+            }
+        }
+    }
+
+    *out_size = (size_t)(op - start);
+
+    return GDBWIRE_OK;
+}
@@ -0,0 +1,100 @@
+#ifndef GDBWIRE_LZ_H
+#define GDBWIRE_LZ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "gdbwire_result.h"
+
+/**
+ * A small, fast compressor of the LZ77 family.
+ *
+ * GDB/MI output repeats itself a great deal, the same variable names,
+ * frames and file names over and over, so a compressor that only finds
+ * repeats of recent bytes shrinks it about tenfold. Speed matters more
+ * than the last few percent, so there is no entropy coding.
+ *
+ * The compressed data is a series of sequences. Each starts with a
+ * byte holding the number of literal bytes in its upper 4 bits and the
+ * length of the match less 4 in its lower 4 bits. A value of 15 in
+ * either is continued in the bytes that follow, each adding up to 255,
+ * the literal length right after the byte and the match length after
+ * the offset. Then come the literal bytes and the 2 byte little endian
+ * offset of the match, back from the end of the literals. The last
+ * sequence has literals only and ends the data.
+ *
+ * The data is decompressed without trusting it, so data that is cut
+ * short or corrupt is reported rather than read or written past.
+ */
+
+/**
+ * The most bytes data of the given size compresses to.
+ *
+ * Data that does not compress grows a little.
+ *
+ * @param size
+ * The number of bytes to compress.
+ *
+ * @return
+ * The number of bytes the compressed data may need.
+ */
+size_t gdbwire_lz_bound(size_t size);
+
+/**
+ * Compress data.
+ *
+ * @param data
+ * The data to compress.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @param out
+ * Set to the compressed data.
+ *
+ * @param capacity
+ * The number of bytes out holds, at least gdbwire_lz_bound(size).
+ *
+ * @param out_size
+ * Set to the number of bytes of compressed data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if capacity is less than gdbwire_lz_bound(size).
+ */
+enum gdbwire_result gdbwire_lz_compress(const char *data, size_t size,
+        char *out, size_t capacity, size_t *out_size);
+
+/**
+ * Decompress data.
+ *
+ * @param data
+ * The compressed data.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @param out
+ * Set to the decompressed data.
+ *
+ * @param capacity
+ * The number of bytes out holds.
+ *
+ * @param out_size
+ * Set to the number of bytes of decompressed data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the data is corrupt, cut short, or decompresses
+ * to more than capacity bytes.
+ */
+enum gdbwire_result gdbwire_lz_decompress(const char *data, size_t size,
+        char *out, size_t capacity, size_t *out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_LZ_H */
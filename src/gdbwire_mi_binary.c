@@ -0,0 +1,1276 @@
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gdbwire_assert.h"
+#include "gdbwire_mi_binary.h"
+#include "gdbwire_mi_pt_alloc.h"
+#include "gdbwire_string.h"
+
+/* The first bytes of an encoded output, followed by the version */
+#define GDBWIRE_MI_BINARY_MAGIC0 'G'
+#define GDBWIRE_MI_BINARY_MAGIC1 'M'
+
+/* The most bytes a varint of 64 bits takes */
+#define GDBWIRE_MI_BINARY_VARINT_SIZE 10
+
+/* A variable in the dictionary of the output being encoded */
+struct gdbwire_mi_binary_slot {
+    /* The hash of the variable */
+    uint64_t hash;
+    /* The offset of the variable in the dictionary plus 1, or 0 if unused */
+    size_t reference;
+};
+
+/* A growable array of bytes */
+struct gdbwire_mi_binary_bytes {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+};
+
+struct gdbwire_mi_binary_encoder {
+    /* The records and results of the output being encoded */
+    struct gdbwire_mi_binary_bytes body;
+    /* The variables of the output being encoded */
+    struct gdbwire_mi_binary_bytes dictionary;
+    /* The encoded output, the header, dictionary and body */
+    struct gdbwire_mi_binary_bytes message;
+    /* The hash table finding variables in the dictionary */
+    struct gdbwire_mi_binary_slot *slots;
+    /* The number of slots, a power of 2, and the number in use */
+    size_t slots_size;
+    size_t slots_used;
+    /* The allocator the encoder is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+/* The position of the reader in an encoded output */
+struct gdbwire_mi_binary_cursor {
+    /* The next byte to read */
+    const unsigned char *data;
+    /* The end of what may be read */
+    const unsigned char *end;
+};
+
+struct gdbwire_mi_binary_encoder *
+gdbwire_mi_binary_encoder_create(void)
+{
+    return gdbwire_mi_binary_encoder_create_with_allocator(NULL);
+}
+
+struct gdbwire_mi_binary_encoder *
+gdbwire_mi_binary_encoder_create_with_allocator(
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_mi_binary_encoder *encoder;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    encoder = (struct gdbwire_mi_binary_encoder *)gdbwire_calloc(allocator,
+        1, sizeof (struct gdbwire_mi_binary_encoder));
+    if (encoder) {
+        encoder->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
+    }
+
+    return encoder;
+}
+
+void
+gdbwire_mi_binary_encoder_destroy(struct gdbwire_mi_binary_encoder *encoder)
+{
+    if (encoder) {
+        /* The encoder is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = encoder->allocator;
+
+        gdbwire_free(&allocator, encoder->body.data);
+        gdbwire_free(&allocator, encoder->dictionary.data);
+        gdbwire_free(&allocator, encoder->message.data);
+        gdbwire_free(&allocator, encoder->slots);
+        gdbwire_free(&allocator, encoder);
+    }
+}
+
+/**
+ * Grow an array of bytes to hold at least a number of bytes.
+ *
+ * @param encoder
+ * The encoder whose allocator grows the array.
+ *
+ * @param bytes
+ * The array to grow.
+ *
+ * @param size
+ * The number of bytes the array must hold.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_reserve(struct gdbwire_mi_binary_encoder *encoder,
+        struct gdbwire_mi_binary_bytes *bytes, size_t size)
+{
+    size_t capacity = (bytes->capacity > 0) ? bytes->capacity : 256;
+    unsigned char *data;
+
+    if (size <= bytes->capacity) {
+        return GDBWIRE_OK;
+    }
+
+    while (capacity < size) {
+        if (capacity > (size_t)-1 / 2) {
+            return GDBWIRE_NOMEM;
+        }
+        capacity *= 2;
+    }
+
+    data = gdbwire_realloc(&encoder->allocator, bytes->data, capacity);
+    if (!data) {
+        return GDBWIRE_NOMEM;
+    }
+
+    bytes->data = data;
+    bytes->capacity = capacity;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Append bytes to an array of bytes.
+ *
+ * @param encoder
+ * The encoder the array belongs to.
+ *
+ * @param bytes
+ * The array to append to.
+ *
+ * @param data
+ * The bytes to append.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_append(struct gdbwire_mi_binary_encoder *encoder,
+        struct gdbwire_mi_binary_bytes *bytes, const void *data, size_t size)
+{
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_binary_reserve(encoder, bytes, bytes->size + size);
+    if (result == GDBWIRE_OK && size > 0) {
+        memcpy(bytes->data + bytes->size, data, size);
+        bytes->size += size;
+    }
+
+    return result;
+}
+
+/**
+ * Write a number as an unsigned LEB128 varint.
+ *
+ * @param value
+ * The number to write.
+ *
+ * @param data
+ * The memory to write to, at least GDBWIRE_MI_BINARY_VARINT_SIZE bytes.
+ *
+ * @return
+ * The number of bytes written.
+ */
+static size_t
+gdbwire_mi_binary_varint(uint64_t value, unsigned char *data)
+{
+    size_t size = 0;
+
+    while (value >= 0x80) {
+        data[size++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    data[size++] = (unsigned char)value;
+
+    return size;
+}
+
+static enum gdbwire_result
+gdbwire_mi_binary_put_varint(struct gdbwire_mi_binary_encoder *encoder,
+        struct gdbwire_mi_binary_bytes *bytes, uint64_t value)
+{
+    unsigned char data[GDBWIRE_MI_BINARY_VARINT_SIZE];
+
+    return gdbwire_mi_binary_append(encoder, bytes, data,
+        gdbwire_mi_binary_varint(value, data));
+}
+
+static enum gdbwire_result
+gdbwire_mi_binary_put_byte(struct gdbwire_mi_binary_encoder *encoder,
+        int value)
+{
+    unsigned char data = (unsigned char)value;
+
+    return gdbwire_mi_binary_append(encoder, &encoder->body, &data, 1);
+}
+
+/**
+ * Write a string as its length, its bytes and a NUL.
+ *
+ * @param encoder
+ * The encoder.
+ *
+ * @param bytes
+ * The array to write to.
+ *
+ * @param str
+ * The string to write.
+ *
+ * @param size
+ * The number of bytes in str.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_put_string(struct gdbwire_mi_binary_encoder *encoder,
+        struct gdbwire_mi_binary_bytes *bytes, const char *str, size_t size)
+{
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_binary_put_varint(encoder, bytes, size);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_binary_append(encoder, bytes, str, size + 1);
+    }
+
+    return result;
+}
+
+/**
+ * Write a string that may be NULL, with its length plus 1, or 0 if NULL.
+ *
+ * @param encoder
+ * The encoder.
+ *
+ * @param str
+ * The string to write to the body, OK to pass in NULL.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_put_optional(struct gdbwire_mi_binary_encoder *encoder,
+        const char *str)
+{
+    enum gdbwire_result result;
+    size_t size;
+
+    if (!str) {
+        return gdbwire_mi_binary_put_varint(encoder, &encoder->body, 0);
+    }
+
+    size = strlen(str);
+    result = gdbwire_mi_binary_put_varint(encoder, &encoder->body, size + 1);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_binary_append(encoder, &encoder->body, str,
+            size + 1);
+    }
+
+    return result;
+}
+
+/**
+ * Read a varint, the reader side of gdbwire_mi_binary_varint.
+ *
+ * @param cursor
+ * The cursor to read from, moved past the varint on success.
+ *
+ * @param value
+ * Set to the number read on success.
+ *
+ * @return
+ * 0 on success or -1 if the varint does not fit in size_t or is cut off.
+ */
+static int
+gdbwire_mi_binary_get_varint(struct gdbwire_mi_binary_cursor *cursor,
+        size_t *value)
+{
+    uint64_t result = 0;
+    unsigned shift = 0;
+    unsigned char byte;
+
+    do {
+        if (cursor->data == cursor->end || shift >= 64) {
+            return -1;
+        }
+        byte = *cursor->data++;
+        if (shift == 63 && (byte & 0x7e)) {
+            return -1;
+        }
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    if (result > (size_t)-1) {
+        return -1;
+    }
+
+    *value = (size_t)result;
+    return 0;
+}
+
+/**
+ * Read a varint from a buffer that was already checked.
+ *
+ * @param data
+ * The varint, moved past it.
+ *
+ * @return
+ * The number read.
+ */
+static size_t
+gdbwire_mi_binary_next_varint(const unsigned char **data)
+{
+    size_t result = 0;
+    unsigned shift = 0;
+    unsigned char byte;
+
+    do {
+        byte = *(*data)++;
+        result |= (size_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    return result;
+}
+
+/**
+ * Read a byte holding an enumerator.
+ *
+ * @param cursor
+ * The cursor to read from, moved past the byte on success.
+ *
+ * @param last
+ * The last enumerator allowed.
+ *
+ * @param value
+ * Set to the enumerator on success.
+ *
+ * @return
+ * 0 on success or -1 if the byte is cut off or out of range.
+ */
+static int
+gdbwire_mi_binary_get_kind(struct gdbwire_mi_binary_cursor *cursor,
+        int last, int *value)
+{
+    if (cursor->data == cursor->end || *cursor->data > last) {
+        return -1;
+    }
+
+    *value = *cursor->data++;
+    return 0;
+}
+
+/**
+ * Read a string written by gdbwire_mi_binary_put_string.
+ *
+ * @param cursor
+ * The cursor to read from, moved past the string on success.
+ *
+ * @param str
+ * Set to the string on success.
+ *
+ * @param size
+ * Set to the number of bytes in the string on success.
+ *
+ * @return
+ * 0 on success or -1 if the string is cut off or not NUL terminated.
+ */
+static int
+gdbwire_mi_binary_get_string(struct gdbwire_mi_binary_cursor *cursor,
+        const char **str, size_t *size)
+{
+    if (gdbwire_mi_binary_get_varint(cursor, size) == -1 ||
+            *size >= (size_t)(cursor->end - cursor->data) ||
+            cursor->data[*size] != 0) {
+        return -1;
+    }
+
+    *str = (const char *)cursor->data;
+    cursor->data += *size + 1;
+    return 0;
+}
+
+/**
+ * Read a string written by gdbwire_mi_binary_put_optional.
+ *
+ * @param cursor
+ * The cursor to read from, moved past the string on success.
+ *
+ * @param str
+ * Set to the string, or NULL if none, on success.
+ *
+ * @return
+ * 0 on success or -1 if the string is cut off or not NUL terminated.
+ */
+static int
+gdbwire_mi_binary_get_optional(struct gdbwire_mi_binary_cursor *cursor,
+        const char **str)
+{
+    size_t size;
+
+    if (gdbwire_mi_binary_get_varint(cursor, &size) == -1) {
+        return -1;
+    }
+
+    if (size == 0) {
+        *str = NULL;
+        return 0;
+    }
+
+    if (size - 1 >= (size_t)(cursor->end - cursor->data) ||
+            cursor->data[size - 1] != 0) {
+        return -1;
+    }
+
+    *str = (const char *)cursor->data;
+    cursor->data += size;
+    return 0;
+}
+
+/**
+ * Get the reference to a variable, adding it to the dictionary if new.
+ *
+ * @param encoder
+ * The encoder.
+ *
+ * @param variable
+ * The variable.
+ *
+ * @param reference
+ * Set to the offset of the variable in the dictionary plus 1.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_intern(struct gdbwire_mi_binary_encoder *encoder,
+        const char *variable, size_t *reference)
+{
+    size_t size = strlen(variable), index, mask, offset;
+    uint64_t hash = gdbwire_fnv1a(GDBWIRE_FNV1A_BASIS, variable, size);
+    struct gdbwire_mi_binary_slot *slot;
+    const unsigned char *entry;
+    enum gdbwire_result result;
+
+    /* Keep the table at most half full */
+    if ((encoder->slots_used + 1) * 2 > encoder->slots_size) {
+        struct gdbwire_mi_binary_slot *slots = encoder->slots;
+        size_t slots_size = encoder->slots_size;
+
+        encoder->slots_size = (slots_size > 0) ? slots_size * 2 : 64;
+        encoder->slots = (struct gdbwire_mi_binary_slot *)gdbwire_calloc(
+            &encoder->allocator, encoder->slots_size,
+            sizeof (struct gdbwire_mi_binary_slot));
+        if (!encoder->slots) {
+            encoder->slots = slots;
+            encoder->slots_size = slots_size;
+            return GDBWIRE_NOMEM;
+        }
+
+        mask = encoder->slots_size - 1;
+        for (index = 0; index < slots_size; ++index) {
+            if (slots[index].reference) {
+                offset = (size_t)slots[index].hash & mask;
+                while (encoder->slots[offset].reference) {
+                    offset = (offset + 1) & mask;
+                }
+                encoder->slots[offset] = slots[index];
+            }
+        }
+        gdbwire_free(&encoder->allocator, slots);
+    }
+
+    mask = encoder->slots_size - 1;
+    for (index = (size_t)hash & mask; encoder->slots[index].reference;
+            index = (index + 1) & mask) {
+        slot = &encoder->slots[index];
+        if (slot->hash == hash) {
+            entry = encoder->dictionary.data + slot->reference - 1;
+            if (gdbwire_mi_binary_next_varint(&entry) == size &&
+                    memcmp(entry, variable, size) == 0) {
+                *reference = slot->reference;
+                return GDBWIRE_OK;
+            }
+        }
+    }
+
+    offset = encoder->dictionary.size;
+    result = gdbwire_mi_binary_put_string(encoder, &encoder->dictionary,
+        variable, size);
+    if (result == GDBWIRE_OK) {
+        encoder->slots[index].hash = hash;
+        encoder->slots[index].reference = offset + 1;
+        encoder->slots_used++;
+        *reference = offset + 1;
+    }
+
+    return result;
+}
+
+/**
+ * Write a list of results, preceded by its count and size.
+ *
+ * The results are written first and then moved over to make room for
+ * the count and size in front of them.
+ *
+ * @param encoder
+ * The encoder.
+ *
+ * @param result
+ * The first result of the list, OK to pass in NULL.
+ *
+ * @param depth
+ * The number of tuples and lists the list is in.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_put_results(struct gdbwire_mi_binary_encoder *encoder,
+        const struct gdbwire_mi_result *result, int depth)
+{
+    unsigned char header[GDBWIRE_MI_BINARY_VARINT_SIZE * 2];
+    struct gdbwire_mi_binary_bytes *body = &encoder->body;
+    size_t start = body->size, count = 0, reference, header_size;
+    enum gdbwire_result status = GDBWIRE_OK;
+
+    if (depth > GDBWIRE_MI_BINARY_MAX_DEPTH) {
+        return GDBWIRE_LOGIC;
+    }
+
+    for (; result && status == GDBWIRE_OK; result = result->next) {
+        reference = 0;
+        status = gdbwire_mi_binary_put_byte(encoder, result->kind);
+        if (status == GDBWIRE_OK && result->variable) {
+            status = gdbwire_mi_binary_intern(encoder, result->variable,
+                &reference);
+        }
+        if (status == GDBWIRE_OK) {
+            status = gdbwire_mi_binary_put_varint(encoder, body, reference);
+        }
+        if (status == GDBWIRE_OK) {
+            if (result->kind == GDBWIRE_MI_CSTRING) {
+                status = gdbwire_mi_binary_put_string(encoder, body,
+                    result->variant.cstring, strlen(result->variant.cstring));
+            } else {
+                status = gdbwire_mi_binary_put_results(encoder,
+                    result->variant.result, depth + 1);
+            }
+        }
+        count++;
+    }
+
+    if (status == GDBWIRE_OK) {
+        header_size = gdbwire_mi_binary_varint(count, header);
+        header_size += gdbwire_mi_binary_varint(body->size - start,
+            header + header_size);
+        status = gdbwire_mi_binary_reserve(encoder, body,
+            body->size + header_size);
+    }
+
+    if (status == GDBWIRE_OK) {
+        memmove(body->data + start + header_size, body->data + start,
+            body->size - start);
+        memcpy(body->data + start, header, header_size);
+        body->size += header_size;
+    }
+
+    return status;
+}
+
+/**
+ * Write the records of an output to the body.
+ *
+ * @param encoder
+ * The encoder.
+ *
+ * @param output
+ * The output to write.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_put_output(struct gdbwire_mi_binary_encoder *encoder,
+        const struct gdbwire_mi_output *output)
+{
+    struct gdbwire_mi_binary_bytes *body = &encoder->body;
+    struct gdbwire_mi_oob_record *oob_record;
+    struct gdbwire_mi_async_record *async_record;
+    struct gdbwire_mi_stream_record *stream_record;
+    struct gdbwire_mi_result_record *result_record;
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_binary_put_byte(encoder, output->kind);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_binary_put_string(encoder, body, output->line,
+            strlen(output->line));
+    }
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            oob_record = output->variant.oob_record;
+            result = gdbwire_mi_binary_put_byte(encoder, oob_record->kind);
+            if (result != GDBWIRE_OK) {
+                break;
+            }
+
+            if (oob_record->kind == GDBWIRE_MI_ASYNC) {
+                async_record = oob_record->variant.async_record;
+                result = gdbwire_mi_binary_put_byte(encoder,
+                    async_record->kind);
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_binary_put_byte(encoder,
+                        async_record->async_class);
+                }
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_binary_put_optional(encoder,
+                        async_record->token);
+                }
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_binary_put_results(encoder,
+                        async_record->result, 0);
+                }
+            } else {
+                stream_record = oob_record->variant.stream_record;
+                result = gdbwire_mi_binary_put_byte(encoder,
+                    stream_record->kind);
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_binary_put_string(encoder, body,
+                        stream_record->cstring,
+                        strlen(stream_record->cstring));
+                }
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            result_record = output->variant.result_record;
+            result = gdbwire_mi_binary_put_byte(encoder,
+                result_record->result_class);
+            if (result == GDBWIRE_OK) {
+                result = gdbwire_mi_binary_put_optional(encoder,
+                    result_record->token);
+            }
+            if (result == GDBWIRE_OK) {
+                result = gdbwire_mi_binary_put_results(encoder,
+                    result_record->result, 0);
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            /* The columns of a parse error are -1 when unknown */
+            result = gdbwire_mi_binary_put_optional(encoder,
+                output->variant.error.token);
+            if (result == GDBWIRE_OK) {
+                result = gdbwire_mi_binary_put_varint(encoder, body,
+                    (uint64_t)(output->variant.error.pos.start_column + 1));
+            }
+            if (result == GDBWIRE_OK) {
+                result = gdbwire_mi_binary_put_varint(encoder, body,
+                    (uint64_t)(output->variant.error.pos.end_column + 1));
+            }
+            break;
+    }
+
+    return result;
+}
+
+enum gdbwire_result
+gdbwire_mi_binary_encode(struct gdbwire_mi_binary_encoder *encoder,
+        const struct gdbwire_mi_output *output,
+        const void **data, size_t *size)
+{
+    unsigned char header[3 + GDBWIRE_MI_BINARY_VARINT_SIZE];
+    enum gdbwire_result result;
+    size_t header_size;
+
+    GDBWIRE_ASSERT(encoder && output && data && size);
+
+    /* Each output has a dictionary of its own */
+    encoder->body.size = 0;
+    encoder->dictionary.size = 0;
+    encoder->message.size = 0;
+    if (encoder->slots_used > 0) {
+        memset(encoder->slots, 0,
+            encoder->slots_size * sizeof (struct gdbwire_mi_binary_slot));
+        encoder->slots_used = 0;
+    }
+
+    result = gdbwire_mi_binary_put_output(encoder, output);
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    header[0] = GDBWIRE_MI_BINARY_MAGIC0;
+    header[1] = GDBWIRE_MI_BINARY_MAGIC1;
+    header[2] = GDBWIRE_MI_BINARY_VERSION;
+    header_size = 3 + gdbwire_mi_binary_varint(encoder->dictionary.size,
+        header + 3);
+
+    result = gdbwire_mi_binary_reserve(encoder, &encoder->message,
+        header_size + encoder->dictionary.size + encoder->body.size);
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    gdbwire_mi_binary_append(encoder, &encoder->message, header,
+        header_size);
+    gdbwire_mi_binary_append(encoder, &encoder->message,
+        encoder->dictionary.data, encoder->dictionary.size);
+    gdbwire_mi_binary_append(encoder, &encoder->message,
+        encoder->body.data, encoder->body.size);
+
+    *data = encoder->message.data;
+    *size = encoder->message.size;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Check a list of results written by gdbwire_mi_binary_put_results.
+ *
+ * @param cursor
+ * The cursor to read from, moved past the list on success.
+ *
+ * @param dictionary
+ * The dictionary of the output.
+ *
+ * @param dictionary_size
+ * The number of bytes in the dictionary.
+ *
+ * @param depth
+ * The number of tuples and lists the list is in.
+ *
+ * @param count
+ * Set to the number of results in the list on success.
+ *
+ * @return
+ * 0 on success or -1 if the list is malformed.
+ */
+static int
+gdbwire_mi_binary_check_results(struct gdbwire_mi_binary_cursor *cursor,
+        const unsigned char *dictionary, size_t dictionary_size, int depth,
+        size_t *count)
+{
+    struct gdbwire_mi_binary_cursor list, entry;
+    size_t size, index, reference, children;
+    const char *str;
+    int kind;
+
+    if (depth > GDBWIRE_MI_BINARY_MAX_DEPTH ||
+            gdbwire_mi_binary_get_varint(cursor, count) == -1 ||
+            gdbwire_mi_binary_get_varint(cursor, &size) == -1 ||
+            size > (size_t)(cursor->end - cursor->data)) {
+        return -1;
+    }
+
+    list.data = cursor->data;
+    list.end = cursor->data + size;
+
+    for (index = 0; index < *count; ++index) {
+        if (gdbwire_mi_binary_get_kind(&list, GDBWIRE_MI_LIST, &kind) == -1 ||
+                gdbwire_mi_binary_get_varint(&list, &reference) == -1 ||
+                reference > dictionary_size) {
+            return -1;
+        }
+
+        /* The variable must be a string within the dictionary */
+        if (reference > 0) {
+            entry.data = dictionary + reference - 1;
+            entry.end = dictionary + dictionary_size;
+            if (gdbwire_mi_binary_get_string(&entry, &str, &size) == -1) {
+                return -1;
+            }
+        }
+
+        if (kind == GDBWIRE_MI_CSTRING) {
+            if (gdbwire_mi_binary_get_string(&list, &str, &size) == -1) {
+                return -1;
+            }
+        } else if (gdbwire_mi_binary_check_results(&list, dictionary,
+                dictionary_size, depth + 1, &children) == -1) {
+            return -1;
+        }
+    }
+
+    /* The results fill the size of the list exactly */
+    if (list.data != list.end) {
+        return -1;
+    }
+
+    cursor->data = list.end;
+    return 0;
+}
+
+/**
+ * Check and read the records of an encoded output.
+ *
+ * @param cursor
+ * The cursor at the body of the output.
+ *
+ * @param output
+ * The output to fill in.
+ *
+ * @param dictionary_size
+ * The number of bytes in the dictionary of the output.
+ *
+ * @return
+ * 0 on success or -1 if the output is malformed.
+ */
+static int
+gdbwire_mi_binary_read_body(struct gdbwire_mi_binary_cursor *cursor,
+        struct gdbwire_mi_binary_output *output, size_t dictionary_size)
+{
+    const unsigned char *results;
+    size_t column;
+    int kind;
+
+    if (gdbwire_mi_binary_get_kind(cursor, GDBWIRE_MI_OUTPUT_PARSE_ERROR,
+            &kind) == -1 ||
+            gdbwire_mi_binary_get_string(cursor, &output->line,
+            &output->line_size) == -1) {
+        return -1;
+    }
+    output->kind = (enum gdbwire_mi_output_kind)kind;
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            if (gdbwire_mi_binary_get_kind(cursor, GDBWIRE_MI_STREAM,
+                    &kind) == -1) {
+                return -1;
+            }
+            output->oob_kind = (enum gdbwire_mi_oob_record_kind)kind;
+
+            if (output->oob_kind == GDBWIRE_MI_STREAM) {
+                if (gdbwire_mi_binary_get_kind(cursor, GDBWIRE_MI_LOG,
+                        &kind) == -1 ||
+                        gdbwire_mi_binary_get_string(cursor,
+                        &output->cstring, &output->cstring_size) == -1) {
+                    return -1;
+                }
+                output->stream_kind = (enum gdbwire_mi_stream_record_kind)kind;
+                return 0;
+            }
+
+            if (gdbwire_mi_binary_get_kind(cursor, GDBWIRE_MI_NOTIFY,
+                    &kind) == -1) {
+                return -1;
+            }
+            output->async_kind = (enum gdbwire_mi_async_record_kind)kind;
+
+            if (gdbwire_mi_binary_get_kind(cursor,
+                    GDBWIRE_MI_ASYNC_UNSUPPORTED, &kind) == -1) {
+                return -1;
+            }
+            output->async_class = (enum gdbwire_mi_async_class)kind;
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            if (gdbwire_mi_binary_get_kind(cursor, GDBWIRE_MI_UNSUPPORTED,
+                    &kind) == -1) {
+                return -1;
+            }
+            output->result_class = (enum gdbwire_mi_result_class)kind;
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            return 0;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            if (gdbwire_mi_binary_get_optional(cursor, &output->token) == -1 ||
+                    gdbwire_mi_binary_get_varint(cursor, &column) == -1 ||
+                    column > INT_MAX) {
+                return -1;
+            }
+            output->pos.start_column = (int)column - 1;
+            if (gdbwire_mi_binary_get_varint(cursor, &column) == -1 ||
+                    column > INT_MAX) {
+                return -1;
+            }
+            output->pos.end_column = (int)column - 1;
+            return 0;
+    }
+
+    /* The asynchronous records and result records have results */
+    if (gdbwire_mi_binary_get_optional(cursor, &output->token) == -1) {
+        return -1;
+    }
+
+    results = cursor->data;
+    if (gdbwire_mi_binary_check_results(cursor, output->dictionary,
+            dictionary_size, 0, &output->results_count) == -1) {
+        return -1;
+    }
+    output->results = results;
+
+    return 0;
+}
+
+enum gdbwire_result
+gdbwire_mi_binary_read(const void *data, size_t size,
+        struct gdbwire_mi_binary_output *output)
+{
+    struct gdbwire_mi_binary_cursor cursor;
+    size_t dictionary_size;
+
+    GDBWIRE_ASSERT(data && output);
+
+    memset(output, 0, sizeof (*output));
+    cursor.data = (const unsigned char *)data;
+    cursor.end = cursor.data + size;
+
+    if (size < 3 || cursor.data[0] != GDBWIRE_MI_BINARY_MAGIC0 ||
+            cursor.data[1] != GDBWIRE_MI_BINARY_MAGIC1 ||
+            cursor.data[2] != GDBWIRE_MI_BINARY_VERSION) {
+        return GDBWIRE_LOGIC;
+    }
+    cursor.data += 3;
+
+    if (gdbwire_mi_binary_get_varint(&cursor, &dictionary_size) == -1 ||
+            dictionary_size > (size_t)(cursor.end - cursor.data)) {
+        return GDBWIRE_LOGIC;
+    }
+    output->dictionary = cursor.data;
+    cursor.data += dictionary_size;
+
+    /* Nothing may follow the output */
+    if (gdbwire_mi_binary_read_body(&cursor, output, dictionary_size) == -1 ||
+            cursor.data != cursor.end) {
+        memset(output, 0, sizeof (*output));
+        return GDBWIRE_LOGIC;
+    }
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Read a result of a list that was already checked.
+ *
+ * @param result
+ * The result to fill in, its next field at the result to read and its
+ * remaining field set.
+ */
+static void
+gdbwire_mi_binary_next_result(struct gdbwire_mi_binary_result *result)
+{
+    const unsigned char *data = result->next, *entry;
+    size_t reference, size;
+
+    result->kind = (enum gdbwire_mi_result_kind)*data++;
+
+    reference = gdbwire_mi_binary_next_varint(&data);
+    result->variable = NULL;
+    if (reference > 0) {
+        entry = result->dictionary + reference - 1;
+        gdbwire_mi_binary_next_varint(&entry);
+        result->variable = (const char *)entry;
+    }
+
+    if (result->kind == GDBWIRE_MI_CSTRING) {
+        result->cstring_size = gdbwire_mi_binary_next_varint(&data);
+        result->cstring = (const char *)data;
+        result->count = 0;
+        result->children = NULL;
+        result->next = data + result->cstring_size + 1;
+    } else {
+        result->count = gdbwire_mi_binary_next_varint(&data);
+        size = gdbwire_mi_binary_next_varint(&data);
+        result->cstring = NULL;
+        result->cstring_size = 0;
+        result->children = data;
+        result->next = data + size;
+    }
+}
+
+/**
+ * Get the first result of a list that was already checked.
+ *
+ * @param data
+ * The results of the list, after its count and size.
+ *
+ * @param count
+ * The number of results in the list.
+ *
+ * @param dictionary
+ * The dictionary of the output.
+ *
+ * @param result
+ * Set to the first result, if there is one.
+ *
+ * @return
+ * 1 if result was set or 0 if the list is empty.
+ */
+static int
+gdbwire_mi_binary_first_result(const unsigned char *data, size_t count,
+        const unsigned char *dictionary,
+        struct gdbwire_mi_binary_result *result)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    result->dictionary = dictionary;
+    result->remaining = count - 1;
+    result->next = data;
+    gdbwire_mi_binary_next_result(result);
+
+    return 1;
+}
+
+int
+gdbwire_mi_binary_output_results(
+        const struct gdbwire_mi_binary_output *output,
+        struct gdbwire_mi_binary_result *result)
+{
+    const unsigned char *data = output->results;
+
+    if (!data) {
+        return 0;
+    }
+
+    /* Skip the count and size in front of the results */
+    gdbwire_mi_binary_next_varint(&data);
+    gdbwire_mi_binary_next_varint(&data);
+
+    return gdbwire_mi_binary_first_result(data, output->results_count,
+        output->dictionary, result);
+}
+
+int
+gdbwire_mi_binary_result_children(
+        const struct gdbwire_mi_binary_result *result,
+        struct gdbwire_mi_binary_result *child)
+{
+    if (result->kind == GDBWIRE_MI_CSTRING) {
+        return 0;
+    }
+
+    return gdbwire_mi_binary_first_result(result->children, result->count,
+        result->dictionary, child);
+}
+
+int
+gdbwire_mi_binary_result_next(struct gdbwire_mi_binary_result *result)
+{
+    if (result->remaining == 0) {
+        return 0;
+    }
+
+    result->remaining--;
+    gdbwire_mi_binary_next_result(result);
+
+    return 1;
+}
+
+/**
+ * Build the parse tree of a list of results that was already checked.
+ *
+ * @param arena
+ * The arena to allocate the results from.
+ *
+ * @param first
+ * The first result of the list.
+ *
+ * @param result
+ * Set to the first result built, or NULL if the list is empty.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_decode_results(struct gdbwire_mi_arena *arena,
+        struct gdbwire_mi_binary_result *first,
+        struct gdbwire_mi_result **result)
+{
+    struct gdbwire_mi_result **link = result, *cur;
+    struct gdbwire_mi_binary_result child;
+    enum gdbwire_result status;
+
+    *link = NULL;
+    do {
+        cur = gdbwire_mi_result_alloc(arena);
+        if (!cur) {
+            return GDBWIRE_NOMEM;
+        }
+
+        cur->kind = first->kind;
+        if (first->variable) {
+            cur->variable = gdbwire_mi_arena_strdup(arena, first->variable);
+            if (!cur->variable) {
+                return GDBWIRE_NOMEM;
+            }
+        }
+
+        if (first->kind == GDBWIRE_MI_CSTRING) {
+            cur->variant.cstring = gdbwire_mi_arena_strndup(arena,
+                first->cstring, first->cstring_size);
+            if (!cur->variant.cstring) {
+                return GDBWIRE_NOMEM;
+            }
+        } else if (gdbwire_mi_binary_result_children(first, &child)) {
+            status = gdbwire_mi_binary_decode_results(arena, &child,
+                &cur->variant.result);
+            if (status != GDBWIRE_OK) {
+                return status;
+            }
+        }
+
+        *link = cur;
+        link = &cur->next;
+    } while (gdbwire_mi_binary_result_next(first));
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Build the parse tree of an output that was read.
+ *
+ * @param arena
+ * The arena to allocate the output from.
+ *
+ * @param view
+ * The output read with gdbwire_mi_binary_read.
+ *
+ * @param output
+ * Set to the output built on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_binary_decode_output(struct gdbwire_mi_arena *arena,
+        const struct gdbwire_mi_binary_output *view,
+        struct gdbwire_mi_output **output)
+{
+    struct gdbwire_mi_oob_record *oob_record;
+    struct gdbwire_mi_async_record *async_record;
+    struct gdbwire_mi_stream_record *stream_record;
+    struct gdbwire_mi_result_record *result_record;
+    struct gdbwire_mi_result **results = NULL;
+    struct gdbwire_mi_binary_result first;
+    struct gdbwire_mi_output *cur;
+
+    cur = gdbwire_mi_output_alloc(arena);
+    if (!cur) {
+        return GDBWIRE_NOMEM;
+    }
+    cur->kind = view->kind;
+    cur->line = gdbwire_mi_arena_strndup(arena, view->line, view->line_size);
+    if (!cur->line) {
+        return GDBWIRE_NOMEM;
+    }
+
+    switch (view->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            oob_record = gdbwire_mi_oob_record_alloc(arena);
+            if (!oob_record) {
+                return GDBWIRE_NOMEM;
+            }
+            oob_record->kind = view->oob_kind;
+            cur->variant.oob_record = oob_record;
+
+            if (view->oob_kind == GDBWIRE_MI_ASYNC) {
+                async_record = gdbwire_mi_async_record_alloc(arena);
+                if (!async_record) {
+                    return GDBWIRE_NOMEM;
+                }
+                async_record->kind = view->async_kind;
+                async_record->async_class = view->async_class;
+                async_record->token = gdbwire_mi_arena_strdup(arena,
+                    view->token);
+                if (view->token && !async_record->token) {
+                    return GDBWIRE_NOMEM;
+                }
+                oob_record->variant.async_record = async_record;
+                results = &async_record->result;
+            } else {
+                stream_record = gdbwire_mi_stream_record_alloc(arena);
+                if (!stream_record) {
+                    return GDBWIRE_NOMEM;
+                }
+                stream_record->kind = view->stream_kind;
+                stream_record->cstring = gdbwire_mi_arena_strndup(arena,
+                    view->cstring, view->cstring_size);
+                if (!stream_record->cstring) {
+                    return GDBWIRE_NOMEM;
+                }
+                oob_record->variant.stream_record = stream_record;
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            result_record = gdbwire_mi_result_record_alloc(arena);
+            if (!result_record) {
+                return GDBWIRE_NOMEM;
+            }
+            result_record->result_class = view->result_class;
+            result_record->token = gdbwire_mi_arena_strdup(arena,
+                view->token);
+            if (view->token && !result_record->token) {
+                return GDBWIRE_NOMEM;
+            }
+            cur->variant.result_record = result_record;
+            results = &result_record->result;
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            cur->variant.error.token = gdbwire_mi_arena_strdup(arena,
+                view->token);
+            if (view->token && !cur->variant.error.token) {
+                return GDBWIRE_NOMEM;
+            }
+            cur->variant.error.pos = view->pos;
+            break;
+    }
+
+    *output = cur;
+
+    if (results && gdbwire_mi_binary_output_results(view, &first)) {
+        return gdbwire_mi_binary_decode_results(arena, &first, results);
+    }
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_binary_decode(const void *data, size_t size,
+        struct gdbwire_mi_output **output)
+{
+    struct gdbwire_mi_binary_output view;
+    struct gdbwire_mi_arena *arena;
+    enum gdbwire_result result;
+
+    GDBWIRE_ASSERT(data && output);
+
+    result = gdbwire_mi_binary_read(data, size, &view);
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    /* The output is in an arena of its own, freed along with it */
+    arena = gdbwire_mi_arena_acquire(NULL);
+    if (!arena) {
+        return GDBWIRE_NOMEM;
+    }
+
+    result = gdbwire_mi_binary_decode_output(arena, &view, output);
+    if (result != GDBWIRE_OK) {
+        gdbwire_mi_arena_release(arena);
+        *output = NULL;
+    }
+
+    return result;
+}
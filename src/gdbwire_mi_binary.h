@@ -0,0 +1,292 @@
+#ifndef GDBWIRE_MI_BINARY_H
+#define GDBWIRE_MI_BINARY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "gdbwire_allocator.h"
+#include "gdbwire_result.h"
+#include "gdbwire_mi_pt.h"
+
+/**
+ * A compact binary encoding of GDB/MI output commands.
+ *
+ * Parsed records are shipped between processes, from the process that
+ * talks to GDB to the one that shows them, or kept in a cache. The
+ * binary encoding is smaller than the MI text or JSON and is read in
+ * place by the receiver, without parsing text or rebuilding a tree.
+ *
+ * An encoded output is self contained and starts with the bytes 'G',
+ * 'M' and the version of the encoding, GDBWIRE_MI_BINARY_VERSION. The
+ * kinds and classes are single bytes, the numbers and lengths are
+ * unsigned LEB128 varints and the strings are their length followed by
+ * their bytes and a NUL, so the reader hands them out as C strings
+ * pointing into the buffer.
+ *
+ * The variables of the results are interned into a dictionary at the
+ * start of the output. Each result refers to its variable by its offset
+ * in the dictionary, so a variable repeated in every element of a list,
+ * like "number" in -break-info, is only written once. A tuple or list
+ * starts with the number of results and the number of bytes it holds,
+ * so the reader skips it without walking it.
+ *
+ * The timestamps of an output are not encoded. They are taken from the
+ * monotonic clock of the process that parsed the output and mean
+ * nothing to another process.
+ */
+
+/** The version of the encoding written by the encoder. */
+#define GDBWIRE_MI_BINARY_VERSION 1
+
+/**
+ * The deepest tuples and lists can nest in an encoded output.
+ *
+ * The encoder refuses deeper trees and the reader refuses deeper
+ * buffers, so that checking a buffer needs a bounded amount of stack.
+ */
+#define GDBWIRE_MI_BINARY_MAX_DEPTH 64
+
+/** Encodes GDB/MI output commands, reusing its memory between them. */
+struct gdbwire_mi_binary_encoder;
+
+/**
+ * An encoded output command, read in place.
+ *
+ * The strings point into the encoded buffer and are valid as long as
+ * the buffer is. The fields that do not apply to the kind of output are
+ * 0 or NULL.
+ */
+struct gdbwire_mi_binary_output {
+    /** The kind of output. */
+    enum gdbwire_mi_output_kind kind;
+
+    /** The line the output was parsed from, never NULL. */
+    const char *line;
+    /** The number of bytes in line. */
+    size_t line_size;
+
+    /** The kind of out of band record, when kind is GDBWIRE_MI_OUTPUT_OOB. */
+    enum gdbwire_mi_oob_record_kind oob_kind;
+
+    /** The kind of asynchronous record, when oob_kind is GDBWIRE_MI_ASYNC. */
+    enum gdbwire_mi_async_record_kind async_kind;
+    /** The class of asynchronous record, when oob_kind is GDBWIRE_MI_ASYNC. */
+    enum gdbwire_mi_async_class async_class;
+
+    /** The kind of stream record, when oob_kind is GDBWIRE_MI_STREAM. */
+    enum gdbwire_mi_stream_record_kind stream_kind;
+    /** The text of the stream record, when oob_kind is GDBWIRE_MI_STREAM. */
+    const char *cstring;
+    /** The number of bytes in cstring. */
+    size_t cstring_size;
+
+    /** The class of result record, when kind is GDBWIRE_MI_OUTPUT_RESULT. */
+    enum gdbwire_mi_result_class result_class;
+
+    /**
+     * The token of an asynchronous record or result record, or the token
+     * a parse error occurred on. NULL if none.
+     */
+    const char *token;
+
+    /** Where the parse error occurred, for GDBWIRE_MI_OUTPUT_PARSE_ERROR. */
+    struct gdbwire_mi_position pos;
+
+    /**
+     * The number of results of an asynchronous record or result record.
+     * See gdbwire_mi_binary_output_results.
+     */
+    size_t results_count;
+
+    /** Private to gdbwire, where the results and dictionary are. */
+    const unsigned char *results;
+    const unsigned char *dictionary;
+};
+
+/**
+ * A result of an encoded output, read in place.
+ *
+ * The strings point into the encoded buffer and are valid as long as
+ * the buffer is.
+ */
+struct gdbwire_mi_binary_result {
+    /** The kind of result. */
+    enum gdbwire_mi_result_kind kind;
+
+    /** The variable of the result, or NULL if none. */
+    const char *variable;
+
+    /** The value of the result, when kind is GDBWIRE_MI_CSTRING. */
+    const char *cstring;
+    /** The number of bytes in cstring. */
+    size_t cstring_size;
+
+    /**
+     * The number of results in the tuple or list, when kind is
+     * GDBWIRE_MI_TUPLE or GDBWIRE_MI_LIST.
+     * See gdbwire_mi_binary_result_children.
+     */
+    size_t count;
+
+    /** Private to gdbwire, where the reader is in the buffer. */
+    const unsigned char *children;
+    const unsigned char *next;
+    const unsigned char *dictionary;
+    size_t remaining;
+};
+
+/**
+ * Create an encoder.
+ *
+ * @return
+ * A new encoder or NULL on error.
+ */
+struct gdbwire_mi_binary_encoder *gdbwire_mi_binary_encoder_create(void);
+
+/**
+ * Create an encoder that allocates with the given allocator.
+ *
+ * @param allocator
+ * The allocator to allocate the encoder with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new encoder or NULL on error.
+ */
+struct gdbwire_mi_binary_encoder *
+gdbwire_mi_binary_encoder_create_with_allocator(
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the encoder instance.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param encoder
+ * The instance to destroy.
+ */
+void gdbwire_mi_binary_encoder_destroy(
+        struct gdbwire_mi_binary_encoder *encoder);
+
+/**
+ * Encode an output command.
+ *
+ * Only this output is encoded, not the outputs linked after it.
+ *
+ * @param encoder
+ * The encoder to use.
+ *
+ * @param output
+ * The output to encode.
+ *
+ * @param data
+ * Set to the encoded output. It belongs to the encoder and is valid
+ * until the encoder is used again or destroyed.
+ *
+ * @param size
+ * Set to the number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the tuples and lists of the output nest deeper than
+ * GDBWIRE_MI_BINARY_MAX_DEPTH.
+ */
+enum gdbwire_result gdbwire_mi_binary_encode(
+        struct gdbwire_mi_binary_encoder *encoder,
+        const struct gdbwire_mi_output *output,
+        const void **data, size_t *size);
+
+/**
+ * Read an encoded output command in place.
+ *
+ * The whole buffer is checked up front, so walking the results of the
+ * output afterwards can not fail. Nothing is allocated or copied.
+ *
+ * @param data
+ * The encoded output.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @param output
+ * Set to the encoded output on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the buffer is not an output of this version of the
+ * encoding.
+ */
+enum gdbwire_result gdbwire_mi_binary_read(const void *data, size_t size,
+        struct gdbwire_mi_binary_output *output);
+
+/**
+ * Get the first result of an encoded output.
+ *
+ * @param output
+ * The output read with gdbwire_mi_binary_read.
+ *
+ * @param result
+ * Set to the first result, if there is one.
+ *
+ * @return
+ * 1 if result was set or 0 if the output has no results.
+ */
+int gdbwire_mi_binary_output_results(
+        const struct gdbwire_mi_binary_output *output,
+        struct gdbwire_mi_binary_result *result);
+
+/**
+ * Get the first result in a tuple or list of an encoded output.
+ *
+ * @param result
+ * The tuple or list.
+ *
+ * @param child
+ * Set to the first result in the tuple or list, if there is one.
+ *
+ * @return
+ * 1 if child was set or 0 if result is an empty tuple or list, or a
+ * c-string.
+ */
+int gdbwire_mi_binary_result_children(
+        const struct gdbwire_mi_binary_result *result,
+        struct gdbwire_mi_binary_result *child);
+
+/**
+ * Move on to the next result of the same list.
+ *
+ * @param result
+ * The result, set to the next result if there is one.
+ *
+ * @return
+ * 1 if result was set to the next result or 0 if it was the last one.
+ */
+int gdbwire_mi_binary_result_next(struct gdbwire_mi_binary_result *result);
+
+/**
+ * Decode an encoded output command into a parse tree.
+ *
+ * @param data
+ * The encoded output.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @param output
+ * Set to the output on success, freed with gdbwire_mi_output_free.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the buffer is not an output of this version of the
+ * encoding.
+ */
+enum gdbwire_result gdbwire_mi_binary_decode(const void *data, size_t size,
+        struct gdbwire_mi_output **output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_MI_BINARY_H */
@@ -0,0 +1,243 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "gdbwire_mi_cache.h"
+#include "gdbwire_string.h"
+
+/* Marks the end of a bucket chain */
+#define GDBWIRE_MI_CACHE_NONE ((size_t)-1)
+
+/* A line in the cache */
+struct gdbwire_mi_cache_entry {
+    /* The hash of the line */
+    uint64_t hash;
+    /* The number of bytes in the line */
+    size_t size;
+    /* The output parsed from the line, or NULL if the entry is unused */
+    struct gdbwire_mi_output *output;
+    /* The next entry in the same bucket, or GDBWIRE_MI_CACHE_NONE */
+    size_t next;
+    /* True if the entry was found since the clock hand last passed it */
+    int referenced;
+};
+
+struct gdbwire_mi_cache {
+    /* The entries, capacity of them */
+    struct gdbwire_mi_cache_entry *entries;
+    size_t capacity;
+    /* The first entry of each bucket, or GDBWIRE_MI_CACHE_NONE */
+    size_t *buckets;
+    /* The number of buckets, a power of 2 */
+    size_t buckets_size;
+    /* The entry the clock hand points at */
+    size_t hand;
+    /* The number of lines found and not found */
+    size_t hits;
+    size_t misses;
+    /* The allocator the cache is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+/**
+ * Hash the bytes of a line.
+ *
+ * @param line
+ * The line.
+ *
+ * @param size
+ * The number of bytes in line.
+ *
+ * @return
+ * The FNV-1a hash of the line.
+ */
+static uint64_t
+gdbwire_mi_cache_hash(const char *line, size_t size)
+{
+    return gdbwire_fnv1a(GDBWIRE_FNV1A_BASIS, line, size);
+}
+
+/**
+ * Get the bucket of a hash.
+ *
+ * @param cache
+ * The cache.
+ *
+ * @param hash
+ * The hash of a line.
+ *
+ * @return
+ * The index of the bucket.
+ */
+static size_t
+gdbwire_mi_cache_bucket(struct gdbwire_mi_cache *cache, uint64_t hash)
+{
+    return (size_t)(hash ^ (hash >> 32)) & (cache->buckets_size - 1);
+}
+
+struct gdbwire_mi_cache *
+gdbwire_mi_cache_create(size_t capacity,
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_mi_cache *cache;
+    size_t index;
+
+    if (capacity == 0 || !gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    cache = (struct gdbwire_mi_cache *)gdbwire_calloc(allocator, 1,
+        sizeof (struct gdbwire_mi_cache));
+    if (!cache) {
+        return NULL;
+    }
+
+    cache->allocator = (allocator) ? *allocator :
+        gdbwire_get_default_allocator();
+    cache->capacity = capacity;
+
+    /* Keep the chains short with at least twice the buckets as entries */
+    cache->buckets_size = 1;
+    while (cache->buckets_size < capacity * 2) {
+        cache->buckets_size *= 2;
+    }
+
+    cache->entries = (struct gdbwire_mi_cache_entry *)gdbwire_calloc(
+        &cache->allocator, capacity, sizeof (struct gdbwire_mi_cache_entry));
+    cache->buckets = (size_t *)gdbwire_calloc(&cache->allocator,
+        cache->buckets_size, sizeof (size_t));
+    if (!cache->entries || !cache->buckets) {
+        gdbwire_mi_cache_destroy(cache);
+        return NULL;
+    }
+
+    for (index = 0; index < cache->buckets_size; ++index) {
+        cache->buckets[index] = GDBWIRE_MI_CACHE_NONE;
+    }
+
+    return cache;
+}
+
+void
+gdbwire_mi_cache_destroy(struct gdbwire_mi_cache *cache)
+{
+    if (cache) {
+        /* The cache is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = cache->allocator;
+
+        if (cache->entries && cache->buckets) {
+            gdbwire_mi_cache_clear(cache);
+        }
+
+        gdbwire_free(&allocator, cache->entries);
+        gdbwire_free(&allocator, cache->buckets);
+        gdbwire_free(&allocator, cache);
+    }
+}
+
+void
+gdbwire_mi_cache_clear(struct gdbwire_mi_cache *cache)
+{
+    size_t index;
+
+    for (index = 0; index < cache->capacity; ++index) {
+        gdbwire_mi_output_free(cache->entries[index].output);
+        cache->entries[index].output = NULL;
+        cache->entries[index].referenced = 0;
+    }
+
+    for (index = 0; index < cache->buckets_size; ++index) {
+        cache->buckets[index] = GDBWIRE_MI_CACHE_NONE;
+    }
+
+    cache->hand = 0;
+}
+
+const struct gdbwire_mi_output *
+gdbwire_mi_cache_find(struct gdbwire_mi_cache *cache, const char *line,
+        size_t size)
+{
+    uint64_t hash = gdbwire_mi_cache_hash(line, size);
+    struct gdbwire_mi_cache_entry *entry;
+    size_t index;
+
+    index = cache->buckets[gdbwire_mi_cache_bucket(cache, hash)];
+    while (index != GDBWIRE_MI_CACHE_NONE) {
+        entry = &cache->entries[index];
+        if (entry->hash == hash && entry->size == size &&
+                memcmp(entry->output->line, line, size) == 0) {
+            entry->referenced = 1;
+            cache->hits++;
+            return entry->output;
+        }
+        index = entry->next;
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+/**
+ * Remove an entry from its bucket chain.
+ *
+ * @param cache
+ * The cache.
+ *
+ * @param index
+ * The index of the entry, which is in use.
+ */
+static void
+gdbwire_mi_cache_unlink(struct gdbwire_mi_cache *cache, size_t index)
+{
+    size_t *link = &cache->buckets[gdbwire_mi_cache_bucket(cache,
+        cache->entries[index].hash)];
+
+    while (*link != index) {
+        link = &cache->entries[*link].next;
+    }
+    *link = cache->entries[index].next;
+}
+
+void
+gdbwire_mi_cache_insert(struct gdbwire_mi_cache *cache,
+        struct gdbwire_mi_output *output, size_t size)
+{
+    struct gdbwire_mi_cache_entry *entry;
+    size_t bucket;
+
+    /**
+     * Advance the clock hand to the first entry that is unused or not
+     * found since the hand last passed it, giving the rest another turn.
+     */
+    for (;;) {
+        entry = &cache->entries[cache->hand];
+        if (!entry->output || !entry->referenced) {
+            break;
+        }
+        entry->referenced = 0;
+        cache->hand = (cache->hand + 1) % cache->capacity;
+    }
+
+    if (entry->output) {
+        gdbwire_mi_cache_unlink(cache, cache->hand);
+        gdbwire_mi_output_free(entry->output);
+    }
+
+    entry->hash = gdbwire_mi_cache_hash(output->line, size);
+    entry->size = size;
+    entry->output = output;
+    entry->referenced = 0;
+
+    bucket = gdbwire_mi_cache_bucket(cache, entry->hash);
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = cache->hand;
+
+    cache->hand = (cache->hand + 1) % cache->capacity;
+}
+
+void
+gdbwire_mi_cache_get_stats(struct gdbwire_mi_cache *cache, size_t *hits,
+        size_t *misses)
+{
+    *hits = cache->hits;
+    *misses = cache->misses;
+}
@@ -0,0 +1,120 @@
+#ifndef GDBWIRE_MI_CACHE_H
+#define GDBWIRE_MI_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include "gdbwire_allocator.h"
+#include "gdbwire_mi_pt.h"
+
+/**
+ * A cache of the parse trees of recently seen GDB/MI lines.
+ *
+ * GDB repeats many lines word for word, like "^done", "(gdb)" and
+ * "*running,thread-id="all"". The parser looks each short line up in
+ * the cache by its bytes and shares the cached parse tree instead of
+ * lexing and parsing the line again.
+ *
+ * The cache holds a fixed number of lines. When it is full, the line
+ * to make room for is chosen with the clock algorithm, an approximation
+ * of least recently used that only sets a flag on a hit.
+ *
+ * The cache is used by the thread that builds the parser's trees,
+ * which owns the arena pool the cached outputs are freed to.
+ */
+struct gdbwire_mi_cache;
+
+/**
+ * Create a cache.
+ *
+ * @param capacity
+ * The number of lines the cache holds, at least 1.
+ *
+ * @param allocator
+ * The allocator to allocate the cache with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new, empty cache or NULL on error.
+ */
+struct gdbwire_mi_cache *gdbwire_mi_cache_create(size_t capacity,
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy a cache, freeing the outputs it holds.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param cache
+ * The cache to destroy.
+ */
+void gdbwire_mi_cache_destroy(struct gdbwire_mi_cache *cache);
+
+/**
+ * Free the outputs a cache holds, keeping its statistics.
+ *
+ * @param cache
+ * The cache to clear.
+ */
+void gdbwire_mi_cache_clear(struct gdbwire_mi_cache *cache);
+
+/**
+ * Find the output parsed from a line.
+ *
+ * Each call counts as a hit or a miss.
+ *
+ * @param cache
+ * The cache to search.
+ *
+ * @param line
+ * The line, including the newline.
+ *
+ * @param size
+ * The number of bytes in line.
+ *
+ * @return
+ * The output parsed from the same bytes, still owned by the cache,
+ * or NULL if the line is not in the cache.
+ */
+const struct gdbwire_mi_output *gdbwire_mi_cache_find(
+        struct gdbwire_mi_cache *cache, const char *line, size_t size);
+
+/**
+ * Add the output of a line that was not found to a cache.
+ *
+ * @param cache
+ * The cache to add to.
+ *
+ * @param output
+ * The output, whose line field holds the line it was parsed from.
+ * The cache takes ownership of the output and frees it when the line
+ * is forgotten.
+ *
+ * @param size
+ * The number of bytes in the line of the output.
+ */
+void gdbwire_mi_cache_insert(struct gdbwire_mi_cache *cache,
+        struct gdbwire_mi_output *output, size_t size);
+
+/**
+ * Get the number of hits and misses of a cache.
+ *
+ * @param cache
+ * The cache.
+ *
+ * @param hits
+ * Set to the number of lines found in the cache.
+ *
+ * @param misses
+ * Set to the number of lines not found in the cache.
+ */
+void gdbwire_mi_cache_get_stats(struct gdbwire_mi_cache *cache,
+        size_t *hits, size_t *misses);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_MI_CACHE_H */
@@ -3,6 +3,7 @@
 #include <errno.h>
 
 #include "gdbwire_sys.h"
+#include "gdbwire_allocator.h"
 #include "gdbwire_assert.h"
 #include "gdbwire_mi_command.h"
 
@@ -17,11 +18,11 @@ gdbwire_mi_source_files_free(struct gdbwire_mi_source_file *files)
 {
     struct gdbwire_mi_source_file *tmp, *cur = files;
     while (cur) {
-        free(cur->file);
-        free(cur->fullname);
+        gdbwire_free(NULL, cur->file);
+        gdbwire_free(NULL, cur->fullname);
         tmp = cur;
         cur = cur->next;
-        free(tmp);
+        gdbwire_free(NULL, tmp);
     }
 }
 
@@ -36,21 +37,21 @@ gdbwire_mi_breakpoints_free(struct gdbwire_mi_breakpoint *breakpoints)
 {
     struct gdbwire_mi_breakpoint *tmp, *cur = breakpoints;
     while (cur) {
-        free(cur->original_location);
-        free(cur->fullname);
-        free(cur->file);
-        free(cur->func_name);
-        free(cur->address);
-        free(cur->catch_type);
-        free(cur->type);
-        free(cur->number);
+        gdbwire_free(NULL, cur->original_location);
+        gdbwire_free(NULL, cur->fullname);
+        gdbwire_free(NULL, cur->file);
+        gdbwire_free(NULL, cur->func_name);
+        gdbwire_free(NULL, cur->address);
+        gdbwire_free(NULL, cur->catch_type);
+        gdbwire_free(NULL, cur->type);
+        gdbwire_free(NULL, cur->number);
 
         gdbwire_mi_breakpoints_free(cur->multi_breakpoints);
         cur->multi_breakpoint = 0;
 
         tmp = cur;
         cur = cur->next;
-        free(tmp);
+        gdbwire_free(NULL, tmp);
     }
 }
 
@@ -63,12 +64,12 @@ gdbwire_mi_breakpoints_free(struct gdbwire_mi_breakpoint *breakpoints)
 static void
 gdbwire_mi_stack_frame_free(struct gdbwire_mi_stack_frame *frame)
 {
-    free(frame->address);
-    free(frame->func);
-    free(frame->file);
-    free(frame->fullname);
-    free(frame->from);
-    free(frame);
+    gdbwire_free(NULL, frame->address);
+    gdbwire_free(NULL, frame->func);
+    gdbwire_free(NULL, frame->file);
+    gdbwire_free(NULL, frame->fullname);
+    gdbwire_free(NULL, frame->from);
+    gdbwire_free(NULL, frame);
 }
 
 /**
@@ -199,7 +200,7 @@ break_info_for_breakpoint(struct gdbwire_mi_result *mi_result,
     GDBWIRE_ASSERT(number);
 
     /* At this point, allocate a breakpoint */
-    breakpoint = calloc(1, sizeof(struct gdbwire_mi_breakpoint));
+    breakpoint = gdbwire_calloc(NULL, 1, sizeof(struct gdbwire_mi_breakpoint));
     if (!breakpoint) {
         return GDBWIRE_NOMEM;
     }
@@ -350,7 +351,7 @@ break_info(
         mi_result = mi_result->next;
     }
 
-    mi_command = calloc(1, sizeof(struct gdbwire_mi_command));
+    mi_command = gdbwire_calloc(NULL, 1, sizeof(struct gdbwire_mi_command));
     if (!mi_command) {
         result = GDBWIRE_NOMEM;
         goto cleanup;
@@ -431,7 +432,7 @@ stack_info_frame(
         address = 0;
     }
 
-    frame = calloc(1, sizeof(struct gdbwire_mi_stack_frame));
+    frame = gdbwire_calloc(NULL, 1, sizeof(struct gdbwire_mi_stack_frame));
     if (!frame) {
         return GDBWIRE_NOMEM;
     }
@@ -454,7 +455,7 @@ stack_info_frame(
         return GDBWIRE_NOMEM;
     }
 
-    mi_command = calloc(1, sizeof(struct gdbwire_mi_command));
+    mi_command = gdbwire_calloc(NULL, 1, sizeof(struct gdbwire_mi_command));
     if (!mi_command) {
         gdbwire_mi_stack_frame_free(frame);
         return GDBWIRE_NOMEM;
@@ -516,7 +517,7 @@ file_list_exec_source_file(
 
     GDBWIRE_ASSERT(line && file);
 
-    mi_command = calloc(1, sizeof(struct gdbwire_mi_command));
+    mi_command = gdbwire_calloc(NULL, 1, sizeof(struct gdbwire_mi_command));
     if (!mi_command) {
         return GDBWIRE_NOMEM;
     }
@@ -603,7 +604,8 @@ file_list_exec_source_files(
         GDBWIRE_ASSERT(!tuple->next);
 
         /* Create the new */
-        new_node = calloc(1, sizeof(struct gdbwire_mi_source_file));
+        new_node = gdbwire_calloc(NULL, 1,
+            sizeof(struct gdbwire_mi_source_file));
         GDBWIRE_ASSERT_GOTO(new_node, result, err);
 
         new_node->file = gdbwire_strdup(file);
@@ -624,7 +626,7 @@ file_list_exec_source_files(
         mi_result = mi_result->next;
     }
 
-    *out = calloc(1, sizeof(struct gdbwire_mi_command));
+    *out = gdbwire_calloc(NULL, 1, sizeof(struct gdbwire_mi_command));
     GDBWIRE_ASSERT_GOTO(*out, result, err);
     (*out)->kind = GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILES;
     (*out)->variant.file_list_exec_source_files.files = files;
@@ -680,8 +682,10 @@ void gdbwire_mi_command_free(struct gdbwire_mi_command *mi_command)
                     mi_command->variant.stack_info_frame.frame);
                 break;
             case GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE:
-                free(mi_command->variant.file_list_exec_source_file.file);
-                free(mi_command->variant.file_list_exec_source_file.fullname);
+                gdbwire_free(NULL,
+                    mi_command->variant.file_list_exec_source_file.file);
+                gdbwire_free(NULL,
+                    mi_command->variant.file_list_exec_source_file.fullname);
                 break;
             case GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILES:
                 gdbwire_mi_source_files_free(
@@ -689,6 +693,6 @@ void gdbwire_mi_command_free(struct gdbwire_mi_command *mi_command)
                 break;
         }
 
-        free(mi_command);
+        gdbwire_free(NULL, mi_command);
     }
 }
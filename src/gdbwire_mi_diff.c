@@ -0,0 +1,681 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gdbwire_assert.h"
+#include "gdbwire_mi_diff.h"
+#include "gdbwire_string.h"
+
+/* The key fields list elements are matched by when none are set */
+static const char *const gdbwire_mi_diff_default_keys[] = {
+    "number", "id", "level", "name", NULL
+};
+
+/* A result of a tuple or list being diffed */
+struct gdbwire_mi_diff_entry {
+    /* The result */
+    const struct gdbwire_mi_result *result;
+    /* The key field of a list element, or NULL if none */
+    const struct gdbwire_mi_result *key;
+    /**
+     * The number of earlier results named the same way. In a tuple,
+     * those with the same variable, in a list, those without a key.
+     */
+    size_t ordinal;
+    /* The index of the matching earlier entry plus 1, or 0 if none */
+    size_t match;
+    /* True if an earlier entry was matched by a later one */
+    int matched;
+};
+
+struct gdbwire_mi_diff {
+    /* The key fields list elements are matched by, ending with NULL */
+    const char *const *keys;
+    /* The path of the result being diffed, NUL terminated */
+    char *path;
+    size_t path_size;
+    size_t path_capacity;
+    /**
+     * The entries of the tuples and lists being diffed, a stack with
+     * the entries of each level of the trees above those of the next.
+     */
+    struct gdbwire_mi_diff_entry *entries;
+    size_t entries_size;
+    size_t entries_capacity;
+    /* The hash table matching list elements by key, rebuilt for each list */
+    size_t *slots;
+    size_t slots_capacity;
+    /* The callback and its context */
+    gdbwire_mi_diff_callback callback;
+    void *context;
+    /* The allocator the diff is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+static enum gdbwire_result gdbwire_mi_diff_result(
+        struct gdbwire_mi_diff *diff,
+        const struct gdbwire_mi_result *before,
+        const struct gdbwire_mi_result *after);
+
+struct gdbwire_mi_diff *
+gdbwire_mi_diff_create(void)
+{
+    return gdbwire_mi_diff_create_with_allocator(NULL);
+}
+
+struct gdbwire_mi_diff *
+gdbwire_mi_diff_create_with_allocator(
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_mi_diff *diff;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    diff = (struct gdbwire_mi_diff *)gdbwire_calloc(allocator, 1,
+        sizeof (struct gdbwire_mi_diff));
+    if (diff) {
+        diff->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
+        diff->keys = gdbwire_mi_diff_default_keys;
+    }
+
+    return diff;
+}
+
+void
+gdbwire_mi_diff_destroy(struct gdbwire_mi_diff *diff)
+{
+    if (diff) {
+        /* The diff is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = diff->allocator;
+
+        gdbwire_free(&allocator, diff->path);
+        gdbwire_free(&allocator, diff->entries);
+        gdbwire_free(&allocator, diff->slots);
+        gdbwire_free(&allocator, diff);
+    }
+}
+
+enum gdbwire_result
+gdbwire_mi_diff_set_keys(struct gdbwire_mi_diff *diff,
+        const char *const *keys)
+{
+    GDBWIRE_ASSERT(diff);
+
+    diff->keys = (keys) ? keys : gdbwire_mi_diff_default_keys;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Grow an array to hold at least a number of elements.
+ *
+ * @param diff
+ * The diff whose allocator grows the array.
+ *
+ * @param data
+ * The array, updated if it moves.
+ *
+ * @param capacity
+ * The number of elements the array holds, updated on success.
+ *
+ * @param count
+ * The number of elements the array must hold.
+ *
+ * @param size
+ * The size of each element.
+ *
+ * @return
+ * 0 on success or -1 if out of memory.
+ */
+static int
+gdbwire_mi_diff_reserve(struct gdbwire_mi_diff *diff, void **data,
+        size_t *capacity, size_t count, size_t size)
+{
+    size_t new_capacity = (*capacity > 0) ? *capacity : 16;
+    void *new_data;
+
+    if (count <= *capacity) {
+        return 0;
+    }
+
+    while (new_capacity < count) {
+        if (new_capacity > (size_t)-1 / 2 / size) {
+            return -1;
+        }
+        new_capacity *= 2;
+    }
+
+    new_data = gdbwire_realloc(&diff->allocator, *data, new_capacity * size);
+    if (!new_data) {
+        return -1;
+    }
+
+    *data = new_data;
+    *capacity = new_capacity;
+
+    return 0;
+}
+
+/**
+ * Append to the path of the result being diffed.
+ *
+ * @param diff
+ * The diff.
+ *
+ * @param data
+ * The characters to append.
+ *
+ * @param size
+ * The number of characters in data.
+ *
+ * @return
+ * 0 on success or -1 if out of memory.
+ */
+static int
+gdbwire_mi_diff_append(struct gdbwire_mi_diff *diff, const char *data,
+        size_t size)
+{
+    if (gdbwire_mi_diff_reserve(diff, (void **)&diff->path,
+            &diff->path_capacity, diff->path_size + size + 1, 1) == -1) {
+        return -1;
+    }
+
+    memcpy(diff->path + diff->path_size, data, size);
+    diff->path_size += size;
+    diff->path[diff->path_size] = 0;
+
+    return 0;
+}
+
+/**
+ * Cut the path back to an earlier size.
+ *
+ * @param diff
+ * The diff.
+ *
+ * @param size
+ * The size of the path before the names appended since.
+ */
+static void
+gdbwire_mi_diff_truncate(struct gdbwire_mi_diff *diff, size_t size)
+{
+    diff->path_size = size;
+    diff->path[size] = 0;
+}
+
+/**
+ * Append a number in brackets or after a # to the path.
+ *
+ * @param diff
+ * The diff.
+ *
+ * @param format
+ * "[%lu]" or "#%lu".
+ *
+ * @param number
+ * The number to append.
+ *
+ * @return
+ * 0 on success or -1 if out of memory.
+ */
+static int
+gdbwire_mi_diff_append_number(struct gdbwire_mi_diff *diff,
+        const char *format, size_t number)
+{
+    char buffer[32];
+    int size = snprintf(buffer, sizeof (buffer), format,
+        (unsigned long)number);
+
+    return gdbwire_mi_diff_append(diff, buffer, (size_t)size);
+}
+
+/**
+ * Append the name of a result in a tuple or list to the path.
+ *
+ * @param diff
+ * The diff.
+ *
+ * @param entry
+ * The entry of the result.
+ *
+ * @param list
+ * True if the result is an element of a list, false for a tuple.
+ *
+ * @return
+ * 0 on success or -1 if out of memory.
+ */
+static int
+gdbwire_mi_diff_append_name(struct gdbwire_mi_diff *diff,
+        const struct gdbwire_mi_diff_entry *entry, int list)
+{
+    const char *variable = entry->result->variable;
+
+    if (list && entry->key) {
+        return (gdbwire_mi_diff_append(diff, "[", 1) == 0 &&
+            gdbwire_mi_diff_append(diff, entry->key->variable,
+                strlen(entry->key->variable)) == 0 &&
+            gdbwire_mi_diff_append(diff, "=", 1) == 0 &&
+            gdbwire_mi_diff_append(diff, entry->key->variant.cstring,
+                strlen(entry->key->variant.cstring)) == 0 &&
+            gdbwire_mi_diff_append(diff, "]", 1) == 0) ? 0 : -1;
+    }
+
+    if (list || !variable) {
+        return gdbwire_mi_diff_append_number(diff, "[%lu]", entry->ordinal);
+    }
+
+    if ((diff->path_size > 0 && gdbwire_mi_diff_append(diff, ".", 1) == -1)
+            || gdbwire_mi_diff_append(diff, variable, strlen(variable)) == -1) {
+        return -1;
+    }
+
+    return (entry->ordinal > 0) ?
+        gdbwire_mi_diff_append_number(diff, "#%lu", entry->ordinal) : 0;
+}
+
+/**
+ * Determine if two strings, which may be NULL, are equal.
+ *
+ * @param lhs
+ * One string or NULL.
+ *
+ * @param rhs
+ * The other string or NULL.
+ *
+ * @return
+ * 1 if both are NULL or both have the same characters, otherwise 0.
+ */
+static int
+gdbwire_mi_diff_string_equal(const char *lhs, const char *rhs)
+{
+    if (!lhs || !rhs) {
+        return lhs == rhs;
+    }
+    return strcmp(lhs, rhs) == 0;
+}
+
+/**
+ * Find the key field of a list element.
+ *
+ * @param diff
+ * The diff holding the key fields.
+ *
+ * @param result
+ * The list element.
+ *
+ * @return
+ * The c-string result of the first key field the element is a tuple
+ * holding, or NULL if none.
+ */
+static const struct gdbwire_mi_result *
+gdbwire_mi_diff_find_key(struct gdbwire_mi_diff *diff,
+        const struct gdbwire_mi_result *result)
+{
+    const struct gdbwire_mi_result *member;
+    const char *const *key;
+
+    if (result->kind != GDBWIRE_MI_TUPLE) {
+        return NULL;
+    }
+
+    for (key = diff->keys; *key; ++key) {
+        for (member = result->variant.result; member; member = member->next) {
+            if (member->kind == GDBWIRE_MI_CSTRING && member->variable &&
+                    strcmp(member->variable, *key) == 0) {
+                return member;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Hash the key field of a list element.
+ *
+ * @param key
+ * The key field.
+ *
+ * @return
+ * The FNV-1a hash of its variable and value.
+ */
+static uint64_t
+gdbwire_mi_diff_hash_key(const struct gdbwire_mi_result *key)
+{
+    /* The NUL of the variable keeps it apart from the value */
+    uint64_t hash = gdbwire_fnv1a(GDBWIRE_FNV1A_BASIS, key->variable,
+        strlen(key->variable) + 1);
+
+    return gdbwire_fnv1a(hash, key->variant.cstring,
+        strlen(key->variant.cstring));
+}
+
+/**
+ * Add the entries of the results of a tuple or list to the stack.
+ *
+ * @param diff
+ * The diff.
+ *
+ * @param result
+ * The first result of the tuple or list.
+ *
+ * @param list
+ * True if the results are the elements of a list.
+ *
+ * @param count
+ * Set to the number of results.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_diff_push_entries(struct gdbwire_mi_diff *diff,
+        const struct gdbwire_mi_result *result, int list, size_t *count)
+{
+    size_t base = diff->entries_size, index, keyless = 0;
+    struct gdbwire_mi_diff_entry *entry;
+    const struct gdbwire_mi_result *cur;
+
+    *count = 0;
+    for (cur = result; cur; cur = cur->next) {
+        ++*count;
+    }
+
+    if (gdbwire_mi_diff_reserve(diff, (void **)&diff->entries,
+            &diff->entries_capacity, base + *count,
+            sizeof (struct gdbwire_mi_diff_entry)) == -1) {
+        return GDBWIRE_NOMEM;
+    }
+
+    for (cur = result, entry = diff->entries + base; cur;
+            cur = cur->next, ++entry) {
+        entry->result = cur;
+        entry->key = (list) ? gdbwire_mi_diff_find_key(diff, cur) : NULL;
+        entry->ordinal = 0;
+        entry->match = 0;
+        entry->matched = 0;
+
+        if (list) {
+            if (!entry->key) {
+                entry->ordinal = keyless++;
+            }
+        } else {
+            /* Tuples are small, count the earlier same variables */
+            for (index = base; index < (size_t)(entry - diff->entries);
+                    ++index) {
+                if (gdbwire_mi_diff_string_equal(
+                        diff->entries[index].result->variable,
+                        cur->variable)) {
+                    entry->ordinal++;
+                }
+            }
+        }
+    }
+
+    diff->entries_size = base + *count;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Match the elements of two lists by their key fields.
+ *
+ * @param diff
+ * The diff.
+ *
+ * @param before
+ * The index of the first entry of the earlier list.
+ *
+ * @param before_count
+ * The number of entries of the earlier list.
+ *
+ * @param after
+ * The index of the first entry of the later list.
+ *
+ * @param after_count
+ * The number of entries of the later list.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_diff_match_keys(struct gdbwire_mi_diff *diff, size_t before,
+        size_t before_count, size_t after, size_t after_count)
+{
+    size_t table_size = 1, mask, index, slot;
+    struct gdbwire_mi_diff_entry *entry, *other;
+
+    while (table_size < before_count * 2) {
+        table_size *= 2;
+    }
+    mask = table_size - 1;
+
+    if (gdbwire_mi_diff_reserve(diff, (void **)&diff->slots,
+            &diff->slots_capacity, table_size, sizeof (size_t)) == -1) {
+        return GDBWIRE_NOMEM;
+    }
+    memset(diff->slots, 0, table_size * sizeof (size_t));
+
+    /* Index the earlier elements with a key, by open addressing */
+    for (index = before; index < before + before_count; ++index) {
+        entry = &diff->entries[index];
+        if (entry->key) {
+            slot = (size_t)gdbwire_mi_diff_hash_key(entry->key) & mask;
+            while (diff->slots[slot]) {
+                slot = (slot + 1) & mask;
+            }
+            diff->slots[slot] = index + 1;
+        }
+    }
+
+    /* Duplicate keys are matched in order by taking the first unmatched */
+    for (index = after; index < after + after_count; ++index) {
+        entry = &diff->entries[index];
+        if (!entry->key) {
+            continue;
+        }
+        slot = (size_t)gdbwire_mi_diff_hash_key(entry->key) & mask;
+        while (diff->slots[slot]) {
+            other = &diff->entries[diff->slots[slot] - 1];
+            if (!other->matched &&
+                    strcmp(other->key->variable, entry->key->variable) == 0 &&
+                    strcmp(other->key->variant.cstring,
+                        entry->key->variant.cstring) == 0) {
+                other->matched = 1;
+                entry->match = diff->slots[slot];
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Report the differences between the results of two tuples or lists.
+ *
+ * @param diff
+ * The diff.
+ *
+ * @param before
+ * The first result of the earlier tuple or list.
+ *
+ * @param after
+ * The first result of the later tuple or list.
+ *
+ * @param list
+ * True for lists, false for tuples.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_diff_children(struct gdbwire_mi_diff *diff,
+        const struct gdbwire_mi_result *before,
+        const struct gdbwire_mi_result *after, int list)
+{
+    size_t entries_base = diff->entries_size, path_size = diff->path_size;
+    size_t before_count, after_count;
+    size_t index, other, next_keyless;
+    enum gdbwire_result result = GDBWIRE_OK;
+    struct gdbwire_mi_diff_entry *entry;
+
+    result = gdbwire_mi_diff_push_entries(diff, before, list, &before_count);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_diff_push_entries(diff, after, list,
+            &after_count);
+    }
+    if (result == GDBWIRE_OK && list) {
+        result = gdbwire_mi_diff_match_keys(diff, entries_base, before_count,
+            entries_base + before_count, after_count);
+    }
+    if (result != GDBWIRE_OK) {
+        goto cleanup;
+    }
+
+    /**
+     * Match the rest in order, the results of a tuple by variable and
+     * the elements of a list without a key by position.
+     */
+    next_keyless = entries_base;
+    for (index = entries_base + before_count;
+            index < entries_base + before_count + after_count; ++index) {
+        entry = &diff->entries[index];
+        if (list) {
+            if (entry->key) {
+                continue;
+            }
+            while (next_keyless < entries_base + before_count &&
+                    diff->entries[next_keyless].key) {
+                ++next_keyless;
+            }
+            if (next_keyless < entries_base + before_count) {
+                diff->entries[next_keyless].matched = 1;
+                entry->match = ++next_keyless;
+            }
+        } else {
+            for (other = entries_base; other < entries_base + before_count;
+                    ++other) {
+                if (!diff->entries[other].matched &&
+                        gdbwire_mi_diff_string_equal(
+                            diff->entries[other].result->variable,
+                            entry->result->variable)) {
+                    diff->entries[other].matched = 1;
+                    entry->match = other + 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (index = entries_base; index < entries_base + before_count; ++index) {
+        if (!diff->entries[index].matched) {
+            if (gdbwire_mi_diff_append_name(diff, &diff->entries[index],
+                    list) == -1) {
+                result = GDBWIRE_NOMEM;
+                goto cleanup;
+            }
+            diff->callback(diff->context, GDBWIRE_MI_DIFF_REMOVED,
+                diff->path, diff->entries[index].result, NULL);
+            gdbwire_mi_diff_truncate(diff, path_size);
+        }
+    }
+
+    /* The entries may move as the results below are diffed */
+    for (index = entries_base + before_count;
+            index < entries_base + before_count + after_count; ++index) {
+        if (gdbwire_mi_diff_append_name(diff, &diff->entries[index],
+                list) == -1) {
+            result = GDBWIRE_NOMEM;
+            break;
+        }
+        other = diff->entries[index].match;
+        if (other) {
+            result = gdbwire_mi_diff_result(diff,
+                diff->entries[other - 1].result,
+                diff->entries[index].result);
+        } else {
+            diff->callback(diff->context, GDBWIRE_MI_DIFF_ADDED, diff->path,
+                NULL, diff->entries[index].result);
+        }
+        gdbwire_mi_diff_truncate(diff, path_size);
+        if (result != GDBWIRE_OK) {
+            break;
+        }
+    }
+
+cleanup:
+    gdbwire_mi_diff_truncate(diff, path_size);
+    diff->entries_size = entries_base;
+    return result;
+}
+
+/**
+ * Report the differences between two results at the same path.
+ *
+ * @param diff
+ * The diff.
+ *
+ * @param before
+ * The earlier result.
+ *
+ * @param after
+ * The later result.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_diff_result(struct gdbwire_mi_diff *diff,
+        const struct gdbwire_mi_result *before,
+        const struct gdbwire_mi_result *after)
+{
+    /* A shared subtree has not changed */
+    if (before == after) {
+        return GDBWIRE_OK;
+    }
+
+    if (before->kind != after->kind || (before->kind == GDBWIRE_MI_CSTRING &&
+            !gdbwire_mi_diff_string_equal(before->variant.cstring,
+                after->variant.cstring))) {
+        diff->callback(diff->context, GDBWIRE_MI_DIFF_CHANGED, diff->path,
+            before, after);
+        return GDBWIRE_OK;
+    }
+
+    if (before->kind == GDBWIRE_MI_CSTRING) {
+        return GDBWIRE_OK;
+    }
+
+    /* Distinct subtrees may hash the same, so equal hashes are confirmed */
+    if (before->hash && before->hash == after->hash &&
+            gdbwire_mi_result_equal(before->variant.result,
+                after->variant.result)) {
+        return GDBWIRE_OK;
+    }
+
+    return gdbwire_mi_diff_children(diff, before->variant.result,
+        after->variant.result, before->kind == GDBWIRE_MI_LIST);
+}
+
+enum gdbwire_result
+gdbwire_mi_diff_results(struct gdbwire_mi_diff *diff,
+        const struct gdbwire_mi_result *before,
+        const struct gdbwire_mi_result *after,
+        gdbwire_mi_diff_callback callback, void *context)
+{
+    GDBWIRE_ASSERT(diff && callback);
+
+    diff->callback = callback;
+    diff->context = context;
+    diff->path_size = 0;
+    if (gdbwire_mi_diff_append(diff, "", 0) == -1) {
+        return GDBWIRE_NOMEM;
+    }
+
+    return gdbwire_mi_diff_children(diff, before, after, 0);
+}
@@ -0,0 +1,168 @@
+#ifndef GDBWIRE_MI_DIFF_H
+#define GDBWIRE_MI_DIFF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gdbwire_allocator.h"
+#include "gdbwire_result.h"
+#include "gdbwire_mi_pt.h"
+
+/**
+ * A structural diff of two GDB/MI result lists.
+ *
+ * Front ends query -thread-info, -stack-list-locals or -break-info
+ * again and again, and only want to redraw what changed. The diff walks
+ * the result lists of two records side by side and reports each path
+ * that was added, removed or changed.
+ *
+ * The results of a tuple, and the results of a record, are matched by
+ * their variable. A path names them with their variables separated by
+ * dots, like "frame.addr". When a variable repeats, as bkpt does in
+ * some versions of GDB, the later results get the number of earlier
+ * ones with the same variable, like "bkpt#1". Results without a
+ * variable are numbered in brackets, like "[0]".
+ *
+ * The elements of a list are matched by a key field when they are
+ * tuples holding one, so a thread that went away is removed rather than
+ * every later thread changing. The key fields are tried in order, by
+ * default "number", "id", "level" and "name". A path names such an
+ * element with its key, like "threads[id=3].state". The other elements
+ * of a list are matched by their position among them, like "args[1]".
+ *
+ * Subtrees shared by both lists, like those from the parser's line
+ * cache, are skipped without being walked. Subtrees whose cached hashes
+ * are equal are only compared with gdbwire_mi_result_equal rather than
+ * diffed, as distinct subtrees may hash the same. See
+ * gdbwire_mi_parser_set_hashes.
+ *
+ * A diff keeps the memory it needs between uses, so diffing records of
+ * about the same size again does not allocate memory.
+ */
+struct gdbwire_mi_diff;
+
+/** The kind of a difference between two result lists. */
+enum gdbwire_mi_diff_kind {
+    /** The path is only in the later list. */
+    GDBWIRE_MI_DIFF_ADDED,
+
+    /** The path is only in the earlier list. */
+    GDBWIRE_MI_DIFF_REMOVED,
+
+    /**
+     * The path is in both lists with a different value.
+     *
+     * Only reported for a c-string that changed, or for a result that
+     * changed between a c-string, a tuple and a list. The changes inside
+     * of a tuple or list are reported for the paths within it.
+     */
+    GDBWIRE_MI_DIFF_CHANGED
+};
+
+/**
+ * Receives the differences found by gdbwire_mi_diff_results.
+ *
+ * @param context
+ * The context passed to gdbwire_mi_diff_results.
+ *
+ * @param kind
+ * The kind of difference.
+ *
+ * @param path
+ * The path of the result that differs, only valid during the call.
+ *
+ * @param before
+ * The result in the earlier list, or NULL if added. Only the result
+ * and what it contains belong to the path, not the results after it.
+ *
+ * @param after
+ * The result in the later list, or NULL if removed.
+ */
+typedef void (*gdbwire_mi_diff_callback)(void *context,
+        enum gdbwire_mi_diff_kind kind, const char *path,
+        const struct gdbwire_mi_result *before,
+        const struct gdbwire_mi_result *after);
+
+/**
+ * Create a diff.
+ *
+ * @return
+ * A new diff or NULL on error.
+ */
+struct gdbwire_mi_diff *gdbwire_mi_diff_create(void);
+
+/**
+ * Create a diff that allocates with the given allocator.
+ *
+ * @param allocator
+ * The allocator to allocate the diff with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new diff or NULL on error.
+ */
+struct gdbwire_mi_diff *gdbwire_mi_diff_create_with_allocator(
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the diff instance.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param diff
+ * The instance to destroy.
+ */
+void gdbwire_mi_diff_destroy(struct gdbwire_mi_diff *diff);
+
+/**
+ * Set the key fields list elements are matched by.
+ *
+ * @param diff
+ * The diff to configure.
+ *
+ * @param keys
+ * The variables of the key fields, in the order they are tried, ending
+ * with NULL. The array and strings must stay valid while the diff uses
+ * them. NULL restores the default keys.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_diff_set_keys(struct gdbwire_mi_diff *diff,
+        const char *const *keys);
+
+/**
+ * Report the differences between two result lists.
+ *
+ * The removed paths of a tuple or list are reported first, in their
+ * earlier order, then the added and changed paths in their later order.
+ *
+ * @param diff
+ * The diff to use.
+ *
+ * @param before
+ * The first result of the earlier list, OK to pass in NULL.
+ *
+ * @param after
+ * The first result of the later list, OK to pass in NULL.
+ *
+ * @param callback
+ * Invoked for each difference found.
+ *
+ * @param context
+ * Passed to the callback.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_diff_results(struct gdbwire_mi_diff *diff,
+        const struct gdbwire_mi_result *before,
+        const struct gdbwire_mi_result *after,
+        gdbwire_mi_diff_callback callback, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_MI_DIFF_H */
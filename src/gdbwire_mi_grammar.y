@@ -3,40 +3,42 @@
 %define api.push_pull "push"
 %defines
 %code requires {
-
-/* An opaque pointer. */
-#ifndef YY_TYPEDEF_YY_SCANNER_T
-#define YY_TYPEDEF_YY_SCANNER_T
-typedef void *yyscan_t;
-#endif
-
+    struct gdbwire_mi_token;
+    struct gdbwire_mi_arena;
     struct gdbwire_mi_output;
 }
-%parse-param {yyscan_t yyscanner}
+%parse-param {const struct gdbwire_mi_token *token}
+%parse-param {struct gdbwire_mi_arena *arena}
 %parse-param {struct gdbwire_mi_output **gdbwire_mi_output}
 
 %{
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "gdbwire_sys.h"
+#include "gdbwire_allocator.h"
 #include "gdbwire_mi_grammar.h"
 #include "gdbwire_mi_pt.h"
 #include "gdbwire_mi_pt_alloc.h"
+#include "gdbwire_mi_lexer.h"
 
-char *gdbwire_mi_get_text(yyscan_t yyscanner);
-struct gdbwire_mi_position gdbwire_mi_get_extra(yyscan_t yyscanner);
+/**
+ * The push parser state is allocated with the default allocator.
+ *
+ * Bison does not pass any parser specific data to gdbwire_mi_pstate_new,
+ * so it can not use the allocator of the gdbwire_mi_parser creating it.
+ */
+#define YYMALLOC(size) gdbwire_malloc(NULL, size)
+#define YYFREE(ptr) gdbwire_free(NULL, ptr)
 
-void gdbwire_mi_error(yyscan_t yyscanner,
+void gdbwire_mi_error(const struct gdbwire_mi_token *token,
+    struct gdbwire_mi_arena *arena,
     struct gdbwire_mi_output **gdbwire_mi_output, const char *s)
 { 
-    char *text = gdbwire_mi_get_text(yyscanner);
-    struct gdbwire_mi_position pos = gdbwire_mi_get_extra(yyscanner);
-
-    *gdbwire_mi_output = gdbwire_mi_output_alloc();
+    *gdbwire_mi_output = gdbwire_mi_output_alloc(arena);
     (*gdbwire_mi_output)->kind = GDBWIRE_MI_OUTPUT_PARSE_ERROR;
-    (*gdbwire_mi_output)->variant.error.token = gdbwire_strdup(text);
-    (*gdbwire_mi_output)->variant.error.pos = pos;
+    (*gdbwire_mi_output)->variant.error.token =
+        gdbwire_mi_arena_strdup(arena, token->text);
+    (*gdbwire_mi_output)->variant.error.pos = token->pos;
 }
 
 /**
@@ -56,21 +58,26 @@ void gdbwire_mi_error(yyscan_t yyscanner,
  *
  * See gdbwire_mi_grammar.txt (GDB/MI Clarifications) for more information.
  *
+ * @param arena
+ * The arena to allocate the result from.
+ *
  * @param str
  * The escaped GDB/MI c-string data.
  *
  * @return
  * An allocated strng representing str with the escaping undone.
  */
-static char *gdbwire_mi_unescape_cstring(char *str)
+static char *gdbwire_mi_unescape_cstring(struct gdbwire_mi_arena *arena,
+    const char *str)
 {
     char *result;
     size_t r, s, length;
 
     /*assert(str);*/
 
-    result = gdbwire_strdup(str);
+    /* The result is never longer than str without the quotes */
     length = strlen(str);
+    result = gdbwire_mi_arena_alloc(arena, length);
 
     /* a CSTRING should start and end with a quote */
     /*assert(result);*/
@@ -170,29 +177,12 @@ static char *gdbwire_mi_unescape_cstring(char *str)
 %type <u_list> list
 %type <u_stream_record_kind> stream_record_class
 
-/** 
- * Some symbols in the grammar require destructor directives to free
- * memory when bison goes into error recovery mode. The below symbols
- * are only used as the right most symbol in a rule, making them
- * not possible to be allocated and then later determined to be
- * unnecessary through error recory. The destructor directive for
- * these are omitted as adding them adds dead code.
- *
- * result_record
- * oob_record
- * async_record
- * cstring
- * tuple
- * list
- * stream_record
- * token
+/**
+ * No destructor directives are needed to free memory when bison goes
+ * into error recovery mode. Every symbol is allocated from the arena
+ * of the line being parsed, so any symbol that bison discards is
+ * reclaimed along with the arena.
  */
-%destructor { gdbwire_mi_output_free($$); } output_variant
-%destructor { gdbwire_mi_result_free($$); } result_list
-%destructor { gdbwire_mi_result_free($$); } result
-%destructor { free($$); } opt_variable
-%destructor { free($$); } variable
-%destructor { free($$); } opt_token
 
 %start output_list
 %%
@@ -212,50 +202,48 @@ output: error NEWLINE {
 };
 
 output_variant: oob_record {
-  $$ = gdbwire_mi_output_alloc();
+  $$ = gdbwire_mi_output_alloc(arena);
   $$->kind = GDBWIRE_MI_OUTPUT_OOB;
   $$->variant.oob_record = $1;
 }
 
 output_variant: result_record {
-  $$ = gdbwire_mi_output_alloc();
+  $$ = gdbwire_mi_output_alloc(arena);
   $$->kind = GDBWIRE_MI_OUTPUT_RESULT;
   $$->variant.result_record = $1;
 }
 
 output_variant: OPEN_PAREN variable {
       if (strcmp("gdb", $2) != 0) {
-          /* Destructor will be called to free $2 on error */
-          yyerror(yyscanner, gdbwire_mi_output, "");
+          yyerror(token, arena, gdbwire_mi_output, "");
           YYERROR;
       }
     } CLOSED_PAREN {
-      $$ = gdbwire_mi_output_alloc();
+      $$ = gdbwire_mi_output_alloc(arena);
       $$->kind = GDBWIRE_MI_OUTPUT_PROMPT;
-      free($2);
     }
 
 result_record: opt_token CARROT result_class result_list {
-  $$ = gdbwire_mi_result_record_alloc();
+  $$ = gdbwire_mi_result_record_alloc(arena);
   $$->token = $1;
   $$->result_class = $3;
   $$->result = $4;
 };
 
 oob_record: async_record {
-  $$ = gdbwire_mi_oob_record_alloc();
+  $$ = gdbwire_mi_oob_record_alloc(arena);
   $$->kind = GDBWIRE_MI_ASYNC;
   $$->variant.async_record = $1;
 };
 
 oob_record: stream_record {
-  $$ = gdbwire_mi_oob_record_alloc();
+  $$ = gdbwire_mi_oob_record_alloc(arena);
   $$->kind = GDBWIRE_MI_STREAM;
   $$->variant.stream_record = $1;
 };
 
 async_record: opt_token async_record_class async_class result_list {
-  $$ = gdbwire_mi_async_record_alloc();
+  $$ = gdbwire_mi_async_record_alloc(arena);
   $$->token = $1;
   $$->kind = $2;
   $$->async_class = $3;
@@ -275,7 +263,7 @@ async_record_class: EQUAL_SIGN {
 };
 
 result_class: STRING_LITERAL {
-  char *text = gdbwire_mi_get_text(yyscanner);
+  const char *text = token->text;
   if (strcmp("done", text) == 0) {
     $$ = GDBWIRE_MI_DONE;
   } else if (strcmp("running", text) == 0) {
@@ -292,7 +280,7 @@ result_class: STRING_LITERAL {
 };
 
 async_class: STRING_LITERAL {
-  char *text = gdbwire_mi_get_text(yyscanner);
+  const char *text = token->text;
   if (strcmp("download", text) == 0) {
       $$ = GDBWIRE_MI_ASYNC_DOWNLOAD;
   } else if (strcmp("stopped", text) == 0) {
@@ -361,34 +349,34 @@ result_list: result_list COMMA result {
 };
 
 result: opt_variable cstring {
-  $$ = gdbwire_mi_result_alloc();
+  $$ = gdbwire_mi_result_alloc(arena);
   $$->variable = $1;
   $$->kind = GDBWIRE_MI_CSTRING;
   $$->variant.cstring = $2;
 };
 
 result: opt_variable tuple {
-  $$ = gdbwire_mi_result_alloc();
+  $$ = gdbwire_mi_result_alloc(arena);
   $$->variable = $1;
   $$->kind = GDBWIRE_MI_TUPLE;
   $$->variant.result = $2;
 };
 
 result: opt_variable list {
-  $$ = gdbwire_mi_result_alloc();
+  $$ = gdbwire_mi_result_alloc(arena);
   $$->variable = $1;
   $$->kind = GDBWIRE_MI_LIST;
   $$->variant.result = $2;
 };
 
 variable: STRING_LITERAL {
-  char *text = gdbwire_mi_get_text(yyscanner);
-  $$ = gdbwire_strdup(text);
+  const char *text = token->text;
+  $$ = gdbwire_mi_arena_strdup(arena, text);
 };
 
 cstring: CSTRING {
-  char *text = gdbwire_mi_get_text(yyscanner);
-  $$ = gdbwire_mi_unescape_cstring(text);
+  const char *text = token->text;
+  $$ = gdbwire_mi_unescape_cstring(arena, text);
 };
 
 tuple: OPEN_BRACE CLOSED_BRACE {
@@ -416,7 +404,7 @@ list: OPEN_BRACKET result result_list CLOSED_BRACKET {
 };
 
 stream_record: stream_record_class cstring {
-  $$ = gdbwire_mi_stream_record_alloc();
+  $$ = gdbwire_mi_stream_record_alloc(arena);
   $$->kind = $1;
   $$->cstring = $2;
 };
@@ -442,6 +430,6 @@ opt_token: token {
 };
 
 token: INTEGER_LITERAL {
-  char *text = gdbwire_mi_get_text(yyscanner);
-  $$ = gdbwire_strdup(text);
+  const char *text = token->text;
+  $$ = gdbwire_mi_arena_strdup(arena, text);
 };
@@ -0,0 +1,1220 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "gdbwire_assert.h"
+#include "gdbwire_mi_grammar.h"
+#include "gdbwire_mi_json.h"
+#include "gdbwire_mi_lexer.h"
+#include "gdbwire_string.h"
+
+/* The type of the result records */
+static const char gdbwire_mi_json_result_type[] = "result";
+
+/* The types of the asynchronous records, by gdbwire_mi_async_record_kind */
+static const char *const gdbwire_mi_json_async_types[] = {
+    "status", "exec", "notify"
+};
+
+/* The types of the stream records, by gdbwire_mi_stream_record_kind */
+static const char *const gdbwire_mi_json_stream_types[] = {
+    "console", "target", "log"
+};
+
+/* Where the transcoder is in the grammar of a line */
+enum gdbwire_mi_json_state {
+    /* At the start of the line */
+    GDBWIRE_MI_JSON_START,
+    /* After the token of a record */
+    GDBWIRE_MI_JSON_TOKEN,
+    /* After the ^, *, + or = of a record, expecting its class */
+    GDBWIRE_MI_JSON_CLASS,
+    /* After the ~, @ or & of a stream record, expecting its c-string */
+    GDBWIRE_MI_JSON_STREAM,
+    /* After the ( of a prompt, expecting gdb */
+    GDBWIRE_MI_JSON_PROMPT,
+    /* After the gdb of a prompt, expecting ) */
+    GDBWIRE_MI_JSON_PROMPT_END,
+    /* After a stream record or prompt, expecting the newline */
+    GDBWIRE_MI_JSON_END,
+    /* After a comma, expecting a result */
+    GDBWIRE_MI_JSON_RESULT,
+    /* After the { or [ of a tuple or list, expecting a result or its end */
+    GDBWIRE_MI_JSON_FIRST,
+    /* After the variable of a result, expecting = */
+    GDBWIRE_MI_JSON_EQUAL,
+    /* After the = of a result, expecting its value */
+    GDBWIRE_MI_JSON_VALUE,
+    /* After a result, expecting a comma or the end of its container */
+    GDBWIRE_MI_JSON_NEXT
+};
+
+/* A JSON object or array being written */
+struct gdbwire_mi_json_frame {
+    /**
+     * The token ending the container, CLOSED_BRACKET for the array of a
+     * list, CLOSED_BRACE for the object of a tuple, or NEWLINE for the
+     * object of the results of a record.
+     */
+    int end;
+    /* The number of members written */
+    size_t count;
+    /* The number of members of an object written without a variable */
+    size_t keyless;
+    /* The index in keys of the first key of an object */
+    size_t keys;
+    /* True if the element of an array being written is wrapped in an object */
+    int wrapped;
+};
+
+/* A key of an object being written, the escaped variable in the JSON */
+struct gdbwire_mi_json_key {
+    /* The offset of the key in the JSON, after its quote */
+    size_t offset;
+    /* The number of bytes in the key */
+    size_t size;
+};
+
+struct gdbwire_mi_json {
+    /* The callback and its context */
+    gdbwire_mi_json_callback callback;
+    void *context;
+    /* The data pushed that does not make up a complete line yet */
+    struct gdbwire_string *buffer;
+    /* The lexer instance and the state it shares with the transcoder */
+    yyscan_t scanner;
+    struct gdbwire_mi_lexer_extra extra;
+    /* The JSON of the line being written */
+    char *out;
+    size_t out_size;
+    size_t out_capacity;
+    /* The objects and arrays being written, the innermost last */
+    struct gdbwire_mi_json_frame *frames;
+    size_t frames_size;
+    size_t frames_capacity;
+    /* The keys of the objects being written, those of each frame in turn */
+    struct gdbwire_mi_json_key *keys;
+    size_t keys_size;
+    size_t keys_capacity;
+    /* The token of the record being written, NUL terminated */
+    char *token;
+    size_t token_capacity;
+    /* The allocator the transcoder is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+struct gdbwire_mi_json *
+gdbwire_mi_json_create(gdbwire_mi_json_callback callback, void *context)
+{
+    return gdbwire_mi_json_create_with_allocator(callback, context, NULL);
+}
+
+struct gdbwire_mi_json *
+gdbwire_mi_json_create_with_allocator(gdbwire_mi_json_callback callback,
+        void *context, const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_mi_json *json;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    json = (struct gdbwire_mi_json *)gdbwire_calloc(allocator, 1,
+        sizeof (struct gdbwire_mi_json));
+    if (!json) {
+        return NULL;
+    }
+
+    json->allocator = (allocator) ? *allocator :
+        gdbwire_get_default_allocator();
+    json->callback = callback;
+    json->context = context;
+
+    json->buffer = gdbwire_string_create_with_allocator(&json->allocator);
+    if (!json->buffer) {
+        gdbwire_mi_json_destroy(json);
+        return NULL;
+    }
+
+    json->extra.allocator = &json->allocator;
+    if (gdbwire_mi_lex_init_extra(&json->extra, &json->scanner) != 0) {
+        gdbwire_mi_json_destroy(json);
+        return NULL;
+    }
+
+    return json;
+}
+
+void
+gdbwire_mi_json_destroy(struct gdbwire_mi_json *json)
+{
+    if (json) {
+        /* The transcoder is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = json->allocator;
+
+        if (json->buffer) {
+            gdbwire_string_destroy(json->buffer);
+        }
+        if (json->scanner) {
+            gdbwire_mi_lex_destroy(json->scanner);
+        }
+        gdbwire_free(&allocator, json->out);
+        gdbwire_free(&allocator, json->frames);
+        gdbwire_free(&allocator, json->keys);
+        gdbwire_free(&allocator, json->token);
+        gdbwire_free(&allocator, json);
+    }
+}
+
+/**
+ * Grow an array to hold at least a number of elements.
+ *
+ * @param json
+ * The transcoder whose allocator grows the array.
+ *
+ * @param data
+ * The array, updated if it moves.
+ *
+ * @param capacity
+ * The number of elements the array holds, updated on success.
+ *
+ * @param count
+ * The number of elements the array must hold.
+ *
+ * @param size
+ * The size of each element.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_reserve(struct gdbwire_mi_json *json, void **data,
+        size_t *capacity, size_t count, size_t size)
+{
+    size_t new_capacity = (*capacity > 0) ? *capacity : 64;
+    void *new_data;
+
+    if (count <= *capacity) {
+        return GDBWIRE_OK;
+    }
+
+    while (new_capacity < count) {
+        if (new_capacity > (size_t)-1 / 2 / size) {
+            return GDBWIRE_NOMEM;
+        }
+        new_capacity *= 2;
+    }
+
+    new_data = gdbwire_realloc(&json->allocator, *data, new_capacity * size);
+    if (!new_data) {
+        return GDBWIRE_NOMEM;
+    }
+
+    *data = new_data;
+    *capacity = new_capacity;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Append to the JSON of the line.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param data
+ * The characters to append.
+ *
+ * @param size
+ * The number of characters in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_append(struct gdbwire_mi_json *json, const char *data,
+        size_t size)
+{
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_json_reserve(json, (void **)&json->out,
+        &json->out_capacity, json->out_size + size, 1);
+    if (result == GDBWIRE_OK) {
+        memcpy(json->out + json->out_size, data, size);
+        json->out_size += size;
+    }
+
+    return result;
+}
+
+/**
+ * Append a number to the JSON of the line.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param format
+ * The printf format of the number, taking an unsigned long.
+ *
+ * @param number
+ * The number to append.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_append_number(struct gdbwire_mi_json *json,
+        const char *format, unsigned long number)
+{
+    char buffer[48];
+    int size = snprintf(buffer, sizeof (buffer), format, number);
+
+    return gdbwire_mi_json_append(json, buffer, (size_t)size);
+}
+
+/**
+ * Escape a character for a JSON string.
+ *
+ * @param out
+ * Where to write the escaped character, with room for 6 characters.
+ *
+ * @param c
+ * The character to escape.
+ *
+ * @return
+ * The position after the escaped character.
+ */
+static char *
+gdbwire_mi_json_escape(char *out, unsigned char c)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    if (c >= 0x20 && c != '"' && c != '\\') {
+        *out++ = (char)c;
+        return out;
+    }
+
+    *out++ = '\\';
+    switch (c) {
+        case '"':
+        case '\\':
+            *out++ = (char)c;
+            break;
+        case '\b':
+            *out++ = 'b';
+            break;
+        case '\f':
+            *out++ = 'f';
+            break;
+        case '\n':
+            *out++ = 'n';
+            break;
+        case '\r':
+            *out++ = 'r';
+            break;
+        case '\t':
+            *out++ = 't';
+            break;
+        default:
+            *out++ = 'u';
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 0xf];
+            break;
+    }
+
+    return out;
+}
+
+/**
+ * Append a JSON string to the JSON of the line.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param data
+ * The characters of the string.
+ *
+ * @param size
+ * The number of characters in data.
+ *
+ * @param cstring
+ * True if data is a GDB/MI c-string, with its quotes and its escapes,
+ * as the lexer returns it. The c-string is unescaped exactly like the
+ * grammar unescapes it, in the same pass that escapes it for JSON.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_string(struct gdbwire_mi_json *json, const char *data,
+        size_t size, int cstring)
+{
+    enum gdbwire_result result;
+    size_t index;
+    char *out;
+
+    /* Each character is escaped to at most 6 characters */
+    if (size > ((size_t)-1 - 2) / 6 - json->out_size) {
+        return GDBWIRE_NOMEM;
+    }
+    result = gdbwire_mi_json_reserve(json, (void **)&json->out,
+        &json->out_capacity, json->out_size + size * 6 + 2, 1);
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    out = json->out + json->out_size;
+    *out++ = '"';
+    if (!cstring) {
+        for (index = 0; index < size; ++index) {
+            out = gdbwire_mi_json_escape(out, (unsigned char)data[index]);
+        }
+    } else {
+        for (index = 1; index + 1 < size; ++index) {
+            if (data[index] != '\\') {
+                out = gdbwire_mi_json_escape(out,
+                    (unsigned char)data[index]);
+                continue;
+            }
+
+            *out++ = '\\';
+            switch (data[index + 1]) {
+                case 'n':
+                case 'r':
+                case 't':
+                case '"':
+                case '\\':
+                    *out++ = data[++index];
+                    break;
+                default:
+                    /* The grammar keeps the backslash of other escapes */
+                    *out++ = '\\';
+                    break;
+            }
+        }
+    }
+    *out++ = '"';
+
+    json->out_size = (size_t)(out - json->out);
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Start a JSON object or array.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param end
+ * The token ending the container, CLOSED_BRACKET for an array,
+ * otherwise an object.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_open(struct gdbwire_mi_json *json, int end)
+{
+    struct gdbwire_mi_json_frame *frame;
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_json_reserve(json, (void **)&json->frames,
+        &json->frames_capacity, json->frames_size + 1,
+        sizeof (struct gdbwire_mi_json_frame));
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json,
+            (end == CLOSED_BRACKET) ? "[" : "{", 1);
+    }
+
+    if (result == GDBWIRE_OK) {
+        frame = json->frames + json->frames_size++;
+        frame->end = end;
+        frame->count = 0;
+        frame->keyless = 0;
+        frame->keys = json->keys_size;
+        frame->wrapped = 0;
+    }
+
+    return result;
+}
+
+/**
+ * Finish a value in the innermost container.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_value_done(struct gdbwire_mi_json *json)
+{
+    struct gdbwire_mi_json_frame *frame = json->frames + json->frames_size - 1;
+
+    if (frame->wrapped) {
+        frame->wrapped = 0;
+        return gdbwire_mi_json_append(json, "}", 1);
+    }
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * End the innermost container, and the value it is in.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_close(struct gdbwire_mi_json *json)
+{
+    struct gdbwire_mi_json_frame *frame = json->frames + json->frames_size - 1;
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_json_append(json,
+        (frame->end == CLOSED_BRACKET) ? "]" : "}", 1);
+    json->keys_size = frame->keys;
+    --json->frames_size;
+
+    if (result == GDBWIRE_OK && json->frames_size > 0) {
+        result = gdbwire_mi_json_value_done(json);
+    }
+
+    return result;
+}
+
+/**
+ * Start a member of the innermost container.
+ *
+ * In an object the member is written up to its value, with its key
+ * named after its variable. In an array, a member with a variable is
+ * wrapped in an object holding just that member.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param variable
+ * The variable of the member, or NULL if none.
+ *
+ * @param size
+ * The number of characters in variable.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_member(struct gdbwire_mi_json *json, const char *variable,
+        size_t size)
+{
+    struct gdbwire_mi_json_frame *frame = json->frames + json->frames_size - 1;
+    struct gdbwire_mi_json_key key;
+    enum gdbwire_result result = GDBWIRE_OK;
+    size_t index, ordinal = 0;
+
+    if (frame->count++ > 0) {
+        result = gdbwire_mi_json_append(json, ",", 1);
+    }
+
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    if (frame->end == CLOSED_BRACKET) {
+        if (variable) {
+            frame->wrapped = 1;
+            result = gdbwire_mi_json_append(json, "{", 1);
+            if (result == GDBWIRE_OK) {
+                result = gdbwire_mi_json_string(json, variable, size, 0);
+            }
+            if (result == GDBWIRE_OK) {
+                result = gdbwire_mi_json_append(json, ":", 1);
+            }
+        }
+        return result;
+    }
+
+    if (!variable) {
+        return gdbwire_mi_json_append_number(json, "\"[%lu]\":",
+            (unsigned long)frame->keyless++);
+    }
+
+    key.offset = json->out_size + 1;
+    result = gdbwire_mi_json_string(json, variable, size, 0);
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+    key.size = json->out_size - 1 - key.offset;
+
+    /* Tuples are small, count the earlier same variables */
+    for (index = frame->keys; index < json->keys_size; ++index) {
+        if (json->keys[index].size == key.size &&
+                memcmp(json->out + json->keys[index].offset,
+                    json->out + key.offset, key.size) == 0) {
+            ++ordinal;
+        }
+    }
+
+    result = gdbwire_mi_json_reserve(json, (void **)&json->keys,
+        &json->keys_capacity, json->keys_size + 1,
+        sizeof (struct gdbwire_mi_json_key));
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+    json->keys[json->keys_size++] = key;
+
+    if (ordinal > 0) {
+        /* Number the key inside of its quotes */
+        --json->out_size;
+        return gdbwire_mi_json_append_number(json, "#%lu\":",
+            (unsigned long)ordinal);
+    }
+
+    return gdbwire_mi_json_append(json, ":", 1);
+}
+
+/**
+ * Start the JSON of an asynchronous record or result record.
+ *
+ * The object of the results of the record is left open.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param type
+ * The type of the record.
+ *
+ * @param token
+ * The token of the record, or NULL if none.
+ *
+ * @param name
+ * The name of the class of the record.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_record(struct gdbwire_mi_json *json, const char *type,
+        const char *token, const char *name)
+{
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_json_append(json, "{\"type\":\"", 9);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, type, strlen(type));
+    }
+    if (result == GDBWIRE_OK && token) {
+        result = gdbwire_mi_json_append(json, "\",\"token\":", 10);
+        if (result == GDBWIRE_OK) {
+            result = gdbwire_mi_json_string(json, token, strlen(token), 0);
+        }
+        if (result == GDBWIRE_OK) {
+            result = gdbwire_mi_json_append(json, ",\"class\":\"", 10);
+        }
+    } else if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, "\",\"class\":\"", 11);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, name, strlen(name));
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, "\",\"results\":", 12);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_open(json, NEWLINE);
+    }
+
+    return result;
+}
+
+/**
+ * Start the JSON of a stream record.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param type
+ * The type of the record.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_stream(struct gdbwire_mi_json *json, const char *type)
+{
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_json_append(json, "{\"type\":\"", 9);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, type, strlen(type));
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, "\",\"text\":", 9);
+    }
+
+    return result;
+}
+
+/**
+ * Replace the JSON of the line with a parse error.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param token
+ * The token the error occurred on.
+ *
+ * @param pos
+ * The position of the token in the line.
+ *
+ * @param line
+ * The line, with or without its newline.
+ *
+ * @param size
+ * The number of characters in line.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_parse_error(struct gdbwire_mi_json *json, const char *token,
+        struct gdbwire_mi_position pos, const char *line, size_t size)
+{
+    enum gdbwire_result result;
+    char buffer[96];
+    int columns;
+
+    json->out_size = 0;
+    json->frames_size = 0;
+    json->keys_size = 0;
+
+    /* The newline is not part of the line */
+    if (size > 0 && line[size - 1] == '\n') {
+        --size;
+    }
+    if (size > 0 && line[size - 1] == '\r') {
+        --size;
+    }
+
+    columns = snprintf(buffer, sizeof (buffer),
+        ",\"start_column\":%d,\"end_column\":%d,\"line\":",
+        pos.start_column, pos.end_column);
+
+    result = gdbwire_mi_json_append(json,
+        "{\"type\":\"parse-error\",\"token\":", 30);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_string(json, token, strlen(token), 0);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, buffer, (size_t)columns);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_string(json, line, size, 0);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, "}", 1);
+    }
+
+    return result;
+}
+
+/**
+ * Hand the JSON of the line to the callback.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_deliver(struct gdbwire_mi_json *json)
+{
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_json_reserve(json, (void **)&json->out,
+        &json->out_capacity, json->out_size + 1, 1);
+    if (result == GDBWIRE_OK) {
+        json->out[json->out_size] = 0;
+        if (json->callback) {
+            json->callback(json->context, json->out, json->out_size);
+        }
+    }
+
+    json->out_size = 0;
+    json->frames_size = 0;
+    json->keys_size = 0;
+
+    return result;
+}
+
+/**
+ * Find the class of a record by its name, as the parser would.
+ *
+ * @param result
+ * True for the class of a result record, false for an asynchronous one.
+ *
+ * @param text
+ * The name of the class.
+ *
+ * @return
+ * The name of the class, or "unsupported" if none has the name.
+ */
+static const char *
+gdbwire_mi_json_find_class(int result, const char *text)
+{
+    int unsupported = (result) ? GDBWIRE_MI_UNSUPPORTED :
+        GDBWIRE_MI_ASYNC_UNSUPPORTED;
+    const char *name;
+    int index;
+
+    for (index = 0; ; ++index) {
+        name = (result) ?
+            gdbwire_mi_result_class_name(
+                (enum gdbwire_mi_result_class)index) :
+            gdbwire_mi_async_class_name((enum gdbwire_mi_async_class)index);
+        if (index == unsupported || strcmp(name, text) == 0) {
+            return name;
+        }
+    }
+}
+
+/**
+ * Write the JSON of the value that starts with a token.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param pattern
+ * The token, CSTRING, OPEN_BRACE or OPEN_BRACKET.
+ *
+ * @param text
+ * The text of the token.
+ *
+ * @param state
+ * Set to the state after the token.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_value(struct gdbwire_mi_json *json, int pattern,
+        const char *text, enum gdbwire_mi_json_state *state)
+{
+    enum gdbwire_result result;
+
+    if (pattern == CSTRING) {
+        result = gdbwire_mi_json_string(json, text, strlen(text), 1);
+        if (result == GDBWIRE_OK) {
+            result = gdbwire_mi_json_value_done(json);
+        }
+        *state = GDBWIRE_MI_JSON_NEXT;
+    } else {
+        result = gdbwire_mi_json_open(json,
+            (pattern == OPEN_BRACE) ? CLOSED_BRACE : CLOSED_BRACKET);
+        *state = GDBWIRE_MI_JSON_FIRST;
+    }
+
+    return result;
+}
+
+/**
+ * Transcode a line, token by token.
+ *
+ * The transcoder follows the GDB/MI grammar with a state and the stack
+ * of containers being written, rather than a tree. A token that can not
+ * come next in the grammar is the same one the grammar reports a parse
+ * error on, and the JSON written for the line is replaced by the error.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param line
+ * The line, including the newline.
+ *
+ * @param size
+ * The number of bytes in line.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_line(struct gdbwire_mi_json *json, const char *line,
+        size_t size)
+{
+    enum gdbwire_mi_json_state state = GDBWIRE_MI_JSON_START;
+    enum gdbwire_result result = GDBWIRE_OK;
+    const char *type = NULL, *text, *name;
+    int pattern, has_token = 0, end;
+    size_t token_size;
+
+    json->out_size = 0;
+    json->frames_size = 0;
+    json->keys_size = 0;
+
+    json->extra.input = line;
+    json->extra.size = size;
+    gdbwire_mi_restart(NULL, json->scanner);
+    gdbwire_mi_set_column(1, json->scanner);
+
+    while (result == GDBWIRE_OK) {
+        /* Every line ends with a newline, which ends the grammar */
+        pattern = gdbwire_mi_lex(json->scanner);
+        GDBWIRE_ASSERT(pattern != 0);
+        text = gdbwire_mi_get_text(json->scanner);
+        end = (json->frames_size > 0) ?
+            json->frames[json->frames_size - 1].end : 0;
+
+        switch (state) {
+            case GDBWIRE_MI_JSON_START:
+                if (pattern == INTEGER_LITERAL) {
+                    token_size = strlen(text) + 1;
+                    result = gdbwire_mi_json_reserve(json,
+                        (void **)&json->token, &json->token_capacity,
+                        token_size, 1);
+                    if (result == GDBWIRE_OK) {
+                        memcpy(json->token, text, token_size);
+                        has_token = 1;
+                    }
+                    state = GDBWIRE_MI_JSON_TOKEN;
+                    continue;
+                } else if (pattern == TILDA || pattern == AT_SYMBOL ||
+                        pattern == AMPERSAND) {
+                    type = gdbwire_mi_json_stream_types[
+                        (pattern == TILDA) ? GDBWIRE_MI_CONSOLE :
+                        (pattern == AT_SYMBOL) ? GDBWIRE_MI_TARGET :
+                        GDBWIRE_MI_LOG];
+                    result = gdbwire_mi_json_stream(json, type);
+                    state = GDBWIRE_MI_JSON_STREAM;
+                    continue;
+                } else if (pattern == OPEN_PAREN) {
+                    state = GDBWIRE_MI_JSON_PROMPT;
+                    continue;
+                }
+                /* Without a token, a record starts as it does after one */
+                /* fall through */
+            case GDBWIRE_MI_JSON_TOKEN:
+                if (pattern == CARROT) {
+                    type = gdbwire_mi_json_result_type;
+                } else if (pattern == MULT_OP) {
+                    type = gdbwire_mi_json_async_types[GDBWIRE_MI_EXEC];
+                } else if (pattern == ADD_OP) {
+                    type = gdbwire_mi_json_async_types[GDBWIRE_MI_STATUS];
+                } else if (pattern == EQUAL_SIGN) {
+                    type = gdbwire_mi_json_async_types[GDBWIRE_MI_NOTIFY];
+                } else {
+                    break;
+                }
+                state = GDBWIRE_MI_JSON_CLASS;
+                continue;
+            case GDBWIRE_MI_JSON_CLASS:
+                if (pattern != STRING_LITERAL) {
+                    break;
+                }
+                name = gdbwire_mi_json_find_class(
+                    type == gdbwire_mi_json_result_type, text);
+                result = gdbwire_mi_json_record(json, type,
+                    (has_token) ? json->token : NULL, name);
+                state = GDBWIRE_MI_JSON_NEXT;
+                continue;
+            case GDBWIRE_MI_JSON_STREAM:
+                if (pattern != CSTRING) {
+                    break;
+                }
+                result = gdbwire_mi_json_string(json, text, strlen(text), 1);
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_json_append(json, "}", 1);
+                }
+                state = GDBWIRE_MI_JSON_END;
+                continue;
+            case GDBWIRE_MI_JSON_PROMPT:
+                if (pattern != STRING_LITERAL || strcmp(text, "gdb") != 0) {
+                    break;
+                }
+                state = GDBWIRE_MI_JSON_PROMPT_END;
+                continue;
+            case GDBWIRE_MI_JSON_PROMPT_END:
+                if (pattern != CLOSED_PAREN) {
+                    break;
+                }
+                result = gdbwire_mi_json_append(json,
+                    "{\"type\":\"prompt\"}", 17);
+                state = GDBWIRE_MI_JSON_END;
+                continue;
+            case GDBWIRE_MI_JSON_END:
+                if (pattern != NEWLINE) {
+                    break;
+                }
+                return gdbwire_mi_json_deliver(json);
+            case GDBWIRE_MI_JSON_FIRST:
+                if (pattern == end) {
+                    result = gdbwire_mi_json_close(json);
+                    state = GDBWIRE_MI_JSON_NEXT;
+                    continue;
+                }
+                /* The first result of a tuple or list */
+                /* fall through */
+            case GDBWIRE_MI_JSON_RESULT:
+                if (pattern == STRING_LITERAL) {
+                    result = gdbwire_mi_json_member(json, text, strlen(text));
+                    state = GDBWIRE_MI_JSON_EQUAL;
+                    continue;
+                } else if (pattern == CSTRING || pattern == OPEN_BRACE ||
+                        pattern == OPEN_BRACKET) {
+                    result = gdbwire_mi_json_member(json, NULL, 0);
+                    if (result == GDBWIRE_OK) {
+                        result = gdbwire_mi_json_value(json, pattern, text,
+                            &state);
+                    }
+                    continue;
+                }
+                break;
+            case GDBWIRE_MI_JSON_EQUAL:
+                if (pattern != EQUAL_SIGN) {
+                    break;
+                }
+                state = GDBWIRE_MI_JSON_VALUE;
+                continue;
+            case GDBWIRE_MI_JSON_VALUE:
+                if (pattern != CSTRING && pattern != OPEN_BRACE &&
+                        pattern != OPEN_BRACKET) {
+                    break;
+                }
+                result = gdbwire_mi_json_value(json, pattern, text, &state);
+                continue;
+            case GDBWIRE_MI_JSON_NEXT:
+                if (pattern == COMMA) {
+                    state = GDBWIRE_MI_JSON_RESULT;
+                    continue;
+                } else if (pattern != end) {
+                    break;
+                }
+                result = gdbwire_mi_json_close(json);
+                if (result == GDBWIRE_OK && json->frames_size == 0) {
+                    /* The newline ended the results of the record */
+                    result = gdbwire_mi_json_append(json, "}", 1);
+                    if (result == GDBWIRE_OK) {
+                        result = gdbwire_mi_json_deliver(json);
+                    }
+                    return result;
+                }
+                continue;
+        }
+
+        /* The token can not come next, the rest of the line is skipped */
+        result = gdbwire_mi_json_parse_error(json, text, json->extra.pos,
+            line, size);
+        if (result == GDBWIRE_OK) {
+            result = gdbwire_mi_json_deliver(json);
+        }
+        return result;
+    }
+
+    return result;
+}
+
+/**
+ * Get the size of the next line in the data.
+ *
+ * Lines end the same way they do for gdbwire_mi_parser_push_data.
+ *
+ * @param data
+ * The data to search for a line.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * The size of the line, including the newline, or 0 if data does not
+ * contain a complete line.
+ */
+static size_t
+gdbwire_mi_json_next_line(const char *data, size_t size)
+{
+    size_t pos;
+
+    for (pos = 0; pos < size; ++pos) {
+        if (data[pos] == '\r' || data[pos] == '\n') {
+            return (data[pos] == '\r' && (pos + 1 < size) &&
+                    data[pos + 1] == '\n') ? pos + 2 : pos + 1;
+        }
+    }
+
+    return 0;
+}
+
+enum gdbwire_result
+gdbwire_mi_json_push_data(struct gdbwire_mi_json *json, const char *data,
+        size_t size)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+    size_t line_size;
+
+    GDBWIRE_ASSERT(json && data);
+
+    /* Finish the line started by an earlier push */
+    if (gdbwire_string_size(json->buffer) > 0) {
+        line_size = gdbwire_mi_json_next_line(data, size);
+        if (line_size == 0) {
+            GDBWIRE_ASSERT(gdbwire_string_append_data(json->buffer,
+                data, size) == 0);
+            return GDBWIRE_OK;
+        }
+
+        /* Append the rest of the line, up to and including its newline */
+        GDBWIRE_ASSERT(gdbwire_string_append_data(json->buffer,
+            data, line_size) == 0);
+        result = gdbwire_mi_json_line(json,
+            gdbwire_string_data(json->buffer),
+            gdbwire_string_size(json->buffer));
+        gdbwire_string_clear(json->buffer);
+        data += line_size;
+        size -= line_size;
+    }
+
+    /* The complete lines are transcoded in place, without a copy */
+    while (result == GDBWIRE_OK && size > 0) {
+        line_size = gdbwire_mi_json_next_line(data, size);
+        if (line_size == 0) {
+            GDBWIRE_ASSERT(gdbwire_string_append_data(json->buffer,
+                data, size) == 0);
+            break;
+        }
+
+        result = gdbwire_mi_json_line(json, data, line_size);
+        data += line_size;
+        size -= line_size;
+    }
+
+    return result;
+}
+
+/**
+ * Write the JSON of a list of results into the innermost container.
+ *
+ * @param json
+ * The transcoder.
+ *
+ * @param result
+ * The results to write.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_json_results(struct gdbwire_mi_json *json,
+        const struct gdbwire_mi_result *result)
+{
+    enum gdbwire_result status = GDBWIRE_OK;
+
+    for (; result && status == GDBWIRE_OK; result = result->next) {
+        status = gdbwire_mi_json_member(json, result->variable,
+            (result->variable) ? strlen(result->variable) : 0);
+        if (status != GDBWIRE_OK) {
+            break;
+        }
+
+        if (result->kind == GDBWIRE_MI_CSTRING) {
+            status = gdbwire_mi_json_string(json, result->variant.cstring,
+                strlen(result->variant.cstring), 0);
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_json_value_done(json);
+            }
+        } else {
+            status = gdbwire_mi_json_open(json,
+                (result->kind == GDBWIRE_MI_LIST) ?
+                    CLOSED_BRACKET : CLOSED_BRACE);
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_json_results(json,
+                    result->variant.result);
+            }
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_json_close(json);
+            }
+        }
+    }
+
+    return status;
+}
+
+enum gdbwire_result
+gdbwire_mi_json_output(struct gdbwire_mi_json *json,
+        const struct gdbwire_mi_output *output)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+    struct gdbwire_mi_oob_record *oob_record;
+    struct gdbwire_mi_async_record *async_record;
+    struct gdbwire_mi_stream_record *stream_record;
+    struct gdbwire_mi_result_record *result_record;
+
+    GDBWIRE_ASSERT(json && output);
+
+    json->out_size = 0;
+    json->frames_size = 0;
+    json->keys_size = 0;
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            oob_record = output->variant.oob_record;
+            if (oob_record->kind == GDBWIRE_MI_ASYNC) {
+                async_record = oob_record->variant.async_record;
+                result = gdbwire_mi_json_record(json,
+                    gdbwire_mi_json_async_types[async_record->kind],
+                    async_record->token,
+                    gdbwire_mi_async_class_name(async_record->async_class));
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_json_results(json,
+                        async_record->result);
+                }
+            } else {
+                stream_record = oob_record->variant.stream_record;
+                result = gdbwire_mi_json_stream(json,
+                    gdbwire_mi_json_stream_types[stream_record->kind]);
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_json_string(json,
+                        stream_record->cstring,
+                        strlen(stream_record->cstring), 0);
+                }
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            result_record = output->variant.result_record;
+            result = gdbwire_mi_json_record(json, gdbwire_mi_json_result_type,
+                result_record->token,
+                gdbwire_mi_result_class_name(result_record->result_class));
+            if (result == GDBWIRE_OK) {
+                result = gdbwire_mi_json_results(json, result_record->result);
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            result = gdbwire_mi_json_append(json, "{\"type\":\"prompt\"", 16);
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            result = gdbwire_mi_json_parse_error(json,
+                output->variant.error.token, output->variant.error.pos,
+                (output->line) ? output->line : "",
+                (output->line) ? strlen(output->line) : 0);
+            if (result == GDBWIRE_OK) {
+                return gdbwire_mi_json_deliver(json);
+            }
+            break;
+    }
+
+    /* Close the results of a record, and the object of the output */
+    if (result == GDBWIRE_OK && json->frames_size > 0) {
+        result = gdbwire_mi_json_close(json);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_append(json, "}", 1);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_json_deliver(json);
+    }
+
+    return result;
+}
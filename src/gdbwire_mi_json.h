@@ -0,0 +1,161 @@
+#ifndef GDBWIRE_MI_JSON_H
+#define GDBWIRE_MI_JSON_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "gdbwire_allocator.h"
+#include "gdbwire_result.h"
+#include "gdbwire_mi_pt.h"
+
+/**
+ * A GDB/MI to JSON transcoder.
+ *
+ * Front ends written in other languages, and tools that log or ship GDB
+ * sessions, want each GDB/MI output command as a JSON object. Parsing
+ * into a tree and then serializing the tree allocates and walks every
+ * result twice. The transcoder reads the tokens of the lexer as they
+ * come and writes the JSON of the line in the same pass, without
+ * building a tree.
+ *
+ * Each line becomes one JSON object, written without a newline,
+ *   {"type":"result","token":"12","class":"done","results":{...}}
+ *   {"type":"exec","class":"stopped","results":{...}}
+ *   {"type":"console","text":"..."}
+ *   {"type":"prompt"}
+ *   {"type":"parse-error","token":"...","start_column":3,
+ *       "end_column":3,"line":"..."}
+ *
+ * The type of an asynchronous record is exec, status or notify and the
+ * type of a stream record is console, target or log. The token is only
+ * written when the record has one. The class is the name GDB uses for
+ * it, or "unsupported" for a class gdbwire does not know, as the parse
+ * tree does not keep its name either.
+ *
+ * The results of a record and of a tuple become a JSON object keyed by
+ * their variables. The MI quirks are mapped the same way the structural
+ * diff names them (see gdbwire_mi_diff.h),
+ * - A variable repeated in the same tuple, like bkpt in -break-info of
+ *   some versions of GDB or thread-id in -thread-list-ids, gets the
+ *   number of earlier results with the same variable, so the keys are
+ *   "bkpt", "bkpt#1", "bkpt#2" and so on.
+ * - A result without a variable gets its number among those without a
+ *   variable in brackets, like "[0]".
+ * - A list becomes a JSON array. An element of a list with a variable,
+ *   like the frames of -stack-list-frames, becomes an object holding
+ *   just that member, like {"frame":{...}}.
+ *
+ * The c-strings are unescaped the same way the parser unescapes them and
+ * escaped again for JSON. The bytes that are not ASCII are copied as they
+ * are, so the JSON is UTF-8 when GDB's output is.
+ */
+struct gdbwire_mi_json;
+
+/**
+ * Receives the JSON of each GDB/MI output command.
+ *
+ * @param context
+ * The context passed to gdbwire_mi_json_create.
+ *
+ * @param json
+ * The JSON object, NUL terminated. Only valid during the call.
+ *
+ * @param size
+ * The number of bytes in json, not counting the NUL.
+ */
+typedef void (*gdbwire_mi_json_callback)(void *context, const char *json,
+        size_t size);
+
+/**
+ * Create a transcoder.
+ *
+ * @param callback
+ * The function to hand each JSON object to.
+ *
+ * @param context
+ * The context to pass to callback.
+ *
+ * @return
+ * A new transcoder or NULL on error.
+ */
+struct gdbwire_mi_json *gdbwire_mi_json_create(
+        gdbwire_mi_json_callback callback, void *context);
+
+/**
+ * Create a transcoder that allocates with the given allocator.
+ *
+ * @param callback
+ * The function to hand each JSON object to.
+ *
+ * @param context
+ * The context to pass to callback.
+ *
+ * @param allocator
+ * The allocator to allocate the transcoder with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new transcoder or NULL on error.
+ */
+struct gdbwire_mi_json *gdbwire_mi_json_create_with_allocator(
+        gdbwire_mi_json_callback callback, void *context,
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the transcoder instance.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param json
+ * The instance to destroy.
+ */
+void gdbwire_mi_json_destroy(struct gdbwire_mi_json *json);
+
+/**
+ * Push GDB/MI output into the transcoder.
+ *
+ * The data is split into lines the same way gdbwire_mi_parser_push_data
+ * splits it. The JSON of each complete line is handed to the callback
+ * before this function returns.
+ *
+ * @param json
+ * The transcoder to use.
+ *
+ * @param data
+ * The GDB/MI output to transcode.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_json_push_data(struct gdbwire_mi_json *json,
+        const char *data, size_t size);
+
+/**
+ * Write the JSON of a parsed output command.
+ *
+ * The JSON is the same as the transcoder writes for the line the output
+ * was parsed from. It is handed to the callback before this function
+ * returns. Only this output is written, not the outputs linked after it.
+ *
+ * @param json
+ * The transcoder to use.
+ *
+ * @param output
+ * The output to write.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_json_output(struct gdbwire_mi_json *json,
+        const struct gdbwire_mi_output *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_MI_JSON_H */
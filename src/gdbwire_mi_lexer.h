@@ -0,0 +1,75 @@
+#ifndef GDBWIRE_MI_LEXER_H
+#define GDBWIRE_MI_LEXER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gdbwire_allocator.h"
+#include "gdbwire_mi_pt.h"
+
+/**
+ * The interface between the GDB/MI parser and the flex generated lexer.
+ *
+ * The lexer reads its input directly from a line in the parser's buffer
+ * rather than from a buffer of its own. This lets the parser lex line
+ * after line with a single lexer buffer, created on the first line,
+ * instead of creating and deleting a copy of every line.
+ */
+
+/* An opaque pointer. */
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+/* The lexer state shared between the parser and the lexer */
+struct gdbwire_mi_lexer_extra {
+    /* The position of the last token returned by the lexer */
+    struct gdbwire_mi_position pos;
+    /* The input not yet read by the lexer */
+    const char *input;
+    /* The number of bytes in input */
+    size_t size;
+    /* The allocator for the lexer's memory or NULL for the default */
+    const struct gdbwire_allocator *allocator;
+    /* The number of bytes the lexer has allocated */
+    size_t bytes;
+};
+
+/**
+ * The token most recently pushed into the GDB/MI grammar.
+ *
+ * The grammar reads the text and position of a token from here rather
+ * than from the lexer, so a line may be lexed ahead of being parsed,
+ * even on another thread.
+ */
+struct gdbwire_mi_token {
+    /* The text of the token, NUL terminated */
+    const char *text;
+    /* The position of the token in its line */
+    struct gdbwire_mi_position pos;
+};
+
+/* Lexer state create/destroy functions */
+int gdbwire_mi_lex_init_extra(struct gdbwire_mi_lexer_extra *extra,
+        yyscan_t *scanner);
+int gdbwire_mi_lex_destroy(yyscan_t scanner);
+
+/* Lexer restart, discards any input buffered from the previous line */
+void gdbwire_mi_restart(FILE *input_file, yyscan_t scanner);
+
+/* Lexer get token function */
+int gdbwire_mi_lex(yyscan_t scanner);
+char *gdbwire_mi_get_text(yyscan_t scanner);
+struct gdbwire_mi_lexer_extra *gdbwire_mi_get_extra(yyscan_t scanner);
+void gdbwire_mi_set_column(int column_no, yyscan_t scanner);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_MI_LEXER_H */
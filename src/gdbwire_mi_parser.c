@@ -1,101 +1,254 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "gdbwire_sys.h"
 #include "gdbwire_assert.h"
+#include "gdbwire_atomic.h"
+#include "gdbwire_mi_cache.h"
 #include "gdbwire_mi_grammar.h"
+#include "gdbwire_mi_lexer.h"
 #include "gdbwire_mi_parser.h"
+#include "gdbwire_mi_pt_alloc.h"
 #include "gdbwire_string.h"
+#include "gdbwire_trace.h"
 
-/* flex prototypes used in this unit */
-#ifndef YY_TYPEDEF_YY_SCANNER_T
-#define YY_TYPEDEF_YY_SCANNER_T
-typedef void *yyscan_t;
-#endif
+/* The most unescaped bytes delivered in a single stream record chunk */
+#define GDBWIRE_MI_STREAM_CHUNK_SIZE 4096
 
-#ifndef YY_TYPEDEF_YY_BUFFER_STATE
-#define YY_TYPEDEF_YY_BUFFER_STATE
-typedef struct yy_buffer_state *YY_BUFFER_STATE;
-#endif
+/* The longest line, including the newline, kept in the line cache */
+#define GDBWIRE_MI_CACHE_LINE_SIZE 256
 
-/* Lexer set/destroy buffer to parse */
-extern YY_BUFFER_STATE gdbwire_mi__scan_string(
-    const char *yy_str, yyscan_t yyscanner);
-extern void gdbwire_mi__delete_buffer(YY_BUFFER_STATE state,
-    yyscan_t yyscanner);
+/* The number of lexed lines that may wait between the pipeline stages */
+#define GDBWIRE_MI_PIPELINE_CAPACITY 256
+
+/* A token lexed by the first stage of the pipeline */
+struct gdbwire_mi_lexed_token {
+    /* The grammar token returned by the lexer */
+    int kind;
+    /* The offset of the text of the token in the text of its line */
+    size_t text;
+    /* The position of the token in its line */
+    struct gdbwire_mi_position pos;
+};
+
+/* A line lexed by the first stage of the pipeline, for the second */
+struct gdbwire_mi_lexed_line {
+    /* The tokens of the line, in order */
+    struct gdbwire_mi_lexed_token *tokens;
+    size_t tokens_size;
+    size_t tokens_capacity;
+    /* The line followed by the NUL terminated text of each token */
+    char *text;
+    size_t text_size;
+    size_t text_capacity;
+    /* The size of the line at the start of text */
+    size_t line_size;
+    /* True if the timestamps of the line were taken */
+    int timestamped;
+    /* The timestamps of the line, the dispatch is taken by the second stage */
+    struct gdbwire_mi_timestamps timestamps;
+    /* The next line in a list of lines to reuse */
+    struct gdbwire_mi_lexed_line *next;
+};
 
-/* Lexer get token function */
-extern int gdbwire_mi_lex(yyscan_t yyscanner);
-extern char *gdbwire_mi_get_text(yyscan_t yyscanner);
-extern void gdbwire_mi_set_column(int column_no, yyscan_t yyscanner);
+/**
+ * The second stage of a pipelined parser.
+ *
+ * The thread pushing data into the parser is the first stage. It splits
+ * the data into lines and lexes them. The second stage builds the parse
+ * trees from the tokens and invokes the callbacks on a thread of its own.
+ * The stages are connected by a lock free ring of lexed lines, taken in
+ * the order they were queued, so the outputs keep the order of the lines.
+ */
+struct gdbwire_mi_pipeline {
+    /* The thread building the parse trees */
+    pthread_t thread;
+    /* The lexed lines waiting for the second stage */
+    struct gdbwire_mi_lexed_line *ring[GDBWIRE_MI_PIPELINE_CAPACITY];
+    /* Where the first stage queues the next line, only accessed atomically */
+    size_t head;
+    /* Where the second stage takes the next line, only accessed atomically */
+    size_t tail;
+    /* The lines the second stage is done with, only accessed atomically */
+    struct gdbwire_mi_lexed_line *done;
+    /* The lines the first stage may reuse, only accessed by it */
+    struct gdbwire_mi_lexed_line *spare;
+    /* True while the second stage waits for a line, accessed atomically */
+    int waiting;
+    /* True while the first stage waits for room, accessed atomically */
+    int full_waiting;
+    /* True when the second stage should stop, accessed atomically */
+    int stopping;
+    /* The first unreported error of the second stage, accessed atomically */
+    int result;
+    /* The memory of the arena pool, as of the last line built */
+    size_t tree_bytes;
+    size_t cache_bytes;
+    /* The hits and misses of the line cache, as of the last line built */
+    size_t cache_hits;
+    size_t cache_misses;
+    /* Lets the second stage sleep while waiting for a line */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    /* Lets the first stage sleep while the ring is full, under mutex */
+    pthread_cond_t full_cond;
+};
 
-/* Lexer state create/destroy functions */
-extern int gdbwire_mi_lex_init(yyscan_t *scanner);
-extern int gdbwire_mi_lex_destroy(yyscan_t scanner);
+/* The progress through the c-string of a stream record being streamed */
+enum gdbwire_mi_stream_state {
+    /* Not streaming a stream record */
+    GDBWIRE_MI_STREAM_NONE,
+    /* In the c-string */
+    GDBWIRE_MI_STREAM_CSTRING,
+    /* In the c-string, right after a backslash */
+    GDBWIRE_MI_STREAM_ESCAPE,
+    /* After the c-string, waiting for the newline */
+    GDBWIRE_MI_STREAM_END,
+    /* After a carriage return, a line feed would belong to it */
+    GDBWIRE_MI_STREAM_CARRIAGE_RETURN
+};
 
 struct gdbwire_mi_parser {
     /* The buffer pushed into the parser from the user */
     struct gdbwire_string *buffer;
+    /* The number of bytes at the start of buffer known to have no newline */
+    size_t scan_pos;
     /* The GDB/MI lexer state */
     yyscan_t mils;
+    /* The input and token position shared with the GDB/MI lexer */
+    struct gdbwire_mi_lexer_extra mils_extra;
     /* The GDB/MI push parser state */
     gdbwire_mi_pstate *mips;
+    /* The arenas the parse trees are allocated from */
+    struct gdbwire_mi_arena_pool *pool;
     /* The client parser callbacks */
     struct gdbwire_mi_parser_callbacks callbacks;
+    /* The allocator the parser allocates its memory with */
+    struct gdbwire_allocator allocator;
+    /* The memory limits of the parser */
+    struct gdbwire_mi_parser_limits limits;
+    /* The statistics of the parser */
+    struct gdbwire_mi_parser_stats stats;
+    /* True while discarding the rest of a line past the hard limit */
+    int oversized;
+    /* The size of the oversized line seen so far, without the newline */
+    size_t oversized_size;
+    /* The function called with each oversized line, or NULL if none */
+    gdbwire_mi_oversized_line_fn oversized_line_callback;
+    /* The context passed to oversized_line_callback */
+    void *oversized_line_context;
+    /* The buffered size at which stream records are streamed, 0 for never */
+    size_t stream_threshold;
+    /* The progress through the stream record being streamed */
+    enum gdbwire_mi_stream_state stream_state;
+    /* The kind of the stream record being streamed */
+    enum gdbwire_mi_stream_record_kind stream_kind;
+    /* The function called with each chunk of a stream record, or NULL */
+    gdbwire_mi_stream_chunk_fn stream_chunk_callback;
+    /* The context passed to stream_chunk_callback */
+    void *stream_chunk_context;
+    /* True if the timestamps of each line are taken */
+    int timestamps;
+    /* When the data being pushed was pushed */
+    uint64_t push_time;
+    /* When the first byte of the buffered partial line was pushed, or 0 */
+    uint64_t line_time;
+    /* The second stage while the parser is pipelined, or NULL */
+    struct gdbwire_mi_pipeline *pipeline;
+    /* The parse trees of recently parsed lines, or NULL if not cached */
+    struct gdbwire_mi_cache *cache;
+    /* True if the hashes of the results are cached in each parse tree */
+    int hashes;
 };
 
+static enum gdbwire_result gdbwire_mi_parser_stop_pipeline(
+        struct gdbwire_mi_parser *parser);
+
 struct gdbwire_mi_parser *
 gdbwire_mi_parser_create(struct gdbwire_mi_parser_callbacks callbacks)
+{
+    return gdbwire_mi_parser_create_with_allocator(callbacks, NULL);
+}
+
+struct gdbwire_mi_parser *
+gdbwire_mi_parser_create_with_allocator(
+        struct gdbwire_mi_parser_callbacks callbacks,
+        const struct gdbwire_allocator *allocator)
 {
     struct gdbwire_mi_parser *parser;
 
-    parser = (struct gdbwire_mi_parser *)calloc(1,
+    /* Ensure that the callbacks are non null */
+    if (!callbacks.gdbwire_mi_output_callback) {
+        return NULL;
+    }
+
+    /* Ensure that the allocator is complete */
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    parser = (struct gdbwire_mi_parser *)gdbwire_calloc(allocator, 1,
         sizeof(struct gdbwire_mi_parser));
     if (!parser) {
         return NULL;
     }
 
+    parser->allocator = (allocator) ? *allocator :
+        gdbwire_get_default_allocator();
+    parser->callbacks = callbacks;
+
     /* Create a new buffer for the user to push parse data into */
-    parser->buffer = gdbwire_string_create();
+    parser->buffer = gdbwire_string_create_with_allocator(&parser->allocator);
     if (!parser->buffer) {
-        free(parser);
+        gdbwire_mi_parser_destroy(parser);
         return NULL;
     }
 
     /* Create a new lexer state instance */
-    if (gdbwire_mi_lex_init(&parser->mils) != 0) {
-        gdbwire_string_destroy(parser->buffer);
-        free(parser);
+    parser->mils_extra.allocator = &parser->allocator;
+    if (gdbwire_mi_lex_init_extra(&parser->mils_extra, &parser->mils) != 0) {
+        gdbwire_mi_parser_destroy(parser);
         return NULL;
     }
 
     /* Create a new push parser state instance */
     parser->mips = gdbwire_mi_pstate_new();
     if (!parser->mips) {
-        gdbwire_mi_lex_destroy(parser->mils);
-        gdbwire_string_destroy(parser->buffer);
-        free(parser);
+        gdbwire_mi_parser_destroy(parser);
         return NULL;
     }
 
-    /* Ensure that the callbacks are non null */
-    if (!callbacks.gdbwire_mi_output_callback) {
-        gdbwire_mi_pstate_delete(parser->mips);
-        gdbwire_mi_lex_destroy(parser->mils);
-        gdbwire_string_destroy(parser->buffer);
-        free(parser);
+    /* Create the pool to allocate parse trees from */
+    parser->pool = gdbwire_mi_arena_pool_create(&parser->allocator);
+    if (!parser->pool) {
+        gdbwire_mi_parser_destroy(parser);
         return NULL;
     }
 
-    parser->callbacks = callbacks;
-
     return parser;
 }
 
 void gdbwire_mi_parser_destroy(struct gdbwire_mi_parser *parser)
 {
     if (parser) {
+        /* The parser is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = parser->allocator;
+
+        /* Let the second stage finish the lines already lexed */
+        gdbwire_mi_parser_stop_pipeline(parser);
+
+        /* Free the line cache, before the pool its trees belong to */
+        if (parser->cache) {
+            gdbwire_mi_cache_destroy(parser->cache);
+            parser->cache = NULL;
+        }
+
         /* Free the parse buffer */
         if (parser->buffer) {
             gdbwire_string_destroy(parser->buffer);
@@ -114,7 +267,13 @@ void gdbwire_mi_parser_destroy(struct gdbwire_mi_parser *parser)
             parser->mips = NULL;
         }
 
-        free(parser);
+        /* Free the arena pool, outputs still in use keep it alive */
+        if (parser->pool) {
+            gdbwire_mi_arena_pool_destroy(parser->pool);
+            parser->pool = NULL;
+        }
+
+        gdbwire_free(&allocator, parser);
         parser = NULL;
     }
 }
@@ -125,49 +284,59 @@ gdbwire_mi_parser_get_callbacks(struct gdbwire_mi_parser *parser)
     return parser->callbacks;
 }
 
+#ifdef GDBWIRE_USDT
 /**
- * Parse a single line of output in GDB/MI format.
+ * Get the class of a parsed line for the record_parsed probe.
  *
- * The normal usage of this function is to call it over and over again with
- * more data lines and wait for it to return an mi output command.
+ * @param output
+ * The parsed line.
  *
- * @param parser
- * The parser context to operate on.
+ * @return
+ * The class of the record, see gdbwire_trace.h.
+ */
+static int
+gdbwire_mi_parser_trace_class(struct gdbwire_mi_output *output)
+{
+    if (output->kind == GDBWIRE_MI_OUTPUT_OOB) {
+        if (output->variant.oob_record->kind == GDBWIRE_MI_ASYNC) {
+            return output->variant.oob_record->variant.async_record->
+                async_class;
+        }
+        return output->variant.oob_record->variant.stream_record->kind;
+    } else if (output->kind == GDBWIRE_MI_OUTPUT_RESULT) {
+        return output->variant.result_record->result_class;
+    }
+    return -1;
+}
+#endif
+
+/**
+ * Finish the parse tree of a line.
+ *
+ * @param arena
+ * The arena the parse tree was allocated from, released on failure.
+ *
+ * @param output
+ * The output the grammar produced for the line, or NULL if none.
+ *
+ * @param mi_status
+ * The status the push parser returned for the last token of the line.
  *
  * @param line
- * A line of output in GDB/MI format to be parsed.
+ * The line, including the newline.
  *
- * \return
+ * @param size
+ * The number of bytes in line.
+ *
+ * @return
  * GDBWIRE_OK on success or appropriate error result on failure.
  */
 static enum gdbwire_result
-gdbwire_mi_parser_parse_line(struct gdbwire_mi_parser *parser,
-    const char *line)
+gdbwire_mi_parser_finish(struct gdbwire_mi_arena *arena,
+    struct gdbwire_mi_output *output, int mi_status, const char *line,
+    size_t size)
 {
-    struct gdbwire_mi_parser_callbacks callbacks =
-        gdbwire_mi_parser_get_callbacks(parser);
-    struct gdbwire_mi_output *output = 0;
-    YY_BUFFER_STATE state = 0;
-    int pattern, mi_status;
-
-    GDBWIRE_ASSERT(parser && line);
-
-    /* Create a new input buffer for flex. */
-    state = gdbwire_mi__scan_string(line, parser->mils);
-    GDBWIRE_ASSERT(state);
-    gdbwire_mi_set_column(1, parser->mils);
-
-    /* Iterate over all the tokens found in the scanner buffer */
-    do {
-        pattern = gdbwire_mi_lex(parser->mils);
-        if (pattern == 0)
-            break;
-        mi_status = gdbwire_mi_push_parse(parser->mips, pattern, NULL,
-            parser->mils, &output);
-    } while (mi_status == YYPUSH_MORE);
-
-    /* Free the scanners buffer */
-    gdbwire_mi__delete_buffer(state, parser->mils);
+    enum gdbwire_result result = GDBWIRE_OK;
 
     /**
      * The push parser will return,
@@ -187,145 +356,1422 @@ gdbwire_mi_parser_parse_line(struct gdbwire_mi_parser *parser,
      */
 
     /* Check mi_status, will be 1 on parse error, and YYPUSH_MORE on success */
-    GDBWIRE_ASSERT(mi_status == 1 || mi_status == YYPUSH_MORE);
+    GDBWIRE_ASSERT_GOTO(mi_status == 1 || mi_status == YYPUSH_MORE,
+        result, cleanup);
 
     /* Each GDB/MI line should produce an output command */
-    GDBWIRE_ASSERT(output);
-    output->line = gdbwire_strdup(line);
+    GDBWIRE_ASSERT_GOTO(output, result, cleanup);
+    output->line = gdbwire_mi_arena_strndup(arena, line, size);
+    GDBWIRE_ASSERT_GOTO(output->line, result, cleanup);
 
-    callbacks.gdbwire_mi_output_callback(callbacks.context, output);
+    return result;
 
-    return GDBWIRE_OK;
+cleanup:
+    gdbwire_mi_arena_release(arena);
+    return result;
 }
 
 /**
- * Get the next line available in the buffer.
+ * Cache the hashes of the results of an output.
  *
- * @param buffer
- * The entire buffer the user has pushed onto the gdbwire_mi parser
- * through gdbwire_mi_parser_push. If a line is found, the returned line
- * will be removed from this buffer.
+ * @param output
+ * The finished output.
+ */
+static void
+gdbwire_mi_parser_hash(struct gdbwire_mi_output *output)
+{
+    if (output->kind == GDBWIRE_MI_OUTPUT_RESULT) {
+        gdbwire_mi_result_cache_hashes(output->variant.result_record->result);
+    } else if (output->kind == GDBWIRE_MI_OUTPUT_OOB &&
+            output->variant.oob_record->kind == GDBWIRE_MI_ASYNC) {
+        gdbwire_mi_result_cache_hashes(
+            output->variant.oob_record->variant.async_record->result);
+    }
+}
+
+/**
+ * Hand the output of a line to the output callback.
  *
- * @param line
- * Will return as an allocated line if a line is available or NULL
- * otherwise. If this function does not return GDBWIRE_OK then ignore
- * the output of this parameter. It is the callers responsibility to
- * free the memory.
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param output
+ * The finished output.
+ *
+ * @param timestamps
+ * The timestamps of the line, or NULL if they are not taken.
+ */
+static void
+gdbwire_mi_parser_deliver(struct gdbwire_mi_parser *parser,
+    struct gdbwire_mi_output *output,
+    const struct gdbwire_mi_timestamps *timestamps)
+{
+    struct gdbwire_mi_parser_callbacks callbacks =
+        gdbwire_mi_parser_get_callbacks(parser);
+
+    if (timestamps) {
+        output->timestamps = *timestamps;
+        output->timestamps.dispatch = gdbwire_monotonic_ns();
+    }
+
+    gdbwire_trace2(record_parsed, (int)output->kind,
+        gdbwire_mi_parser_trace_class(output));
+    if (output->kind == GDBWIRE_MI_OUTPUT_PARSE_ERROR) {
+        gdbwire_trace3(parse_error, output->line, strlen(output->line),
+            output->variant.error.token);
+    }
+
+    gdbwire_trace1(callback_enter, (int)output->kind);
+    callbacks.gdbwire_mi_output_callback(callbacks.context, output);
+    gdbwire_trace0(callback_exit);
+}
+
+/**
+ * Hand an output sharing the parse tree of a cached line to the callback.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param cached
+ * The output of the cached line.
+ *
+ * @param timestamps
+ * The timestamps of the line, or NULL if they are not taken.
  *
  * @return
  * GDBWIRE_OK on success or appropriate error result on failure.
  */
 static enum gdbwire_result
-gdbwire_mi_parser_get_next_line(struct gdbwire_string *buffer,
-        struct gdbwire_string **line)
+gdbwire_mi_parser_share(struct gdbwire_mi_parser *parser,
+    const struct gdbwire_mi_output *cached,
+    const struct gdbwire_mi_timestamps *timestamps)
 {
     enum gdbwire_result result = GDBWIRE_OK;
+    struct gdbwire_mi_output *output;
+    struct gdbwire_mi_arena *arena;
 
-    GDBWIRE_ASSERT(buffer && line);
+    arena = gdbwire_mi_arena_acquire(parser->pool);
+    GDBWIRE_ASSERT(arena);
 
-    char *data = gdbwire_string_data(buffer);
-    size_t size = gdbwire_string_size(buffer);
-    size_t pos = gdbwire_string_find_first_of(buffer, "\r\n");
+    output = gdbwire_mi_output_share(arena, cached);
+    GDBWIRE_ASSERT_GOTO(output, result, cleanup);
 
-    /**
-     * Search to see if a newline has been reached in gdb/mi.
-     * If a line of data has been recieved, process it.
-     */
-    if (pos != size) {
-        int status;
+    gdbwire_mi_parser_deliver(parser, output, timestamps);
 
-        /**
-         * We have the position of the newline character from
-         * gdbwire_string_find_first_of. However, the length must be
-         * calculated to make a copy of the line.
-         *
-         * This is either pos + 1 (for \r or \n) or pos + 1 + 1 for (\r\n).
-         * Check for\r\n for the special case.
-         */
-        size_t line_length = (data[pos] == '\r' && (pos + 1 < size) &&
-                data[pos + 1] == '\n') ? pos + 2 : pos + 1;
+    return result;
 
-        /**
-         * - allocate the buffer
-         * - append the new line
-         * - append a null terminating character
-         * - if successful, delete the new line found from buffer
-         * - any failures cleanup and return an error
-         */
-        *line = gdbwire_string_create();
-        GDBWIRE_ASSERT(*line);
+cleanup:
+    gdbwire_mi_arena_release(arena);
+    return result;
+}
+
+/**
+ * Point the lexer at a line in place.
+ *
+ * Restarting the lexer reuses its input buffer, rather than creating
+ * and deleting a buffer with a copy of every line.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param line
+ * The line to lex, including the newline.
+ *
+ * @param size
+ * The number of bytes in line.
+ */
+static void
+gdbwire_mi_parser_start_lexer(struct gdbwire_mi_parser *parser,
+    const char *line, size_t size)
+{
+    parser->mils_extra.input = line;
+    parser->mils_extra.size = size;
+    gdbwire_mi_restart(NULL, parser->mils);
+    gdbwire_mi_set_column(1, parser->mils);
+}
+
+/**
+ * Grow an array to hold at least a number of elements.
+ *
+ * @param parser
+ * The parser context whose allocator grows the array.
+ *
+ * @param data
+ * The array, or NULL for none yet.
+ *
+ * @param capacity
+ * The number of elements the array holds, updated on success.
+ *
+ * @param count
+ * The number of elements the array must hold.
+ *
+ * @param size
+ * The size of each element.
+ *
+ * @return
+ * The array, moved if it had to grow, or NULL if out of memory.
+ */
+static void *
+gdbwire_mi_parser_reserve(struct gdbwire_mi_parser *parser, void *data,
+    size_t *capacity, size_t count, size_t size)
+{
+    size_t new_capacity = (*capacity > 0) ? *capacity : 16;
 
-        status = gdbwire_string_append_data(*line, data, line_length);
-        GDBWIRE_ASSERT_GOTO(status == 0, result, cleanup);
+    if (count <= *capacity) {
+        return data;
+    }
 
-        status = gdbwire_string_append_data(*line, "\0", 1);
-        GDBWIRE_ASSERT_GOTO(status == 0, result, cleanup);
+    while (new_capacity < count) {
+        if (new_capacity > (size_t)-1 / 2 / size) {
+            return NULL;
+        }
+        new_capacity *= 2;
+    }
 
-        status = gdbwire_string_erase(buffer, 0, line_length);
-        GDBWIRE_ASSERT_GOTO(status == 0, result, cleanup);
+    data = gdbwire_realloc(&parser->allocator, data, new_capacity * size);
+    if (data) {
+        *capacity = new_capacity;
     }
 
-    return result;
+    return data;
+}
 
-cleanup:
-    gdbwire_string_destroy(*line);
-    *line = 0;
-    return result;
+/**
+ * Append bytes to the text of a lexed line.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param lexed
+ * The lexed line to append to.
+ *
+ * @param data
+ * The bytes to append.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * 0 on success or -1 if out of memory.
+ */
+static int
+gdbwire_mi_parser_append_text(struct gdbwire_mi_parser *parser,
+    struct gdbwire_mi_lexed_line *lexed, const char *data, size_t size)
+{
+    char *text = (char *)gdbwire_mi_parser_reserve(parser, lexed->text,
+        &lexed->text_capacity, lexed->text_size + size, 1);
+
+    if (!text) {
+        return -1;
+    }
+
+    lexed->text = text;
+    memcpy(lexed->text + lexed->text_size, data, size);
+    lexed->text_size += size;
 
+    return 0;
 }
 
-enum gdbwire_result
-gdbwire_mi_parser_push(struct gdbwire_mi_parser *parser, const char *data)
+/**
+ * Free a list of lexed lines.
+ *
+ * @param parser
+ * The parser context the lines were allocated by.
+ *
+ * @param lexed
+ * The first line of the list, OK to pass in NULL.
+ */
+static void
+gdbwire_mi_parser_free_lexed_lines(struct gdbwire_mi_parser *parser,
+    struct gdbwire_mi_lexed_line *lexed)
 {
-    return gdbwire_mi_parser_push_data(parser, data, strlen(data));
+    struct gdbwire_mi_lexed_line *next;
+
+    for (; lexed; lexed = next) {
+        next = lexed->next;
+        gdbwire_free(&parser->allocator, lexed->tokens);
+        gdbwire_free(&parser->allocator, lexed->text);
+        gdbwire_free(&parser->allocator, lexed);
+    }
 }
 
-enum gdbwire_result
-gdbwire_mi_parser_push_data(struct gdbwire_mi_parser *parser, const char *data,
-    size_t size)
+/**
+ * Lex a line and queue it for the second stage, on the first stage.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param line
+ * The line to lex, including the newline.
+ *
+ * @param size
+ * The number of bytes in line.
+ *
+ * @param timestamps
+ * The timestamps of the line, or NULL if they are not taken.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_parser_lex_line(struct gdbwire_mi_parser *parser,
+    const char *line, size_t size,
+    const struct gdbwire_mi_timestamps *timestamps)
 {
-    struct gdbwire_string *line = 0;
+    struct gdbwire_mi_pipeline *pipeline = parser->pipeline;
     enum gdbwire_result result = GDBWIRE_OK;
-    int has_newline = 0;
-    size_t index;
+    struct gdbwire_mi_lexed_token *tokens;
+    struct gdbwire_mi_lexed_line *lexed;
+    const char *text;
+    size_t head;
+    int pattern;
 
-    GDBWIRE_ASSERT(parser && data);
+    /* Reuse a line the second stage is done with if there is one */
+    if (!pipeline->spare) {
+        pipeline->spare = gdbwire_atomic_exchange(&pipeline->done,
+            (struct gdbwire_mi_lexed_line *)NULL);
+    }
+    if (pipeline->spare) {
+        lexed = pipeline->spare;
+        pipeline->spare = lexed->next;
+    } else {
+        lexed = (struct gdbwire_mi_lexed_line *)gdbwire_calloc(
+            &parser->allocator, 1, sizeof(struct gdbwire_mi_lexed_line));
+        GDBWIRE_ASSERT(lexed);
+    }
+
+    lexed->tokens_size = 0;
+    lexed->text_size = 0;
+    lexed->line_size = size;
+    lexed->timestamped = (timestamps != NULL);
+    if (timestamps) {
+        lexed->timestamps = *timestamps;
+    }
+    GDBWIRE_ASSERT_GOTO(gdbwire_mi_parser_append_text(parser, lexed,
+        line, size) == 0, result, cleanup);
+
+    /* The copy of the line may move as the token text is appended */
+    gdbwire_mi_parser_start_lexer(parser, line, size);
+    while ((pattern = gdbwire_mi_lex(parser->mils)) != 0) {
+        tokens = (struct gdbwire_mi_lexed_token *)gdbwire_mi_parser_reserve(
+            parser, lexed->tokens, &lexed->tokens_capacity,
+            lexed->tokens_size + 1, sizeof(struct gdbwire_mi_lexed_token));
+        GDBWIRE_ASSERT_GOTO(tokens, result, cleanup);
+        lexed->tokens = tokens;
+
+        tokens[lexed->tokens_size].kind = pattern;
+        tokens[lexed->tokens_size].text = lexed->text_size;
+        tokens[lexed->tokens_size].pos = parser->mils_extra.pos;
+        lexed->tokens_size++;
+
+        text = gdbwire_mi_get_text(parser->mils);
+        GDBWIRE_ASSERT_GOTO(gdbwire_mi_parser_append_text(parser, lexed,
+            text, strlen(text) + 1) == 0, result, cleanup);
+    }
 
     /**
-     * No need to parse an MI command until a newline occurs.
-     *
-     * A gdb/mi command may be a very long line. For this reason, it is
-     * better to check the data passed into this function once for a newline
-     * rather than checking all the data every time this function is called.
-     * This optimizes the case where this function is called one character
-     * at a time.
+     * Only the first stage writes head. Sleep while the ring is full,
+     * the second stage checks for a waiting first stage after taking a
+     * line, so either it sees the wait or the check below sees the room.
      */
-    for (index = size; index > 0; --index) {
-        if (data[index-1] == '\n' || data[index-1] == '\r') {
-            has_newline = 1;
-            break;
+    head = pipeline->head;
+    if (head - gdbwire_atomic_load(&pipeline->tail) ==
+            GDBWIRE_MI_PIPELINE_CAPACITY) {
+        pthread_mutex_lock(&pipeline->mutex);
+        gdbwire_atomic_store(&pipeline->full_waiting, 1);
+        gdbwire_atomic_fence();
+        while (head - gdbwire_atomic_load(&pipeline->tail) ==
+                GDBWIRE_MI_PIPELINE_CAPACITY) {
+            pthread_cond_wait(&pipeline->full_cond, &pipeline->mutex);
         }
+        gdbwire_atomic_store(&pipeline->full_waiting, 0);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+
+    pipeline->ring[head % GDBWIRE_MI_PIPELINE_CAPACITY] = lexed;
+    gdbwire_atomic_store(&pipeline->head, head + 1);
+
+    /* Wake the second stage if it went to sleep on an empty queue */
+    gdbwire_atomic_fence();
+    if (gdbwire_atomic_load(&pipeline->waiting)) {
+        pthread_mutex_lock(&pipeline->mutex);
+        pthread_cond_signal(&pipeline->cond);
+        pthread_mutex_unlock(&pipeline->mutex);
     }
 
-    GDBWIRE_ASSERT(gdbwire_string_append_data(parser->buffer, data, size) == 0);
+    return result;
 
-    if (has_newline) {
-        for (;;) {
-            result = gdbwire_mi_parser_get_next_line(parser->buffer, &line);
-            GDBWIRE_ASSERT_GOTO(result == GDBWIRE_OK, result, cleanup);
+cleanup:
+    lexed->next = pipeline->spare;
+    pipeline->spare = lexed;
+    return result;
+}
 
-            if (line) {
-                result = gdbwire_mi_parser_parse_line(parser,
-                    gdbwire_string_data(line));
-                gdbwire_string_destroy(line);
-                line = 0;
-                GDBWIRE_ASSERT_GOTO(result == GDBWIRE_OK, result, cleanup);
-            } else {
+/**
+ * Build the parse tree of a line and hand it to the output callback.
+ *
+ * A line found in the line cache shares the parse tree of the cached
+ * line instead. Otherwise the line is parsed from the tokens lexed by
+ * the first stage of the pipeline, or lexed here if not pipelined.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param lexed
+ * The tokens of the line, or NULL to lex the line now.
+ *
+ * @param line
+ * The line, including the newline.
+ *
+ * @param size
+ * The number of bytes in line.
+ *
+ * @param timestamps
+ * The timestamps of the line, or NULL if they are not taken.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_parser_build(struct gdbwire_mi_parser *parser,
+    const struct gdbwire_mi_lexed_line *lexed, const char *line,
+    size_t size, const struct gdbwire_mi_timestamps *timestamps)
+{
+    const struct gdbwire_mi_output *cached;
+    struct gdbwire_mi_output *output = 0;
+    struct gdbwire_mi_arena *arena;
+    struct gdbwire_mi_token token;
+    enum gdbwire_result result;
+    int pattern, mi_status = YYPUSH_MORE;
+    int cacheable = parser->cache && size <= GDBWIRE_MI_CACHE_LINE_SIZE;
+    size_t index = 0;
+
+    if (cacheable) {
+        cached = gdbwire_mi_cache_find(parser->cache, line, size);
+        if (cached) {
+            return gdbwire_mi_parser_share(parser, cached, timestamps);
+        }
+    }
+
+    /* The output and everything it references is allocated in the arena */
+    arena = gdbwire_mi_arena_acquire(parser->pool);
+    GDBWIRE_ASSERT(arena);
+
+    if (!lexed) {
+        gdbwire_mi_parser_start_lexer(parser, line, size);
+    }
+
+    /* Iterate over all the tokens of the line */
+    do {
+        if (lexed) {
+            if (index == lexed->tokens_size)
                 break;
-            }
+            pattern = lexed->tokens[index].kind;
+            token.text = lexed->text + lexed->tokens[index].text;
+            token.pos = lexed->tokens[index].pos;
+            ++index;
+        } else {
+            pattern = gdbwire_mi_lex(parser->mils);
+            if (pattern == 0)
+                break;
+            token.text = gdbwire_mi_get_text(parser->mils);
+            token.pos = parser->mils_extra.pos;
         }
+        mi_status = gdbwire_mi_push_parse(parser->mips, pattern, NULL,
+            &token, arena, &output);
+    } while (mi_status == YYPUSH_MORE);
+
+    result = gdbwire_mi_parser_finish(arena, output, mi_status, line, size);
+    if (result != GDBWIRE_OK) {
+        return result;
     }
 
-cleanup:
+    if (parser->hashes) {
+        gdbwire_mi_parser_hash(output);
+    }
+
+    /* The cache keeps the parsed output, the callback gets a share of it */
+    if (cacheable) {
+        gdbwire_mi_cache_insert(parser->cache, output, size);
+        return gdbwire_mi_parser_share(parser, output, timestamps);
+    }
+
+    gdbwire_mi_parser_deliver(parser, output, timestamps);
+
     return result;
 }
+
+/**
+ * The second stage of a pipelined parser.
+ *
+ * Builds the lexed lines in the order they were queued until the parser
+ * stops the pipeline and every line queued before then is built.
+ *
+ * @param data
+ * The parser.
+ *
+ * @return
+ * NULL.
+ */
+static void *
+gdbwire_mi_parser_run_pipeline(void *data)
+{
+    struct gdbwire_mi_parser *parser = (struct gdbwire_mi_parser *)data;
+    struct gdbwire_mi_pipeline *pipeline = parser->pipeline;
+    struct gdbwire_mi_lexed_line *lexed;
+    enum gdbwire_result result;
+    size_t tail, tree_bytes, cache_bytes, cache_hits, cache_misses;
+    int expected;
+
+    for (;;) {
+        /* Only the second stage writes tail */
+        tail = pipeline->tail;
+        if (gdbwire_atomic_load(&pipeline->head) != tail) {
+            lexed = pipeline->ring[tail % GDBWIRE_MI_PIPELINE_CAPACITY];
+
+            result = gdbwire_mi_parser_build(parser, lexed, lexed->text,
+                lexed->line_size,
+                (lexed->timestamped) ? &lexed->timestamps : NULL);
+            if (result != GDBWIRE_OK) {
+                expected = GDBWIRE_OK;
+                gdbwire_atomic_compare_exchange(&pipeline->result,
+                    &expected, (int)result);
+            }
+
+            gdbwire_mi_arena_pool_get_bytes(parser->pool, &tree_bytes,
+                &cache_bytes);
+            gdbwire_atomic_store(&pipeline->tree_bytes, tree_bytes);
+            gdbwire_atomic_store(&pipeline->cache_bytes, cache_bytes);
+            if (parser->cache) {
+                gdbwire_mi_cache_get_stats(parser->cache, &cache_hits,
+                    &cache_misses);
+                gdbwire_atomic_store(&pipeline->cache_hits, cache_hits);
+                gdbwire_atomic_store(&pipeline->cache_misses, cache_misses);
+            }
+
+            gdbwire_atomic_store(&pipeline->tail, tail + 1);
+
+            /* Wake the first stage if it waits for room in the ring */
+            gdbwire_atomic_fence();
+            if (gdbwire_atomic_load(&pipeline->full_waiting)) {
+                pthread_mutex_lock(&pipeline->mutex);
+                pthread_cond_signal(&pipeline->full_cond);
+                pthread_mutex_unlock(&pipeline->mutex);
+            }
+
+            /* Hand the line back to the first stage to reuse */
+            lexed->next = gdbwire_atomic_load(&pipeline->done);
+            while (!gdbwire_atomic_compare_exchange(&pipeline->done,
+                    &lexed->next, lexed)) {
+            }
+            continue;
+        }
+
+        if (gdbwire_atomic_load(&pipeline->stopping)) {
+            break;
+        }
+
+        /**
+         * Sleep until a line is queued. The first stage checks for a
+         * waiting second stage after queueing a line, so either it sees
+         * the wait or the check below sees the line.
+         */
+        pthread_mutex_lock(&pipeline->mutex);
+        gdbwire_atomic_store(&pipeline->waiting, 1);
+        gdbwire_atomic_fence();
+        if (gdbwire_atomic_load(&pipeline->head) == tail &&
+                !gdbwire_atomic_load(&pipeline->stopping)) {
+            pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+        }
+        gdbwire_atomic_store(&pipeline->waiting, 0);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+
+    return NULL;
+}
+
+/**
+ * Stop the second stage once it built the lines already lexed.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @return
+ * The first error of the second stage not yet reported, or GDBWIRE_OK.
+ */
+static enum gdbwire_result
+gdbwire_mi_parser_stop_pipeline(struct gdbwire_mi_parser *parser)
+{
+    struct gdbwire_mi_pipeline *pipeline = parser->pipeline;
+    enum gdbwire_result result;
+
+    if (!pipeline) {
+        return GDBWIRE_OK;
+    }
+
+    pthread_mutex_lock(&pipeline->mutex);
+    gdbwire_atomic_store(&pipeline->stopping, 1);
+    pthread_cond_signal(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->mutex);
+    pthread_join(pipeline->thread, NULL);
+
+    result = (enum gdbwire_result)pipeline->result;
+
+    gdbwire_mi_parser_free_lexed_lines(parser, pipeline->done);
+    gdbwire_mi_parser_free_lexed_lines(parser, pipeline->spare);
+    pthread_cond_destroy(&pipeline->full_cond);
+    pthread_cond_destroy(&pipeline->cond);
+    pthread_mutex_destroy(&pipeline->mutex);
+    gdbwire_free(&parser->allocator, pipeline);
+    parser->pipeline = NULL;
+
+    return result;
+}
+
+/**
+ * Parse a single line of output in GDB/MI format.
+ *
+ * The normal usage of this function is to call it over and over again with
+ * more data lines and wait for it to return an mi output command.
+ *
+ * When the parser is pipelined, the line is only lexed here and
+ * queued for the second stage to build.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param line
+ * A line of output in GDB/MI format to be parsed, including the newline.
+ * The line does not need to be NUL terminated.
+ *
+ * @param size
+ * The number of bytes in line.
+ *
+ * \return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_parser_parse_line(struct gdbwire_mi_parser *parser,
+    const char *line, size_t size)
+{
+    struct gdbwire_mi_timestamps timestamps = { 0, 0, 0 };
+
+    GDBWIRE_ASSERT(parser && line);
+
+    parser->stats.lines++;
+    gdbwire_trace2(line_complete, line, size);
+
+    /* The lines after the first one in the buffer began in this push */
+    if (parser->timestamps) {
+        timestamps.first_byte = (parser->line_time) ?
+            parser->line_time : parser->push_time;
+        timestamps.newline = parser->push_time;
+    }
+    parser->line_time = 0;
+
+    if (parser->pipeline) {
+        return gdbwire_mi_parser_lex_line(parser, line, size,
+            (parser->timestamps) ? &timestamps : NULL);
+    }
+
+    return gdbwire_mi_parser_build(parser, NULL, line, size,
+        (parser->timestamps) ? &timestamps : NULL);
+}
+
+/**
+ * Get the size of the next line available in the buffer.
+ *
+ * @param data
+ * The data to search for a line.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @param pos
+ * The position in data to start searching for a newline at. Every byte
+ * before this position is known not to be a newline.
+ *
+ * @return
+ * The size of the line, including the newline, or 0 if data does not
+ * contain a complete line yet.
+ */
+static size_t
+gdbwire_mi_parser_get_next_line(const char *data, size_t size, size_t pos)
+{
+    for (; pos < size; ++pos) {
+        if (data[pos] == '\r' || data[pos] == '\n') {
+            /**
+             * The line is either pos + 1 (for \r or \n) or
+             * pos + 1 + 1 for (\r\n). Check for\r\n for the special case.
+             */
+            return (data[pos] == '\r' && (pos + 1 < size) &&
+                    data[pos + 1] == '\n') ? pos + 2 : pos + 1;
+        }
+    }
+
+    return 0;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_push(struct gdbwire_mi_parser *parser, const char *data)
+{
+    return gdbwire_mi_parser_push_data(parser, data, strlen(data));
+}
+
+/**
+ * Parse each complete line in the buffer.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_parser_parse_lines(struct gdbwire_mi_parser *parser)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+    char *buffer_data = gdbwire_string_data(parser->buffer);
+    size_t buffer_size = gdbwire_string_size(parser->buffer);
+    size_t line_start = 0, line_size;
+
+    /**
+     * Parse each complete line in place in the buffer.
+     *
+     * The parsed lines are erased from the buffer all at once
+     * afterwards, rather than shifting the rest of the buffer
+     * down after every line.
+     */
+    for (;;) {
+        line_size = gdbwire_mi_parser_get_next_line(
+            buffer_data + line_start, buffer_size - line_start,
+            parser->scan_pos - line_start);
+        if (line_size == 0) {
+            break;
+        }
+
+        /* The line is consumed even if it fails to parse */
+        result = gdbwire_mi_parser_parse_line(parser,
+            buffer_data + line_start, line_size);
+        line_start += line_size;
+        parser->scan_pos = line_start;
+        if (result != GDBWIRE_OK) {
+            break;
+        }
+    }
+
+    if (line_start > 0) {
+        GDBWIRE_ASSERT(gdbwire_string_erase(parser->buffer, 0,
+            line_start) == 0);
+    }
+    parser->scan_pos = (result == GDBWIRE_OK) ?
+        buffer_size - line_start : 0;
+
+    return result;
+}
+
+/**
+ * Close the c-string of a truncated stream record.
+ *
+ * A stream record cut off by the hard limit is missing the quote
+ * that ends its c-string. Without it, the truncated line would not
+ * parse and the start of the output would be lost along with the rest.
+ *
+ * @param buffer
+ * The buffer holding the truncated line, without the newline.
+ *
+ * @return
+ * 0 on success or -1 on error.
+ */
+static int
+gdbwire_mi_parser_close_stream_record(struct gdbwire_string *buffer)
+{
+    char *data = gdbwire_string_data(buffer);
+    size_t size = gdbwire_string_size(buffer);
+    size_t index;
+
+    if (size < 2 || (data[0] != '~' && data[0] != '@' && data[0] != '&') ||
+            data[1] != '"') {
+        return 0;
+    }
+
+    for (index = 2; index < size; ++index) {
+        if (data[index] == '"') {
+            /* The c-string was closed before the line was truncated */
+            return 0;
+        } else if (data[index] == '\\') {
+            if (index + 1 == size) {
+                /* Drop the escape character that lost its escaped one */
+                if (gdbwire_string_erase(buffer, index, 1) == -1) {
+                    return -1;
+                }
+                break;
+            }
+            ++index;
+        }
+    }
+
+    return gdbwire_string_append_data(buffer, "\"", 1);
+}
+
+/**
+ * Finish a line that did not fit in the hard limit.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param newline
+ * The newline characters that ended the line.
+ *
+ * @param newline_size
+ * The number of newline characters.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_parser_finish_oversized(struct gdbwire_mi_parser *parser,
+    const char *newline, size_t newline_size)
+{
+    enum gdbwire_mi_parser_limit_action action = parser->limits.action;
+
+    parser->oversized = 0;
+
+    /* A line truncated down to nothing has nothing left to parse */
+    if (action == GDBWIRE_MI_LIMIT_TRUNCATE &&
+            gdbwire_string_size(parser->buffer) == 0) {
+        action = GDBWIRE_MI_LIMIT_SKIP;
+    }
+
+    if (action == GDBWIRE_MI_LIMIT_TRUNCATE) {
+        parser->stats.lines_truncated++;
+    } else {
+        parser->stats.lines_skipped++;
+    }
+
+    if (parser->oversized_line_callback) {
+        parser->oversized_line_callback(parser->oversized_line_context,
+            action, parser->oversized_size);
+    }
+
+    if (action == GDBWIRE_MI_LIMIT_SKIP) {
+        gdbwire_string_clear(parser->buffer);
+        parser->scan_pos = 0;
+        parser->line_time = 0;
+        return GDBWIRE_OK;
+    }
+
+    GDBWIRE_ASSERT(gdbwire_mi_parser_close_stream_record(
+        parser->buffer) == 0);
+    GDBWIRE_ASSERT(gdbwire_string_append_data(parser->buffer,
+        newline, newline_size) == 0);
+
+    return gdbwire_mi_parser_parse_lines(parser);
+}
+
+/**
+ * Get the capacity the buffer may grow to under the hard limit.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @return
+ * The memory the rest of the parser leaves the buffer.
+ */
+static size_t
+gdbwire_mi_parser_get_budget(struct gdbwire_mi_parser *parser)
+{
+    struct gdbwire_mi_parser_stats stats;
+    size_t other_bytes;
+
+    if (parser->limits.hard_limit == 0) {
+        return (size_t)-1;
+    }
+
+    gdbwire_mi_parser_get_stats(parser, &stats);
+    other_bytes = stats.total_bytes - gdbwire_string_capacity(parser->buffer);
+
+    return (parser->limits.hard_limit > other_bytes) ?
+        parser->limits.hard_limit - other_bytes : 0;
+}
+
+/**
+ * Push data into the parser while enforcing the hard limit.
+ *
+ * The data is taken a line at a time. Each line is appended to the
+ * buffer only as far as the hard limit allows, the rest of a line that
+ * does not fit is discarded as it arrives.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param data
+ * The data to push onto the parser.
+ *
+ * @param size
+ * The size of the data to push onto the parser.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_parser_push_data_limited(struct gdbwire_mi_parser *parser,
+    const char *data, size_t size)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+    size_t piece_size, content_size, budget, buffer_size;
+
+    while (size > 0 && result == GDBWIRE_OK) {
+        /* Take up to and including the next newline */
+        piece_size = gdbwire_mi_parser_get_next_line(data, size, 0);
+        if (piece_size == 0) {
+            piece_size = content_size = size;
+        } else {
+            content_size = piece_size - 1;
+            if (content_size > 0 && data[content_size - 1] == '\r') {
+                --content_size;
+            }
+        }
+
+        if (parser->oversized) {
+            parser->oversized_size += content_size;
+        } else {
+            budget = gdbwire_mi_parser_get_budget(parser);
+            buffer_size = gdbwire_string_size(parser->buffer);
+
+            /* Give up the memory held for reuse before giving up data */
+            if (gdbwire_string_capacity_for(parser->buffer,
+                    buffer_size + piece_size) > budget) {
+                if (parser->cache) {
+                    gdbwire_mi_cache_clear(parser->cache);
+                }
+                gdbwire_mi_arena_pool_trim(parser->pool);
+                budget = gdbwire_mi_parser_get_budget(parser);
+            }
+
+            if (gdbwire_string_capacity_for(parser->buffer,
+                    buffer_size + piece_size) <= budget) {
+                GDBWIRE_ASSERT(gdbwire_string_append_data(parser->buffer,
+                    data, piece_size) == 0);
+                if (piece_size > content_size) {
+                    result = gdbwire_mi_parser_parse_lines(parser);
+                } else {
+                    parser->scan_pos = gdbwire_string_size(parser->buffer);
+                }
+                data += piece_size;
+                size -= piece_size;
+                continue;
+            }
+
+            parser->oversized = 1;
+            parser->oversized_size = buffer_size + content_size;
+
+            if (parser->limits.action == GDBWIRE_MI_LIMIT_TRUNCATE) {
+                /**
+                 * Keep as much of the start of the line as fits, leaving
+                 * room for the quote and newline appended when it ends.
+                 */
+                size_t low = 0, high = content_size, mid;
+                while (low < high) {
+                    mid = low + (high - low + 1) / 2;
+                    if (gdbwire_string_capacity_for(parser->buffer,
+                            buffer_size + mid + 3) <= budget) {
+                        low = mid;
+                    } else {
+                        high = mid - 1;
+                    }
+                }
+                GDBWIRE_ASSERT(gdbwire_string_append_data(parser->buffer,
+                    data, low) == 0);
+            } else {
+                gdbwire_string_clear(parser->buffer);
+            }
+            parser->scan_pos = gdbwire_string_size(parser->buffer);
+        }
+
+        if (piece_size > content_size) {
+            result = gdbwire_mi_parser_finish_oversized(parser,
+                data + content_size, piece_size - content_size);
+        }
+
+        data += piece_size;
+        size -= piece_size;
+    }
+
+    return result;
+}
+
+/**
+ * Deliver the data of the stream record being streamed.
+ *
+ * The c-string is unescaped the same way the grammar unescapes it,
+ * a chunk at a time, as the data arrives.
+ *
+ * @param parser
+ * The parser context to operate on.
+ *
+ * @param data
+ * The data of the stream record.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * The number of bytes of data that belong to the stream record,
+ * including its newline. The rest of data is the lines after it.
+ */
+static size_t
+gdbwire_mi_parser_stream(struct gdbwire_mi_parser *parser,
+    const char *data, size_t size)
+{
+    char chunk[GDBWIRE_MI_STREAM_CHUNK_SIZE];
+    size_t chunk_size = 0, index = 0;
+    int last = 0;
+    char c;
+
+    while (index < size && !last) {
+        c = data[index++];
+
+        if (parser->stream_state == GDBWIRE_MI_STREAM_CARRIAGE_RETURN) {
+            /* The record ended in the last push, take its \r\n along */
+            parser->stream_state = GDBWIRE_MI_STREAM_NONE;
+            return (c == '\n') ? 1 : 0;
+        }
+
+        if (c == '\n' || c == '\r') {
+            if (c == '\r') {
+                if (index < size) {
+                    index += (data[index] == '\n') ? 1 : 0;
+                } else {
+                    last = 2;
+                    break;
+                }
+            }
+            last = 1;
+            break;
+        }
+
+        switch (parser->stream_state) {
+            case GDBWIRE_MI_STREAM_CSTRING:
+                if (c == '\\') {
+                    parser->stream_state = GDBWIRE_MI_STREAM_ESCAPE;
+                } else if (c == '"') {
+                    parser->stream_state = GDBWIRE_MI_STREAM_END;
+                } else {
+                    chunk[chunk_size++] = c;
+                }
+                break;
+            case GDBWIRE_MI_STREAM_ESCAPE:
+                parser->stream_state = GDBWIRE_MI_STREAM_CSTRING;
+                switch (c) {
+                    case 'n':
+                        chunk[chunk_size++] = '\n';
+                        break;
+                    case 'r':
+                        chunk[chunk_size++] = '\r';
+                        break;
+                    case 't':
+                        chunk[chunk_size++] = '\t';
+                        break;
+                    case '"':
+                    case '\\':
+                        chunk[chunk_size++] = c;
+                        break;
+                    default:
+                        /* Keep the backslash, the character is reread */
+                        chunk[chunk_size++] = '\\';
+                        --index;
+                        break;
+                }
+                break;
+            default:
+                /* Anything after the c-string is not part of it */
+                break;
+        }
+
+        if (chunk_size == GDBWIRE_MI_STREAM_CHUNK_SIZE) {
+            parser->stream_chunk_callback(parser->stream_chunk_context,
+                parser->stream_kind, chunk, chunk_size, 0);
+            chunk_size = 0;
+        }
+    }
+
+    if (last) {
+        parser->stream_state = (last == 2) ?
+            GDBWIRE_MI_STREAM_CARRIAGE_RETURN : GDBWIRE_MI_STREAM_NONE;
+        parser->stats.lines++;
+        parser->stats.lines_streamed++;
+    }
+
+    if (chunk_size > 0 || last) {
+        parser->stream_chunk_callback(parser->stream_chunk_context,
+            parser->stream_kind, chunk, chunk_size, last != 0);
+    }
+
+    return index;
+}
+
+/**
+ * Start streaming the stream record in the buffer if it is large enough.
+ *
+ * @param parser
+ * The parser context to operate on.
+ */
+static void
+gdbwire_mi_parser_start_stream(struct gdbwire_mi_parser *parser)
+{
+    char *data = gdbwire_string_data(parser->buffer);
+    size_t size = gdbwire_string_size(parser->buffer);
+
+    if (!parser->stream_chunk_callback ||
+            parser->stream_threshold == 0 ||
+            size < parser->stream_threshold || size < 2 ||
+            parser->oversized || data[1] != '"') {
+        return;
+    }
+
+    switch (data[0]) {
+        case '~':
+            parser->stream_kind = GDBWIRE_MI_CONSOLE;
+            break;
+        case '@':
+            parser->stream_kind = GDBWIRE_MI_TARGET;
+            break;
+        case '&':
+            parser->stream_kind = GDBWIRE_MI_LOG;
+            break;
+        default:
+            return;
+    }
+
+    /* The buffer holds no newline, so all of it belongs to the record */
+    parser->stream_state = GDBWIRE_MI_STREAM_CSTRING;
+    gdbwire_mi_parser_stream(parser, data + 2, size - 2);
+    gdbwire_string_clear(parser->buffer);
+    parser->scan_pos = 0;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_push_data(struct gdbwire_mi_parser *parser, const char *data,
+    size_t size)
+{
+    enum gdbwire_result result = GDBWIRE_OK, pipeline_result = GDBWIRE_OK;
+    struct gdbwire_mi_parser_stats stats;
+    int has_newline = 0;
+    size_t index;
+
+    GDBWIRE_ASSERT(parser && data);
+
+    /* Report the error the second stage hit since the last push */
+    if (parser->pipeline) {
+        pipeline_result = (enum gdbwire_result)gdbwire_atomic_exchange(
+            &parser->pipeline->result, (int)GDBWIRE_OK);
+    }
+
+    if (parser->timestamps) {
+        parser->push_time = gdbwire_monotonic_ns();
+    }
+
+    /* Deliver the stream record being streamed, up to its newline */
+    if (parser->stream_state != GDBWIRE_MI_STREAM_NONE) {
+        index = gdbwire_mi_parser_stream(parser, data, size);
+        data += index;
+        size -= index;
+    }
+
+    if (size == 0) {
+        /* All of the data belonged to the stream record */
+    } else if (parser->limits.hard_limit > 0 || parser->oversized) {
+        result = gdbwire_mi_parser_push_data_limited(parser, data, size);
+    } else {
+        /**
+         * No need to parse an MI command until a newline occurs.
+         *
+         * A gdb/mi command may be a very long line. For this reason, it is
+         * better to check the data passed into this function once for a
+         * newline rather than checking all the data every time this
+         * function is called. This optimizes the case where this function
+         * is called one character at a time.
+         */
+        for (index = size; index > 0; --index) {
+            if (data[index-1] == '\n' || data[index-1] == '\r') {
+                has_newline = 1;
+                break;
+            }
+        }
+
+        GDBWIRE_ASSERT(gdbwire_string_append_data(parser->buffer,
+            data, size) == 0);
+
+        if (has_newline) {
+            result = gdbwire_mi_parser_parse_lines(parser);
+        } else {
+            /* The data pushed in has no newline, no need to search again */
+            parser->scan_pos = gdbwire_string_size(parser->buffer);
+        }
+    }
+
+    if (result == GDBWIRE_OK &&
+            parser->stream_state == GDBWIRE_MI_STREAM_NONE) {
+        gdbwire_mi_parser_start_stream(parser);
+    }
+
+    /* The partial line left in the buffer began in this push or before */
+    if (gdbwire_string_size(parser->buffer) == 0) {
+        parser->line_time = 0;
+    } else if (parser->line_time == 0) {
+        parser->line_time = parser->push_time;
+    }
+
+    /* Give back the memory held for reuse when over the soft limit */
+    gdbwire_mi_parser_get_stats(parser, &stats);
+    if (parser->limits.soft_limit > 0 &&
+            stats.total_bytes > parser->limits.soft_limit) {
+        parser->stats.soft_limit_exceeded++;
+        if (parser->cache) {
+            gdbwire_mi_cache_clear(parser->cache);
+        }
+        gdbwire_mi_arena_pool_trim(parser->pool);
+        gdbwire_string_shrink(parser->buffer);
+        gdbwire_mi_parser_get_stats(parser, &stats);
+    }
+    if (stats.total_bytes > parser->stats.peak_bytes) {
+        parser->stats.peak_bytes = stats.total_bytes;
+    }
+
+    return (result == GDBWIRE_OK) ? pipeline_result : result;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_reset(struct gdbwire_mi_parser *parser)
+{
+    GDBWIRE_ASSERT(parser);
+
+    gdbwire_string_clear(parser->buffer);
+    parser->scan_pos = 0;
+    parser->oversized = 0;
+    parser->oversized_size = 0;
+    parser->stream_state = GDBWIRE_MI_STREAM_NONE;
+    parser->line_time = 0;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_set_limits(struct gdbwire_mi_parser *parser,
+    struct gdbwire_mi_parser_limits limits)
+{
+    GDBWIRE_ASSERT(parser);
+    GDBWIRE_ASSERT(limits.action == GDBWIRE_MI_LIMIT_TRUNCATE ||
+        limits.action == GDBWIRE_MI_LIMIT_SKIP);
+
+    /**
+     * The limits trim the arena pool, which belongs to the second stage
+     * of a pipelined parser, and the oversized line callback is not
+     * ordered with the outputs it builds.
+     */
+    if (parser->pipeline &&
+            (limits.hard_limit > 0 || limits.soft_limit > 0)) {
+        return GDBWIRE_LOGIC;
+    }
+
+    parser->limits = limits;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_set_oversized_line_callback(
+    struct gdbwire_mi_parser *parser,
+    gdbwire_mi_oversized_line_fn callback, void *context)
+{
+    GDBWIRE_ASSERT(parser);
+
+    parser->oversized_line_callback = callback;
+    parser->oversized_line_context = context;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_set_stream_threshold(struct gdbwire_mi_parser *parser,
+    size_t threshold)
+{
+    GDBWIRE_ASSERT(parser);
+
+    /* The stream chunks would not be ordered with the pipelined outputs */
+    if (parser->pipeline && threshold > 0) {
+        return GDBWIRE_LOGIC;
+    }
+
+    parser->stream_threshold = threshold;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_set_stream_chunk_callback(
+    struct gdbwire_mi_parser *parser,
+    gdbwire_mi_stream_chunk_fn callback, void *context)
+{
+    GDBWIRE_ASSERT(parser);
+
+    parser->stream_chunk_callback = callback;
+    parser->stream_chunk_context = context;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_set_timestamps(struct gdbwire_mi_parser *parser,
+    int enabled)
+{
+    GDBWIRE_ASSERT(parser);
+
+    parser->timestamps = enabled;
+    parser->line_time = 0;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_set_pipelined(struct gdbwire_mi_parser *parser,
+    int enabled)
+{
+    struct gdbwire_mi_pipeline *pipeline;
+
+    GDBWIRE_ASSERT(parser);
+
+    if (!enabled) {
+        return gdbwire_mi_parser_stop_pipeline(parser);
+    }
+
+    if (parser->pipeline) {
+        return GDBWIRE_OK;
+    }
+
+    /* See gdbwire_mi_parser_set_limits and set_stream_threshold */
+    if (parser->limits.hard_limit > 0 || parser->limits.soft_limit > 0 ||
+            parser->stream_threshold > 0 || parser->oversized ||
+            parser->stream_state != GDBWIRE_MI_STREAM_NONE) {
+        return GDBWIRE_LOGIC;
+    }
+
+    pipeline = (struct gdbwire_mi_pipeline *)gdbwire_calloc(
+        &parser->allocator, 1, sizeof(struct gdbwire_mi_pipeline));
+    GDBWIRE_ASSERT(pipeline);
+
+    gdbwire_mi_arena_pool_get_bytes(parser->pool, &pipeline->tree_bytes,
+        &pipeline->cache_bytes);
+    if (parser->cache) {
+        gdbwire_mi_cache_get_stats(parser->cache, &pipeline->cache_hits,
+            &pipeline->cache_misses);
+    }
+
+    if (pthread_mutex_init(&pipeline->mutex, NULL) != 0) {
+        gdbwire_free(&parser->allocator, pipeline);
+        return GDBWIRE_LOGIC;
+    }
+    if (pthread_cond_init(&pipeline->cond, NULL) != 0) {
+        pthread_mutex_destroy(&pipeline->mutex);
+        gdbwire_free(&parser->allocator, pipeline);
+        return GDBWIRE_LOGIC;
+    }
+    if (pthread_cond_init(&pipeline->full_cond, NULL) != 0) {
+        pthread_cond_destroy(&pipeline->cond);
+        pthread_mutex_destroy(&pipeline->mutex);
+        gdbwire_free(&parser->allocator, pipeline);
+        return GDBWIRE_LOGIC;
+    }
+
+    parser->pipeline = pipeline;
+    if (pthread_create(&pipeline->thread, NULL,
+            gdbwire_mi_parser_run_pipeline, parser) != 0) {
+        parser->pipeline = NULL;
+        pthread_cond_destroy(&pipeline->full_cond);
+        pthread_cond_destroy(&pipeline->cond);
+        pthread_mutex_destroy(&pipeline->mutex);
+        gdbwire_free(&parser->allocator, pipeline);
+        return GDBWIRE_LOGIC;
+    }
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_set_cache(struct gdbwire_mi_parser *parser,
+    size_t capacity)
+{
+    size_t hits, misses;
+
+    GDBWIRE_ASSERT(parser);
+
+    /* The cache belongs to the second stage of a pipelined parser */
+    if (parser->pipeline) {
+        return GDBWIRE_LOGIC;
+    }
+
+    /* Keep counting the hits and misses of the cache being replaced */
+    if (parser->cache) {
+        gdbwire_mi_cache_get_stats(parser->cache, &hits, &misses);
+        parser->stats.cache_hits += hits;
+        parser->stats.cache_misses += misses;
+        gdbwire_mi_cache_destroy(parser->cache);
+        parser->cache = NULL;
+    }
+
+    if (capacity > 0) {
+        parser->cache = gdbwire_mi_cache_create(capacity, &parser->allocator);
+        GDBWIRE_ASSERT(parser->cache);
+    }
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_set_hashes(struct gdbwire_mi_parser *parser,
+    int enabled)
+{
+    GDBWIRE_ASSERT(parser);
+
+    /* The trees are built by the second stage of a pipelined parser */
+    if (parser->pipeline) {
+        return GDBWIRE_LOGIC;
+    }
+
+    parser->hashes = enabled;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mi_parser_get_stats(struct gdbwire_mi_parser *parser,
+    struct gdbwire_mi_parser_stats *stats)
+{
+    size_t hits = 0, misses = 0;
+
+    GDBWIRE_ASSERT(parser && stats);
+
+    *stats = parser->stats;
+    stats->buffer_bytes = gdbwire_string_capacity(parser->buffer) +
+        parser->mils_extra.bytes;
+    if (parser->pipeline) {
+        stats->tree_bytes = gdbwire_atomic_load(&parser->pipeline->tree_bytes);
+        stats->cache_bytes =
+            gdbwire_atomic_load(&parser->pipeline->cache_bytes);
+        hits = gdbwire_atomic_load(&parser->pipeline->cache_hits);
+        misses = gdbwire_atomic_load(&parser->pipeline->cache_misses);
+    } else {
+        gdbwire_mi_arena_pool_get_bytes(parser->pool, &stats->tree_bytes,
+            &stats->cache_bytes);
+        if (parser->cache) {
+            gdbwire_mi_cache_get_stats(parser->cache, &hits, &misses);
+        }
+    }
+    stats->cache_hits += hits;
+    stats->cache_misses += misses;
+    stats->total_bytes = stats->buffer_bytes + stats->tree_bytes +
+        stats->cache_bytes;
+
+    return GDBWIRE_OK;
+}
@@ -5,12 +5,137 @@
 extern "C" { 
 #endif 
 
+#include "gdbwire_allocator.h"
 #include "gdbwire_result.h"
 #include "gdbwire_mi_pt.h"
 
 /* The opaque GDB/MI parser context */
 struct gdbwire_mi_parser;
 
+/**
+ * What the parser does with a line that does not fit in the hard limit.
+ */
+enum gdbwire_mi_parser_limit_action {
+    /**
+     * Parse the start of the line that fits and discard the rest.
+     *
+     * If the line is a stream record, the truncated c-string is closed
+     * so that the record still parses.
+     */
+    GDBWIRE_MI_LIMIT_TRUNCATE,
+
+    /* Discard the entire line */
+    GDBWIRE_MI_LIMIT_SKIP
+};
+
+/**
+ * The memory limits of a GDB/MI parser.
+ *
+ * The limits apply to the memory reported in gdbwire_mi_parser_stats
+ * total_bytes. A limit of 0 means no limit.
+ */
+struct gdbwire_mi_parser_limits {
+    /**
+     * The memory the parser should try to stay below.
+     *
+     * When it is exceeded, the parser frees the memory it holds for reuse
+     * and shrinks its input buffer. Exceeding it is otherwise harmless.
+     */
+    size_t soft_limit;
+
+    /**
+     * The memory the parser's input may not grow past.
+     *
+     * When buffering the rest of a line would exceed the hard limit,
+     * the line is handled according to the action below and reported
+     * to the callback set with
+     * gdbwire_mi_parser_set_oversized_line_callback.
+     *
+     * The parse trees that have not been freed count towards the limit,
+     * leaving less room to buffer input. Building the parse tree of a
+     * line may still take the parser past the limit until it is freed.
+     */
+    size_t hard_limit;
+
+    /* What to do with a line that does not fit in the hard limit */
+    enum gdbwire_mi_parser_limit_action action;
+};
+
+/**
+ * Handle a line that did not fit in the parser's hard memory limit.
+ *
+ * See gdbwire_mi_parser_set_oversized_line_callback.
+ *
+ * @param context
+ * The context given along with the callback.
+ *
+ * @param action
+ * What the parser did with the line.
+ *
+ * @param size
+ * The size of the line in bytes, not including the newline.
+ */
+typedef void (*gdbwire_mi_oversized_line_fn)(void *context,
+        enum gdbwire_mi_parser_limit_action action, size_t size);
+
+/**
+ * Handle a chunk of a large stream record.
+ *
+ * See gdbwire_mi_parser_set_stream_chunk_callback. The chunks of a
+ * stream record are delivered in order as the record arrives, the
+ * record is not delivered with the gdbwire_mi_output_callback.
+ *
+ * @param context
+ * The context given along with the callback.
+ *
+ * @param kind
+ * The kind of the stream record.
+ *
+ * @param data
+ * The next chunk of the stream record's c-string with the escaping
+ * undone. The data is not NUL terminated and is only valid during
+ * the callback.
+ *
+ * @param size
+ * The number of bytes in data, which may be 0 for the last chunk.
+ *
+ * @param last
+ * 1 if this is the last chunk of the stream record, 0 otherwise.
+ */
+typedef void (*gdbwire_mi_stream_chunk_fn)(void *context,
+        enum gdbwire_mi_stream_record_kind kind, const char *data,
+        size_t size, int last);
+
+/**
+ * Statistics about a GDB/MI parser.
+ */
+struct gdbwire_mi_parser_stats {
+    /* The bytes allocated for the input buffer and the lexer */
+    size_t buffer_bytes;
+    /* The bytes allocated for parse trees that have not been freed yet */
+    size_t tree_bytes;
+    /* The bytes held for reuse by future parse trees */
+    size_t cache_bytes;
+    /* The sum of the bytes above */
+    size_t total_bytes;
+    /* The most total_bytes seen at the end of a push */
+    size_t peak_bytes;
+
+    /* The number of lines parsed */
+    size_t lines;
+    /* The number of lines truncated because of the hard limit */
+    size_t lines_truncated;
+    /* The number of lines skipped because of the hard limit */
+    size_t lines_skipped;
+    /* The number of stream records delivered in chunks */
+    size_t lines_streamed;
+    /* The number of times the soft limit was exceeded */
+    size_t soft_limit_exceeded;
+    /* The number of lines found and not found in the line cache */
+    size_t cache_hits;
+    size_t cache_misses;
+};
+
 /**
  * The primary mechanism to alert users of GDB/MI notifications.
  *
@@ -56,6 +181,27 @@ struct gdbwire_mi_parser_callbacks {
 struct gdbwire_mi_parser *gdbwire_mi_parser_create(
         struct gdbwire_mi_parser_callbacks callbacks);
 
+/**
+ * Create a GDB/MI parser context that allocates with the given allocator.
+ *
+ * The parser, its buffers and every parse tree it creates are allocated
+ * with the allocator. The parse trees must be freed, with
+ * gdbwire_mi_output_free, before the allocator goes away.
+ *
+ * @param callbacks
+ * The callback functions to invoke upon discovery of parse data.
+ *
+ * @param allocator
+ * The allocator to copy and allocate with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new GDB/MI parser instance or NULL on error.
+ */
+struct gdbwire_mi_parser *gdbwire_mi_parser_create_with_allocator(
+        struct gdbwire_mi_parser_callbacks callbacks,
+        const struct gdbwire_allocator *allocator);
+
 /**
  * Destroy a gdbwire_mi_parser context.
  *
@@ -105,6 +251,251 @@ enum gdbwire_result gdbwire_mi_parser_push(struct gdbwire_mi_parser *parser,
 enum gdbwire_result gdbwire_mi_parser_push_data(
         struct gdbwire_mi_parser *parser, const char *data, size_t size);
 
+/**
+ * Discard the data pushed into the parser that has not been parsed yet.
+ *
+ * This returns the parser to the state it was created in, ready to
+ * parse unrelated GDB/MI output, while keeping the memory it allocated
+ * for reuse. The limits, stream threshold and statistics are kept.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_parser_reset(struct gdbwire_mi_parser *parser);
+
+/**
+ * Set the memory limits of the parser.
+ *
+ * The parser has no memory limits until this function is called.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param limits
+ * The limits to set.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the parser is pipelined and a limit is not 0.
+ */
+enum gdbwire_result gdbwire_mi_parser_set_limits(
+        struct gdbwire_mi_parser *parser,
+        struct gdbwire_mi_parser_limits limits);
+
+/**
+ * Set the function to call with each line that did not fit in the
+ * hard memory limit.
+ *
+ * The parser has no such callback until this function is called.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param callback
+ * The function to call, or NULL for none.
+ *
+ * @param context
+ * An arbitrary pointer passed to the callback.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_parser_set_oversized_line_callback(
+        struct gdbwire_mi_parser *parser,
+        gdbwire_mi_oversized_line_fn callback, void *context);
+
+/**
+ * Set the size at which stream records are delivered in chunks.
+ *
+ * Normally a stream record is buffered until its newline arrives and
+ * is then delivered whole. A console record can be many megabytes,
+ * for instance when printing a large structure. Once the buffered
+ * part of a stream record reaches the threshold, the parser instead
+ * delivers the record through the stream chunk callback
+ * as its data arrives, without buffering it.
+ *
+ * A record that arrives whole in a single push is delivered whole.
+ * The threshold should be below the hard limit, a record that reaches
+ * the hard limit first is handled as an oversized line.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param threshold
+ * The number of buffered bytes at which to start delivering a stream
+ * record in chunks, or 0 to always deliver stream records whole.
+ * Streaming also requires a callback set with
+ * gdbwire_mi_parser_set_stream_chunk_callback.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the parser is pipelined and threshold is not 0.
+ */
+enum gdbwire_result gdbwire_mi_parser_set_stream_threshold(
+        struct gdbwire_mi_parser *parser, size_t threshold);
+
+/**
+ * Set the function to call with the chunks of large stream records.
+ *
+ * The parser has no such callback until this function is called, and
+ * delivers every stream record whole. See
+ * gdbwire_mi_parser_set_stream_threshold.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param callback
+ * The function to call, or NULL for none.
+ *
+ * @param context
+ * An arbitrary pointer passed to the callback.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_parser_set_stream_chunk_callback(
+        struct gdbwire_mi_parser *parser,
+        gdbwire_mi_stream_chunk_fn callback, void *context);
+
+/**
+ * Set whether the parser takes the timestamps of each line.
+ *
+ * When enabled, each output's timestamps, see
+ * gdbwire_mi_output_get_timestamps, record when the first byte and the
+ * newline of its line were pushed, and when it was handed to the
+ * output callback. Taking them costs a read of the clock for each
+ * push and each line.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param enabled
+ * 1 to take the timestamps or 0 to leave them at 0, the default.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_parser_set_timestamps(
+        struct gdbwire_mi_parser *parser, int enabled);
+
+/**
+ * Set whether the parser splits its work across two threads.
+ *
+ * A single thread may not keep up with a very high volume of output,
+ * like tracing a whole program with dprintf. When pipelined, the
+ * thread pushing data into the parser only splits it into lines and
+ * lexes them. A thread started by the parser builds the parse trees
+ * from the tokens and invokes the output callback, in the order of
+ * the lines.
+ *
+ * While pipelined,
+ * - the output callback is invoked on the parser's thread, after the
+ *   push of the line returned.
+ * - the allocator of the parser must be safe to use from both threads.
+ * - a push waits while the lines lexed ahead fill the queue between
+ *   the threads.
+ * - an error building a line is returned by the next push, or when
+ *   the pipeline is stopped.
+ * - the tree and cache bytes of the statistics are as of the last
+ *   line built.
+ * - memory limits and stream thresholds can not be set, their
+ *   callbacks would not be ordered with the outputs.
+ *
+ * Stopping the pipeline waits for the lines already lexed to be built
+ * and their callbacks to return. Destroying the parser stops it too.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param enabled
+ * 1 to pipeline the parser or 0 to stop the pipeline, the default.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if memory limits or a stream threshold are set.
+ * When stopping, the error of a line built since the last push.
+ */
+enum gdbwire_result gdbwire_mi_parser_set_pipelined(
+        struct gdbwire_mi_parser *parser, int enabled);
+
+/**
+ * Set the number of lines whose parse trees the parser remembers.
+ *
+ * GDB repeats many short lines word for word, like "^done", "(gdb)"
+ * and "*running,thread-id=\"all\"". With a line cache, a line that
+ * was parsed recently is not lexed and parsed again. Its output shares
+ * the parse tree of the earlier line instead.
+ *
+ * Only lines of up to 256 bytes, including the newline, are cached.
+ * When the cache is full, the line to forget is chosen with the
+ * clock algorithm, an approximation of least recently used.
+ *
+ * Each output still has its own gdbwire_mi_output, freed as usual, but
+ * the records and results it references may be shared with other
+ * outputs. The parse trees must not be modified. The cached trees
+ * count as tree bytes, and are forgotten to stay within the memory
+ * limits. The hits and misses are counted in the statistics.
+ *
+ * While pipelined, the cache is used by the thread building the parse
+ * trees, so the lines are still lexed.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param capacity
+ * The number of lines to remember, or 0 for no cache, the default.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the parser is pipelined.
+ */
+enum gdbwire_result gdbwire_mi_parser_set_cache(
+        struct gdbwire_mi_parser *parser, size_t capacity);
+
+/**
+ * Set whether the parser caches the hash of each result it parses.
+ *
+ * When enabled, gdbwire_mi_result_cache_hashes is called on the results
+ * of each output before it is handed to the output callback. Then
+ * gdbwire_mi_result_hash takes constant time for each result of a list,
+ * and gdbwire_mi_result_equal tells different results apart without
+ * walking them, at the cost of hashing every tree once.
+ *
+ * With a line cache, the trees cached before the hashes were enabled
+ * are shared without hashes.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param enabled
+ * 1 to cache the hashes or 0 to leave them at 0, the default.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the parser is pipelined.
+ */
+enum gdbwire_result gdbwire_mi_parser_set_hashes(
+        struct gdbwire_mi_parser *parser, int enabled);
+
+/**
+ * Get the statistics of the parser.
+ *
+ * @param parser
+ * The gdbwire_mi parser context to operate on.
+ *
+ * @param stats
+ * Set to the statistics of the parser on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_parser_get_stats(
+        struct gdbwire_mi_parser *parser,
+        struct gdbwire_mi_parser_stats *stats);
+
 #ifdef __cplusplus 
 }
 #endif 
@@ -1,7 +1,35 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "gdbwire_mi_pt.h"
+#include "gdbwire_string.h"
+
+/**
+ * The names of the result classes, by gdbwire_mi_result_class.
+ *
+ * Keep these in the order of the enumeration, and the same as the
+ * names the grammar recognizes.
+ */
+static const char *const gdbwire_mi_result_class_names[] = {
+    "done", "running", "connected", "error", "exit", "unsupported"
+};
+
+/**
+ * The names of the asynchronous classes, by gdbwire_mi_async_class.
+ *
+ * Keep these in the order of the enumeration, and the same as the
+ * names the grammar recognizes.
+ */
+static const char *const gdbwire_mi_async_class_names[] = {
+    "download", "stopped", "running", "thread-group-added",
+    "thread-group-removed", "thread-group-started", "thread-group-exited",
+    "thread-created", "thread-exited", "thread-selected", "library-loaded",
+    "library-unloaded", "traceframe-changed", "tsv-created", "tsv-modified",
+    "tsv-deleted", "breakpoint-created", "breakpoint-modified",
+    "breakpoint-deleted", "record-started", "record-stopped",
+    "cmd-param-changed", "memory-changed", "unsupported"
+};
 
 struct gdbwire_mi_output *
 append_gdbwire_mi_output(struct gdbwire_mi_output *list,
@@ -44,3 +72,168 @@ append_gdbwire_mi_result(struct gdbwire_mi_result *list,
 
     return list;
 }
+
+/**
+ * Add a string, which may be NULL, to an FNV-1a hash.
+ *
+ * The string is added with its NUL and after a marker byte, so that
+ * the strings hashed one after another can not run into each other
+ * and NULL differs from the empty string.
+ *
+ * @param hash
+ * The hash so far.
+ *
+ * @param str
+ * The string to add or NULL.
+ *
+ * @return
+ * The new hash.
+ */
+static uint64_t
+gdbwire_mi_hash_string(uint64_t hash, const char *str)
+{
+    unsigned char marker = (str) ? 1 : 0;
+
+    hash = gdbwire_fnv1a(hash, &marker, 1);
+    if (str) {
+        hash = gdbwire_fnv1a(hash, str, strlen(str) + 1);
+    }
+
+    return hash;
+}
+
+/**
+ * Compute the hash of a result and its subtree, without the results
+ * after it.
+ *
+ * The hashes cached in the results it contains are used as is.
+ *
+ * @param result
+ * The result to hash.
+ *
+ * @return
+ * The hash, never 0 so that 0 can mean not computed.
+ */
+static uint64_t
+gdbwire_mi_result_node_hash(const struct gdbwire_mi_result *result)
+{
+    const struct gdbwire_mi_result *child;
+    uint64_t hash = GDBWIRE_FNV1A_BASIS, child_hash;
+    unsigned char kind = (unsigned char)result->kind;
+
+    hash = gdbwire_fnv1a(hash, &kind, 1);
+    hash = gdbwire_mi_hash_string(hash, result->variable);
+
+    if (result->kind == GDBWIRE_MI_CSTRING) {
+        hash = gdbwire_mi_hash_string(hash, result->variant.cstring);
+    } else {
+        for (child = result->variant.result; child; child = child->next) {
+            child_hash = (child->hash) ? child->hash :
+                gdbwire_mi_result_node_hash(child);
+            hash = gdbwire_fnv1a(hash, &child_hash, sizeof (child_hash));
+        }
+    }
+
+    return (hash) ? hash : 1;
+}
+
+uint64_t
+gdbwire_mi_result_hash(const struct gdbwire_mi_result *result)
+{
+    uint64_t hash = GDBWIRE_FNV1A_BASIS, node_hash;
+
+    for (; result; result = result->next) {
+        node_hash = (result->hash) ? result->hash :
+            gdbwire_mi_result_node_hash(result);
+        hash = gdbwire_fnv1a(hash, &node_hash, sizeof (node_hash));
+    }
+
+    return hash;
+}
+
+/**
+ * Determine if two strings, which may be NULL, are equal.
+ *
+ * @param lhs
+ * One string or NULL.
+ *
+ * @param rhs
+ * The other string or NULL.
+ *
+ * @return
+ * 1 if both are NULL or both have the same characters, otherwise 0.
+ */
+static int
+gdbwire_mi_string_equal(const char *lhs, const char *rhs)
+{
+    if (!lhs || !rhs) {
+        return lhs == rhs;
+    }
+    return strcmp(lhs, rhs) == 0;
+}
+
+int
+gdbwire_mi_result_equal(const struct gdbwire_mi_result *lhs,
+    const struct gdbwire_mi_result *rhs)
+{
+    for (; lhs && rhs; lhs = lhs->next, rhs = rhs->next) {
+        /* The rest of a shared list is equal to itself */
+        if (lhs == rhs) {
+            return 1;
+        }
+
+        if (lhs->hash && rhs->hash && lhs->hash != rhs->hash) {
+            return 0;
+        }
+
+        if (lhs->kind != rhs->kind ||
+                !gdbwire_mi_string_equal(lhs->variable, rhs->variable)) {
+            return 0;
+        }
+
+        if (lhs->kind == GDBWIRE_MI_CSTRING) {
+            if (!gdbwire_mi_string_equal(lhs->variant.cstring,
+                    rhs->variant.cstring)) {
+                return 0;
+            }
+        } else if (!gdbwire_mi_result_equal(lhs->variant.result,
+                rhs->variant.result)) {
+            return 0;
+        }
+    }
+
+    return lhs == rhs;
+}
+
+void
+gdbwire_mi_result_cache_hashes(struct gdbwire_mi_result *result)
+{
+    for (; result; result = result->next) {
+        if (result->kind != GDBWIRE_MI_CSTRING) {
+            gdbwire_mi_result_cache_hashes(result->variant.result);
+        }
+        result->hash = gdbwire_mi_result_node_hash(result);
+    }
+}
+
+const char *
+gdbwire_mi_result_class_name(enum gdbwire_mi_result_class result_class)
+{
+    if ((size_t)result_class >= sizeof (gdbwire_mi_result_class_names) /
+            sizeof (gdbwire_mi_result_class_names[0])) {
+        return NULL;
+    }
+
+    return gdbwire_mi_result_class_names[result_class];
+}
+
+const char *
+gdbwire_mi_async_class_name(enum gdbwire_mi_async_class async_class)
+{
+    if ((size_t)async_class >= sizeof (gdbwire_mi_async_class_names) /
+            sizeof (gdbwire_mi_async_class_names[0])) {
+        return NULL;
+    }
+
+    return gdbwire_mi_async_class_names[async_class];
+}
@@ -5,6 +5,12 @@
 extern "C" { 
 #endif 
 
+#include <stddef.h>
+#include <stdint.h>
+
+/* The memory a parse tree is allocated from, private to gdbwire. */
+struct gdbwire_mi_arena;
+
 /**
  * The position of a token in a GDB/MI line.
  *
@@ -56,6 +62,22 @@ enum gdbwire_mi_output_kind {
     GDBWIRE_MI_OUTPUT_PARSE_ERROR
 };
 
+/**
+ * When a GDB/MI output command's line arrived and was handed out.
+ *
+ * The times are in nanoseconds of gdbwire_monotonic_ns. They are only
+ * taken when enabled with gdbwire_mi_parser_set_timestamps, otherwise
+ * they are all 0.
+ */
+struct gdbwire_mi_timestamps {
+    /** When the data with the first byte of the line was pushed. */
+    uint64_t first_byte;
+    /** When the data with the newline of the line was pushed. */
+    uint64_t newline;
+    /** When the line was parsed and its output callback was called. */
+    uint64_t dispatch;
+};
+
 /**
  * The GDB/MI output command.
  *
@@ -92,6 +114,21 @@ struct gdbwire_mi_output {
 
     /** The next GDB/MI output command or NULL if none */
     struct gdbwire_mi_output *next;
+
+    /**
+     * The memory this output and its entire parse tree were allocated from.
+     *
+     * This is private to gdbwire. The parse tree is released as a whole
+     * with gdbwire_mi_output_free.
+     */
+    struct gdbwire_mi_arena *arena;
+
+    /**
+     * When the line arrived and was handed out.
+     *
+     * This is private to gdbwire, use gdbwire_mi_output_get_timestamps.
+     */
+    struct gdbwire_mi_timestamps timestamps;
 };
 
 /**
@@ -637,6 +674,15 @@ struct gdbwire_mi_result {
 
     /** The next result or NULL if none */
     struct gdbwire_mi_result *next;
+
+    /**
+     * The hash of this result and the results it contains, or 0.
+     *
+     * Only set by gdbwire_mi_result_cache_hashes, which the parser calls
+     * when gdbwire_mi_parser_set_hashes is enabled. The results after
+     * this one are not part of the hash.
+     */
+    uint64_t hash;
 };
 
 /**
@@ -652,8 +698,207 @@ struct gdbwire_mi_stream_record {
     char *cstring;
 };
 
+/**
+ * Free a GDB/MI output command and its parse tree.
+ *
+ * The outputs linked through the next field are freed as well.
+ *
+ * This drops the reference the output callback handed out. An output
+ * retained with gdbwire_mi_output_retain is freed once the last of its
+ * references is dropped. This may be called on any thread, the memory
+ * is handed back to the parser that created the output.
+ *
+ * @param param
+ * The output command to free, OK to pass in NULL.
+ */
 void gdbwire_mi_output_free(struct gdbwire_mi_output *param);
 
+/**
+ * Share a GDB/MI output command with another consumer.
+ *
+ * Each output comes with a single reference, owned by the receiver of
+ * the output callback. Retaining adds a reference that is dropped with
+ * gdbwire_mi_output_release, so several consumers, on any threads, can
+ * hold the same output and its parse tree without copying it.
+ *
+ * A shared output is immutable, it is only read through the const
+ * pointer. Only this output is retained, not the outputs linked after
+ * it. Its next field belongs to the list it was linked into by the
+ * original receiver and should not be followed by the other holders.
+ *
+ * @param output
+ * The output to retain, OK to pass in NULL.
+ *
+ * @return
+ * The output.
+ */
+const struct gdbwire_mi_output *gdbwire_mi_output_retain(
+        const struct gdbwire_mi_output *output);
+
+/**
+ * Drop a reference to a GDB/MI output command.
+ *
+ * The output and its parse tree are freed with the last reference.
+ * Like gdbwire_mi_output_free, this may be called on any thread.
+ * The memory is handed back to the parser that created the output,
+ * which reuses it for the lines it parses next.
+ *
+ * @param output
+ * The output to release, OK to pass in NULL.
+ */
+void gdbwire_mi_output_release(const struct gdbwire_mi_output *output);
+
+/**
+ * Get when a GDB/MI output command's line arrived and was handed out.
+ *
+ * See gdbwire_mi_parser_set_timestamps.
+ *
+ * @param output
+ * The output to get the timestamps of, OK to pass in NULL.
+ *
+ * @return
+ * The timestamps of the output, valid as long as the output is,
+ * or NULL if output is NULL.
+ */
+const struct gdbwire_mi_timestamps *gdbwire_mi_output_get_timestamps(
+        const struct gdbwire_mi_output *output);
+
+/**
+ * Copy a GDB/MI output command and its parse tree.
+ *
+ * The copy is made in a single contiguous allocation that is
+ * independent of the parser and of the original output. When the
+ * original's parse tree is already contiguous, as it is for most lines
+ * straight from the parser, it is copied with a single memcpy and its
+ * pointers are moved over to the copy. Otherwise the tree is copied
+ * object by object.
+ *
+ * Only this output is copied, not the outputs linked after it, so the
+ * next field of the copy is NULL. The copy is freed like any other
+ * output, with gdbwire_mi_output_free or gdbwire_mi_output_release.
+ *
+ * @param output
+ * The output to copy, OK to pass in NULL.
+ *
+ * @return
+ * The copy or NULL if output is NULL or out of memory.
+ */
+struct gdbwire_mi_output *gdbwire_mi_output_clone(
+        const struct gdbwire_mi_output *output);
+
+/**
+ * Copy a GDB/MI output command and its parse tree into a buffer.
+ *
+ * This is gdbwire_mi_output_clone into memory the caller provides, such
+ * as shared memory or a buffer that is reused from record to record.
+ * The copy holds no memory of its own and refers to nothing outside of
+ * the buffer. It stays valid as long as the buffer does not change.
+ * gdbwire_mi_output_free, gdbwire_mi_output_retain and
+ * gdbwire_mi_output_release do nothing for the copy.
+ *
+ * @param output
+ * The output to copy, OK to pass in NULL.
+ *
+ * @param buffer
+ * The buffer to copy into, aligned like memory from malloc.
+ *
+ * @param size
+ * The number of bytes in buffer.
+ *
+ * @param needed
+ * If not NULL, set to the number of bytes the copy needs.
+ *
+ * @return
+ * The copy, which lies within buffer, or NULL if output is NULL
+ * or buffer is too small.
+ */
+struct gdbwire_mi_output *gdbwire_mi_output_clone_into(
+        const struct gdbwire_mi_output *output, void *buffer, size_t size,
+        size_t *needed);
+
+/**
+ * Compute the structural hash of a list of GDB/MI results.
+ *
+ * The hash covers the kind, variable and value of each result in the
+ * list and of every result they contain, in order. Equal lists have
+ * equal hashes. The hashes cached in the results are used as is, so
+ * unchanged subtrees are not walked again.
+ *
+ * @param result
+ * The first result of the list, OK to pass in NULL for an empty list.
+ *
+ * @return
+ * The hash of the list.
+ */
+uint64_t gdbwire_mi_result_hash(const struct gdbwire_mi_result *result);
+
+/**
+ * Determine if two lists of GDB/MI results are structurally equal.
+ *
+ * The lists are equal if each pair of results in them have the same
+ * kind, variable and value, comparing tuples and lists recursively.
+ *
+ * A subtree shared by both lists is equal without being walked, and
+ * results with different cached hashes are unequal without being
+ * walked. Results with the same hash are still compared, as distinct
+ * trees may hash the same.
+ *
+ * @param lhs
+ * The first result of one list, OK to pass in NULL for an empty list.
+ *
+ * @param rhs
+ * The first result of the other list, OK to pass in NULL.
+ *
+ * @return
+ * 1 if the lists are equal, otherwise 0.
+ */
+int gdbwire_mi_result_equal(const struct gdbwire_mi_result *lhs,
+        const struct gdbwire_mi_result *rhs);
+
+/**
+ * Compute and cache the hash of each result in a list and its subtrees.
+ *
+ * After this, gdbwire_mi_result_hash takes constant time for each
+ * result in the list and gdbwire_mi_result_equal tells different
+ * results apart without walking them. The tree should not be modified
+ * afterwards, or the cached hashes will be stale.
+ *
+ * @param result
+ * The first result of the list, OK to pass in NULL.
+ */
+void gdbwire_mi_result_cache_hashes(struct gdbwire_mi_result *result);
+
+/**
+ * Get the name GDB gives a result class, like "done" for GDBWIRE_MI_DONE.
+ *
+ * These are the names the parser recognizes. Any other name is parsed
+ * as GDBWIRE_MI_UNSUPPORTED, which is named "unsupported".
+ *
+ * @param result_class
+ * The result class.
+ *
+ * @return
+ * The name, or NULL if result_class is not a result class.
+ */
+const char *gdbwire_mi_result_class_name(
+        enum gdbwire_mi_result_class result_class);
+
+/**
+ * Get the name GDB gives an asynchronous class, like "stopped" for
+ * GDBWIRE_MI_ASYNC_STOPPED.
+ *
+ * These are the names the parser recognizes. Any other name is parsed
+ * as GDBWIRE_MI_ASYNC_UNSUPPORTED, which is named "unsupported".
+ *
+ * @param async_class
+ * The asynchronous class.
+ *
+ * @return
+ * The name, or NULL if async_class is not an asynchronous class.
+ */
+const char *gdbwire_mi_async_class_name(
+        enum gdbwire_mi_async_class async_class);
+
 struct gdbwire_mi_output *append_gdbwire_mi_output(
         struct gdbwire_mi_output *list, struct gdbwire_mi_output *item);
 
@@ -1,171 +1,1065 @@
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "gdbwire_atomic.h"
 #include "gdbwire_mi_pt.h"
 #include "gdbwire_mi_pt_alloc.h"
 
-/* struct gdbwire_mi_output */
-struct gdbwire_mi_output *
-gdbwire_mi_output_alloc(void)
+/* Round size up to the alignment of every object stored in an arena */
+#define GDBWIRE_MI_ARENA_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+/* The size of the first block of a new arena */
+#define GDBWIRE_MI_ARENA_BLOCK_SIZE 2048
+
+/**
+ * The most memory an arena keeps when it is returned to the pool.
+ *
+ * An arena that grew larger than this, for a very large line, gives
+ * back all but its first block so that the pool does not pin the
+ * memory of the largest line ever seen.
+ */
+#define GDBWIRE_MI_ARENA_RETAIN_SIZE (64 * 1024)
+
+/* The most arenas a pool holds for reuse */
+#define GDBWIRE_MI_ARENA_POOL_SIZE 16
+
+/* A contiguous piece of memory in an arena, the data follows the header */
+struct gdbwire_mi_arena_block {
+    /* The next block in the arena or NULL if none */
+    struct gdbwire_mi_arena_block *next;
+    /* The number of bytes of data in this block */
+    size_t size;
+    /* The number of bytes of data handed out from this block */
+    size_t used;
+};
+
+struct gdbwire_mi_arena {
+    /* The pool this arena returns to on release or NULL if none */
+    struct gdbwire_mi_arena_pool *pool;
+    /* The next arena in the pool's free list */
+    struct gdbwire_mi_arena *next;
+    /* The first block, allocated along with the arena */
+    struct gdbwire_mi_arena_block *head;
+    /* The block allocations are currently made from */
+    struct gdbwire_mi_arena_block *current;
+    /* The number of bytes allocated for the arena and all of its blocks */
+    size_t size;
+    /* The references to the output the arena holds, accessed atomically */
+    int refcount;
+    /* The arena whose parse tree the output shares, or NULL if none */
+    struct gdbwire_mi_arena *shared;
+};
+
+struct gdbwire_mi_arena_pool {
+    /* The allocator the pool and its arenas are allocated with */
+    struct gdbwire_allocator allocator;
+    /* One for the pool owner plus one for each arena in use, atomically */
+    int refcount;
+    /**
+     * True after gdbwire_mi_arena_pool_destroy has been called.
+     * Only accessed atomically.
+     */
+    int destroyed;
+    /* The arenas available for reuse */
+    struct gdbwire_mi_arena *free_list;
+    /* The number of arenas in free_list */
+    int free_count;
+    /* The number of bytes allocated for all of the pool's arenas */
+    size_t bytes;
+    /* The number of bytes allocated for the arenas in free_list */
+    size_t free_bytes;
+    /**
+     * The arenas whose last reference was dropped with
+     * gdbwire_mi_output_free or gdbwire_mi_output_release, on any thread,
+     * and that have not been taken back into free_list yet. Only accessed
+     * atomically.
+     */
+    struct gdbwire_mi_arena *returned;
+};
+
+#define GDBWIRE_MI_ARENA_HEADER_SIZE \
+    GDBWIRE_MI_ARENA_ALIGN(sizeof(struct gdbwire_mi_arena))
+#define GDBWIRE_MI_ARENA_BLOCK_HEADER_SIZE \
+    GDBWIRE_MI_ARENA_ALIGN(sizeof(struct gdbwire_mi_arena_block))
+
+/* The data of a block */
+#define GDBWIRE_MI_ARENA_BLOCK_DATA(block) \
+    ((char *)(block) + GDBWIRE_MI_ARENA_BLOCK_HEADER_SIZE)
+
+/**
+ * Get the allocator an arena is allocated with.
+ *
+ * @param arena
+ * The arena to get the allocator of.
+ *
+ * @return
+ * The allocator or NULL for the default allocator.
+ */
+static const struct gdbwire_allocator *
+gdbwire_mi_arena_allocator(struct gdbwire_mi_arena *arena)
 {
-    return calloc(1, sizeof (struct gdbwire_mi_output));
+    return (arena->pool) ? &arena->pool->allocator : NULL;
 }
 
-void
-gdbwire_mi_output_free(struct gdbwire_mi_output *param)
+/**
+ * Account for memory allocated or freed for an arena.
+ *
+ * @param arena
+ * The arena the memory belongs to.
+ *
+ * @param size
+ * The number of bytes allocated or freed.
+ *
+ * @param allocated
+ * 1 if the memory was allocated, 0 if it was freed.
+ */
+static void
+gdbwire_mi_arena_account(struct gdbwire_mi_arena *arena, size_t size,
+        int allocated)
 {
-    if (param) {
-        switch (param->kind) {
-            case GDBWIRE_MI_OUTPUT_OOB:
-                gdbwire_mi_oob_record_free(param->variant.oob_record);
-                param->variant.oob_record = NULL;
-                break;
-            case GDBWIRE_MI_OUTPUT_RESULT:
-                gdbwire_mi_result_record_free(param->variant.result_record);
-                param->variant.result_record = NULL;
-                break;
-            case GDBWIRE_MI_OUTPUT_PROMPT:
-                break;
-            case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
-                free(param->variant.error.token);
-                param->variant.error.token = NULL;
-                break;
+    if (allocated) {
+        arena->size += size;
+        if (arena->pool) {
+            arena->pool->bytes += size;
+        }
+    } else {
+        arena->size -= size;
+        if (arena->pool) {
+            arena->pool->bytes -= size;
         }
+    }
+}
+
+/**
+ * Create an arena along with its first block.
+ *
+ * @param pool
+ * The pool the arena returns to on release or NULL if none.
+ *
+ * @param block_size
+ * The number of bytes of data in the first block.
+ *
+ * @return
+ * The new arena or NULL if out of memory.
+ */
+static struct gdbwire_mi_arena *
+gdbwire_mi_arena_create(struct gdbwire_mi_arena_pool *pool,
+        size_t block_size)
+{
+    struct gdbwire_mi_arena *arena;
+    size_t size = GDBWIRE_MI_ARENA_HEADER_SIZE +
+        GDBWIRE_MI_ARENA_BLOCK_HEADER_SIZE + block_size;
+
+    arena = gdbwire_malloc((pool) ? &pool->allocator : NULL, size);
+    if (arena) {
+        arena->pool = pool;
+        arena->next = NULL;
+        arena->head = (struct gdbwire_mi_arena_block *)
+            ((char *)arena + GDBWIRE_MI_ARENA_HEADER_SIZE);
+        arena->head->next = NULL;
+        arena->head->size = block_size;
+        arena->head->used = 0;
+        arena->current = arena->head;
+        arena->size = 0;
+        arena->shared = NULL;
+        gdbwire_mi_arena_account(arena, size, 1);
+    }
 
-        free(param->line);
-        param->line = 0;
+    return arena;
+}
 
-        gdbwire_mi_output_free(param->next);
-        param->next = NULL;
+/**
+ * Free the blocks following the first block of the arena.
+ *
+ * @param arena
+ * The arena to shrink.
+ */
+static void
+gdbwire_mi_arena_shrink(struct gdbwire_mi_arena *arena)
+{
+    const struct gdbwire_allocator *allocator =
+        gdbwire_mi_arena_allocator(arena);
+    struct gdbwire_mi_arena_block *tmp, *cur = arena->head->next;
 
-        free(param);
-        param = NULL;
+    while (cur) {
+        tmp = cur;
+        cur = cur->next;
+        gdbwire_mi_arena_account(arena,
+            GDBWIRE_MI_ARENA_BLOCK_HEADER_SIZE + tmp->size, 0);
+        gdbwire_free(allocator, tmp);
     }
+
+    arena->head->next = NULL;
 }
 
-/* struct gdbwire_mi_result_record */
-struct gdbwire_mi_result_record *
-gdbwire_mi_result_record_alloc(void)
+static void
+gdbwire_mi_arena_destroy(struct gdbwire_mi_arena *arena)
+{
+    gdbwire_mi_arena_shrink(arena);
+    gdbwire_mi_arena_account(arena, arena->size, 0);
+    gdbwire_free(gdbwire_mi_arena_allocator(arena), arena);
+}
+
+/**
+ * Reset the arena to empty, keeping its blocks for reuse.
+ *
+ * @param arena
+ * The arena to reset.
+ */
+static void
+gdbwire_mi_arena_reset(struct gdbwire_mi_arena *arena)
+{
+    struct gdbwire_mi_arena_block *cur;
+
+    if (arena->size > GDBWIRE_MI_ARENA_RETAIN_SIZE) {
+        gdbwire_mi_arena_shrink(arena);
+    }
+
+    for (cur = arena->head; cur; cur = cur->next) {
+        cur->used = 0;
+    }
+
+    arena->current = arena->head;
+}
+
+struct gdbwire_mi_arena_pool *
+gdbwire_mi_arena_pool_create(const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_mi_arena_pool *pool;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    pool = gdbwire_calloc(allocator, 1, sizeof (struct gdbwire_mi_arena_pool));
+    if (pool) {
+        pool->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
+        pool->refcount = 1;
+    }
+
+    return pool;
+}
+
+/**
+ * Add a reference to the pool.
+ *
+ * @param pool
+ * The pool to add a reference to.
+ */
+static void
+gdbwire_mi_arena_pool_ref(struct gdbwire_mi_arena_pool *pool)
+{
+    gdbwire_atomic_fetch_add(&pool->refcount, 1);
+}
+
+/**
+ * Drop a reference to the pool, freeing it when the last one is gone.
+ *
+ * @param pool
+ * The pool to drop a reference to.
+ */
+static void
+gdbwire_mi_arena_pool_unref(struct gdbwire_mi_arena_pool *pool)
+{
+    struct gdbwire_mi_arena *tmp, *cur;
+
+    if (gdbwire_atomic_fetch_add(&pool->refcount, -1) == 1) {
+        /* Copy the allocator out of the pool before freeing it */
+        struct gdbwire_allocator allocator = pool->allocator;
+
+        /* No one is left to take back the arenas returned last */
+        cur = gdbwire_atomic_exchange(&pool->returned,
+            (struct gdbwire_mi_arena *)NULL);
+        while (cur) {
+            tmp = cur;
+            cur = cur->next;
+            gdbwire_mi_arena_destroy(tmp);
+        }
+
+        gdbwire_free(&allocator, pool);
+    }
+}
+
+/**
+ * Keep a released arena in the pool for reuse, or free it.
+ *
+ * @param pool
+ * The pool the arena came from.
+ *
+ * @param arena
+ * The arena to keep or free.
+ */
+static void
+gdbwire_mi_arena_pool_keep(struct gdbwire_mi_arena_pool *pool,
+        struct gdbwire_mi_arena *arena)
+{
+    if (!gdbwire_atomic_load(&pool->destroyed) &&
+            pool->free_count < GDBWIRE_MI_ARENA_POOL_SIZE) {
+        gdbwire_mi_arena_reset(arena);
+        arena->next = pool->free_list;
+        pool->free_list = arena;
+        pool->free_count++;
+        pool->free_bytes += arena->size;
+    } else {
+        gdbwire_mi_arena_destroy(arena);
+    }
+}
+
+/**
+ * Take back the arenas returned to the pool from other threads.
+ *
+ * @param pool
+ * The pool to take the arenas back into.
+ */
+static void
+gdbwire_mi_arena_pool_reclaim(struct gdbwire_mi_arena_pool *pool)
+{
+    struct gdbwire_mi_arena *tmp, *cur;
+
+    if (!gdbwire_atomic_load(&pool->returned)) {
+        return;
+    }
+
+    cur = gdbwire_atomic_exchange(&pool->returned,
+        (struct gdbwire_mi_arena *)NULL);
+    while (cur) {
+        tmp = cur;
+        cur = cur->next;
+        gdbwire_mi_arena_pool_keep(pool, tmp);
+    }
+}
+
+void
+gdbwire_mi_arena_pool_destroy(struct gdbwire_mi_arena_pool *pool)
 {
-    return calloc(1, sizeof (struct gdbwire_mi_result_record));
+    if (pool) {
+        gdbwire_mi_arena_pool_trim(pool);
+        gdbwire_atomic_store(&pool->destroyed, 1);
+
+        gdbwire_mi_arena_pool_unref(pool);
+    }
 }
 
 void
-gdbwire_mi_result_record_free(struct gdbwire_mi_result_record *param)
+gdbwire_mi_arena_pool_trim(struct gdbwire_mi_arena_pool *pool)
 {
-    if (param) {
-        free(param->token);
+    struct gdbwire_mi_arena *tmp, *cur;
+
+    gdbwire_mi_arena_pool_reclaim(pool);
 
-        gdbwire_mi_result_free(param->result);
-        param->result = NULL;
+    cur = pool->free_list;
 
-        free(param);
-        param = NULL;
+    while (cur) {
+        tmp = cur;
+        cur = cur->next;
+        gdbwire_mi_arena_destroy(tmp);
     }
+
+    pool->free_list = NULL;
+    pool->free_count = 0;
+    pool->free_bytes = 0;
 }
 
-/* struct gdbwire_mi_result */
-struct gdbwire_mi_result *
-gdbwire_mi_result_alloc(void)
+void
+gdbwire_mi_arena_pool_get_bytes(struct gdbwire_mi_arena_pool *pool,
+        size_t *in_use, size_t *pooled)
+{
+    gdbwire_mi_arena_pool_reclaim(pool);
+
+    *in_use = pool->bytes - pool->free_bytes;
+    *pooled = pool->free_bytes;
+}
+
+struct gdbwire_mi_arena *
+gdbwire_mi_arena_acquire(struct gdbwire_mi_arena_pool *pool)
 {
-    return calloc(1, sizeof (struct gdbwire_mi_result));
+    struct gdbwire_mi_arena *arena;
+
+    if (pool) {
+        gdbwire_mi_arena_pool_reclaim(pool);
+    }
+
+    if (pool && pool->free_list) {
+        arena = pool->free_list;
+        pool->free_list = arena->next;
+        pool->free_count--;
+        pool->free_bytes -= arena->size;
+        arena->next = NULL;
+    } else {
+        arena = gdbwire_mi_arena_create(pool, GDBWIRE_MI_ARENA_BLOCK_SIZE);
+    }
+
+    if (arena) {
+        arena->refcount = 1;
+        if (pool) {
+            gdbwire_mi_arena_pool_ref(pool);
+        }
+    }
+
+    return arena;
 }
 
 void
-gdbwire_mi_result_free(struct gdbwire_mi_result *param)
+gdbwire_mi_arena_release(struct gdbwire_mi_arena *arena)
+{
+    if (arena) {
+        struct gdbwire_mi_arena_pool *pool = arena->pool;
+        struct gdbwire_mi_arena *shared = arena->shared;
+
+        arena->shared = NULL;
+        if (pool) {
+            gdbwire_mi_arena_pool_keep(pool, arena);
+            gdbwire_mi_arena_pool_unref(pool);
+        } else {
+            gdbwire_mi_arena_destroy(arena);
+        }
+
+        if (shared && gdbwire_atomic_fetch_add(&shared->refcount, -1) == 1) {
+            gdbwire_mi_arena_release(shared);
+        }
+    }
+}
+
+/**
+ * Release an arena from any thread.
+ *
+ * The pool is only touched by the thread that owns it, so the arena
+ * is handed back to the pool to take back on its next acquire. Once the
+ * pool is destroyed, the arenas handed back are freed along with it,
+ * when the last arena acquired from it is released.
+ *
+ * @param arena
+ * The arena to release.
+ */
+static void
+gdbwire_mi_arena_return(struct gdbwire_mi_arena *arena)
 {
-    if (param) {
-        if (param->variable) {
-            free(param->variable);
-            param->variable = NULL;
+    struct gdbwire_mi_arena_pool *pool = arena->pool;
+    struct gdbwire_mi_arena *shared = arena->shared;
+
+    arena->shared = NULL;
+    if (!pool) {
+        /* An arena without a pool uses the default allocator */
+        gdbwire_mi_arena_destroy(arena);
+    } else {
+        arena->next = gdbwire_atomic_load(&pool->returned);
+        while (!gdbwire_atomic_compare_exchange(&pool->returned,
+                &arena->next, arena)) {
         }
 
-        switch (param->kind) {
-            case GDBWIRE_MI_CSTRING:
-                if (param->variant.cstring) {
-                    free(param->variant.cstring);
-                    param->variant.cstring = NULL;
-                }
-                break;
-            case GDBWIRE_MI_TUPLE:
-            case GDBWIRE_MI_LIST:
-                gdbwire_mi_result_free(param->variant.result);
-                param->variant.result = NULL;
-                break;
+        gdbwire_mi_arena_pool_unref(pool);
+    }
+
+    if (shared && gdbwire_atomic_fetch_add(&shared->refcount, -1) == 1) {
+        gdbwire_mi_arena_return(shared);
+    }
+}
+
+/**
+ * Allocate uninitialized memory from an arena.
+ *
+ * Moves on to the following blocks, kept from previous uses of the arena,
+ * until one has room. Otherwise a new block, at least twice the size of
+ * the last one, is added to the end of the arena.
+ */
+static void *
+gdbwire_mi_arena_alloc_raw(struct gdbwire_mi_arena *arena, size_t size)
+{
+    struct gdbwire_mi_arena_block *block = arena->current;
+    void *result;
+
+    size = GDBWIRE_MI_ARENA_ALIGN(size);
+
+    while (block->size - block->used < size) {
+        if (!block->next) {
+            size_t block_size = block->size * 2;
+            if (block_size < size) {
+                block_size = size;
+            }
+
+            block->next = gdbwire_malloc(gdbwire_mi_arena_allocator(arena),
+                GDBWIRE_MI_ARENA_BLOCK_HEADER_SIZE + block_size);
+            if (!block->next) {
+                return NULL;
+            }
+            block->next->next = NULL;
+            block->next->size = block_size;
+            block->next->used = 0;
+            gdbwire_mi_arena_account(arena,
+                GDBWIRE_MI_ARENA_BLOCK_HEADER_SIZE + block_size, 1);
         }
+        block = block->next;
+    }
 
-        gdbwire_mi_result_free(param->next);
-        param->next = NULL;
+    arena->current = block;
+    result = GDBWIRE_MI_ARENA_BLOCK_DATA(block) + block->used;
+    block->used += size;
 
-        free(param);
-        param = NULL;
+    return result;
+}
+
+void *
+gdbwire_mi_arena_alloc(struct gdbwire_mi_arena *arena, size_t size)
+{
+    void *result = gdbwire_mi_arena_alloc_raw(arena, size);
+    if (result) {
+        memset(result, 0, size);
     }
+    return result;
 }
 
-/* struct gdbwire_mi_oob_record */
-struct gdbwire_mi_oob_record *
-gdbwire_mi_oob_record_alloc(void)
+char *
+gdbwire_mi_arena_strndup(struct gdbwire_mi_arena *arena, const char *str,
+        size_t size)
 {
-    return calloc(1, sizeof (struct gdbwire_mi_oob_record));
+    char *result = gdbwire_mi_arena_alloc_raw(arena, size + 1);
+    if (result) {
+        memcpy(result, str, size);
+        result[size] = 0;
+    }
+    return result;
+}
+
+char *
+gdbwire_mi_arena_strdup(struct gdbwire_mi_arena *arena, const char *str)
+{
+    return (str) ? gdbwire_mi_arena_strndup(arena, str, strlen(str)) : NULL;
+}
+
+/* struct gdbwire_mi_output */
+struct gdbwire_mi_output *
+gdbwire_mi_output_alloc(struct gdbwire_mi_arena *arena)
+{
+    struct gdbwire_mi_output *output =
+        gdbwire_mi_arena_alloc(arena, sizeof (struct gdbwire_mi_output));
+    if (output) {
+        output->arena = arena;
+    }
+    return output;
+}
+
+struct gdbwire_mi_output *
+gdbwire_mi_output_share(struct gdbwire_mi_arena *arena,
+        const struct gdbwire_mi_output *output)
+{
+    struct gdbwire_mi_output *result = gdbwire_mi_output_alloc(arena);
+    if (result) {
+        result->kind = output->kind;
+        result->variant = output->variant;
+        result->line = output->line;
+        gdbwire_atomic_fetch_add(&output->arena->refcount, 1);
+        arena->shared = output->arena;
+    }
+    return result;
 }
 
 void
-gdbwire_mi_oob_record_free(struct gdbwire_mi_oob_record *param)
-{
-    if (param) {
-        switch(param->kind) {
-            case GDBWIRE_MI_ASYNC:
-                gdbwire_mi_async_record_free(param->variant.async_record);
-                param->variant.async_record = NULL;
-                break;
-            case GDBWIRE_MI_STREAM:
-                gdbwire_mi_stream_record_free(param->variant.stream_record);
-                param->variant.stream_record = NULL;
-                break;
+gdbwire_mi_output_free(struct gdbwire_mi_output *param)
+{
+    while (param) {
+        /* The output lives in its own arena, so get next first */
+        struct gdbwire_mi_output *next = param->next;
+        if (param->arena &&
+                gdbwire_atomic_fetch_add(&param->arena->refcount, -1) == 1) {
+            gdbwire_mi_arena_return(param->arena);
         }
-
-        free(param);
-        param = NULL;
+        param = next;
     }
 }
 
-/* struct gdbwire_mi_async_record */
-struct gdbwire_mi_async_record *
-gdbwire_mi_async_record_alloc(void)
+const struct gdbwire_mi_output *
+gdbwire_mi_output_retain(const struct gdbwire_mi_output *output)
 {
-    return calloc(1, sizeof (struct gdbwire_mi_async_record));
+    if (output && output->arena) {
+        gdbwire_atomic_fetch_add(&output->arena->refcount, 1);
+    }
+    return output;
 }
 
 void
-gdbwire_mi_async_record_free(struct gdbwire_mi_async_record *param)
+gdbwire_mi_output_release(const struct gdbwire_mi_output *output)
+{
+    if (output && output->arena &&
+            gdbwire_atomic_fetch_add(&output->arena->refcount, -1) == 1) {
+        gdbwire_mi_arena_return(output->arena);
+    }
+}
+
+const struct gdbwire_mi_timestamps *
+gdbwire_mi_output_get_timestamps(const struct gdbwire_mi_output *output)
 {
-    if (param) {
-        free(param->token);
+    return (output) ? &output->timestamps : NULL;
+}
+
+/**
+ * Copies a parse tree into one contiguous piece of memory.
+ *
+ * The objects are laid out one after another, each aligned like the
+ * objects of an arena. Without any memory to copy into, the bytes the
+ * copy needs are only counted.
+ */
+struct gdbwire_mi_clone {
+    /* The memory to copy into or NULL to only count the bytes */
+    char *data;
+    /* The number of bytes laid out so far */
+    size_t used;
+};
 
-        gdbwire_mi_result_free(param->result);
-        param->result = NULL;
+/* Point a pointer into the copy of the memory it pointed into */
+#define GDBWIRE_MI_CLONE_RELOCATE(pointer, delta) \
+    do { \
+        if (pointer) { \
+            (pointer) = (void *)((uintptr_t)(pointer) + (delta)); \
+        } \
+    } while (0)
+
+/**
+ * Lay out a copy of some bytes.
+ *
+ * @param clone
+ * The clone to lay the bytes out in.
+ *
+ * @param bytes
+ * The bytes to copy.
+ *
+ * @param size
+ * The number of bytes to copy.
+ *
+ * @return
+ * The copy or NULL if only counting.
+ */
+static void *
+gdbwire_mi_clone_bytes(struct gdbwire_mi_clone *clone, const void *bytes,
+        size_t size)
+{
+    void *result = NULL;
 
-        free(param);
-        param = NULL;
+    if (clone->data) {
+        result = clone->data + clone->used;
+        memcpy(result, bytes, size);
     }
+    clone->used += GDBWIRE_MI_ARENA_ALIGN(size);
+
+    return result;
 }
 
-/* struct gdbwire_mi_stream_record */
-struct gdbwire_mi_stream_record *
-gdbwire_mi_stream_record_alloc(void)
+static char *
+gdbwire_mi_clone_string(struct gdbwire_mi_clone *clone, const char *str)
 {
-    return calloc(1, sizeof (struct gdbwire_mi_stream_record));
+    return (str) ? gdbwire_mi_clone_bytes(clone, str, strlen(str) + 1) : NULL;
 }
 
-void
-gdbwire_mi_stream_record_free(struct gdbwire_mi_stream_record *param)
+/**
+ * Lay out a copy of a list of results and everything they contain.
+ *
+ * @param clone
+ * The clone to lay the results out in.
+ *
+ * @param result
+ * The first result of the list, OK to pass in NULL.
+ *
+ * @return
+ * The first result of the copy or NULL if only counting.
+ */
+static struct gdbwire_mi_result *
+gdbwire_mi_clone_results(struct gdbwire_mi_clone *clone,
+        const struct gdbwire_mi_result *result)
+{
+    struct gdbwire_mi_result *first = NULL, **link = &first, *copy;
+    struct gdbwire_mi_result *results = NULL;
+    char *variable, *cstring = NULL;
+
+    for (; result; result = result->next) {
+        copy = gdbwire_mi_clone_bytes(clone, result, sizeof (*result));
+        variable = gdbwire_mi_clone_string(clone, result->variable);
+        if (result->kind == GDBWIRE_MI_CSTRING) {
+            cstring = gdbwire_mi_clone_string(clone, result->variant.cstring);
+        } else {
+            results = gdbwire_mi_clone_results(clone, result->variant.result);
+        }
+
+        if (copy) {
+            copy->variable = variable;
+            if (copy->kind == GDBWIRE_MI_CSTRING) {
+                copy->variant.cstring = cstring;
+            } else {
+                copy->variant.result = results;
+            }
+            copy->next = NULL;
+            *link = copy;
+            link = &copy->next;
+        }
+    }
+
+    return first;
+}
+
+/**
+ * Lay out a copy of an out of band record.
+ *
+ * @param clone
+ * The clone to lay the record out in.
+ *
+ * @param record
+ * The record to copy.
+ *
+ * @return
+ * The copy or NULL if only counting.
+ */
+static struct gdbwire_mi_oob_record *
+gdbwire_mi_clone_oob_record(struct gdbwire_mi_clone *clone,
+        const struct gdbwire_mi_oob_record *record)
+{
+    struct gdbwire_mi_oob_record *copy;
+    struct gdbwire_mi_async_record *async;
+    struct gdbwire_mi_stream_record *stream;
+    char *token, *cstring;
+    struct gdbwire_mi_result *result;
+
+    copy = gdbwire_mi_clone_bytes(clone, record, sizeof (*record));
+    if (record->kind == GDBWIRE_MI_ASYNC) {
+        async = gdbwire_mi_clone_bytes(clone, record->variant.async_record,
+            sizeof (*async));
+        token = gdbwire_mi_clone_string(clone,
+            record->variant.async_record->token);
+        result = gdbwire_mi_clone_results(clone,
+            record->variant.async_record->result);
+        if (copy) {
+            async->token = token;
+            async->result = result;
+            copy->variant.async_record = async;
+        }
+    } else {
+        stream = gdbwire_mi_clone_bytes(clone, record->variant.stream_record,
+            sizeof (*stream));
+        cstring = gdbwire_mi_clone_string(clone,
+            record->variant.stream_record->cstring);
+        if (copy) {
+            stream->cstring = cstring;
+            copy->variant.stream_record = stream;
+        }
+    }
+
+    return copy;
+}
+
+/**
+ * Lay out a copy of an output and its parse tree.
+ *
+ * @param clone
+ * The clone to lay the output out in.
+ *
+ * @param output
+ * The output to copy.
+ *
+ * @return
+ * The copy, not linked to any other output, or NULL if only counting.
+ */
+static struct gdbwire_mi_output *
+gdbwire_mi_clone_output(struct gdbwire_mi_clone *clone,
+        const struct gdbwire_mi_output *output)
+{
+    struct gdbwire_mi_output *copy;
+    struct gdbwire_mi_result_record *record;
+    struct gdbwire_mi_oob_record *oob_record;
+    struct gdbwire_mi_result *result;
+    char *line, *token;
+
+    copy = gdbwire_mi_clone_bytes(clone, output, sizeof (*output));
+    line = gdbwire_mi_clone_string(clone, output->line);
+    if (copy) {
+        copy->line = line;
+        copy->next = NULL;
+    }
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            oob_record = gdbwire_mi_clone_oob_record(clone,
+                output->variant.oob_record);
+            if (copy) {
+                copy->variant.oob_record = oob_record;
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            record = gdbwire_mi_clone_bytes(clone,
+                output->variant.result_record, sizeof (*record));
+            token = gdbwire_mi_clone_string(clone,
+                output->variant.result_record->token);
+            result = gdbwire_mi_clone_results(clone,
+                output->variant.result_record->result);
+            if (copy) {
+                record->token = token;
+                record->result = result;
+                copy->variant.result_record = record;
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            token = gdbwire_mi_clone_string(clone,
+                output->variant.error.token);
+            if (copy) {
+                copy->variant.error.token = token;
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            break;
+    }
+
+    return copy;
+}
+
+/**
+ * Point the pointers of a copied list of results into the copy.
+ *
+ * @param link
+ * The pointer to the first result of the list.
+ *
+ * @param delta
+ * The distance from the original memory to the copy.
+ */
+static void
+gdbwire_mi_relocate_results(struct gdbwire_mi_result **link, uintptr_t delta)
 {
-    if (param) {
-        if (param->cstring) {
-            free(param->cstring);
-            param->cstring = NULL;
+    struct gdbwire_mi_result *result;
+
+    for (; *link; link = &result->next) {
+        GDBWIRE_MI_CLONE_RELOCATE(*link, delta);
+        result = *link;
+        GDBWIRE_MI_CLONE_RELOCATE(result->variable, delta);
+        if (result->kind == GDBWIRE_MI_CSTRING) {
+            GDBWIRE_MI_CLONE_RELOCATE(result->variant.cstring, delta);
+        } else {
+            gdbwire_mi_relocate_results(&result->variant.result, delta);
         }
+    }
+}
+
+/**
+ * Point the pointers of a copied output into the copy.
+ *
+ * @param output
+ * The copied output.
+ *
+ * @param delta
+ * The distance from the original memory to the copy.
+ */
+static void
+gdbwire_mi_relocate_output(struct gdbwire_mi_output *output, uintptr_t delta)
+{
+    struct gdbwire_mi_oob_record *oob_record;
+    struct gdbwire_mi_result_record *record;
 
-        free(param);
-        param = NULL;
+    GDBWIRE_MI_CLONE_RELOCATE(output->line, delta);
+    output->next = NULL;
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            GDBWIRE_MI_CLONE_RELOCATE(output->variant.oob_record, delta);
+            oob_record = output->variant.oob_record;
+            if (oob_record->kind == GDBWIRE_MI_ASYNC) {
+                GDBWIRE_MI_CLONE_RELOCATE(
+                    oob_record->variant.async_record, delta);
+                GDBWIRE_MI_CLONE_RELOCATE(
+                    oob_record->variant.async_record->token, delta);
+                gdbwire_mi_relocate_results(
+                    &oob_record->variant.async_record->result, delta);
+            } else {
+                GDBWIRE_MI_CLONE_RELOCATE(
+                    oob_record->variant.stream_record, delta);
+                GDBWIRE_MI_CLONE_RELOCATE(
+                    oob_record->variant.stream_record->cstring, delta);
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            GDBWIRE_MI_CLONE_RELOCATE(output->variant.result_record, delta);
+            record = output->variant.result_record;
+            GDBWIRE_MI_CLONE_RELOCATE(record->token, delta);
+            gdbwire_mi_relocate_results(&record->result, delta);
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            GDBWIRE_MI_CLONE_RELOCATE(output->variant.error.token, delta);
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            break;
     }
 }
+
+/**
+ * Get the memory an output can be copied from as a whole.
+ *
+ * The parse tree of an output that was not shared with another output
+ * is all in its arena. When the arena fit in its first block, the block
+ * holds nothing but the output and its parse tree.
+ *
+ * @param output
+ * The output to copy.
+ *
+ * @param size
+ * Set to the number of bytes of the memory.
+ *
+ * @return
+ * The memory or NULL if the output has to be copied object by object.
+ */
+static const char *
+gdbwire_mi_clone_flat(const struct gdbwire_mi_output *output, size_t *size)
+{
+    struct gdbwire_mi_arena *arena = output->arena;
+
+    if (!arena || arena->shared || arena->current != arena->head) {
+        return NULL;
+    }
+
+    *size = arena->head->used;
+    return GDBWIRE_MI_ARENA_BLOCK_DATA(arena->head);
+}
+
+/**
+ * Get the number of bytes a clone of an output needs.
+ *
+ * @param output
+ * The output to clone.
+ *
+ * @return
+ * The number of bytes.
+ */
+static size_t
+gdbwire_mi_clone_size(const struct gdbwire_mi_output *output)
+{
+    struct gdbwire_mi_clone clone = { NULL, 0 };
+    size_t size;
+
+    if (gdbwire_mi_clone_flat(output, &size)) {
+        return size;
+    }
+
+    gdbwire_mi_clone_output(&clone, output);
+    return clone.used;
+}
+
+/**
+ * Clone an output into memory of the size from gdbwire_mi_clone_size.
+ *
+ * @param output
+ * The output to clone.
+ *
+ * @param data
+ * The memory to clone into.
+ *
+ * @return
+ * The clone.
+ */
+static struct gdbwire_mi_output *
+gdbwire_mi_clone_into(const struct gdbwire_mi_output *output, char *data)
+{
+    struct gdbwire_mi_clone clone = { NULL, 0 };
+    struct gdbwire_mi_output *result;
+    const char *flat;
+    size_t size;
+
+    flat = gdbwire_mi_clone_flat(output, &size);
+    if (flat) {
+        memcpy(data, flat, size);
+        result = (struct gdbwire_mi_output *)
+            (data + ((const char *)output - flat));
+        gdbwire_mi_relocate_output(result,
+            (uintptr_t)data - (uintptr_t)flat);
+    } else {
+        clone.data = data;
+        result = gdbwire_mi_clone_output(&clone, output);
+    }
+
+    return result;
+}
+
+struct gdbwire_mi_output *
+gdbwire_mi_output_clone(const struct gdbwire_mi_output *output)
+{
+    struct gdbwire_mi_output *result;
+    struct gdbwire_mi_arena *arena;
+    size_t size;
+
+    if (!output) {
+        return NULL;
+    }
+
+    /* The clone fills the first block of an arena of its own exactly */
+    size = gdbwire_mi_clone_size(output);
+    arena = gdbwire_mi_arena_create(NULL, size);
+    if (!arena) {
+        return NULL;
+    }
+    arena->refcount = 1;
+    arena->head->used = size;
+
+    result = gdbwire_mi_clone_into(output,
+        GDBWIRE_MI_ARENA_BLOCK_DATA(arena->head));
+    result->arena = arena;
+
+    return result;
+}
+
+struct gdbwire_mi_output *
+gdbwire_mi_output_clone_into(const struct gdbwire_mi_output *output,
+        void *buffer, size_t size, size_t *needed)
+{
+    struct gdbwire_mi_output *result;
+    size_t required;
+
+    if (!output) {
+        return NULL;
+    }
+
+    required = gdbwire_mi_clone_size(output);
+    if (needed) {
+        *needed = required;
+    }
+
+    if (!buffer || size < required) {
+        return NULL;
+    }
+
+    result = gdbwire_mi_clone_into(output, buffer);
+    result->arena = NULL;
+
+    return result;
+}
+
+/* struct gdbwire_mi_result_record */
+struct gdbwire_mi_result_record *
+gdbwire_mi_result_record_alloc(struct gdbwire_mi_arena *arena)
+{
+    return gdbwire_mi_arena_alloc(arena,
+        sizeof (struct gdbwire_mi_result_record));
+}
+
+/* struct gdbwire_mi_result */
+struct gdbwire_mi_result *
+gdbwire_mi_result_alloc(struct gdbwire_mi_arena *arena)
+{
+    return gdbwire_mi_arena_alloc(arena, sizeof (struct gdbwire_mi_result));
+}
+
+/* struct gdbwire_mi_oob_record */
+struct gdbwire_mi_oob_record *
+gdbwire_mi_oob_record_alloc(struct gdbwire_mi_arena *arena)
+{
+    return gdbwire_mi_arena_alloc(arena,
+        sizeof (struct gdbwire_mi_oob_record));
+}
+
+/* struct gdbwire_mi_async_record */
+struct gdbwire_mi_async_record *
+gdbwire_mi_async_record_alloc(struct gdbwire_mi_arena *arena)
+{
+    return gdbwire_mi_arena_alloc(arena,
+        sizeof (struct gdbwire_mi_async_record));
+}
+
+/* struct gdbwire_mi_stream_record */
+struct gdbwire_mi_stream_record *
+gdbwire_mi_stream_record_alloc(struct gdbwire_mi_arena *arena)
+{
+    return gdbwire_mi_arena_alloc(arena,
+        sizeof (struct gdbwire_mi_stream_record));
+}
@@ -1,40 +1,211 @@
 #ifndef GDBWIRE_MI_PT_ALLOC_H
 #define GDBWIRE_MI_PT_ALLOC_H
 
-#ifdef __cplusplus 
-extern "C" { 
-#endif 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include "gdbwire_allocator.h"
 
 /**
  * Responsible for allocating and deallocating gdbwire_mi_pt objects.
+ *
+ * Every object in a parse tree, including the strings it references and
+ * the gdbwire_mi_output at its root, is allocated from a single arena.
+ * The arena is released as a whole when the output is freed with
+ * gdbwire_mi_output_free. There is no way to free individual objects.
+ *
+ * Arenas are handed out by an arena pool. When an arena is released it
+ * is reset and returned to the pool it came from, keeping the memory it
+ * grew to. A parser that keeps a pool therefore parses line after line
+ * without calling the system allocator once the pool has warmed up.
+ *
+ * A pool belongs to the thread that acquires arenas from it. Outputs may
+ * be freed on any thread, so the arena of a freed output is handed back
+ * to its pool without a lock, and the owner takes it back into the pool
+ * on its next acquire.
+ */
+
+/**
+ * A bump allocator for a single parse tree.
+ */
+struct gdbwire_mi_arena;
+
+/**
+ * A pool of arenas available for reuse.
+ *
+ * The pool stays alive until it has been destroyed and every arena
+ * acquired from it has been released, so parse trees may outlive
+ * the parser that created them.
+ */
+struct gdbwire_mi_arena_pool;
+
+/**
+ * Create an arena pool.
+ *
+ * @param allocator
+ * The allocator to copy and allocate the pool and its arenas with,
+ * or NULL for the default allocator.
+ *
+ * @return
+ * A new arena pool or NULL on error.
+ */
+struct gdbwire_mi_arena_pool *gdbwire_mi_arena_pool_create(
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy an arena pool.
+ *
+ * The arenas held for reuse are freed. Arenas that are still in use are
+ * freed when they are released.
+ *
+ * @param pool
+ * The pool to destroy, OK to pass in NULL.
+ */
+void gdbwire_mi_arena_pool_destroy(struct gdbwire_mi_arena_pool *pool);
+
+/**
+ * Free the arenas a pool holds for reuse.
+ *
+ * @param pool
+ * The pool to trim.
+ */
+void gdbwire_mi_arena_pool_trim(struct gdbwire_mi_arena_pool *pool);
+
+/**
+ * Get the memory allocated for the arenas of a pool.
+ *
+ * @param pool
+ * The pool to get the memory of.
+ *
+ * @param in_use
+ * Set to the number of bytes allocated for arenas that are in use,
+ * those holding a parse tree that has not been freed yet.
+ *
+ * @param pooled
+ * Set to the number of bytes allocated for arenas held for reuse.
  */
+void gdbwire_mi_arena_pool_get_bytes(struct gdbwire_mi_arena_pool *pool,
+        size_t *in_use, size_t *pooled);
+
+/**
+ * Acquire an empty arena.
+ *
+ * @param pool
+ * The pool to acquire the arena from. If NULL, a new arena is created
+ * with the default allocator that will be freed when it is released.
+ *
+ * @return
+ * An empty arena or NULL on error.
+ */
+struct gdbwire_mi_arena *gdbwire_mi_arena_acquire(
+        struct gdbwire_mi_arena_pool *pool);
+
+/**
+ * Release an arena and everything allocated from it.
+ *
+ * This must be called on the thread that owns the arena's pool.
+ *
+ * @param arena
+ * The arena to release, OK to pass in NULL.
+ */
+void gdbwire_mi_arena_release(struct gdbwire_mi_arena *arena);
+
+/**
+ * Allocate zero initialized memory from an arena.
+ *
+ * @param arena
+ * The arena to allocate from.
+ *
+ * @param size
+ * The number of bytes to allocate.
+ *
+ * @return
+ * The memory or NULL if out of memory.
+ */
+void *gdbwire_mi_arena_alloc(struct gdbwire_mi_arena *arena, size_t size);
+
+/**
+ * Copy a sequence of bytes into an arena as a NUL terminated string.
+ *
+ * @param arena
+ * The arena to allocate from.
+ *
+ * @param str
+ * The bytes to copy.
+ *
+ * @param size
+ * The number of bytes in str to copy.
+ *
+ * @return
+ * The string or NULL if out of memory.
+ */
+char *gdbwire_mi_arena_strndup(struct gdbwire_mi_arena *arena,
+        const char *str, size_t size);
+
+/**
+ * Copy a NUL terminated string into an arena.
+ *
+ * @param arena
+ * The arena to allocate from.
+ *
+ * @param str
+ * The string to copy.
+ *
+ * @return
+ * The string or NULL if out of memory or str is NULL.
+ */
+char *gdbwire_mi_arena_strdup(struct gdbwire_mi_arena *arena,
+        const char *str);
 
 /* struct gdbwire_mi_output */
-struct gdbwire_mi_output *gdbwire_mi_output_alloc(void);
+struct gdbwire_mi_output *gdbwire_mi_output_alloc(
+        struct gdbwire_mi_arena *arena);
 void gdbwire_mi_output_free(struct gdbwire_mi_output *param);
 
+/**
+ * Allocate an output that shares the parse tree of another output.
+ *
+ * The new output has the kind, variant and line of the other output,
+ * which stays alive until the arena of the new output is released.
+ * Neither output may be modified afterwards.
+ *
+ * @param arena
+ * The arena to allocate the new output from.
+ *
+ * @param output
+ * The output whose parse tree is shared.
+ *
+ * @return
+ * The new output or NULL if out of memory.
+ */
+struct gdbwire_mi_output *gdbwire_mi_output_share(
+        struct gdbwire_mi_arena *arena,
+        const struct gdbwire_mi_output *output);
+
 /* struct gdbwire_mi_result_record */
-struct gdbwire_mi_result_record *gdbwire_mi_result_record_alloc(void);
-void gdbwire_mi_result_record_free(struct gdbwire_mi_result_record *param);
+struct gdbwire_mi_result_record *gdbwire_mi_result_record_alloc(
+        struct gdbwire_mi_arena *arena);
 
 /* struct gdbwire_mi_result */
-struct gdbwire_mi_result *gdbwire_mi_result_alloc(void);
-void gdbwire_mi_result_free(struct gdbwire_mi_result *param);
+struct gdbwire_mi_result *gdbwire_mi_result_alloc(
+        struct gdbwire_mi_arena *arena);
 
 /* struct gdbwire_mi_oob_record */
-struct gdbwire_mi_oob_record *gdbwire_mi_oob_record_alloc(void);
-void gdbwire_mi_oob_record_free(struct gdbwire_mi_oob_record *param);
+struct gdbwire_mi_oob_record *gdbwire_mi_oob_record_alloc(
+        struct gdbwire_mi_arena *arena);
 
 /* struct gdbwire_mi_async_record */
-struct gdbwire_mi_async_record *gdbwire_mi_async_record_alloc(void);
-void gdbwire_mi_async_record_free(struct gdbwire_mi_async_record *param);
+struct gdbwire_mi_async_record *gdbwire_mi_async_record_alloc(
+        struct gdbwire_mi_arena *arena);
 
 /* struct gdbwire_mi_stream_record */
-struct gdbwire_mi_stream_record *gdbwire_mi_stream_record_alloc(void);
-void gdbwire_mi_stream_record_free(struct gdbwire_mi_stream_record *param);
+struct gdbwire_mi_stream_record *gdbwire_mi_stream_record_alloc(
+        struct gdbwire_mi_arena *arena);
 
-#ifdef __cplusplus 
+#ifdef __cplusplus
 }
-#endif 
+#endif
 
 #endif /* GDBWIRE_MI_PT_ALLOC_H */
@@ -0,0 +1,378 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "gdbwire_assert.h"
+#include "gdbwire_atomic.h"
+#include "gdbwire_mi_queue.h"
+
+struct gdbwire_mi_queue {
+    /* The batches, each a list of outputs, capacity of them */
+    struct gdbwire_mi_output **ring;
+    size_t mask;
+
+    /* Where the producer queues the next batch, only accessed atomically */
+    size_t head;
+
+    /* Where the consumer pops the next batch, only accessed atomically */
+    size_t tail;
+
+    /* The outputs released by the consumer, only accessed atomically */
+    struct gdbwire_mi_output *released;
+
+    /* The parser of the producer */
+    struct gdbwire_mi_parser *parser;
+
+    /* The batch being parsed, first and last output */
+    struct gdbwire_mi_output *batch;
+    struct gdbwire_mi_output *batch_last;
+
+    /* The signal the consumer waits on, read and write ends */
+    int fds[2];
+
+    /* The signal the producer waits on while the queue is full */
+    int full_fds[2];
+
+    /* True while the producer waits on full_fds, accessed atomically */
+    int full_waiting;
+
+    /* The allocator the queue allocates its memory with */
+    struct gdbwire_allocator allocator;
+};
+
+/**
+ * Add a parsed output to the batch being parsed.
+ */
+static void
+gdbwire_mi_queue_output_callback(void *context,
+        struct gdbwire_mi_output *output)
+{
+    struct gdbwire_mi_queue *queue = (struct gdbwire_mi_queue *)context;
+
+    if (queue->batch_last) {
+        queue->batch_last->next = output;
+    } else {
+        queue->batch = output;
+    }
+
+    queue->batch_last = output;
+    while (queue->batch_last->next) {
+        queue->batch_last = queue->batch_last->next;
+    }
+}
+
+/**
+ * Create a signal a thread waits on.
+ *
+ * @param fds
+ * Set to the read and write end, the same descriptor for an eventfd.
+ *
+ * @return
+ * 0 on success or -1 on error.
+ */
+static int
+gdbwire_mi_queue_open_signal(int fds[2])
+{
+#ifdef __linux__
+    fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return (fds[0] == -1) ? -1 : 0;
+#else
+    if (pipe(fds) == -1) {
+        return -1;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+#endif
+}
+
+/**
+ * Make a signal readable.
+ *
+ * @param fds
+ * The read and write end of the signal.
+ */
+static void
+gdbwire_mi_queue_raise_signal(const int fds[2])
+{
+    uint64_t value = 1;
+    ssize_t written;
+
+    /* A full pipe or eventfd counter is already readable */
+    written = write(fds[1], &value, sizeof(value));
+    (void)written;
+}
+
+/**
+ * Make a signal unreadable.
+ *
+ * @param fds
+ * The read and write end of the signal.
+ */
+static void
+gdbwire_mi_queue_clear_signal(const int fds[2])
+{
+    char buffer[64];
+
+    while (read(fds[0], buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+/**
+ * Close a signal.
+ *
+ * @param fds
+ * The read and write end of the signal, -1 if not open.
+ */
+static void
+gdbwire_mi_queue_close_signal(const int fds[2])
+{
+    if (fds[0] != -1) {
+        close(fds[0]);
+    }
+    if (fds[1] != -1 && fds[1] != fds[0]) {
+        close(fds[1]);
+    }
+}
+
+/**
+ * Wait for the consumer to pop a batch from a full queue, on the
+ * producer.
+ *
+ * @param queue
+ * The queue.
+ *
+ * @param head
+ * Where the producer queues the next batch.
+ */
+static void
+gdbwire_mi_queue_wait_full(struct gdbwire_mi_queue *queue, size_t head)
+{
+    struct pollfd fd;
+
+    fd.fd = queue->full_fds[0];
+    fd.events = POLLIN;
+
+    /**
+     * The consumer checks for a waiting producer after popping a batch,
+     * so either it sees the wait or the check below sees the batch gone.
+     */
+    gdbwire_mi_queue_clear_signal(queue->full_fds);
+    gdbwire_atomic_store(&queue->full_waiting, 1);
+    gdbwire_atomic_fence();
+    if (head - gdbwire_atomic_load(&queue->tail) > queue->mask) {
+        poll(&fd, 1, -1);
+    }
+    gdbwire_atomic_store(&queue->full_waiting, 0);
+}
+
+/**
+ * Reclaim the outputs released by the consumer, on the producer.
+ *
+ * @param queue
+ * The queue.
+ */
+static void
+gdbwire_mi_queue_reclaim(struct gdbwire_mi_queue *queue)
+{
+    struct gdbwire_mi_output *released;
+
+    if (gdbwire_atomic_load(&queue->released)) {
+        released = gdbwire_atomic_exchange(&queue->released,
+            (struct gdbwire_mi_output *)NULL);
+        gdbwire_mi_output_free(released);
+    }
+}
+
+struct gdbwire_mi_queue *
+gdbwire_mi_queue_create(size_t capacity)
+{
+    return gdbwire_mi_queue_create_with_allocator(capacity, NULL);
+}
+
+struct gdbwire_mi_queue *
+gdbwire_mi_queue_create_with_allocator(size_t capacity,
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_mi_parser_callbacks callbacks = { 0, 0 };
+    struct gdbwire_mi_queue *queue;
+    size_t size = 1;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    while (size < capacity) {
+        if (size > (size_t)-1 / 2 / sizeof(struct gdbwire_mi_output *)) {
+            return NULL;
+        }
+        size *= 2;
+    }
+
+    queue = (struct gdbwire_mi_queue *)gdbwire_calloc(allocator, 1,
+        sizeof(struct gdbwire_mi_queue));
+    if (!queue) {
+        return NULL;
+    }
+
+    queue->allocator = (allocator) ? *allocator :
+        gdbwire_get_default_allocator();
+    queue->mask = size - 1;
+    queue->fds[0] = queue->fds[1] = -1;
+    queue->full_fds[0] = queue->full_fds[1] = -1;
+
+    callbacks.context = queue;
+    callbacks.gdbwire_mi_output_callback = gdbwire_mi_queue_output_callback;
+
+    queue->ring = (struct gdbwire_mi_output **)gdbwire_calloc(
+        &queue->allocator, size, sizeof(struct gdbwire_mi_output *));
+    queue->parser = gdbwire_mi_parser_create_with_allocator(callbacks,
+        &queue->allocator);
+    if (!queue->ring || !queue->parser ||
+            gdbwire_mi_queue_open_signal(queue->fds) == -1 ||
+            gdbwire_mi_queue_open_signal(queue->full_fds) == -1) {
+        gdbwire_mi_queue_destroy(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+void
+gdbwire_mi_queue_destroy(struct gdbwire_mi_queue *queue)
+{
+    size_t index;
+
+    if (queue) {
+        struct gdbwire_allocator allocator = queue->allocator;
+
+        if (queue->ring) {
+            for (index = queue->tail; index != queue->head; ++index) {
+                gdbwire_mi_output_free(queue->ring[index & queue->mask]);
+            }
+            gdbwire_free(&allocator, queue->ring);
+        }
+        gdbwire_mi_output_free(queue->released);
+        gdbwire_mi_output_free(queue->batch);
+        gdbwire_mi_parser_destroy(queue->parser);
+
+        gdbwire_mi_queue_close_signal(queue->fds);
+        gdbwire_mi_queue_close_signal(queue->full_fds);
+
+        gdbwire_free(&allocator, queue);
+    }
+}
+
+struct gdbwire_mi_parser *
+gdbwire_mi_queue_get_parser(struct gdbwire_mi_queue *queue)
+{
+    return (queue) ? queue->parser : NULL;
+}
+
+enum gdbwire_result
+gdbwire_mi_queue_push_data(struct gdbwire_mi_queue *queue, const char *data,
+        size_t size)
+{
+    enum gdbwire_result result;
+    size_t head;
+
+    GDBWIRE_ASSERT(queue && data);
+
+    gdbwire_mi_queue_reclaim(queue);
+
+    result = gdbwire_mi_parser_push_data(queue->parser, data, size);
+    if (!queue->batch) {
+        return result;
+    }
+
+    /* Only the producer writes head */
+    head = queue->head;
+    while (head - gdbwire_atomic_load(&queue->tail) > queue->mask) {
+        gdbwire_mi_queue_reclaim(queue);
+        gdbwire_mi_queue_wait_full(queue, head);
+    }
+
+    queue->ring[head & queue->mask] = queue->batch;
+    queue->batch = queue->batch_last = NULL;
+    gdbwire_atomic_store(&queue->head, head + 1);
+
+    /**
+     * Wake the consumer if it popped every batch before this one, it
+     * may be waiting. Otherwise it has a batch to pop before it waits.
+     */
+    gdbwire_atomic_fence();
+    if (gdbwire_atomic_load(&queue->tail) == head) {
+        gdbwire_mi_queue_raise_signal(queue->fds);
+    }
+
+    return result;
+}
+
+struct gdbwire_mi_output *
+gdbwire_mi_queue_pop(struct gdbwire_mi_queue *queue)
+{
+    struct gdbwire_mi_output *batch;
+    size_t tail;
+
+    if (!queue) {
+        return NULL;
+    }
+
+    /* Only the consumer writes tail */
+    tail = queue->tail;
+    gdbwire_atomic_fence();
+    if (gdbwire_atomic_load(&queue->head) == tail) {
+        /* Check again after clearing, a batch may have just arrived */
+        gdbwire_mi_queue_clear_signal(queue->fds);
+        if (gdbwire_atomic_load(&queue->head) == tail) {
+            return NULL;
+        }
+    }
+
+    batch = queue->ring[tail & queue->mask];
+    gdbwire_atomic_store(&queue->tail, tail + 1);
+
+    /* Wake the producer if it waits for this slot */
+    gdbwire_atomic_fence();
+    if (gdbwire_atomic_load(&queue->full_waiting)) {
+        gdbwire_mi_queue_raise_signal(queue->full_fds);
+    }
+
+    return batch;
+}
+
+void
+gdbwire_mi_queue_release(struct gdbwire_mi_queue *queue,
+        struct gdbwire_mi_output *output)
+{
+    struct gdbwire_mi_output *last;
+
+    if (!queue || !output) {
+        return;
+    }
+
+    for (last = output; last->next; last = last->next) {
+    }
+
+    last->next = gdbwire_atomic_load(&queue->released);
+    while (!gdbwire_atomic_compare_exchange(&queue->released, &last->next,
+            output)) {
+    }
+}
+
+int
+gdbwire_mi_queue_get_fd(struct gdbwire_mi_queue *queue)
+{
+    return (queue) ? queue->fds[0] : -1;
+}
@@ -0,0 +1,177 @@
+#ifndef GDBWIRE_MI_QUEUE_H
+#define GDBWIRE_MI_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include "gdbwire_allocator.h"
+#include "gdbwire_result.h"
+#include "gdbwire_mi_pt.h"
+#include "gdbwire_mi_parser.h"
+
+/**
+ * Hands the parsed GDB/MI output from one thread to another.
+ *
+ * A common front end reads GDB's output on an I/O thread and handles
+ * it on another thread, like a UI thread. The queue parses the output
+ * on the I/O thread, the producer, and passes the outputs to the other
+ * thread, the consumer, through a bounded lock free ring. Neither
+ * thread takes a lock.
+ *
+ * The outputs parsed from each push travel together, as a batch. The
+ * consumer pops a batch at a time, either by polling or by waiting
+ * for the file descriptor from gdbwire_mi_queue_get_fd to be readable.
+ *
+ * The outputs are allocated from the parser's memory, which only the
+ * producer may touch. So the consumer hands each batch back with
+ * gdbwire_mi_queue_release instead of freeing it, and the producer
+ * reclaims the memory on its next push.
+ *
+ * Usage:
+ *   producer thread:
+ *     queue = gdbwire_mi_queue_create(64);
+ *     while (read GDB's output into data)
+ *       gdbwire_mi_queue_push_data(queue, data, size);
+ *   consumer thread:
+ *     while ((batch = gdbwire_mi_queue_pop(queue)))
+ *       handle the outputs in batch
+ *       gdbwire_mi_queue_release(queue, batch);
+ *     wait for gdbwire_mi_queue_get_fd(queue) to be readable
+ *   once both threads are done:
+ *     gdbwire_mi_queue_destroy(queue);
+ */
+struct gdbwire_mi_queue;
+
+/**
+ * Create a queue.
+ *
+ * @param capacity
+ * The number of batches the queue holds, rounded up to a power of 2.
+ *
+ * @return
+ * A new queue or NULL on error.
+ */
+struct gdbwire_mi_queue *gdbwire_mi_queue_create(size_t capacity);
+
+/**
+ * Create a queue that allocates with the given allocator.
+ *
+ * @param capacity
+ * The number of batches the queue holds, rounded up to a power of 2.
+ *
+ * @param allocator
+ * The allocator to copy and allocate the queue, its parser and the
+ * outputs with, or NULL for the default allocator.
+ *
+ * @return
+ * A new queue or NULL on error.
+ */
+struct gdbwire_mi_queue *gdbwire_mi_queue_create_with_allocator(
+        size_t capacity, const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy a queue.
+ *
+ * The batches still in the queue and the batches released but not yet
+ * reclaimed are freed. Neither thread may use the queue during or
+ * after this call.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param queue
+ * The queue to destroy.
+ */
+void gdbwire_mi_queue_destroy(struct gdbwire_mi_queue *queue);
+
+/**
+ * Get the parser of the queue, to set its limits or timestamps.
+ *
+ * The parser belongs to the producer thread. Its output callback is
+ * the queue's, the oversized line and stream chunk callbacks are not
+ * available through the queue.
+ *
+ * @param queue
+ * The queue.
+ *
+ * @return
+ * The parser.
+ */
+struct gdbwire_mi_parser *gdbwire_mi_queue_get_parser(
+        struct gdbwire_mi_queue *queue);
+
+/**
+ * Parse data and queue the outputs for the consumer, on the producer.
+ *
+ * The outputs released by the consumer are reclaimed first. Then the
+ * data is parsed and the outputs of its complete lines are queued as
+ * one batch.
+ *
+ * When the queue is full, this waits for the consumer to pop a batch.
+ * This pushes back on the producer reading GDB's output, rather than
+ * buffering without bound.
+ *
+ * @param queue
+ * The queue.
+ *
+ * @param data
+ * The data to parse.
+ *
+ * @param size
+ * The size of the data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mi_queue_push_data(struct gdbwire_mi_queue *queue,
+        const char *data, size_t size);
+
+/**
+ * Take the next batch of outputs, on the consumer.
+ *
+ * @param queue
+ * The queue.
+ *
+ * @return
+ * The outputs of a batch, linked by their next field in the order
+ * they were parsed, or NULL if the queue is empty. Hand the batch
+ * back with gdbwire_mi_queue_release rather than freeing it.
+ */
+struct gdbwire_mi_output *gdbwire_mi_queue_pop(struct gdbwire_mi_queue *queue);
+
+/**
+ * Hand outputs back to the producer to reclaim, on the consumer.
+ *
+ * @param queue
+ * The queue.
+ *
+ * @param output
+ * The outputs to hand back, a batch or any part of one, linked by
+ * their next field. OK to pass in NULL.
+ */
+void gdbwire_mi_queue_release(struct gdbwire_mi_queue *queue,
+        struct gdbwire_mi_output *output);
+
+/**
+ * Get the file descriptor that signals that batches were queued.
+ *
+ * The descriptor is readable after a batch is queued while the
+ * consumer has popped all the batches before it. gdbwire_mi_queue_pop
+ * clears it when it finds the queue empty, so the consumer may wait
+ * for the descriptor whenever gdbwire_mi_queue_pop returns NULL.
+ * The descriptor is an eventfd on Linux and a pipe elsewhere.
+ *
+ * @param queue
+ * The queue.
+ *
+ * @return
+ * The file descriptor to wait on for reading, do not read or close it.
+ */
+int gdbwire_mi_queue_get_fd(struct gdbwire_mi_queue *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_MI_QUEUE_H */
@@ -0,0 +1,714 @@
+#include <string.h>
+
+#include "gdbwire_assert.h"
+#include "gdbwire_mi_writer.h"
+
+/* The characters starting the asynchronous records, by their kind */
+static const char gdbwire_mi_writer_async_chars[] = { '+', '*', '=' };
+
+/* The characters starting the stream records, by their kind */
+static const char gdbwire_mi_writer_stream_chars[] = { '~', '@', '&' };
+
+/* True for the blanks the GDB/MI lexer skips between tokens */
+#define GDBWIRE_MI_WRITER_BLANK(c) \
+    ((c) == ' ' || (c) == '\t' || (c) == '\v' || (c) == '\f')
+
+/* The prompt GDB writes after the records of a command */
+#define GDBWIRE_MI_WRITER_PROMPT "(gdb) \n"
+
+struct gdbwire_mi_writer {
+    /* The lines written since the buffer was cleared */
+    char *data;
+    size_t size;
+    size_t capacity;
+    /* The allocator the writer is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+struct gdbwire_mi_writer *
+gdbwire_mi_writer_create(void)
+{
+    return gdbwire_mi_writer_create_with_allocator(NULL);
+}
+
+struct gdbwire_mi_writer *
+gdbwire_mi_writer_create_with_allocator(
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_mi_writer *writer;
+
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    writer = (struct gdbwire_mi_writer *)gdbwire_calloc(allocator, 1,
+        sizeof (struct gdbwire_mi_writer));
+    if (writer) {
+        writer->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
+    }
+
+    return writer;
+}
+
+void
+gdbwire_mi_writer_destroy(struct gdbwire_mi_writer *writer)
+{
+    if (writer) {
+        /* The writer is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = writer->allocator;
+
+        gdbwire_free(&allocator, writer->data);
+        gdbwire_free(&allocator, writer);
+    }
+}
+
+/**
+ * Grow the buffer to hold at least a number of bytes.
+ *
+ * One more byte is kept for the NUL handed out after the lines.
+ *
+ * @param writer
+ * The writer whose buffer grows.
+ *
+ * @param size
+ * The number of bytes the buffer must hold.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_reserve(struct gdbwire_mi_writer *writer, size_t size)
+{
+    size_t capacity = (writer->capacity > 0) ? writer->capacity : 256;
+    char *data;
+
+    if (size < writer->capacity) {
+        return GDBWIRE_OK;
+    }
+
+    while (capacity <= size) {
+        if (capacity > (size_t)-1 / 2) {
+            return GDBWIRE_NOMEM;
+        }
+        capacity *= 2;
+    }
+
+    data = gdbwire_realloc(&writer->allocator, writer->data, capacity);
+    if (!data) {
+        return GDBWIRE_NOMEM;
+    }
+
+    writer->data = data;
+    writer->capacity = capacity;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Append bytes to the buffer.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param data
+ * The bytes to append.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_append(struct gdbwire_mi_writer *writer, const char *data,
+        size_t size)
+{
+    enum gdbwire_result result;
+
+    result = gdbwire_mi_writer_reserve(writer, writer->size + size);
+    if (result == GDBWIRE_OK) {
+        memcpy(writer->data + writer->size, data, size);
+        writer->size += size;
+    }
+
+    return result;
+}
+
+/**
+ * Append a c-string to the buffer, escaped and quoted.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param data
+ * The characters of the c-string.
+ *
+ * @param size
+ * The number of characters in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_cstring(struct gdbwire_mi_writer *writer,
+        const char *data, size_t size)
+{
+    enum gdbwire_result result;
+    size_t index;
+    char *out;
+
+    /* Each character is escaped to at most 2 characters */
+    if (size > ((size_t)-1 - 2) / 2 - writer->size) {
+        return GDBWIRE_NOMEM;
+    }
+    result = gdbwire_mi_writer_reserve(writer, writer->size + size * 2 + 2);
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    out = writer->data + writer->size;
+    *out++ = '"';
+    for (index = 0; index < size; ++index) {
+        switch (data[index]) {
+            case '"':
+            case '\\':
+                *out++ = '\\';
+                *out++ = data[index];
+                break;
+            case '\n':
+                *out++ = '\\';
+                *out++ = 'n';
+                break;
+            case '\r':
+                *out++ = '\\';
+                *out++ = 'r';
+                break;
+            case '\t':
+                *out++ = '\\';
+                *out++ = 't';
+                break;
+            default:
+                *out++ = data[index];
+                break;
+        }
+    }
+    *out++ = '"';
+
+    writer->size = (size_t)(out - writer->data);
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Find the name of the class of a record in the line it was parsed from.
+ *
+ * The name follows the token and the ^, *, + or = of the record, and
+ * is lexed the way the GDB/MI lexer lexes it.
+ *
+ * @param line
+ * The line, or NULL if none.
+ *
+ * @param size
+ * The number of bytes in line.
+ *
+ * @param name
+ * Set to the name of the class, pointing into line.
+ *
+ * @param name_size
+ * Set to the number of bytes in name.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_LOGIC if the line has no class.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_line_class(const char *line, size_t size,
+        const char **name, size_t *name_size)
+{
+    size_t index = 0, start;
+
+    if (!line) {
+        return GDBWIRE_LOGIC;
+    }
+
+    /* Skip the token and the blanks the lexer skips */
+    while (index < size && (GDBWIRE_MI_WRITER_BLANK(line[index]) ||
+            (line[index] >= '0' && line[index] <= '9'))) {
+        ++index;
+    }
+    if (index == size || (line[index] != '^' && line[index] != '*' &&
+            line[index] != '+' && line[index] != '=')) {
+        return GDBWIRE_LOGIC;
+    }
+    ++index;
+    while (index < size && GDBWIRE_MI_WRITER_BLANK(line[index])) {
+        ++index;
+    }
+    if (index == size || line[index] == '\n' || line[index] == '\r') {
+        return GDBWIRE_LOGIC;
+    }
+
+    /* An identifier, or else a single character */
+    start = index++;
+    if ((line[start] >= 'a' && line[start] <= 'z') ||
+            (line[start] >= 'A' && line[start] <= 'Z') ||
+            line[start] == '_') {
+        while (index < size && ((line[index] >= 'a' && line[index] <= 'z') ||
+                (line[index] >= 'A' && line[index] <= 'Z') ||
+                (line[index] >= '0' && line[index] <= '9') ||
+                line[index] == '_' || line[index] == '-')) {
+            ++index;
+        }
+    }
+
+    *name = line + start;
+    *name_size = index - start;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Append the start of an asynchronous record or result record.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param token
+ * The token of the record, or NULL if none.
+ *
+ * @param c
+ * The character starting the record after its token.
+ *
+ * @param name
+ * The name of the class of the record, or NULL to take it from line.
+ *
+ * @param line
+ * The line the record was parsed from, or NULL if none.
+ *
+ * @param line_size
+ * The number of bytes in line.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_record(struct gdbwire_mi_writer *writer, const char *token,
+        char c, const char *name, const char *line, size_t line_size)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+    size_t name_size;
+
+    if (name) {
+        name_size = strlen(name);
+    } else {
+        result = gdbwire_mi_writer_line_class(line, line_size, &name,
+            &name_size);
+    }
+
+    if (result == GDBWIRE_OK && token) {
+        result = gdbwire_mi_writer_append(writer, token, strlen(token));
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_writer_append(writer, &c, 1);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_writer_append(writer, name, name_size);
+    }
+
+    return result;
+}
+
+/**
+ * Append a list of results of a parse tree.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param result
+ * The first result of the list, or NULL if it is empty.
+ *
+ * @param comma
+ * True to write a comma before the first result as well, as the
+ * results of a record are.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_results(struct gdbwire_mi_writer *writer,
+        const struct gdbwire_mi_result *result, int comma)
+{
+    enum gdbwire_result status = GDBWIRE_OK;
+
+    for (; result && status == GDBWIRE_OK; result = result->next) {
+        if (comma) {
+            status = gdbwire_mi_writer_append(writer, ",", 1);
+        }
+        comma = 1;
+
+        if (status == GDBWIRE_OK && result->variable) {
+            status = gdbwire_mi_writer_append(writer, result->variable,
+                strlen(result->variable));
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_writer_append(writer, "=", 1);
+            }
+        }
+
+        if (status != GDBWIRE_OK) {
+            break;
+        }
+
+        if (result->kind == GDBWIRE_MI_CSTRING) {
+            status = gdbwire_mi_writer_cstring(writer,
+                result->variant.cstring, strlen(result->variant.cstring));
+        } else {
+            status = gdbwire_mi_writer_append(writer,
+                (result->kind == GDBWIRE_MI_LIST) ? "[" : "{", 1);
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_writer_results(writer,
+                    result->variant.result, 0);
+            }
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_writer_append(writer,
+                    (result->kind == GDBWIRE_MI_LIST) ? "]" : "}", 1);
+            }
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Append a list of results of an encoded output.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param result
+ * The first result of the list.
+ *
+ * @param has_result
+ * True if the list has a first result, false if it is empty.
+ *
+ * @param comma
+ * True to write a comma before the first result as well, as the
+ * results of a record are.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_binary_results(struct gdbwire_mi_writer *writer,
+        struct gdbwire_mi_binary_result *result, int has_result, int comma)
+{
+    enum gdbwire_result status = GDBWIRE_OK;
+    struct gdbwire_mi_binary_result child;
+
+    for (; has_result && status == GDBWIRE_OK;
+            has_result = gdbwire_mi_binary_result_next(result)) {
+        if (comma) {
+            status = gdbwire_mi_writer_append(writer, ",", 1);
+        }
+        comma = 1;
+
+        if (status == GDBWIRE_OK && result->variable) {
+            status = gdbwire_mi_writer_append(writer, result->variable,
+                strlen(result->variable));
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_writer_append(writer, "=", 1);
+            }
+        }
+
+        if (status != GDBWIRE_OK) {
+            break;
+        }
+
+        if (result->kind == GDBWIRE_MI_CSTRING) {
+            status = gdbwire_mi_writer_cstring(writer, result->cstring,
+                result->cstring_size);
+        } else {
+            status = gdbwire_mi_writer_append(writer,
+                (result->kind == GDBWIRE_MI_LIST) ? "[" : "{", 1);
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_writer_binary_results(writer, &child,
+                    gdbwire_mi_binary_result_children(result, &child), 0);
+            }
+            if (status == GDBWIRE_OK) {
+                status = gdbwire_mi_writer_append(writer,
+                    (result->kind == GDBWIRE_MI_LIST) ? "]" : "}", 1);
+            }
+        }
+    }
+
+    return status;
+}
+
+/**
+ * Determine if a token may be written.
+ *
+ * @param token
+ * The token, or NULL if none.
+ *
+ * @return
+ * 1 if the token is NULL or made of digits, otherwise 0.
+ */
+static int
+gdbwire_mi_writer_token_valid(const char *token)
+{
+    if (!token) {
+        return 1;
+    }
+
+    return token[0] != 0 && token[strspn(token, "0123456789")] == 0;
+}
+
+/**
+ * Append a line the output was parsed from as it is.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param line
+ * The line, or NULL if none.
+ *
+ * @param size
+ * The number of bytes in line.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_line(struct gdbwire_mi_writer *writer, const char *line,
+        size_t size)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+
+    if (line) {
+        result = gdbwire_mi_writer_append(writer, line, size);
+    }
+
+    /* The line the error occurred on ends with its own newline */
+    if (result == GDBWIRE_OK && (size == 0 ||
+            (line[size - 1] != '\n' && line[size - 1] != '\r'))) {
+        result = gdbwire_mi_writer_append(writer, "\n", 1);
+    }
+
+    return result;
+}
+
+/**
+ * Append the line of an output command.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param output
+ * The output to write.
+ *
+ * @param token
+ * The token of the record to write.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_mi_writer_output(struct gdbwire_mi_writer *writer,
+        const struct gdbwire_mi_output *output, const char *token)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+    struct gdbwire_mi_oob_record *oob_record;
+    struct gdbwire_mi_async_record *async_record;
+    struct gdbwire_mi_stream_record *stream_record;
+    struct gdbwire_mi_result_record *result_record;
+    size_t line_size = (output->line) ? strlen(output->line) : 0;
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            oob_record = output->variant.oob_record;
+            if (oob_record->kind == GDBWIRE_MI_ASYNC) {
+                async_record = oob_record->variant.async_record;
+                result = gdbwire_mi_writer_record(writer, token,
+                    gdbwire_mi_writer_async_chars[async_record->kind],
+                    (async_record->async_class ==
+                        GDBWIRE_MI_ASYNC_UNSUPPORTED) ? NULL :
+                    gdbwire_mi_async_class_name(async_record->async_class),
+                    output->line, line_size);
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_writer_results(writer,
+                        async_record->result, 1);
+                }
+            } else {
+                stream_record = oob_record->variant.stream_record;
+                result = gdbwire_mi_writer_append(writer,
+                    &gdbwire_mi_writer_stream_chars[stream_record->kind], 1);
+                if (result == GDBWIRE_OK) {
+                    result = gdbwire_mi_writer_cstring(writer,
+                        stream_record->cstring,
+                        strlen(stream_record->cstring));
+                }
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            result_record = output->variant.result_record;
+            result = gdbwire_mi_writer_record(writer, token, '^',
+                (result_record->result_class == GDBWIRE_MI_UNSUPPORTED) ?
+                    NULL : gdbwire_mi_result_class_name(
+                        result_record->result_class),
+                output->line, line_size);
+            if (result == GDBWIRE_OK) {
+                result = gdbwire_mi_writer_results(writer,
+                    result_record->result, 1);
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            return gdbwire_mi_writer_append(writer, GDBWIRE_MI_WRITER_PROMPT,
+                sizeof (GDBWIRE_MI_WRITER_PROMPT) - 1);
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            return gdbwire_mi_writer_line(writer, output->line, line_size);
+    }
+
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mi_writer_append(writer, "\n", 1);
+    }
+
+    return result;
+}
+
+/**
+ * Get the token of the record of an output command.
+ *
+ * @param output
+ * The output.
+ *
+ * @return
+ * The token, or NULL if the output is not a record or has no token.
+ */
+static const char *
+gdbwire_mi_writer_token(const struct gdbwire_mi_output *output)
+{
+    if (output->kind == GDBWIRE_MI_OUTPUT_RESULT) {
+        return output->variant.result_record->token;
+    } else if (output->kind == GDBWIRE_MI_OUTPUT_OOB &&
+            output->variant.oob_record->kind == GDBWIRE_MI_ASYNC) {
+        return output->variant.oob_record->variant.async_record->token;
+    }
+
+    return NULL;
+}
+
+enum gdbwire_result
+gdbwire_mi_writer_write(struct gdbwire_mi_writer *writer,
+        const struct gdbwire_mi_output *output)
+{
+    GDBWIRE_ASSERT(output);
+
+    return gdbwire_mi_writer_write_with_token(writer, output,
+        gdbwire_mi_writer_token(output));
+}
+
+enum gdbwire_result
+gdbwire_mi_writer_write_with_token(struct gdbwire_mi_writer *writer,
+        const struct gdbwire_mi_output *output, const char *token)
+{
+    enum gdbwire_result result;
+    size_t size;
+
+    GDBWIRE_ASSERT(writer && output);
+
+    if (!gdbwire_mi_writer_token_valid(token)) {
+        return GDBWIRE_LOGIC;
+    }
+
+    size = writer->size;
+    result = gdbwire_mi_writer_output(writer, output, token);
+    if (result != GDBWIRE_OK) {
+        writer->size = size;
+    }
+
+    return result;
+}
+
+enum gdbwire_result
+gdbwire_mi_writer_write_binary(struct gdbwire_mi_writer *writer,
+        const struct gdbwire_mi_binary_output *output)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+    struct gdbwire_mi_binary_result first;
+    const char *name = NULL;
+    size_t size;
+    char c = 0;
+
+    GDBWIRE_ASSERT(writer && output);
+
+    size = writer->size;
+
+    if (output->kind == GDBWIRE_MI_OUTPUT_PROMPT) {
+        return gdbwire_mi_writer_append(writer, GDBWIRE_MI_WRITER_PROMPT,
+            sizeof (GDBWIRE_MI_WRITER_PROMPT) - 1);
+    } else if (output->kind == GDBWIRE_MI_OUTPUT_PARSE_ERROR) {
+        result = gdbwire_mi_writer_line(writer, output->line,
+            output->line_size);
+    } else if (output->kind == GDBWIRE_MI_OUTPUT_OOB &&
+            output->oob_kind == GDBWIRE_MI_STREAM) {
+        result = gdbwire_mi_writer_append(writer,
+            &gdbwire_mi_writer_stream_chars[output->stream_kind], 1);
+        if (result == GDBWIRE_OK) {
+            result = gdbwire_mi_writer_cstring(writer, output->cstring,
+                output->cstring_size);
+        }
+    } else {
+        if (output->kind == GDBWIRE_MI_OUTPUT_RESULT) {
+            c = '^';
+            if (output->result_class != GDBWIRE_MI_UNSUPPORTED) {
+                name = gdbwire_mi_result_class_name(output->result_class);
+            }
+        } else {
+            c = gdbwire_mi_writer_async_chars[output->async_kind];
+            if (output->async_class != GDBWIRE_MI_ASYNC_UNSUPPORTED) {
+                name = gdbwire_mi_async_class_name(output->async_class);
+            }
+        }
+
+        /* A parse error keeps the token it occurred on in its token */
+        if (!gdbwire_mi_writer_token_valid(output->token)) {
+            return GDBWIRE_LOGIC;
+        }
+
+        result = gdbwire_mi_writer_record(writer, output->token, c, name,
+            output->line, output->line_size);
+        if (result == GDBWIRE_OK) {
+            result = gdbwire_mi_writer_binary_results(writer, &first,
+                gdbwire_mi_binary_output_results(output, &first), 1);
+        }
+    }
+
+    if (result == GDBWIRE_OK && output->kind != GDBWIRE_MI_OUTPUT_PARSE_ERROR) {
+        result = gdbwire_mi_writer_append(writer, "\n", 1);
+    }
+
+    if (result != GDBWIRE_OK) {
+        writer->size = size;
+    }
+
+    return result;
+}
+
+void
+gdbwire_mi_writer_get_data(struct gdbwire_mi_writer *writer,
+        const char **data, size_t *size)
+{
+    /* The buffer always has room for the NUL once it is allocated */
+    if (writer->data) {
+        writer->data[writer->size] = 0;
+        *data = writer->data;
+    } else {
+        *data = "";
+    }
+    *size = writer->size;
+}
+
+void
+gdbwire_mi_writer_clear(struct gdbwire_mi_writer *writer)
+{
+    writer->size = 0;
+}
@@ -0,0 +1,167 @@
+#ifndef GDBWIRE_MI_WRITER_H
+#define GDBWIRE_MI_WRITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "gdbwire_allocator.h"
+#include "gdbwire_result.h"
+#include "gdbwire_mi_pt.h"
+#include "gdbwire_mi_binary.h"
+
+/**
+ * Writes GDB/MI output commands back out as GDB/MI text.
+ *
+ * A proxy between GDB and its front ends passes records on, sometimes
+ * with their token rewritten. The writer turns a parse tree, or an
+ * output read in place from its binary encoding, back into the line GDB
+ * would have written for it.
+ *
+ * The lines are written the way GDB writes them. There is no space
+ * between the tokens, the prompt is "(gdb) " and each line ends with a
+ * single newline. A c-string escapes a quote and a backslash with a
+ * backslash, and a newline, carriage return and tab as \n, \r and \t.
+ * Every other byte is written as it is. Such a canonical line parses
+ * back into the same tree, and is written again byte for byte.
+ *
+ * The parse tree does not keep the name of a result or asynchronous
+ * class gdbwire does not know. The writer takes the name from the line
+ * the output was parsed from instead. A parse error is written as the
+ * line it occurred on.
+ *
+ * The writer appends each line to its buffer, so that a proxy may write
+ * several lines to a front end at once. Clearing the buffer keeps its
+ * memory for the lines written next.
+ */
+struct gdbwire_mi_writer;
+
+/**
+ * Create a writer.
+ *
+ * @return
+ * A new writer or NULL on error.
+ */
+struct gdbwire_mi_writer *gdbwire_mi_writer_create(void);
+
+/**
+ * Create a writer that allocates with the given allocator.
+ *
+ * @param allocator
+ * The allocator to allocate the writer with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new writer or NULL on error.
+ */
+struct gdbwire_mi_writer *gdbwire_mi_writer_create_with_allocator(
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the writer instance.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param writer
+ * The instance to destroy.
+ */
+void gdbwire_mi_writer_destroy(struct gdbwire_mi_writer *writer);
+
+/**
+ * Append the line of an output command to the buffer.
+ *
+ * Only this output is written, not the outputs linked after it.
+ *
+ * @param writer
+ * The writer to use.
+ *
+ * @param output
+ * The output to write.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the output has a class gdbwire does not know and
+ * no line to take its name from. The buffer is left as it was on failure.
+ */
+enum gdbwire_result gdbwire_mi_writer_write(
+        struct gdbwire_mi_writer *writer,
+        const struct gdbwire_mi_output *output);
+
+/**
+ * Append the line of an output command to the buffer with another token.
+ *
+ * The token replaces the token of an asynchronous record or result
+ * record. The other kinds of output have no token and are written as
+ * gdbwire_mi_writer_write writes them.
+ *
+ * @param writer
+ * The writer to use.
+ *
+ * @param output
+ * The output to write.
+ *
+ * @param token
+ * The token to write, made of digits, or NULL to write the record
+ * without a token.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the token is not made of digits, or as for
+ * gdbwire_mi_writer_write. The buffer is left as it was on failure.
+ */
+enum gdbwire_result gdbwire_mi_writer_write_with_token(
+        struct gdbwire_mi_writer *writer,
+        const struct gdbwire_mi_output *output, const char *token);
+
+/**
+ * Append the line of an encoded output command to the buffer.
+ *
+ * The output is written from its encoding in place, without decoding
+ * it into a tree. To write it with another token, set the token of the
+ * output read with gdbwire_mi_binary_read before writing it.
+ *
+ * @param writer
+ * The writer to use.
+ *
+ * @param output
+ * The output read with gdbwire_mi_binary_read.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the token of a record is not made of digits, or as
+ * for gdbwire_mi_writer_write. The buffer is left as it was on failure.
+ */
+enum gdbwire_result gdbwire_mi_writer_write_binary(
+        struct gdbwire_mi_writer *writer,
+        const struct gdbwire_mi_binary_output *output);
+
+/**
+ * Get the lines written since the buffer was last cleared.
+ *
+ * @param writer
+ * The writer to use.
+ *
+ * @param data
+ * Set to the lines, NUL terminated. They belong to the writer and are
+ * valid until the writer is used again or destroyed.
+ *
+ * @param size
+ * Set to the number of bytes in data, not counting the NUL.
+ */
+void gdbwire_mi_writer_get_data(struct gdbwire_mi_writer *writer,
+        const char **data, size_t *size);
+
+/**
+ * Clear the buffer, keeping its memory for the lines written next.
+ *
+ * @param writer
+ * The writer to clear.
+ */
+void gdbwire_mi_writer_clear(struct gdbwire_mi_writer *writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_MI_WRITER_H */
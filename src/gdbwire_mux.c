@@ -0,0 +1,670 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "gdbwire_assert.h"
+#include "gdbwire_mux.h"
+
+/* A record in the queue of a client */
+struct gdbwire_mux_slot {
+    /* The output, retained for the client */
+    const struct gdbwire_mi_output *output;
+    /* The number of records dropped before this one */
+    size_t dropped;
+    /* The client's token for the record, empty if none */
+    char token[GDBWIRE_MUX_TOKEN_MAX + 1];
+    /* True to hand out the token GDB wrote instead */
+    int foreign;
+};
+
+struct gdbwire_mux_client {
+    /* The multiplexer the client belongs to */
+    struct gdbwire_mux *mux;
+    /* The pointer associated with the client */
+    void *context;
+    /* The records the client subscribed to */
+    int subscriptions;
+    /* The queue, a ring of capacity slots starting at head */
+    struct gdbwire_mux_slot *slots;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    /* The number of commands sent whose results have not come yet */
+    size_t in_flight;
+    /* The number of records dropped since the last one queued */
+    size_t dropped;
+    /* The token of the record popped last */
+    char token[GDBWIRE_MUX_TOKEN_MAX + 1];
+};
+
+/* A command sent to GDB through the multiplexer */
+struct gdbwire_mux_command {
+    /* The multiplexer's token for the command */
+    uint64_t token;
+    /* The client that sent it, or NULL if the client was destroyed */
+    struct gdbwire_mux_client *client;
+    /* True once the result of the command came */
+    int done;
+    /* The client's token for the command, empty if none */
+    char client_token[GDBWIRE_MUX_TOKEN_MAX + 1];
+};
+
+struct gdbwire_mux {
+    /* The gdbwire context parsing GDB's output */
+    struct gdbwire *wire;
+    /* The callbacks of the multiplexer */
+    struct gdbwire_mux_callbacks callbacks;
+    /* The allocator the multiplexer is allocated with */
+    struct gdbwire_allocator allocator;
+
+    /* The clients, in no particular order */
+    struct gdbwire_mux_client **clients;
+    size_t clients_size;
+    size_t clients_capacity;
+
+    /**
+     * The commands in flight, a ring starting at commands_head.
+     *
+     * The commands are added with increasing tokens, so the ring is
+     * sorted by token. GDB answers the commands in the order it gets
+     * them, so the commands are mostly done from the front of the ring.
+     * A command done behind one still in flight stays in the ring,
+     * marked done, until the commands before it are done as well.
+     * The capacity is a power of 2.
+     */
+    struct gdbwire_mux_command *commands;
+    size_t commands_head;
+    size_t commands_size;
+    size_t commands_capacity;
+
+    /* The token of the next command sent */
+    uint64_t next_token;
+
+    /* The command written to GDB last */
+    char *line;
+    size_t line_capacity;
+};
+
+/**
+ * Parse a token written by GDB as one of the multiplexer's tokens.
+ *
+ * @param token
+ * The token, or NULL if none.
+ *
+ * @param value
+ * Set to the value of the token on success.
+ *
+ * @return
+ * 1 if the token may be one of the multiplexer's or 0 if not.
+ */
+static int
+gdbwire_mux_parse_token(const char *token, uint64_t *value)
+{
+    uint64_t result = 0;
+    size_t index;
+
+    if (!token || !token[0]) {
+        return 0;
+    }
+
+    for (index = 0; token[index]; ++index) {
+        unsigned digit = (unsigned)(token[index] - '0');
+        if (digit > 9 || result > (UINT64_MAX - digit) / 10) {
+            return 0;
+        }
+        result = result * 10 + digit;
+    }
+
+    *value = result;
+
+    return 1;
+}
+
+/**
+ * Find a command in flight by its token.
+ *
+ * @param mux
+ * The multiplexer.
+ *
+ * @param token
+ * The token GDB wrote, or NULL if none.
+ *
+ * @return
+ * The command or NULL if no command in flight has the token.
+ */
+static struct gdbwire_mux_command *
+gdbwire_mux_find_command(struct gdbwire_mux *mux, const char *token)
+{
+    size_t low = 0, high = mux->commands_size, mask, middle;
+    struct gdbwire_mux_command *command;
+    uint64_t value;
+
+    if (!gdbwire_mux_parse_token(token, &value)) {
+        return NULL;
+    }
+
+    mask = mux->commands_capacity - 1;
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        command = &mux->commands[(mux->commands_head + middle) & mask];
+        if (command->token < value) {
+            low = middle + 1;
+        } else if (command->token > value) {
+            high = middle;
+        } else {
+            return (command->done) ? NULL : command;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Mark a command done and drop the done commands from the front.
+ *
+ * @param mux
+ * The multiplexer.
+ *
+ * @param command
+ * The command whose result came.
+ */
+static void
+gdbwire_mux_command_done(struct gdbwire_mux *mux,
+        struct gdbwire_mux_command *command)
+{
+    size_t mask = mux->commands_capacity - 1;
+
+    command->done = 1;
+    command->client = NULL;
+
+    while (mux->commands_size > 0 &&
+            mux->commands[mux->commands_head].done) {
+        mux->commands_head = (mux->commands_head + 1) & mask;
+        --mux->commands_size;
+    }
+}
+
+/**
+ * Add an output to the queue of a client.
+ *
+ * The client must have a free slot.
+ *
+ * @param client
+ * The client.
+ *
+ * @param output
+ * The output to retain for the client.
+ *
+ * @param token
+ * The client's token for the output, or NULL if none.
+ *
+ * @param foreign
+ * True to hand out the token GDB wrote instead.
+ */
+static void
+gdbwire_mux_client_push(struct gdbwire_mux_client *client,
+        const struct gdbwire_mi_output *output, const char *token,
+        int foreign)
+{
+    struct gdbwire_mux *mux = client->mux;
+    struct gdbwire_mux_slot *slot;
+
+    slot = &client->slots[(client->head + client->count) % client->capacity];
+    slot->output = gdbwire_mi_output_retain(output);
+    slot->dropped = client->dropped;
+    slot->foreign = foreign;
+    if (token) {
+        strcpy(slot->token, token);
+    } else {
+        slot->token[0] = 0;
+    }
+
+    client->dropped = 0;
+    if (client->count++ == 0 && mux->callbacks.gdbwire_mux_ready_fn) {
+        mux->callbacks.gdbwire_mux_ready_fn(mux->callbacks.context, client);
+    }
+}
+
+/**
+ * Get the token GDB wrote for an output.
+ *
+ * @param output
+ * The output.
+ *
+ * @return
+ * The token, or NULL if the output is not a record or has no token.
+ */
+static const char *
+gdbwire_mux_output_token(const struct gdbwire_mi_output *output)
+{
+    if (output->kind == GDBWIRE_MI_OUTPUT_RESULT) {
+        return output->variant.result_record->token;
+    } else if (output->kind == GDBWIRE_MI_OUTPUT_OOB &&
+            output->variant.oob_record->kind == GDBWIRE_MI_ASYNC) {
+        return output->variant.oob_record->variant.async_record->token;
+    }
+
+    return NULL;
+}
+
+/**
+ * Hand an output parsed from GDB to the clients.
+ *
+ * The result record of a command sent through the multiplexer goes to
+ * the client that sent it, into the slot set aside for it. Any other
+ * record goes to the clients subscribed to it that have a free slot.
+ *
+ * @param context
+ * The multiplexer.
+ *
+ * @param output
+ * The output parsed from GDB.
+ */
+static void
+gdbwire_mux_output_callback(void *context,
+        const struct gdbwire_mi_output *output)
+{
+    struct gdbwire_mux *mux = (struct gdbwire_mux *)context;
+    struct gdbwire_mux_client *client;
+    struct gdbwire_mux_command *command;
+    const char *token = gdbwire_mux_output_token(output);
+    int subscription = GDBWIRE_MUX_OTHER, foreign = 0;
+    size_t index;
+
+    command = gdbwire_mux_find_command(mux, token);
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            subscription = (output->variant.oob_record->kind ==
+                GDBWIRE_MI_ASYNC) ? GDBWIRE_MUX_ASYNC : GDBWIRE_MUX_STREAM;
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            if (command) {
+                /* The slot set aside for the result is taken */
+                client = command->client;
+                if (client) {
+                    --client->in_flight;
+                    gdbwire_mux_client_push(client, output,
+                        command->client_token[0] ?
+                            command->client_token : NULL, 0);
+                }
+                gdbwire_mux_command_done(mux, command);
+                return;
+            }
+            foreign = 1;
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            subscription = GDBWIRE_MUX_PROMPT;
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            break;
+    }
+
+    for (index = 0; index < mux->clients_size; ++index) {
+        client = mux->clients[index];
+        if (!(client->subscriptions & subscription)) {
+            continue;
+        }
+
+        if (client->count + client->in_flight >= client->capacity) {
+            ++client->dropped;
+        } else if (command && command->client == client &&
+                command->client_token[0]) {
+            gdbwire_mux_client_push(client, output, command->client_token, 0);
+        } else {
+            gdbwire_mux_client_push(client, output, NULL, foreign);
+        }
+    }
+}
+
+struct gdbwire_mux *
+gdbwire_mux_create(struct gdbwire_mux_callbacks callbacks)
+{
+    return gdbwire_mux_create_with_allocator(callbacks, NULL);
+}
+
+struct gdbwire_mux *
+gdbwire_mux_create_with_allocator(struct gdbwire_mux_callbacks callbacks,
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_callbacks wire_callbacks;
+    struct gdbwire_mux *mux;
+
+    if (!gdbwire_allocator_valid(allocator) ||
+            !callbacks.gdbwire_mux_write_fn) {
+        return NULL;
+    }
+
+    mux = (struct gdbwire_mux *)gdbwire_calloc(allocator, 1,
+        sizeof (struct gdbwire_mux));
+    if (!mux) {
+        return NULL;
+    }
+
+    mux->callbacks = callbacks;
+    mux->allocator = (allocator) ? *allocator :
+        gdbwire_get_default_allocator();
+    mux->next_token = 1;
+
+    memset(&wire_callbacks, 0, sizeof (wire_callbacks));
+    mux->wire = gdbwire_create_with_allocator(wire_callbacks,
+        &mux->allocator);
+    if (!mux->wire) {
+        gdbwire_free(&mux->allocator, mux);
+        return NULL;
+    }
+    gdbwire_set_output_callback(mux->wire, gdbwire_mux_output_callback, mux);
+
+    return mux;
+}
+
+void
+gdbwire_mux_destroy(struct gdbwire_mux *mux)
+{
+    if (mux) {
+        /* The multiplexer is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = mux->allocator;
+
+        while (mux->clients_size > 0) {
+            gdbwire_mux_client_destroy(mux->clients[0]);
+        }
+
+        gdbwire_destroy(mux->wire);
+        gdbwire_free(&allocator, mux->clients);
+        gdbwire_free(&allocator, mux->commands);
+        gdbwire_free(&allocator, mux->line);
+        gdbwire_free(&allocator, mux);
+    }
+}
+
+struct gdbwire *
+gdbwire_mux_get_gdbwire(struct gdbwire_mux *mux)
+{
+    return mux->wire;
+}
+
+enum gdbwire_result
+gdbwire_mux_push_data(struct gdbwire_mux *mux, const char *data, size_t size)
+{
+    GDBWIRE_ASSERT(mux);
+
+    return gdbwire_push_data(mux->wire, data, size);
+}
+
+struct gdbwire_mux_client *
+gdbwire_mux_client_create(struct gdbwire_mux *mux, size_t capacity,
+        int subscriptions, void *context)
+{
+    struct gdbwire_mux_client *client, **clients;
+    size_t clients_capacity;
+
+    if (!mux || capacity == 0) {
+        return NULL;
+    }
+
+    if (mux->clients_size == mux->clients_capacity) {
+        clients_capacity = (mux->clients_capacity > 0) ?
+            mux->clients_capacity * 2 : 4;
+        clients = (struct gdbwire_mux_client **)gdbwire_realloc(
+            &mux->allocator, mux->clients,
+            clients_capacity * sizeof (struct gdbwire_mux_client *));
+        if (!clients) {
+            return NULL;
+        }
+        mux->clients = clients;
+        mux->clients_capacity = clients_capacity;
+    }
+
+    client = (struct gdbwire_mux_client *)gdbwire_calloc(&mux->allocator, 1,
+        sizeof (struct gdbwire_mux_client));
+    if (!client) {
+        return NULL;
+    }
+
+    client->slots = (struct gdbwire_mux_slot *)gdbwire_calloc(
+        &mux->allocator, capacity, sizeof (struct gdbwire_mux_slot));
+    if (!client->slots) {
+        gdbwire_free(&mux->allocator, client);
+        return NULL;
+    }
+
+    client->mux = mux;
+    client->context = context;
+    client->subscriptions = subscriptions;
+    client->capacity = capacity;
+    mux->clients[mux->clients_size++] = client;
+
+    return client;
+}
+
+void
+gdbwire_mux_client_destroy(struct gdbwire_mux_client *client)
+{
+    struct gdbwire_mux *mux;
+    size_t index, mask;
+
+    if (!client) {
+        return;
+    }
+
+    mux = client->mux;
+
+    for (; client->count > 0; --client->count) {
+        gdbwire_mi_output_release(client->slots[client->head].output);
+        client->head = (client->head + 1) % client->capacity;
+    }
+
+    /* The results of its commands in flight are dropped when they come */
+    mask = mux->commands_capacity - 1;
+    for (index = 0; index < mux->commands_size; ++index) {
+        struct gdbwire_mux_command *command =
+            &mux->commands[(mux->commands_head + index) & mask];
+        if (command->client == client) {
+            command->client = NULL;
+        }
+    }
+
+    for (index = 0; index < mux->clients_size; ++index) {
+        if (mux->clients[index] == client) {
+            mux->clients[index] = mux->clients[--mux->clients_size];
+            break;
+        }
+    }
+
+    gdbwire_free(&mux->allocator, client->slots);
+    gdbwire_free(&mux->allocator, client);
+}
+
+void *
+gdbwire_mux_client_get_context(struct gdbwire_mux_client *client)
+{
+    return client->context;
+}
+
+/**
+ * Make room for one more command in flight.
+ *
+ * @param mux
+ * The multiplexer.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mux_reserve_command(struct gdbwire_mux *mux)
+{
+    struct gdbwire_mux_command *commands;
+    size_t capacity, index, mask;
+
+    if (mux->commands_size < mux->commands_capacity) {
+        return GDBWIRE_OK;
+    }
+
+    capacity = (mux->commands_capacity > 0) ? mux->commands_capacity * 2 : 16;
+    commands = (struct gdbwire_mux_command *)gdbwire_calloc(&mux->allocator,
+        capacity, sizeof (struct gdbwire_mux_command));
+    if (!commands) {
+        return GDBWIRE_NOMEM;
+    }
+
+    /* The ring is unrolled to the start of the new one */
+    mask = mux->commands_capacity - 1;
+    for (index = 0; index < mux->commands_size; ++index) {
+        commands[index] = mux->commands[(mux->commands_head + index) & mask];
+    }
+
+    gdbwire_free(&mux->allocator, mux->commands);
+    mux->commands = commands;
+    mux->commands_head = 0;
+    mux->commands_capacity = capacity;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Write a command to the line buffer with the multiplexer's token.
+ *
+ * @param mux
+ * The multiplexer.
+ *
+ * @param token
+ * The multiplexer's token for the command.
+ *
+ * @param command
+ * The command, without its token and newline.
+ *
+ * @param size
+ * The number of bytes in command.
+ *
+ * @param line_size
+ * Set to the number of bytes in the line on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_mux_format(struct gdbwire_mux *mux, uint64_t token,
+        const char *command, size_t size, size_t *line_size)
+{
+    char digits[GDBWIRE_MUX_TOKEN_MAX];
+    size_t count = 0, needed, capacity;
+    char *line;
+
+    do {
+        digits[GDBWIRE_MUX_TOKEN_MAX - ++count] = (char)('0' + token % 10);
+        token /= 10;
+    } while (token > 0);
+
+    if (size > (size_t)-1 - count - 1) {
+        return GDBWIRE_NOMEM;
+    }
+    needed = count + size + 1;
+
+    if (needed > mux->line_capacity) {
+        capacity = (mux->line_capacity > 0) ? mux->line_capacity : 256;
+        while (capacity < needed) {
+            if (capacity > (size_t)-1 / 2) {
+                return GDBWIRE_NOMEM;
+            }
+            capacity *= 2;
+        }
+        line = (char *)gdbwire_realloc(&mux->allocator, mux->line, capacity);
+        if (!line) {
+            return GDBWIRE_NOMEM;
+        }
+        mux->line = line;
+        mux->line_capacity = capacity;
+    }
+
+    memcpy(mux->line, digits + GDBWIRE_MUX_TOKEN_MAX - count, count);
+    memcpy(mux->line + count, command, size);
+    mux->line[count + size] = '\n';
+    *line_size = needed;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_mux_send(struct gdbwire_mux_client *client, const char *command,
+        size_t size)
+{
+    struct gdbwire_mux *mux;
+    struct gdbwire_mux_command *entry;
+    enum gdbwire_result result;
+    size_t digits = 0, line_size;
+
+    GDBWIRE_ASSERT(client && command);
+
+    mux = client->mux;
+
+    /* A single newline may end the command */
+    if (size > 0 && command[size - 1] == '\n') {
+        --size;
+        if (size > 0 && command[size - 1] == '\r') {
+            --size;
+        }
+    }
+
+    while (digits < size && command[digits] >= '0' &&
+            command[digits] <= '9') {
+        ++digits;
+    }
+
+    if (digits > GDBWIRE_MUX_TOKEN_MAX || digits == size ||
+            memchr(command, '\n', size) || memchr(command, '\r', size)) {
+        return GDBWIRE_LOGIC;
+    }
+
+    if (client->count + client->in_flight >= client->capacity) {
+        return GDBWIRE_LOGIC;
+    }
+
+    result = gdbwire_mux_reserve_command(mux);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_mux_format(mux, mux->next_token, command + digits,
+            size - digits, &line_size);
+    }
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    entry = &mux->commands[(mux->commands_head + mux->commands_size) &
+        (mux->commands_capacity - 1)];
+    entry->token = mux->next_token++;
+    entry->client = client;
+    entry->done = 0;
+    memcpy(entry->client_token, command, digits);
+    entry->client_token[digits] = 0;
+    ++mux->commands_size;
+    ++client->in_flight;
+
+    mux->callbacks.gdbwire_mux_write_fn(mux->callbacks.context, mux->line,
+        line_size);
+
+    return GDBWIRE_OK;
+}
+
+int
+gdbwire_mux_client_pop(struct gdbwire_mux_client *client,
+        struct gdbwire_mux_event *event)
+{
+    struct gdbwire_mux_slot *slot;
+
+    if (client->count == 0) {
+        return 0;
+    }
+
+    slot = &client->slots[client->head];
+    client->head = (client->head + 1) % client->capacity;
+    --client->count;
+
+    strcpy(client->token, slot->token);
+    event->output = slot->output;
+    event->dropped = slot->dropped;
+    if (slot->foreign) {
+        event->token = gdbwire_mux_output_token(slot->output);
+    } else {
+        event->token = (client->token[0]) ? client->token : NULL;
+    }
+
+    return 1;
+}
@@ -0,0 +1,335 @@
+#ifndef GDBWIRE_MUX_H
+#define GDBWIRE_MUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "gdbwire_allocator.h"
+#include "gdbwire_result.h"
+#include "gdbwire_mi_pt.h"
+#include "gdbwire.h"
+
+/**
+ * Shares one GDB between several front ends.
+ *
+ * An IDE, a crash reporter and an automation bot may all want to talk to
+ * the same GDB session. The multiplexer sits between GDB and the front
+ * ends, its clients. It parses GDB's output once, with a gdbwire context,
+ * and hands each record to the clients that should see it.
+ *
+ * Each client numbers its commands with tokens of its own, which may
+ * clash with those of the other clients. The multiplexer writes each
+ * command to GDB with a token of its own instead, and remembers which
+ * client sent it with which token. The result record of the command is
+ * only handed to that client, along with the client's token.
+ *
+ * The asynchronous records, stream records and prompts are handed to
+ * every client that subscribed to them. Each client gets a reference to
+ * the same output, retained with gdbwire_mi_output_retain, so an output
+ * is neither copied nor parsed again however many clients get it. The
+ * client may write it back out with its own token with
+ * gdbwire_mi_writer_write_with_token.
+ *
+ * Each client has a queue of its own that holds a bounded number of
+ * records. A slot is set aside for the result of each command the client
+ * has in flight, so a result is never lost. The other records are dropped
+ * when the client's queue is full, rather than holding the records of the
+ * other clients back or buffering without bound. The client is told how
+ * many records it missed with the next record it gets.
+ *
+ * The multiplexer and its clients are used from one thread, like a
+ * gdbwire context. The outputs popped may be released on any thread.
+ *
+ * Usage:
+ *   mux = gdbwire_mux_create(callbacks);
+ *   client = gdbwire_mux_client_create(mux, 256, GDBWIRE_MUX_ALL, conn);
+ *   on a command line from a front end:
+ *     gdbwire_mux_send(client, line, size);
+ *   on output from GDB:
+ *     gdbwire_mux_push_data(mux, data, size);
+ *   when the front end of a client can take more:
+ *     while (gdbwire_mux_client_pop(client, &event))
+ *       gdbwire_mi_writer_write_with_token(writer, event.output,
+ *           event.token);
+ *       gdbwire_mi_output_release(event.output);
+ */
+struct gdbwire_mux;
+
+/* A front end sharing GDB through the multiplexer */
+struct gdbwire_mux_client;
+
+/**
+ * The largest number of digits in a token the multiplexer keeps.
+ *
+ * This is as many as the largest 64 bit number has.
+ */
+#define GDBWIRE_MUX_TOKEN_MAX 20
+
+/**
+ * The records a client subscribes to, or'd together.
+ *
+ * The result records of the commands a client sends are handed to it
+ * whatever it subscribed to.
+ */
+enum gdbwire_mux_subscription {
+    /** The console, target and log stream records. */
+    GDBWIRE_MUX_STREAM = 1 << 0,
+    /** The exec, status and notify asynchronous records. */
+    GDBWIRE_MUX_ASYNC = 1 << 1,
+    /** The prompts. */
+    GDBWIRE_MUX_PROMPT = 1 << 2,
+    /**
+     * The result records of commands not sent through the multiplexer,
+     * and the lines that failed to parse.
+     */
+    GDBWIRE_MUX_OTHER = 1 << 3,
+    /** All of the above. */
+    GDBWIRE_MUX_ALL = (1 << 4) - 1
+};
+
+/**
+ * The callbacks of the multiplexer.
+ */
+struct gdbwire_mux_callbacks {
+    /**
+     * An arbitrary pointer to pass back in each callback.
+     */
+    void *context;
+
+    /**
+     * Write a command to GDB.
+     *
+     * This must be set.
+     *
+     * @param context
+     * The context pointer above.
+     *
+     * @param data
+     * The command, with the multiplexer's token and a newline.
+     *
+     * @param size
+     * The number of bytes in data.
+     */
+    void (*gdbwire_mux_write_fn)(void *context, const char *data,
+            size_t size);
+
+    /**
+     * The queue of a client went from empty to holding a record.
+     *
+     * A caller waiting on the front ends may use this to start waiting
+     * for the client's front end to take more. This may be NULL.
+     *
+     * @param context
+     * The context pointer above.
+     *
+     * @param client
+     * The client with a record to pop.
+     */
+    void (*gdbwire_mux_ready_fn)(void *context,
+            struct gdbwire_mux_client *client);
+};
+
+/**
+ * A record popped from the queue of a client.
+ */
+struct gdbwire_mux_event {
+    /**
+     * The output, retained for the client.
+     *
+     * Release it with gdbwire_mi_output_release. The output is shared
+     * with the other clients and should not be changed. Its token is
+     * the multiplexer's, not the client's.
+     */
+    const struct gdbwire_mi_output *output;
+
+    /**
+     * The client's token for the record, or NULL if it has none.
+     *
+     * This is the token the client sent the command with, for the result
+     * record of the command and for the asynchronous records GDB writes
+     * with the command's token while it is in flight. The token of a
+     * record of another client is not handed out. The token of a result
+     * record of a command not sent through the multiplexer is the one
+     * GDB wrote. Valid until the next record is popped.
+     */
+    const char *token;
+
+    /**
+     * The number of records dropped before this one as the queue was
+     * full.
+     */
+    size_t dropped;
+};
+
+/**
+ * Create a multiplexer.
+ *
+ * @param callbacks
+ * The callbacks of the multiplexer.
+ *
+ * @return
+ * A new multiplexer or NULL on error.
+ */
+struct gdbwire_mux *gdbwire_mux_create(
+        struct gdbwire_mux_callbacks callbacks);
+
+/**
+ * Create a multiplexer that allocates with the given allocator.
+ *
+ * @param callbacks
+ * The callbacks of the multiplexer.
+ *
+ * @param allocator
+ * The allocator to copy and allocate the multiplexer, its clients and
+ * its gdbwire context with, or NULL for the default allocator.
+ *
+ * @return
+ * A new multiplexer or NULL on error.
+ */
+struct gdbwire_mux *gdbwire_mux_create_with_allocator(
+        struct gdbwire_mux_callbacks callbacks,
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the multiplexer instance and the clients it still has.
+ *
+ * The outputs the clients popped stay valid until they are released.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param mux
+ * The instance to destroy.
+ */
+void gdbwire_mux_destroy(struct gdbwire_mux *mux);
+
+/**
+ * Get the gdbwire context of the multiplexer, to set its limits or
+ * timestamps.
+ *
+ * The records are handed to the clients through the output callback of
+ * the context. The stream records delivered in chunks, see
+ * gdbwire_set_stream_threshold, are not handed to the clients.
+ *
+ * @param mux
+ * The multiplexer.
+ *
+ * @return
+ * The gdbwire context.
+ */
+struct gdbwire *gdbwire_mux_get_gdbwire(struct gdbwire_mux *mux);
+
+/**
+ * Push output from GDB into the multiplexer.
+ *
+ * The records of the complete lines are handed to the clients before
+ * this function returns.
+ *
+ * @param mux
+ * The multiplexer.
+ *
+ * @param data
+ * The output of GDB.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+enum gdbwire_result gdbwire_mux_push_data(struct gdbwire_mux *mux,
+        const char *data, size_t size);
+
+/**
+ * Add a client to the multiplexer.
+ *
+ * @param mux
+ * The multiplexer.
+ *
+ * @param capacity
+ * The number of records the client's queue holds, at least 1. This
+ * bounds the number of commands the client may have in flight as well.
+ *
+ * @param subscriptions
+ * The records the client gets, see gdbwire_mux_subscription.
+ *
+ * @param context
+ * An arbitrary pointer to associate with the client.
+ *
+ * @return
+ * A new client or NULL on error.
+ */
+struct gdbwire_mux_client *gdbwire_mux_client_create(struct gdbwire_mux *mux,
+        size_t capacity, int subscriptions, void *context);
+
+/**
+ * Remove a client from the multiplexer.
+ *
+ * The records still in its queue are released. The results of the
+ * commands it has in flight are dropped when they come.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param client
+ * The client to destroy.
+ */
+void gdbwire_mux_client_destroy(struct gdbwire_mux_client *client);
+
+/**
+ * Get the pointer associated with a client.
+ *
+ * @param client
+ * The client.
+ *
+ * @return
+ * The context passed to gdbwire_mux_client_create.
+ */
+void *gdbwire_mux_client_get_context(struct gdbwire_mux_client *client);
+
+/**
+ * Send a command of a client to GDB.
+ *
+ * The command is a single GDB/MI input command, an MI command or a CLI
+ * command, optionally starting with the client's token. Its token is
+ * replaced with one of the multiplexer's and it is written to GDB with
+ * the write callback.
+ *
+ * @param client
+ * The client sending the command.
+ *
+ * @param command
+ * The command, with or without its newline.
+ *
+ * @param size
+ * The number of bytes in command.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the command is empty, is more than one line or has
+ * a token of more than GDBWIRE_MUX_TOKEN_MAX digits, or if the client's
+ * queue has no slot left for the result. Nothing is written on failure.
+ */
+enum gdbwire_result gdbwire_mux_send(struct gdbwire_mux_client *client,
+        const char *command, size_t size);
+
+/**
+ * Take the next record from the queue of a client.
+ *
+ * @param client
+ * The client.
+ *
+ * @param event
+ * Set to the record, if there is one.
+ *
+ * @return
+ * 1 if a record was popped or 0 if the queue is empty.
+ */
+int gdbwire_mux_client_pop(struct gdbwire_mux_client *client,
+        struct gdbwire_mux_event *event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_MUX_H */
@@ -0,0 +1,665 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#include "gdbwire_assert.h"
+#include "gdbwire_sys.h"
+#include "gdbwire_recorder.h"
+
+/* The start of the log and of the index, with their version */
+#define GDBWIRE_RECORDER_LOG_MAGIC "GDBWLOG\1"
+#define GDBWIRE_RECORDER_INDEX_MAGIC "GDBWIDX\1"
+
+/* The number of bytes of the header of a chunk */
+#define GDBWIRE_RECORDER_CHUNK_HEADER_SIZE 12
+
+/* The number of bytes kept from the start of a line to classify it */
+#define GDBWIRE_RECORDER_PREFIX_SIZE 48
+
+/* The number of entries read from the index at once while searching */
+#define GDBWIRE_RECORDER_FIND_BLOCK 64
+
+struct gdbwire_recorder {
+    /* The log and the index, or NULL if there is no index */
+    FILE *log;
+    FILE *index;
+    /* The position in the log of the next chunk */
+    uint64_t log_offset;
+
+    /* True while a line has started and not ended */
+    int in_line;
+    /* The chunk the line started in and its position in the chunk */
+    uint64_t line_chunk_offset;
+    uint32_t line_offset;
+    /* The number of bytes of the line so far */
+    uint64_t line_size;
+    /* The start of the line, to classify it once it ends */
+    char prefix[GDBWIRE_RECORDER_PREFIX_SIZE];
+    size_t prefix_size;
+
+    /* The allocator the recorder is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+static void
+gdbwire_recorder_put_u32(unsigned char *data, uint32_t value)
+{
+    int index;
+
+    for (index = 0; index < 4; ++index) {
+        data[index] = (unsigned char)(value >> (index * 8));
+    }
+}
+
+static void
+gdbwire_recorder_put_u64(unsigned char *data, uint64_t value)
+{
+    int index;
+
+    for (index = 0; index < 8; ++index) {
+        data[index] = (unsigned char)(value >> (index * 8));
+    }
+}
+
+static uint32_t
+gdbwire_recorder_get_u32(const unsigned char *data)
+{
+    uint32_t value = 0;
+    int index;
+
+    for (index = 3; index >= 0; --index) {
+        value = (value << 8) | data[index];
+    }
+
+    return value;
+}
+
+static uint64_t
+gdbwire_recorder_get_u64(const unsigned char *data)
+{
+    uint64_t value = 0;
+    int index;
+
+    for (index = 7; index >= 0; --index) {
+        value = (value << 8) | data[index];
+    }
+
+    return value;
+}
+
+/**
+ * Find the class of a record by its name.
+ *
+ * @param result
+ * True for the class of a result record, false for an asynchronous one.
+ *
+ * @param name
+ * The name, not NUL terminated.
+ *
+ * @param size
+ * The number of bytes in name.
+ *
+ * @return
+ * The class, or the unsupported class if there is no class of that name.
+ */
+static int
+gdbwire_recorder_class(int result, const char *name, size_t size)
+{
+    int count = (result) ? GDBWIRE_MI_UNSUPPORTED :
+        GDBWIRE_MI_ASYNC_UNSUPPORTED;
+    const char *known;
+    int index;
+
+    for (index = 0; index < count; ++index) {
+        known = (result) ?
+            gdbwire_mi_result_class_name(
+                (enum gdbwire_mi_result_class)index) :
+            gdbwire_mi_async_class_name((enum gdbwire_mi_async_class)index);
+        if (strlen(known) == size && memcmp(known, name, size) == 0) {
+            break;
+        }
+    }
+
+    return index;
+}
+
+/**
+ * Classify a line from its start, the way the GDB/MI lexer would see it.
+ *
+ * @param recorder
+ * The recorder holding the start of the line.
+ *
+ * @param entry
+ * The kind, class and token of the entry are set.
+ */
+static void
+gdbwire_recorder_classify(struct gdbwire_recorder *recorder,
+        struct gdbwire_recorder_entry *entry)
+{
+    const char *line = recorder->prefix;
+    size_t size = recorder->prefix_size, digits = 0, start, end;
+    uint64_t token = 0;
+    int valid = 1;
+
+    entry->kind = GDBWIRE_RECORDER_OTHER;
+    entry->record_class = 0;
+    entry->token = 0;
+    entry->has_token = 0;
+
+    while (digits < size && line[digits] >= '0' && line[digits] <= '9') {
+        unsigned digit = (unsigned)(line[digits] - '0');
+        if (token > (UINT64_MAX - digit) / 10) {
+            valid = 0;
+        }
+        token = token * 10 + digit;
+        ++digits;
+    }
+
+    if (digits == size) {
+        return;
+    }
+
+    switch (line[digits]) {
+        case '~':
+        case '@':
+        case '&':
+            if (digits == 0) {
+                entry->kind = GDBWIRE_RECORDER_STREAM;
+                entry->record_class = (line[0] == '~') ? GDBWIRE_MI_CONSOLE :
+                    (line[0] == '@') ? GDBWIRE_MI_TARGET : GDBWIRE_MI_LOG;
+            }
+            return;
+        case '(':
+            if (digits == 0 && size >= 5 && memcmp(line, "(gdb)", 5) == 0) {
+                entry->kind = GDBWIRE_RECORDER_PROMPT;
+            }
+            return;
+        case '^':
+            entry->kind = GDBWIRE_RECORDER_RESULT;
+            break;
+        case '*':
+        case '+':
+        case '=':
+            entry->kind = GDBWIRE_RECORDER_ASYNC;
+            break;
+        default:
+            return;
+    }
+
+    entry->has_token = digits > 0 && valid;
+    entry->token = (entry->has_token) ? token : 0;
+
+    /* The name of the class, which may be cut short by the prefix */
+    start = end = digits + 1;
+    while (end < size && ((line[end] >= 'a' && line[end] <= 'z') ||
+            (line[end] >= 'A' && line[end] <= 'Z') ||
+            (line[end] >= '0' && line[end] <= '9') ||
+            line[end] == '_' || line[end] == '-')) {
+        ++end;
+    }
+    if (end == size && recorder->line_size > size) {
+        end = start;
+    }
+
+    entry->record_class = gdbwire_recorder_class(
+        entry->kind == GDBWIRE_RECORDER_RESULT, line + start, end - start);
+}
+
+/**
+ * Add the entry of the line that just ended to the index.
+ *
+ * @param recorder
+ * The recorder.
+ *
+ * @param time
+ * The time of the chunk the line ended in.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_ASSERT if the index could not be
+ * written.
+ */
+static enum gdbwire_result
+gdbwire_recorder_end_line(struct gdbwire_recorder *recorder, uint64_t time)
+{
+    unsigned char data[GDBWIRE_RECORDER_ENTRY_SIZE];
+    struct gdbwire_recorder_entry entry;
+
+    recorder->in_line = 0;
+    if (!recorder->index) {
+        return GDBWIRE_OK;
+    }
+
+    gdbwire_recorder_classify(recorder, &entry);
+
+    memset(data, 0, sizeof (data));
+    gdbwire_recorder_put_u64(data, recorder->line_chunk_offset);
+    gdbwire_recorder_put_u32(data + 8, recorder->line_offset);
+    gdbwire_recorder_put_u32(data + 12,
+        (recorder->line_size > UINT32_MAX) ? UINT32_MAX :
+            (uint32_t)recorder->line_size);
+    gdbwire_recorder_put_u64(data + 16, time);
+    gdbwire_recorder_put_u64(data + 24, entry.token);
+    data[32] = (unsigned char)entry.kind;
+    data[33] = (unsigned char)entry.record_class;
+    data[34] = (unsigned char)entry.has_token;
+
+    GDBWIRE_ASSERT_ERRNO(fwrite(data, sizeof (data), 1, recorder->index) == 1);
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Find the lines of a chunk just written to the log.
+ *
+ * @param recorder
+ * The recorder.
+ *
+ * @param chunk_offset
+ * The position of the chunk in the log.
+ *
+ * @param time
+ * The time of the chunk.
+ *
+ * @param data
+ * The bytes of the chunk.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_ASSERT if the index could not be
+ * written.
+ */
+static enum gdbwire_result
+gdbwire_recorder_scan(struct gdbwire_recorder *recorder,
+        uint64_t chunk_offset, uint64_t time, const char *data, size_t size)
+{
+    enum gdbwire_result result;
+    size_t index, start;
+
+    for (index = 0; index < size; ++index) {
+        if (data[index] == '\n' || data[index] == '\r') {
+            if (recorder->in_line) {
+                result = gdbwire_recorder_end_line(recorder, time);
+                if (result != GDBWIRE_OK) {
+                    return result;
+                }
+            }
+            continue;
+        }
+
+        if (!recorder->in_line) {
+            recorder->in_line = 1;
+            recorder->line_chunk_offset = chunk_offset;
+            recorder->line_offset = (uint32_t)index;
+            recorder->line_size = 0;
+            recorder->prefix_size = 0;
+        }
+
+        /* Only the start of the line is kept, the rest is counted */
+        start = index;
+        while (index + 1 < size && data[index + 1] != '\n' &&
+                data[index + 1] != '\r') {
+            ++index;
+        }
+        if (recorder->prefix_size < GDBWIRE_RECORDER_PREFIX_SIZE) {
+            size_t count = GDBWIRE_RECORDER_PREFIX_SIZE - recorder->prefix_size;
+            if (count > index + 1 - start) {
+                count = index + 1 - start;
+            }
+            memcpy(recorder->prefix + recorder->prefix_size, data + start,
+                count);
+            recorder->prefix_size += count;
+        }
+        recorder->line_size += index + 1 - start;
+    }
+
+    return GDBWIRE_OK;
+}
+
+struct gdbwire_recorder *
+gdbwire_recorder_create(FILE *log, FILE *index)
+{
+    return gdbwire_recorder_create_with_allocator(log, index, NULL);
+}
+
+struct gdbwire_recorder *
+gdbwire_recorder_create_with_allocator(FILE *log, FILE *index,
+        const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_recorder *recorder;
+
+    if (!log || !gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    if (fwrite(GDBWIRE_RECORDER_LOG_MAGIC, GDBWIRE_RECORDER_HEADER_SIZE, 1,
+            log) != 1 || (index && fwrite(GDBWIRE_RECORDER_INDEX_MAGIC,
+                GDBWIRE_RECORDER_HEADER_SIZE, 1, index) != 1)) {
+        return NULL;
+    }
+
+    recorder = (struct gdbwire_recorder *)gdbwire_calloc(allocator, 1,
+        sizeof (struct gdbwire_recorder));
+    if (recorder) {
+        recorder->log = log;
+        recorder->index = index;
+        recorder->log_offset = GDBWIRE_RECORDER_HEADER_SIZE;
+        recorder->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
+    }
+
+    return recorder;
+}
+
+void
+gdbwire_recorder_destroy(struct gdbwire_recorder *recorder)
+{
+    if (recorder) {
+        /* The recorder is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = recorder->allocator;
+
+        gdbwire_recorder_flush(recorder);
+        gdbwire_free(&allocator, recorder);
+    }
+}
+
+enum gdbwire_result
+gdbwire_recorder_push_data(struct gdbwire_recorder *recorder,
+        const char *data, size_t size)
+{
+    unsigned char header[GDBWIRE_RECORDER_CHUNK_HEADER_SIZE];
+    enum gdbwire_result result = GDBWIRE_OK;
+    uint64_t time, chunk_offset;
+    size_t count;
+
+    GDBWIRE_ASSERT(recorder && (data || size == 0));
+
+    time = gdbwire_monotonic_ns();
+
+    while (size > 0 && result == GDBWIRE_OK) {
+        count = (size > GDBWIRE_RECORDER_CHUNK_MAX) ?
+            GDBWIRE_RECORDER_CHUNK_MAX : size;
+
+        gdbwire_recorder_put_u64(header, time);
+        gdbwire_recorder_put_u32(header + 8, (uint32_t)count);
+        GDBWIRE_ASSERT_ERRNO(
+            fwrite(header, sizeof (header), 1, recorder->log) == 1 &&
+            fwrite(data, count, 1, recorder->log) == 1);
+
+        chunk_offset = recorder->log_offset;
+        recorder->log_offset += sizeof (header) + count;
+
+        result = gdbwire_recorder_scan(recorder, chunk_offset, time, data,
+            count);
+        data += count;
+        size -= count;
+    }
+
+    return result;
+}
+
+enum gdbwire_result
+gdbwire_recorder_flush(struct gdbwire_recorder *recorder)
+{
+    GDBWIRE_ASSERT(recorder);
+
+    GDBWIRE_ASSERT_ERRNO(fflush(recorder->log) == 0);
+    if (recorder->index) {
+        GDBWIRE_ASSERT_ERRNO(fflush(recorder->index) == 0);
+    }
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Check a file starts with the header of a log or an index.
+ *
+ * @param file
+ * The file, positioned at its start.
+ *
+ * @param magic
+ * The header the file should start with.
+ *
+ * @return
+ * GDBWIRE_OK if it does or GDBWIRE_LOGIC if not.
+ */
+static enum gdbwire_result
+gdbwire_recorder_check_header(FILE *file, const char *magic)
+{
+    char header[GDBWIRE_RECORDER_HEADER_SIZE];
+
+    if (fread(header, sizeof (header), 1, file) != 1 ||
+            memcmp(header, magic, sizeof (header)) != 0) {
+        return GDBWIRE_LOGIC;
+    }
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Decode an entry of the index.
+ *
+ * @param data
+ * The GDBWIRE_RECORDER_ENTRY_SIZE bytes of the entry.
+ *
+ * @param entry
+ * Set to the entry.
+ */
+static void
+gdbwire_recorder_decode(const unsigned char *data,
+        struct gdbwire_recorder_entry *entry)
+{
+    entry->chunk_offset = gdbwire_recorder_get_u64(data);
+    entry->offset = gdbwire_recorder_get_u32(data + 8);
+    entry->size = gdbwire_recorder_get_u32(data + 12);
+    entry->time = gdbwire_recorder_get_u64(data + 16);
+    entry->token = gdbwire_recorder_get_u64(data + 24);
+    entry->kind = (enum gdbwire_recorder_kind)data[32];
+    entry->record_class = data[33];
+    entry->has_token = data[34];
+}
+
+/**
+ * Seek to a position in a file.
+ *
+ * @param file
+ * The file.
+ *
+ * @param offset
+ * The position from the start of the file.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_LOGIC if the file can not be
+ * positioned there.
+ */
+static enum gdbwire_result
+gdbwire_recorder_seek(FILE *file, uint64_t offset)
+{
+    if (offset > (uint64_t)LONG_MAX ||
+            fseek(file, (long)offset, SEEK_SET) != 0) {
+        return GDBWIRE_LOGIC;
+    }
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_recorder_read_entry(FILE *index, size_t position,
+        struct gdbwire_recorder_entry *entry)
+{
+    unsigned char data[GDBWIRE_RECORDER_ENTRY_SIZE];
+    enum gdbwire_result result;
+
+    GDBWIRE_ASSERT(index && entry);
+
+    result = gdbwire_recorder_seek(index, 0);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_recorder_check_header(index,
+            GDBWIRE_RECORDER_INDEX_MAGIC);
+    }
+    if (result == GDBWIRE_OK && position > (UINT64_MAX -
+            GDBWIRE_RECORDER_HEADER_SIZE) / GDBWIRE_RECORDER_ENTRY_SIZE) {
+        result = GDBWIRE_LOGIC;
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_recorder_seek(index, GDBWIRE_RECORDER_HEADER_SIZE +
+            (uint64_t)position * GDBWIRE_RECORDER_ENTRY_SIZE);
+    }
+    if (result == GDBWIRE_OK && fread(data, sizeof (data), 1, index) != 1) {
+        result = GDBWIRE_LOGIC;
+    }
+    if (result == GDBWIRE_OK) {
+        gdbwire_recorder_decode(data, entry);
+    }
+
+    return result;
+}
+
+enum gdbwire_result
+gdbwire_recorder_find(FILE *index, int kind, int record_class,
+        const uint64_t *token, size_t nth,
+        struct gdbwire_recorder_entry *entry)
+{
+    unsigned char data[GDBWIRE_RECORDER_FIND_BLOCK *
+        GDBWIRE_RECORDER_ENTRY_SIZE];
+    struct gdbwire_recorder_entry current;
+    enum gdbwire_result result;
+    size_t count, position;
+
+    GDBWIRE_ASSERT(index && entry);
+
+    result = gdbwire_recorder_seek(index, 0);
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_recorder_check_header(index,
+            GDBWIRE_RECORDER_INDEX_MAGIC);
+    }
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    while ((count = fread(data, GDBWIRE_RECORDER_ENTRY_SIZE,
+            GDBWIRE_RECORDER_FIND_BLOCK, index)) > 0) {
+        for (position = 0; position < count; ++position) {
+            gdbwire_recorder_decode(
+                data + position * GDBWIRE_RECORDER_ENTRY_SIZE, &current);
+            if ((kind != -1 && (int)current.kind != kind) ||
+                    (record_class != -1 &&
+                        current.record_class != record_class) ||
+                    (token && (!current.has_token ||
+                        current.token != *token))) {
+                continue;
+            }
+            if (nth-- == 0) {
+                *entry = current;
+                return GDBWIRE_OK;
+            }
+        }
+    }
+
+    return GDBWIRE_LOGIC;
+}
+
+/**
+ * Read the header of a chunk.
+ *
+ * @param log
+ * The log, positioned at the chunk.
+ *
+ * @param time
+ * Set to the time of the chunk.
+ *
+ * @param size
+ * Set to the number of bytes of the chunk, or 0 at the end of the log.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_LOGIC if the header is cut short or
+ * not a chunk's.
+ */
+static enum gdbwire_result
+gdbwire_recorder_read_header(FILE *log, uint64_t *time, size_t *size)
+{
+    unsigned char header[GDBWIRE_RECORDER_CHUNK_HEADER_SIZE];
+    size_t count = fread(header, 1, sizeof (header), log);
+
+    if (count == 0 && feof(log)) {
+        *size = 0;
+        return GDBWIRE_OK;
+    } else if (count != sizeof (header)) {
+        return GDBWIRE_LOGIC;
+    }
+
+    *time = gdbwire_recorder_get_u64(header);
+    *size = gdbwire_recorder_get_u32(header + 8);
+    if (*size == 0 || *size > GDBWIRE_RECORDER_CHUNK_MAX) {
+        return GDBWIRE_LOGIC;
+    }
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_recorder_read_line(FILE *log,
+        const struct gdbwire_recorder_entry *entry, char *line)
+{
+    enum gdbwire_result result;
+    size_t done = 0, size, count, offset;
+    uint64_t time;
+
+    GDBWIRE_ASSERT(log && entry && (line || entry->size == 0));
+
+    result = gdbwire_recorder_seek(log, entry->chunk_offset);
+
+    /* The line may go on through the chunks after its first */
+    for (offset = entry->offset; result == GDBWIRE_OK && done < entry->size;
+            offset = 0) {
+        result = gdbwire_recorder_read_header(log, &time, &size);
+        if (result != GDBWIRE_OK) {
+            break;
+        }
+        if (size <= offset || fseek(log, (long)offset, SEEK_CUR) != 0) {
+            result = GDBWIRE_LOGIC;
+            break;
+        }
+
+        count = size - offset;
+        if (count > entry->size - done) {
+            count = entry->size - done;
+        }
+        if (fread(line + done, 1, count, log) != count) {
+            result = GDBWIRE_LOGIC;
+            break;
+        }
+        done += count;
+
+        /* Skip the rest of the chunk to the next header */
+        if (fseek(log, (long)(size - offset - count), SEEK_CUR) != 0) {
+            result = GDBWIRE_LOGIC;
+        }
+    }
+
+    return result;
+}
+
+enum gdbwire_result
+gdbwire_recorder_read_chunk(FILE *log, uint64_t *time, char *data,
+        size_t *size)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+
+    GDBWIRE_ASSERT(log && time && data && size);
+
+    if (ftell(log) == 0) {
+        result = gdbwire_recorder_check_header(log,
+            GDBWIRE_RECORDER_LOG_MAGIC);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_recorder_read_header(log, time, size);
+    }
+    if (result == GDBWIRE_OK && *size > 0 &&
+            fread(data, 1, *size, log) != *size) {
+        result = GDBWIRE_LOGIC;
+    }
+
+    return result;
+}
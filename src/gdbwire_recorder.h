@@ -0,0 +1,283 @@
+#ifndef GDBWIRE_RECORDER_H
+#define GDBWIRE_RECORDER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include "gdbwire_allocator.h"
+#include "gdbwire_result.h"
+#include "gdbwire_mi_pt.h"
+
+/**
+ * Records the output of GDB, with timestamps, for later analysis.
+ *
+ * After an incident, the exact bytes GDB wrote and when it wrote them
+ * are worth more than any summary. The recorder appends every chunk of
+ * output pushed into it to a log, along with the time it was pushed,
+ * and adds an entry for each line to a sidecar index.
+ *
+ * The log starts with the 7 bytes "GDBWLOG" and a version byte of 1.
+ * Each chunk follows as a 12 byte header, the time in nanoseconds of a
+ * clock that never jumps as 8 bytes and the number of bytes as 4 bytes,
+ * followed by the bytes. A push of more than GDBWIRE_RECORDER_CHUNK_MAX
+ * bytes is split into several chunks with the same time.
+ *
+ * The index starts with the 7 bytes "GDBWIDX" and a version byte of 1.
+ * Each line follows as an entry of GDBWIRE_RECORDER_ENTRY_SIZE bytes,
+ * in the order the lines end. As the entries have a fixed size, a
+ * replay tool finds the Nth *stopped record by reading the index alone,
+ * and then reads the line, or replays from it, without reading the log
+ * before it. All numbers are little endian.
+ *
+ * A line ends with a newline, a carriage return or both, the way the
+ * GDB/MI parser splits lines. Empty lines are not indexed. To keep the
+ * cost low, the kind, class and token of a line are taken from its
+ * start, without parsing it. So a line that starts like a record but
+ * fails to parse is indexed as the record it starts like.
+ */
+struct gdbwire_recorder;
+
+/** The most bytes a chunk of the log holds. */
+#define GDBWIRE_RECORDER_CHUNK_MAX 65536
+
+/** The number of bytes at the start of the log and of the index. */
+#define GDBWIRE_RECORDER_HEADER_SIZE 8
+
+/** The number of bytes of each entry of the index. */
+#define GDBWIRE_RECORDER_ENTRY_SIZE 40
+
+/**
+ * The kinds of lines in the index.
+ *
+ * Each kind is further split by its class.
+ */
+enum gdbwire_recorder_kind {
+    /** A stream record, the class is its gdbwire_mi_stream_record_kind. */
+    GDBWIRE_RECORDER_STREAM,
+    /** An async record, the class is its gdbwire_mi_async_class. */
+    GDBWIRE_RECORDER_ASYNC,
+    /** A result record, the class is its gdbwire_mi_result_class. */
+    GDBWIRE_RECORDER_RESULT,
+    /** A prompt, the class is 0. */
+    GDBWIRE_RECORDER_PROMPT,
+    /** A line that does not start like any of the above, the class is 0. */
+    GDBWIRE_RECORDER_OTHER
+};
+
+/**
+ * An entry of the index, for a line of the log.
+ */
+struct gdbwire_recorder_entry {
+    /** The position in the log of the chunk the line starts in. */
+    uint64_t chunk_offset;
+    /** The position of the line in the bytes of that chunk. */
+    uint32_t offset;
+    /** The number of bytes in the line, without its newline. */
+    uint32_t size;
+    /** The time of the chunk the line ended in. */
+    uint64_t time;
+    /** The token of the record, if has_token is set. */
+    uint64_t token;
+    /** The kind of the line. */
+    enum gdbwire_recorder_kind kind;
+    /** The class of the line, see gdbwire_recorder_kind. */
+    int record_class;
+    /**
+     * 1 if the record has a token, 0 otherwise.
+     *
+     * A token of more digits than fit in 64 bits is not indexed.
+     */
+    int has_token;
+};
+
+/**
+ * Create a recorder.
+ *
+ * The headers of the log and of the index are written before this
+ * returns. The files are written from where they are, which should be
+ * their start.
+ *
+ * @param log
+ * The file to write the chunks to. It belongs to the caller, who closes
+ * it after destroying the recorder.
+ *
+ * @param index
+ * The file to write the index to, or NULL to not write an index. It
+ * belongs to the caller as well.
+ *
+ * @return
+ * A new recorder or NULL on error.
+ */
+struct gdbwire_recorder *gdbwire_recorder_create(FILE *log, FILE *index);
+
+/**
+ * Create a recorder that allocates with the given allocator.
+ *
+ * @param log
+ * The file to write the chunks to.
+ *
+ * @param index
+ * The file to write the index to, or NULL to not write an index.
+ *
+ * @param allocator
+ * The allocator to allocate the recorder with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new recorder or NULL on error.
+ */
+struct gdbwire_recorder *gdbwire_recorder_create_with_allocator(
+        FILE *log, FILE *index, const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the recorder instance.
+ *
+ * The files are flushed but not closed. A line that has not ended is
+ * in the log but not in the index.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param recorder
+ * The instance to destroy.
+ */
+void gdbwire_recorder_destroy(struct gdbwire_recorder *recorder);
+
+/**
+ * Record output of GDB.
+ *
+ * This is called by gdbwire_push_data once the recorder is set with
+ * gdbwire_set_recorder. It may be called directly to record output that
+ * is not pushed into a gdbwire context.
+ *
+ * @param recorder
+ * The recorder.
+ *
+ * @param data
+ * The output of GDB.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_ASSERT if a file could not be written.
+ */
+enum gdbwire_result gdbwire_recorder_push_data(
+        struct gdbwire_recorder *recorder, const char *data, size_t size);
+
+/**
+ * Flush the log and the index.
+ *
+ * @param recorder
+ * The recorder.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_ASSERT if a file could not be
+ * written.
+ */
+enum gdbwire_result gdbwire_recorder_flush(struct gdbwire_recorder *recorder);
+
+/**
+ * Read an entry of an index.
+ *
+ * @param index
+ * The index.
+ *
+ * @param position
+ * The number of entries before the one to read.
+ *
+ * @param entry
+ * Set to the entry on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the file is not an index or has no such entry.
+ */
+enum gdbwire_result gdbwire_recorder_read_entry(FILE *index,
+        size_t position, struct gdbwire_recorder_entry *entry);
+
+/**
+ * Find an entry of an index, like the Nth *stopped record.
+ *
+ * Only the index is read.
+ *
+ * @param index
+ * The index.
+ *
+ * @param kind
+ * The kind of line to find, or -1 for any kind.
+ *
+ * @param record_class
+ * The class of line to find, or -1 for any class.
+ *
+ * @param token
+ * The token of the line to find, or NULL for any token.
+ *
+ * @param nth
+ * The number of matching entries to skip, 0 for the first.
+ *
+ * @param entry
+ * Set to the entry on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the file is not an index or the entry was not found.
+ */
+enum gdbwire_result gdbwire_recorder_find(FILE *index, int kind,
+        int record_class, const uint64_t *token, size_t nth,
+        struct gdbwire_recorder_entry *entry);
+
+/**
+ * Read the line of an entry from the log.
+ *
+ * @param log
+ * The log the index was written with.
+ *
+ * @param entry
+ * The entry of the line.
+ *
+ * @param line
+ * Set to the line, without its newline. It must hold entry->size bytes.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the log does not hold the line.
+ */
+enum gdbwire_result gdbwire_recorder_read_line(FILE *log,
+        const struct gdbwire_recorder_entry *entry, char *line);
+
+/**
+ * Read the next chunk of a log, to replay it.
+ *
+ * Seek to GDBWIRE_RECORDER_HEADER_SIZE to replay from the start, or to
+ * the chunk_offset of an entry to replay from its line onwards. The log
+ * is checked to be a log when read from its start.
+ *
+ * @param log
+ * The log, positioned at a chunk.
+ *
+ * @param time
+ * Set to the time of the chunk.
+ *
+ * @param data
+ * Set to the bytes of the chunk. It must hold GDBWIRE_RECORDER_CHUNK_MAX
+ * bytes.
+ *
+ * @param size
+ * Set to the number of bytes of the chunk, or 0 at the end of the log.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the file is not a log or its last chunk is cut short.
+ */
+enum gdbwire_result gdbwire_recorder_read_chunk(FILE *log, uint64_t *time,
+        char *data, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_RECORDER_H */
@@ -1,6 +1,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include "gdbwire_string.h"
+#include "gdbwire_trace.h"
 
 struct gdbwire_string {
     /* The bytes that make up the string. May contain NUL characters. */
@@ -9,15 +10,29 @@ struct gdbwire_string {
     size_t size;
     /* The max capacity of the string */
     size_t capacity;
+    /* The allocator the string and its data are allocated with */
+    struct gdbwire_allocator allocator;
 };
 
 struct gdbwire_string *
 gdbwire_string_create(void)
+{
+    return gdbwire_string_create_with_allocator(NULL);
+}
+
+struct gdbwire_string *
+gdbwire_string_create_with_allocator(const struct gdbwire_allocator *allocator)
 {
     struct gdbwire_string *string;
 
-    string = calloc(1, sizeof (struct gdbwire_string));
+    if (!gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    string = gdbwire_calloc(allocator, 1, sizeof (struct gdbwire_string));
     if (string) {
+        string->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
         if (gdbwire_string_append_cstr(string, "") == -1) {
             gdbwire_string_destroy(string);
             string = NULL;
@@ -32,12 +47,12 @@ gdbwire_string_destroy(struct gdbwire_string *string)
 {
     if (string) {
         if (string->data) {
-            free(string->data);
+            gdbwire_free(&string->allocator, string->data);
             string->data = NULL;
         }
         string->size = 0;
         string->capacity = 0;
-        free(string);
+        gdbwire_free(&string->allocator, string);
     }
 }
 
@@ -51,16 +66,16 @@ gdbwire_string_clear(struct gdbwire_string *string)
 }
 
 /**
- * Increase the size of the string capacity.
+ * Get the capacity the string grows to after the given capacity.
  *
- * @param string
- * The string to increase the capacity.
+ * @param capacity
+ * The current capacity of the string.
  *
  * @return
- * 0 on success or -1 on error.
+ * The next larger capacity.
  */
-static int
-gdbwire_string_increase_capacity(struct gdbwire_string *string)
+static size_t
+gdbwire_string_next_capacity(size_t capacity)
 {
     /**
      * The algorithm chosen to increase the capacity is arbitrary.
@@ -68,18 +83,13 @@ gdbwire_string_increase_capacity(struct gdbwire_string *string)
      *   128, 256, 512, 1024, 2048, 4096
      * After it reaches 4096 it then grows by 4096 bytes at a time.
      */
-    if (string->capacity == 0) {
-        string->capacity = 128;
-    } else if (string->capacity < 4096) {
-        string->capacity *= 2;
+    if (capacity == 0) {
+        return 128;
+    } else if (capacity < 4096) {
+        return capacity * 2;
     } else {
-        string->capacity += 4096;
+        return capacity + 4096;
     }
-
-    /* At this point string->capacity is set to the new size, so realloc */
-    string->data = (char*)realloc(string->data, string->capacity);
-
-    return (string->data) ? 0 : -1;
 }
 
 int
@@ -106,21 +116,34 @@ int
 gdbwire_string_append_data(struct gdbwire_string *string, const char *data,
         size_t size)
 {
-    int result = (string && data) ? 0 : -1;
-    size_t data_index = 0;
-
-    for (; string && data && data_index < size; ++data_index, ++string->size) {
-        if (string->size >= string->capacity) {
-            result = gdbwire_string_increase_capacity(string);
-            if (result == -1) {
-                break;
+    if (!string || !data) {
+        return -1;
+    }
+
+    /* Grow the capacity once up front rather than byte by byte */
+    if (size > 0) {
+        size_t capacity = string->capacity;
+
+        while (string->size + size > capacity) {
+            capacity = gdbwire_string_next_capacity(capacity);
+        }
+
+        if (capacity != string->capacity) {
+            char *data_new = (char*)gdbwire_realloc(&string->allocator,
+                string->data, capacity);
+            if (!data_new) {
+                return -1;
             }
+            gdbwire_trace2(buffer_grow, string->capacity, capacity);
+            string->data = data_new;
+            string->capacity = capacity;
         }
 
-        string->data[string->size] = data[data_index];
+        memcpy(string->data + string->size, data, size);
+        string->size += size;
     }
 
-    return result;
+    return 0;
 }
 
 char *
@@ -198,12 +221,8 @@ gdbwire_string_erase(struct gdbwire_string *string, size_t pos, size_t count)
             /* If so, move characters from the from position
                to the to position */
             } else {
-                char *to_cur = &data[pos], *from_cur = &data[from_pos];
-
                 /* shift everything after the erase request to the left */
-                for (; from_pos < data_size; ++from_pos, ++to_cur, ++from_cur) {
-                    *to_cur = *from_cur;
-                }
+                memmove(&data[pos], &data[from_pos], data_size - from_pos);
             }
             string->size -= count_erased;
             result = 0;
@@ -212,3 +231,67 @@ gdbwire_string_erase(struct gdbwire_string *string, size_t pos, size_t count)
 
     return result;
 }
+
+size_t
+gdbwire_string_capacity_for(struct gdbwire_string *string, size_t size)
+{
+    size_t capacity = string->capacity;
+
+    while (size > capacity) {
+        capacity = gdbwire_string_next_capacity(capacity);
+    }
+
+    return capacity;
+}
+
+int
+gdbwire_string_shrink(struct gdbwire_string *string)
+{
+    size_t needed, capacity = 0;
+    char *data_new;
+
+    if (!string) {
+        return -1;
+    }
+
+    /* Keep room for the NUL character of NUL terminated strings */
+    needed = string->size + 1;
+
+    /* Find the smallest capacity in the growth sequence holding the data */
+    if (needed > 4096) {
+        capacity = (needed + 4095) / 4096 * 4096;
+    } else {
+        do {
+            capacity = gdbwire_string_next_capacity(capacity);
+        } while (capacity < needed);
+    }
+
+    if (capacity < string->capacity) {
+        data_new = (char*)gdbwire_realloc(&string->allocator,
+            string->data, capacity);
+        if (!data_new) {
+            return -1;
+        }
+        string->data = data_new;
+        string->capacity = capacity;
+    }
+
+    return 0;
+}
+
+/* The FNV-1a prime for 64 bit hashes */
+#define GDBWIRE_FNV1A_PRIME 0x100000001b3ULL
+
+uint64_t
+gdbwire_fnv1a(uint64_t seed, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t index;
+
+    for (index = 0; index < size; ++index) {
+        seed ^= bytes[index];
+        seed *= GDBWIRE_FNV1A_PRIME;
+    }
+
+    return seed;
+}
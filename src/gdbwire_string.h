@@ -5,7 +5,9 @@
 extern "C" { 
 #endif 
 
+#include <stdint.h>
 #include <stdlib.h>
+#include "gdbwire_allocator.h"
 
 /**
  * A dynamic string representation.
@@ -40,6 +42,19 @@ struct gdbwire_string;
  */
 struct gdbwire_string *gdbwire_string_create(void);
 
+/**
+ * Create a string instance that allocates with the given allocator.
+ *
+ * @param allocator
+ * The allocator to copy and allocate the string with, or NULL for
+ * the default allocator.
+ *
+ * @return
+ * A valid string instance or NULL on error.
+ */
+struct gdbwire_string *gdbwire_string_create_with_allocator(
+        const struct gdbwire_allocator *allocator);
+
 /**
  * Destroy the string instance and it's resources.
  *
@@ -186,6 +201,59 @@ size_t gdbwire_string_find_first_of(struct gdbwire_string *string,
 int gdbwire_string_erase(struct gdbwire_string *string, size_t pos,
         size_t count);
 
+/**
+ * Get the capacity the string would grow to in order to hold some data.
+ *
+ * @param string
+ * The string to get the capacity of.
+ *
+ * @param size
+ * The number of bytes the string would hold.
+ *
+ * @return
+ * The capacity the string would have, which is its current capacity
+ * if the data already fits.
+ */
+size_t gdbwire_string_capacity_for(struct gdbwire_string *string,
+        size_t size);
+
+/**
+ * Reduce the capacity of the string to the smallest capacity that
+ * still holds its data.
+ *
+ * The string grows again as needed when data is appended to it.
+ *
+ * @param string
+ * The string to shrink.
+ *
+ * @return
+ * 0 on success or -1 on error. The string is unmodified on error.
+ */
+int gdbwire_string_shrink(struct gdbwire_string *string);
+
+/** The FNV-1a offset basis, the seed of a 64 bit hash of nothing yet. */
+#define GDBWIRE_FNV1A_BASIS 0xcbf29ce484222325ULL
+
+/**
+ * Add bytes to a 64 bit FNV-1a hash.
+ *
+ * Pass GDBWIRE_FNV1A_BASIS as the seed to start a hash, or the result
+ * of an earlier call to continue one.
+ *
+ * @param seed
+ * The hash so far.
+ *
+ * @param data
+ * The bytes to add.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * The new hash.
+ */
+uint64_t gdbwire_fnv1a(uint64_t seed, const void *data, size_t size);
+
 #ifdef __cplusplus 
 }
 #endif 
@@ -1,7 +1,13 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "gdbwire_sys.h"
+#include "gdbwire_allocator.h"
 
 char *gdbwire_strdup(const char *str)
 {
@@ -9,7 +15,7 @@ char *gdbwire_strdup(const char *str)
 
     if (str) {
         size_t length_to_allocate = strlen(str) + 1;
-        result = malloc(length_to_allocate * sizeof(char));
+        result = gdbwire_malloc(NULL, length_to_allocate * sizeof(char));
         if (result) {
             strcpy(result, str);
         }
@@ -17,3 +23,10 @@ char *gdbwire_strdup(const char *str)
 
     return result;
 }
+
+uint64_t gdbwire_monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
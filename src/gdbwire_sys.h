@@ -9,6 +9,8 @@
 extern "C" { 
 #endif 
 
+#include <stdint.h>
+
 /**
  * Duplicate a string.
  *
@@ -21,6 +23,14 @@ extern "C" {
  */
 char *gdbwire_strdup(const char *str);
 
+/**
+ * Get the time of a clock that never jumps, like CLOCK_MONOTONIC.
+ *
+ * @return
+ * The time in nanoseconds since an arbitrary starting point.
+ */
+uint64_t gdbwire_monotonic_ns(void);
+
 #ifdef __cplusplus 
 }
 #endif 
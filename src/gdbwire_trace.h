@@ -0,0 +1,53 @@
+#ifndef GDBWIRE_TRACE_H
+#define GDBWIRE_TRACE_H
+
+/**
+ * Static tracepoints on the parser's hot paths.
+ *
+ * When GDBWIRE_USDT is defined, each tracepoint is a USDT probe from
+ * sys/sdt.h in the provider gdbwire. A probe compiles to a single nop
+ * instruction until a tool like perf or bpftrace attaches to it, for
+ * instance,
+ *   bpftrace -e 'usdt:./libgdbwire.so:gdbwire:line_complete
+ *       { @bytes = hist(arg1); }'
+ *
+ * The arguments are evaluated even when no tool is attached, so they
+ * are kept to values the code already has at hand.
+ *
+ * When GDBWIRE_USDT is not defined, the tracepoints compile to nothing.
+ * Configure with --enable-usdt to define it.
+ *
+ * The probes are,
+ *   line_complete(const char *line, size_t size)
+ *     A complete line is about to be parsed.
+ *   record_parsed(int kind, int class)
+ *     A line was parsed. kind is the gdbwire_mi_output_kind and class
+ *     is the gdbwire_mi_async_class of an asynchronous record, the
+ *     gdbwire_mi_stream_record_kind of a stream record, the
+ *     gdbwire_mi_result_class of a result record or -1 otherwise.
+ *   parse_error(const char *line, size_t size, const char *token)
+ *     A line failed to parse at the token.
+ *   callback_enter(int kind)
+ *     The output callback is about to be called with a line of the
+ *     gdbwire_mi_output_kind.
+ *   callback_exit()
+ *     The output callback returned.
+ *   buffer_grow(size_t old_capacity, size_t new_capacity)
+ *     A string, like the parser's line buffer, grew.
+ */
+#ifdef GDBWIRE_USDT
+#include <sys/sdt.h>
+
+#define gdbwire_trace0(probe) DTRACE_PROBE(gdbwire, probe)
+#define gdbwire_trace1(probe, a) DTRACE_PROBE1(gdbwire, probe, a)
+#define gdbwire_trace2(probe, a, b) DTRACE_PROBE2(gdbwire, probe, a, b)
+#define gdbwire_trace3(probe, a, b, c) \
+    DTRACE_PROBE3(gdbwire, probe, a, b, c)
+#else
+#define gdbwire_trace0(probe) do { } while (0)
+#define gdbwire_trace1(probe, a) do { } while (0)
+#define gdbwire_trace2(probe, a, b) do { } while (0)
+#define gdbwire_trace3(probe, a, b, c) do { } while (0)
+#endif
+
+#endif /* GDBWIRE_TRACE_H */
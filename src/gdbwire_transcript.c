@@ -0,0 +1,1133 @@
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "gdbwire_assert.h"
+#include "gdbwire_atomic.h"
+#include "gdbwire_sys.h"
+#include "gdbwire_lz.h"
+#include "gdbwire_transcript.h"
+
+/* The start of the transcript and the end of its index, with versions */
+#define GDBWIRE_TRANSCRIPT_MAGIC "GDBWTRS\1"
+#define GDBWIRE_TRANSCRIPT_INDEX_MAGIC "GDBWTIX\1"
+
+/* The number of bytes of the start of the transcript */
+#define GDBWIRE_TRANSCRIPT_HEADER_SIZE 8
+
+/* The number of bytes of the header of a block */
+#define GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE 48
+
+/* The number of bytes of an entry of the index, a position and a header */
+#define GDBWIRE_TRANSCRIPT_ENTRY_SIZE \
+    (8 + GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE)
+
+/* The number of bytes after the index, its position and the magic */
+#define GDBWIRE_TRANSCRIPT_TRAILER_SIZE 16
+
+/* The most bytes of a time, 7 bits of 64 per byte */
+#define GDBWIRE_TRANSCRIPT_TIME_MAX 10
+
+/**
+ * The largest block size, and the largest line.
+ *
+ * These keep the sizes of a block, its lines and its times in 32 bits.
+ */
+#define GDBWIRE_TRANSCRIPT_BLOCK_SIZE_MAX (1u << 28)
+#define GDBWIRE_TRANSCRIPT_LINE_MAX (1u << 31)
+
+struct gdbwire_transcript_writer {
+    /* The transcript and the position in it of the next block */
+    FILE *file;
+    uint64_t offset;
+    /* The number of bytes of lines that fill a block */
+    size_t block_size;
+
+    /**
+     * The lines of the block, followed by the start of a line that has
+     * not ended. Only the first complete bytes are complete lines.
+     */
+    char *lines;
+    size_t size;
+    size_t complete;
+    size_t lines_capacity;
+
+    /* The time of each complete line of the block */
+    uint64_t *times;
+    uint32_t count;
+    size_t times_capacity;
+
+    /* The number of lines in the blocks written */
+    uint64_t first_line;
+    /* The time of the last push */
+    uint64_t time;
+
+    /* The block being written, its compressed lines and its times */
+    char *stored;
+    size_t stored_capacity;
+    unsigned char *encoded;
+    size_t encoded_capacity;
+
+    /* The entries of the index, written once the transcript finishes */
+    unsigned char *index;
+    size_t index_size;
+    size_t index_capacity;
+
+    /* True once the transcript is finished */
+    int finished;
+
+    /* The allocator the writer is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+struct gdbwire_transcript_reader {
+    /* The transcript, which one thread at a time reads from */
+    FILE *file;
+    pthread_mutex_t mutex;
+
+    /* The blocks of the transcript */
+    struct gdbwire_transcript_block *blocks;
+    size_t count;
+
+    /* The allocator the reader is allocated with */
+    struct gdbwire_allocator allocator;
+};
+
+static void
+gdbwire_transcript_put_u32(unsigned char *data, uint32_t value)
+{
+    int index;
+
+    for (index = 0; index < 4; ++index) {
+        data[index] = (unsigned char)(value >> (index * 8));
+    }
+}
+
+static void
+gdbwire_transcript_put_u64(unsigned char *data, uint64_t value)
+{
+    int index;
+
+    for (index = 0; index < 8; ++index) {
+        data[index] = (unsigned char)(value >> (index * 8));
+    }
+}
+
+static uint32_t
+gdbwire_transcript_get_u32(const unsigned char *data)
+{
+    uint32_t value = 0;
+    int index;
+
+    for (index = 3; index >= 0; --index) {
+        value = (value << 8) | data[index];
+    }
+
+    return value;
+}
+
+static uint64_t
+gdbwire_transcript_get_u64(const unsigned char *data)
+{
+    uint64_t value = 0;
+    int index;
+
+    for (index = 7; index >= 0; --index) {
+        value = (value << 8) | data[index];
+    }
+
+    return value;
+}
+
+/**
+ * The checksum of the lines of a block, the 32 bit FNV-1a hash.
+ *
+ * @param data
+ * The lines.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * The checksum.
+ */
+static uint32_t
+gdbwire_transcript_checksum(const char *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    size_t index;
+
+    for (index = 0; index < size; ++index) {
+        hash = (hash ^ (unsigned char)data[index]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * Grow a buffer to hold at least the given number of bytes.
+ *
+ * @param allocator
+ * The allocator of the buffer.
+ *
+ * @param data
+ * The buffer, which may be moved.
+ *
+ * @param capacity
+ * The number of bytes the buffer holds, which may be increased.
+ *
+ * @param size
+ * The number of bytes the buffer needs to hold.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_transcript_reserve(const struct gdbwire_allocator *allocator,
+        void **data, size_t *capacity, size_t size)
+{
+    size_t grown = (*capacity > 0) ? *capacity : 256;
+    void *buffer;
+
+    if (size <= *capacity) {
+        return GDBWIRE_OK;
+    }
+
+    while (grown < size) {
+        if (grown > (size_t)-1 / 2) {
+            return GDBWIRE_NOMEM;
+        }
+        grown *= 2;
+    }
+
+    buffer = gdbwire_realloc(allocator, *data, grown);
+    if (!buffer) {
+        return GDBWIRE_NOMEM;
+    }
+
+    *data = buffer;
+    *capacity = grown;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Encode the header of a block.
+ *
+ * @param block
+ * The block.
+ *
+ * @param data
+ * Set to the GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE bytes of the header.
+ */
+static void
+gdbwire_transcript_encode_header(const struct gdbwire_transcript_block *block,
+        unsigned char *data)
+{
+    memset(data, 0, GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE);
+    gdbwire_transcript_put_u64(data, block->first_line);
+    gdbwire_transcript_put_u64(data + 8, block->first_time);
+    gdbwire_transcript_put_u64(data + 16, block->last_time);
+    gdbwire_transcript_put_u32(data + 24, block->lines);
+    gdbwire_transcript_put_u32(data + 28, block->size);
+    gdbwire_transcript_put_u32(data + 32, block->stored_size);
+    gdbwire_transcript_put_u32(data + 36, block->times_size);
+    gdbwire_transcript_put_u32(data + 40, block->checksum);
+}
+
+/**
+ * Decode the header of a block.
+ *
+ * @param data
+ * The GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE bytes of the header.
+ *
+ * @param block
+ * Set to the block, all but its offset.
+ */
+static void
+gdbwire_transcript_decode_header(const unsigned char *data,
+        struct gdbwire_transcript_block *block)
+{
+    block->first_line = gdbwire_transcript_get_u64(data);
+    block->first_time = gdbwire_transcript_get_u64(data + 8);
+    block->last_time = gdbwire_transcript_get_u64(data + 16);
+    block->lines = gdbwire_transcript_get_u32(data + 24);
+    block->size = gdbwire_transcript_get_u32(data + 28);
+    block->stored_size = gdbwire_transcript_get_u32(data + 32);
+    block->times_size = gdbwire_transcript_get_u32(data + 36);
+    block->checksum = gdbwire_transcript_get_u32(data + 40);
+}
+
+/**
+ * Compress and write the complete lines of the writer as a block.
+ *
+ * @param writer
+ * The writer, with at least one complete line.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_transcript_write_block(struct gdbwire_transcript_writer *writer)
+{
+    unsigned char header[GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE];
+    struct gdbwire_transcript_block block;
+    enum gdbwire_result result;
+    uint64_t previous, delta;
+    const char *stored;
+    size_t stored_size, times_size = 0;
+    uint32_t line;
+
+    result = gdbwire_transcript_reserve(&writer->allocator,
+        (void **)&writer->stored, &writer->stored_capacity,
+        gdbwire_lz_bound(writer->complete));
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_transcript_reserve(&writer->allocator,
+            (void **)&writer->encoded, &writer->encoded_capacity,
+            (size_t)writer->count * GDBWIRE_TRANSCRIPT_TIME_MAX);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_transcript_reserve(&writer->allocator,
+            (void **)&writer->index, &writer->index_capacity,
+            writer->index_size + GDBWIRE_TRANSCRIPT_ENTRY_SIZE);
+    }
+    if (result == GDBWIRE_OK) {
+        result = gdbwire_lz_compress(writer->lines, writer->complete,
+            writer->stored, writer->stored_capacity, &stored_size);
+    }
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    /* Lines that do not compress are stored as they are */
+    stored = writer->stored;
+    if (stored_size >= writer->complete) {
+        stored = writer->lines;
+        stored_size = writer->complete;
+    }
+
+    previous = writer->times[0];
+    for (line = 0; line < writer->count; ++line) {
+        delta = writer->times[line] - previous;
+        previous = writer->times[line];
+        while (delta >= 0x80) {
+            writer->encoded[times_size++] = (unsigned char)(delta | 0x80);
+            delta >>= 7;
+        }
+        writer->encoded[times_size++] = (unsigned char)delta;
+    }
+
+    block.offset = writer->offset;
+    block.first_line = writer->first_line;
+    block.first_time = writer->times[0];
+    block.last_time = writer->times[writer->count - 1];
+    block.lines = writer->count;
+    block.size = (uint32_t)writer->complete;
+    block.stored_size = (uint32_t)stored_size;
+    block.times_size = (uint32_t)times_size;
+    block.checksum = gdbwire_transcript_checksum(writer->lines,
+        writer->complete);
+
+    gdbwire_transcript_encode_header(&block, header);
+    GDBWIRE_ASSERT_ERRNO(
+        fwrite(header, sizeof (header), 1, writer->file) == 1 &&
+        fwrite(stored, stored_size, 1, writer->file) == 1 &&
+        fwrite(writer->encoded, times_size, 1, writer->file) == 1);
+
+    gdbwire_transcript_put_u64(writer->index + writer->index_size,
+        block.offset);
+    memcpy(writer->index + writer->index_size + 8, header, sizeof (header));
+    writer->index_size += GDBWIRE_TRANSCRIPT_ENTRY_SIZE;
+
+    writer->offset += sizeof (header) + stored_size + times_size;
+    writer->first_line += writer->count;
+    writer->count = 0;
+
+    /* Keep the start of the line that has not ended */
+    memmove(writer->lines, writer->lines + writer->complete,
+        writer->size - writer->complete);
+    writer->size -= writer->complete;
+    writer->complete = 0;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * End the line the writer has the start of.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_transcript_end_line(struct gdbwire_transcript_writer *writer)
+{
+    enum gdbwire_result result;
+
+    result = gdbwire_transcript_reserve(&writer->allocator,
+        (void **)&writer->times, &writer->times_capacity,
+        ((size_t)writer->count + 1) * sizeof (uint64_t));
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    writer->times[writer->count++] = writer->time;
+    writer->complete = writer->size;
+
+    if (writer->complete >= writer->block_size) {
+        result = gdbwire_transcript_write_block(writer);
+    }
+
+    return result;
+}
+
+struct gdbwire_transcript_writer *
+gdbwire_transcript_writer_create(FILE *file, size_t block_size)
+{
+    return gdbwire_transcript_writer_create_with_allocator(file, block_size,
+        NULL);
+}
+
+struct gdbwire_transcript_writer *
+gdbwire_transcript_writer_create_with_allocator(FILE *file,
+        size_t block_size, const struct gdbwire_allocator *allocator)
+{
+    struct gdbwire_transcript_writer *writer;
+
+    if (!file || block_size > GDBWIRE_TRANSCRIPT_BLOCK_SIZE_MAX ||
+            !gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    if (fwrite(GDBWIRE_TRANSCRIPT_MAGIC, GDBWIRE_TRANSCRIPT_HEADER_SIZE, 1,
+            file) != 1) {
+        return NULL;
+    }
+
+    writer = (struct gdbwire_transcript_writer *)gdbwire_calloc(allocator,
+        1, sizeof (struct gdbwire_transcript_writer));
+    if (writer) {
+        writer->file = file;
+        writer->offset = GDBWIRE_TRANSCRIPT_HEADER_SIZE;
+        writer->block_size = (block_size > 0) ? block_size :
+            GDBWIRE_TRANSCRIPT_BLOCK_SIZE;
+        writer->allocator = (allocator) ? *allocator :
+            gdbwire_get_default_allocator();
+    }
+
+    return writer;
+}
+
+void
+gdbwire_transcript_writer_destroy(struct gdbwire_transcript_writer *writer)
+{
+    if (writer) {
+        /* The writer is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = writer->allocator;
+
+        if (!writer->finished) {
+            gdbwire_transcript_writer_finish(writer);
+        }
+
+        gdbwire_free(&allocator, writer->lines);
+        gdbwire_free(&allocator, writer->times);
+        gdbwire_free(&allocator, writer->stored);
+        gdbwire_free(&allocator, writer->encoded);
+        gdbwire_free(&allocator, writer->index);
+        gdbwire_free(&allocator, writer);
+    }
+}
+
+enum gdbwire_result
+gdbwire_transcript_writer_push_data(struct gdbwire_transcript_writer *writer,
+        const char *data, size_t size)
+{
+    return gdbwire_transcript_writer_push_data_at(writer,
+        gdbwire_monotonic_ns(), data, size);
+}
+
+enum gdbwire_result
+gdbwire_transcript_writer_push_data_at(
+        struct gdbwire_transcript_writer *writer, uint64_t time,
+        const char *data, size_t size)
+{
+    enum gdbwire_result result = GDBWIRE_OK;
+    const char *newline;
+    size_t count;
+
+    GDBWIRE_ASSERT(writer && (data || size == 0));
+
+    if (writer->finished || time < writer->time) {
+        return GDBWIRE_LOGIC;
+    }
+    writer->time = time;
+
+    while (size > 0 && result == GDBWIRE_OK) {
+        newline = (const char *)memchr(data, '\n', size);
+        count = (newline) ? (size_t)(newline - data) + 1 : size;
+
+        if (count > GDBWIRE_TRANSCRIPT_LINE_MAX -
+                (writer->size - writer->complete)) {
+            return GDBWIRE_LOGIC;
+        }
+
+        result = gdbwire_transcript_reserve(&writer->allocator,
+            (void **)&writer->lines, &writer->lines_capacity,
+            writer->size + count);
+        if (result != GDBWIRE_OK) {
+            break;
+        }
+        memcpy(writer->lines + writer->size, data, count);
+        writer->size += count;
+        data += count;
+        size -= count;
+
+        if (newline) {
+            result = gdbwire_transcript_end_line(writer);
+        }
+    }
+
+    return result;
+}
+
+enum gdbwire_result
+gdbwire_transcript_writer_finish(struct gdbwire_transcript_writer *writer)
+{
+    unsigned char trailer[GDBWIRE_TRANSCRIPT_TRAILER_SIZE];
+    enum gdbwire_result result = GDBWIRE_OK;
+
+    GDBWIRE_ASSERT(writer);
+
+    if (writer->finished) {
+        return GDBWIRE_LOGIC;
+    }
+    writer->finished = 1;
+
+    if (writer->size > writer->complete) {
+        result = gdbwire_transcript_end_line(writer);
+    }
+    if (result == GDBWIRE_OK && writer->count > 0) {
+        result = gdbwire_transcript_write_block(writer);
+    }
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    gdbwire_transcript_put_u64(trailer, writer->offset);
+    memcpy(trailer + 8, GDBWIRE_TRANSCRIPT_INDEX_MAGIC, 8);
+    GDBWIRE_ASSERT_ERRNO(
+        (writer->index_size == 0 || fwrite(writer->index, writer->index_size,
+            1, writer->file) == 1) &&
+        fwrite(trailer, sizeof (trailer), 1, writer->file) == 1 &&
+        fflush(writer->file) == 0);
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Seek to a position in a file.
+ *
+ * @param file
+ * The file.
+ *
+ * @param offset
+ * The position from the start of the file.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_LOGIC if the file can not be
+ * positioned there.
+ */
+static enum gdbwire_result
+gdbwire_transcript_seek(FILE *file, uint64_t offset)
+{
+    if (offset > (uint64_t)LONG_MAX ||
+            fseek(file, (long)offset, SEEK_SET) != 0) {
+        return GDBWIRE_LOGIC;
+    }
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Check a block fits the file and follows the block before it.
+ *
+ * @param block
+ * The block.
+ *
+ * @param previous
+ * The block before it, or NULL for the first block.
+ *
+ * @param end
+ * The position in the file the block must end by.
+ *
+ * @return
+ * True if the block is valid, false otherwise.
+ */
+static int
+gdbwire_transcript_valid(const struct gdbwire_transcript_block *block,
+        const struct gdbwire_transcript_block *previous, uint64_t end)
+{
+    uint64_t expected_line = (previous) ?
+        previous->first_line + previous->lines : 0;
+    uint64_t expected_offset = (previous) ? previous->offset +
+        GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE + previous->stored_size +
+            previous->times_size : GDBWIRE_TRANSCRIPT_HEADER_SIZE;
+
+    return block->offset == expected_offset &&
+        block->first_line == expected_line &&
+        (!previous || block->first_time >= previous->last_time) &&
+        block->last_time >= block->first_time &&
+        block->lines > 0 && block->size >= block->lines &&
+        block->stored_size <= block->size &&
+        block->times_size >= block->lines &&
+        block->times_size / GDBWIRE_TRANSCRIPT_TIME_MAX <= block->lines &&
+        block->offset + GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE +
+            block->stored_size + block->times_size <= end;
+}
+
+/**
+ * Add a block to the blocks of the reader.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param capacity
+ * The number of blocks the reader has room for, which may be increased.
+ *
+ * @param block
+ * The block.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_transcript_add_block(struct gdbwire_transcript_reader *reader,
+        size_t *capacity, const struct gdbwire_transcript_block *block)
+{
+    size_t bytes = *capacity * sizeof (struct gdbwire_transcript_block);
+    enum gdbwire_result result;
+
+    result = gdbwire_transcript_reserve(&reader->allocator,
+        (void **)&reader->blocks, &bytes,
+        (reader->count + 1) * sizeof (struct gdbwire_transcript_block));
+    if (result == GDBWIRE_OK) {
+        *capacity = bytes / sizeof (struct gdbwire_transcript_block);
+        reader->blocks[reader->count++] = *block;
+    }
+
+    return result;
+}
+
+/**
+ * Load the blocks of a finished transcript from its index.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param end
+ * The size of the file.
+ *
+ * @return
+ * GDBWIRE_OK on success, GDBWIRE_LOGIC if the transcript has no valid
+ * index or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_transcript_load_index(struct gdbwire_transcript_reader *reader,
+        uint64_t end)
+{
+    unsigned char trailer[GDBWIRE_TRANSCRIPT_TRAILER_SIZE];
+    struct gdbwire_transcript_block block;
+    enum gdbwire_result result;
+    unsigned char *index;
+    uint64_t position, size;
+    size_t capacity = 0, entry;
+
+    if (end < GDBWIRE_TRANSCRIPT_HEADER_SIZE +
+                GDBWIRE_TRANSCRIPT_TRAILER_SIZE ||
+            gdbwire_transcript_seek(reader->file,
+                end - GDBWIRE_TRANSCRIPT_TRAILER_SIZE) != GDBWIRE_OK ||
+            fread(trailer, sizeof (trailer), 1, reader->file) != 1 ||
+            memcmp(trailer + 8, GDBWIRE_TRANSCRIPT_INDEX_MAGIC, 8) != 0) {
+        return GDBWIRE_LOGIC;
+    }
+
+    position = gdbwire_transcript_get_u64(trailer);
+    if (position < GDBWIRE_TRANSCRIPT_HEADER_SIZE ||
+            position > end - GDBWIRE_TRANSCRIPT_TRAILER_SIZE) {
+        return GDBWIRE_LOGIC;
+    }
+    size = end - GDBWIRE_TRANSCRIPT_TRAILER_SIZE - position;
+    if (size % GDBWIRE_TRANSCRIPT_ENTRY_SIZE != 0 || size > (size_t)-1) {
+        return GDBWIRE_LOGIC;
+    }
+    if (size == 0) {
+        return GDBWIRE_OK;
+    }
+
+    index = (unsigned char *)gdbwire_malloc(&reader->allocator,
+        (size_t)size);
+    if (!index) {
+        return GDBWIRE_NOMEM;
+    }
+
+    result = gdbwire_transcript_seek(reader->file, position);
+    if (result == GDBWIRE_OK &&
+            fread(index, (size_t)size, 1, reader->file) != 1) {
+        result = GDBWIRE_LOGIC;
+    }
+
+    for (entry = 0; result == GDBWIRE_OK && entry < size;
+            entry += GDBWIRE_TRANSCRIPT_ENTRY_SIZE) {
+        block.offset = gdbwire_transcript_get_u64(index + entry);
+        gdbwire_transcript_decode_header(index + entry + 8, &block);
+        if (!gdbwire_transcript_valid(&block, (reader->count > 0) ?
+                &reader->blocks[reader->count - 1] : NULL, position)) {
+            result = GDBWIRE_LOGIC;
+        } else {
+            result = gdbwire_transcript_add_block(reader, &capacity, &block);
+        }
+    }
+
+    gdbwire_free(&reader->allocator, index);
+
+    return result;
+}
+
+/**
+ * Find the blocks of a transcript that was not finished, from their
+ * headers, up to the first that is cut short or not valid.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param end
+ * The size of the file.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_NOMEM if out of memory.
+ */
+static enum gdbwire_result
+gdbwire_transcript_scan(struct gdbwire_transcript_reader *reader,
+        uint64_t end)
+{
+    unsigned char header[GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE];
+    struct gdbwire_transcript_block block;
+    enum gdbwire_result result = GDBWIRE_OK;
+    uint64_t offset = GDBWIRE_TRANSCRIPT_HEADER_SIZE;
+    size_t capacity = 0;
+
+    while (result == GDBWIRE_OK &&
+            gdbwire_transcript_seek(reader->file, offset) == GDBWIRE_OK &&
+            fread(header, sizeof (header), 1, reader->file) == 1) {
+        block.offset = offset;
+        gdbwire_transcript_decode_header(header, &block);
+        if (!gdbwire_transcript_valid(&block, (reader->count > 0) ?
+                &reader->blocks[reader->count - 1] : NULL, end)) {
+            break;
+        }
+
+        result = gdbwire_transcript_add_block(reader, &capacity, &block);
+        offset += sizeof (header) + block.stored_size + block.times_size;
+    }
+
+    return result;
+}
+
+struct gdbwire_transcript_reader *
+gdbwire_transcript_reader_create(FILE *file)
+{
+    return gdbwire_transcript_reader_create_with_allocator(file, NULL);
+}
+
+struct gdbwire_transcript_reader *
+gdbwire_transcript_reader_create_with_allocator(FILE *file,
+        const struct gdbwire_allocator *allocator)
+{
+    char magic[GDBWIRE_TRANSCRIPT_HEADER_SIZE];
+    struct gdbwire_transcript_reader *reader;
+    enum gdbwire_result result;
+    long end;
+
+    if (!file || !gdbwire_allocator_valid(allocator)) {
+        return NULL;
+    }
+
+    if (fseek(file, 0, SEEK_SET) != 0 ||
+            fread(magic, sizeof (magic), 1, file) != 1 ||
+            memcmp(magic, GDBWIRE_TRANSCRIPT_MAGIC, sizeof (magic)) != 0 ||
+            fseek(file, 0, SEEK_END) != 0 || (end = ftell(file)) < 0) {
+        return NULL;
+    }
+
+    reader = (struct gdbwire_transcript_reader *)gdbwire_calloc(allocator,
+        1, sizeof (struct gdbwire_transcript_reader));
+    if (!reader) {
+        return NULL;
+    }
+
+    reader->file = file;
+    reader->allocator = (allocator) ? *allocator :
+        gdbwire_get_default_allocator();
+
+    result = gdbwire_transcript_load_index(reader, (uint64_t)end);
+    if (result == GDBWIRE_LOGIC) {
+        reader->count = 0;
+        result = gdbwire_transcript_scan(reader, (uint64_t)end);
+    }
+
+    if (result != GDBWIRE_OK ||
+            pthread_mutex_init(&reader->mutex, NULL) != 0) {
+        gdbwire_free(&reader->allocator, reader->blocks);
+        gdbwire_free(&reader->allocator, reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+void
+gdbwire_transcript_reader_destroy(struct gdbwire_transcript_reader *reader)
+{
+    if (reader) {
+        /* The reader is freed with the allocator it holds */
+        struct gdbwire_allocator allocator = reader->allocator;
+
+        pthread_mutex_destroy(&reader->mutex);
+        gdbwire_free(&allocator, reader->blocks);
+        gdbwire_free(&allocator, reader);
+    }
+}
+
+size_t
+gdbwire_transcript_reader_count(
+        const struct gdbwire_transcript_reader *reader)
+{
+    return (reader) ? reader->count : 0;
+}
+
+enum gdbwire_result
+gdbwire_transcript_reader_block(
+        const struct gdbwire_transcript_reader *reader, size_t index,
+        struct gdbwire_transcript_block *block)
+{
+    GDBWIRE_ASSERT(reader && block);
+
+    if (index >= reader->count) {
+        return GDBWIRE_LOGIC;
+    }
+
+    *block = reader->blocks[index];
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_transcript_reader_find_line(
+        const struct gdbwire_transcript_reader *reader, uint64_t line,
+        size_t *index)
+{
+    size_t low = 0, high, middle;
+
+    GDBWIRE_ASSERT(reader && index);
+
+    /* Find the first block that ends after the line */
+    high = reader->count;
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (reader->blocks[middle].first_line +
+                reader->blocks[middle].lines <= line) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low == reader->count) {
+        return GDBWIRE_LOGIC;
+    }
+
+    *index = low;
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_transcript_reader_find_time(
+        const struct gdbwire_transcript_reader *reader, uint64_t time,
+        size_t *index)
+{
+    size_t low = 0, high, middle;
+
+    GDBWIRE_ASSERT(reader && index);
+
+    /* Find the first block that ends at or after the time */
+    high = reader->count;
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (reader->blocks[middle].last_time < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low == reader->count) {
+        return GDBWIRE_LOGIC;
+    }
+
+    *index = low;
+
+    return GDBWIRE_OK;
+}
+
+/**
+ * Decode a block, reading it into a buffer of the caller.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param block
+ * The block.
+ *
+ * @param buffer
+ * The buffer to read the block into, which may be grown.
+ *
+ * @param capacity
+ * The number of bytes of the buffer, which may be increased.
+ *
+ * @param lines
+ * Set to the lines of the block.
+ *
+ * @param times
+ * Set to the times of the lines of the block.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ */
+static enum gdbwire_result
+gdbwire_transcript_decode(struct gdbwire_transcript_reader *reader,
+        const struct gdbwire_transcript_block *block, char **buffer,
+        size_t *capacity, char *lines, uint64_t *times)
+{
+    size_t stored = block->stored_size, size, position = 0;
+    const unsigned char *encoded;
+    enum gdbwire_result result;
+    uint64_t time = block->first_time, delta;
+    uint32_t line;
+    int shift;
+
+    result = gdbwire_transcript_reserve(&reader->allocator, (void **)buffer,
+        capacity, stored + block->times_size);
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    /* Only the read is made one thread at a time */
+    pthread_mutex_lock(&reader->mutex);
+    result = gdbwire_transcript_seek(reader->file,
+        block->offset + GDBWIRE_TRANSCRIPT_BLOCK_HEADER_SIZE);
+    if (result == GDBWIRE_OK && fread(*buffer, stored + block->times_size, 1,
+            reader->file) != 1) {
+        result = GDBWIRE_LOGIC;
+    }
+    pthread_mutex_unlock(&reader->mutex);
+    if (result != GDBWIRE_OK) {
+        return result;
+    }
+
+    if (stored == block->size) {
+        memcpy(lines, *buffer, stored);
+    } else if (gdbwire_lz_decompress(*buffer, stored, lines, block->size,
+            &size) != GDBWIRE_OK || size != block->size) {
+        return GDBWIRE_LOGIC;
+    }
+    if (gdbwire_transcript_checksum(lines, block->size) != block->checksum) {
+        return GDBWIRE_LOGIC;
+    }
+
+    encoded = (const unsigned char *)*buffer + stored;
+    for (line = 0; line < block->lines; ++line) {
+        delta = 0;
+        shift = 0;
+        do {
+            if (position == block->times_size || shift > 63) {
+                return GDBWIRE_LOGIC;
+            }
+            delta |= (uint64_t)(encoded[position] & 0x7f) << shift;
+            shift += 7;
+        } while (encoded[position++] & 0x80);
+        time += delta;
+        times[line] = time;
+    }
+    if (position != block->times_size || time != block->last_time) {
+        return GDBWIRE_LOGIC;
+    }
+
+    return GDBWIRE_OK;
+}
+
+enum gdbwire_result
+gdbwire_transcript_reader_decode(struct gdbwire_transcript_reader *reader,
+        size_t index, char *lines, uint64_t *times)
+{
+    enum gdbwire_result result;
+    char *buffer = NULL;
+    size_t capacity = 0;
+
+    GDBWIRE_ASSERT(reader && lines && times);
+
+    if (index >= reader->count) {
+        return GDBWIRE_LOGIC;
+    }
+
+    result = gdbwire_transcript_decode(reader, &reader->blocks[index],
+        &buffer, &capacity, lines, times);
+    gdbwire_free(&reader->allocator, buffer);
+
+    return result;
+}
+
+/* The blocks to decode, shared by all of the workers */
+struct gdbwire_transcript_batch {
+    struct gdbwire_transcript_reader *reader;
+    size_t first;
+    size_t count;
+    gdbwire_transcript_block_fn callback;
+    void *context;
+
+    /* The number of blocks claimed by a worker so far */
+    size_t next;
+    /* GDBWIRE_OK, or the result of a block that failed */
+    int result;
+};
+
+/* A worker decoding its share of the blocks */
+struct gdbwire_transcript_worker {
+    struct gdbwire_transcript_batch *batch;
+    size_t number;
+    pthread_t thread;
+};
+
+static void *
+gdbwire_transcript_worker_run(void *arg)
+{
+    struct gdbwire_transcript_worker *worker =
+        (struct gdbwire_transcript_worker *)arg;
+    struct gdbwire_transcript_batch *batch = worker->batch;
+    struct gdbwire_transcript_reader *reader = batch->reader;
+    const struct gdbwire_transcript_block *block;
+    char *buffer = NULL, *lines = NULL;
+    uint64_t *times = NULL;
+    size_t buffer_capacity = 0, lines_capacity = 0, times_capacity = 0;
+    enum gdbwire_result result;
+    size_t index;
+
+    /* The buffers of a worker are reused from block to block */
+    for (;;) {
+        index = gdbwire_atomic_fetch_add(&batch->next, 1);
+        if (index >= batch->count) {
+            break;
+        }
+        index += batch->first;
+        block = &reader->blocks[index];
+
+        result = gdbwire_transcript_reserve(&reader->allocator,
+            (void **)&lines, &lines_capacity, block->size);
+        if (result == GDBWIRE_OK) {
+            result = gdbwire_transcript_reserve(&reader->allocator,
+                (void **)&times, &times_capacity,
+                (size_t)block->lines * sizeof (uint64_t));
+        }
+        if (result == GDBWIRE_OK) {
+            result = gdbwire_transcript_decode(reader, block, &buffer,
+                &buffer_capacity, lines, times);
+        }
+
+        if (result == GDBWIRE_OK) {
+            batch->callback(batch->context, worker->number, index, block,
+                lines, times);
+        } else {
+            gdbwire_atomic_store(&batch->result, (int)result);
+        }
+    }
+
+    gdbwire_free(&reader->allocator, buffer);
+    gdbwire_free(&reader->allocator, lines);
+    gdbwire_free(&reader->allocator, times);
+
+    return NULL;
+}
+
+enum gdbwire_result
+gdbwire_transcript_reader_decode_parallel(
+        struct gdbwire_transcript_reader *reader, size_t first,
+        size_t count, size_t threads, gdbwire_transcript_block_fn callback,
+        void *context)
+{
+    struct gdbwire_transcript_batch batch;
+    struct gdbwire_transcript_worker *workers;
+    size_t index, started;
+
+    GDBWIRE_ASSERT(reader && callback);
+
+    if (first > reader->count || count > reader->count - first) {
+        return GDBWIRE_LOGIC;
+    }
+
+    if (threads == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (processors > 0) ? (size_t)processors : 1;
+    }
+
+    /* There is no point in more workers than blocks */
+    if (threads > count) {
+        threads = (count > 0) ? count : 1;
+    }
+
+    batch.reader = reader;
+    batch.first = first;
+    batch.count = count;
+    batch.callback = callback;
+    batch.context = context;
+    batch.next = 0;
+    batch.result = GDBWIRE_OK;
+
+    workers = (struct gdbwire_transcript_worker *)gdbwire_calloc(
+        &reader->allocator, threads,
+            sizeof (struct gdbwire_transcript_worker));
+    if (!workers) {
+        return GDBWIRE_NOMEM;
+    }
+
+    for (index = 0; index < threads; ++index) {
+        workers[index].batch = &batch;
+        workers[index].number = index;
+    }
+
+    /**
+     * The calling thread is the first worker.
+     *
+     * If a thread can not be started, the workers that did start
+     * decode its share of the blocks.
+     */
+    for (started = 1; started < threads; ++started) {
+        if (pthread_create(&workers[started].thread, NULL,
+                gdbwire_transcript_worker_run, &workers[started]) != 0) {
+            break;
+        }
+    }
+
+    gdbwire_transcript_worker_run(&workers[0]);
+
+    for (index = 1; index < started; ++index) {
+        pthread_join(workers[index].thread, NULL);
+    }
+
+    gdbwire_free(&reader->allocator, workers);
+
+    return (enum gdbwire_result)batch.result;
+}
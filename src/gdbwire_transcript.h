@@ -0,0 +1,413 @@
+#ifndef GDBWIRE_TRANSCRIPT_H
+#define GDBWIRE_TRANSCRIPT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include "gdbwire_allocator.h"
+#include "gdbwire_result.h"
+
+/**
+ * A compressed transcript of the output of GDB, in blocks that are
+ * read independently.
+ *
+ * The transcript of a long session runs to gigabytes. It compresses
+ * about tenfold with gdbwire_lz, but a transcript compressed as a whole
+ * can only be read from its start, by one thread. So the lines of the
+ * transcript are grouped into blocks of about the same size, and each
+ * block is compressed on its own. A block never splits a line. A replay
+ * tool seeks to the block holding a line number or a time, and decodes
+ * and parses the blocks on as many threads as there are processors.
+ *
+ * A line ends with a newline, which is kept with the line. A line may
+ * be longer than a block, in which case its block holds it alone.
+ * Each line has the time it was pushed, or the time of the push it
+ * ended in if it came in several pushes.
+ *
+ * The file starts with the 7 bytes "GDBWTRS" and a version byte of 1.
+ * Each block follows as a 48 byte header and the compressed lines,
+ * followed by the time of each line as the difference from the line
+ * before it, 7 bits per byte with the high bit set on all bytes but
+ * the last. The header holds the number of lines before the block, the
+ * times of its first and last lines as 8 bytes each, then the number
+ * of lines, the number of bytes of lines, the number of bytes they
+ * compressed to, the number of bytes of times and a checksum of the
+ * lines as 4 bytes each, and 4 bytes of 0. Lines that do not compress
+ * are stored as they are, with the same number of compressed bytes.
+ * All numbers are little endian.
+ *
+ * Once the transcript is finished, the header of each block is
+ * repeated in an index at the end of the file, preceded by the position
+ * of the block as 8 bytes. The index is followed by its position as 8
+ * bytes and the 7 bytes "GDBWTIX" and a version byte of 1. A reader
+ * loads the index with one read. Without it, as when the writer did not
+ * finish, a reader finds the blocks by reading each of their headers.
+ */
+struct gdbwire_transcript_writer;
+struct gdbwire_transcript_reader;
+
+/** The number of bytes of lines in a block if none is given. */
+#define GDBWIRE_TRANSCRIPT_BLOCK_SIZE 262144
+
+/**
+ * A block of a transcript.
+ */
+struct gdbwire_transcript_block {
+    /** The position of the block in the file. */
+    uint64_t offset;
+    /** The number of lines in the blocks before this one. */
+    uint64_t first_line;
+    /** The time of the first line of the block. */
+    uint64_t first_time;
+    /** The time of the last line of the block. */
+    uint64_t last_time;
+    /** The number of lines in the block. */
+    uint32_t lines;
+    /** The number of bytes of lines in the block. */
+    uint32_t size;
+    /** The number of bytes the lines are compressed to. */
+    uint32_t stored_size;
+    /** The number of bytes of the times of the lines. */
+    uint32_t times_size;
+    /** The checksum of the lines of the block. */
+    uint32_t checksum;
+};
+
+/**
+ * Handle a block decoded by gdbwire_transcript_reader_decode_parallel.
+ *
+ * This is called from several threads at once.
+ *
+ * @param context
+ * The context passed to gdbwire_transcript_reader_decode_parallel.
+ *
+ * @param worker
+ * The number of the worker that decoded the block, less than the number
+ * of threads. A worker handles one block at a time, so state kept per
+ * worker, like a GDB/MI parser, needs no lock.
+ *
+ * @param index
+ * The number of the block.
+ *
+ * @param block
+ * The block.
+ *
+ * @param lines
+ * The block->size bytes of the lines of the block.
+ *
+ * @param times
+ * The block->lines times of the lines of the block.
+ */
+typedef void (*gdbwire_transcript_block_fn)(void *context, size_t worker,
+        size_t index, const struct gdbwire_transcript_block *block,
+        const char *lines, const uint64_t *times);
+
+/**
+ * Create a transcript writer.
+ *
+ * The header of the transcript is written before this returns. The file
+ * is written from where it is, which should be its start.
+ *
+ * @param file
+ * The file to write the transcript to. It belongs to the caller, who
+ * closes it after destroying the writer.
+ *
+ * @param block_size
+ * The number of bytes of lines to gather into a block before
+ * compressing it, or 0 for GDBWIRE_TRANSCRIPT_BLOCK_SIZE. Larger blocks
+ * compress better, smaller blocks are found and decoded faster. It may
+ * be at most 256 MiB.
+ *
+ * @return
+ * A new writer or NULL on error.
+ */
+struct gdbwire_transcript_writer *gdbwire_transcript_writer_create(
+        FILE *file, size_t block_size);
+
+/**
+ * Create a transcript writer that allocates with the given allocator.
+ *
+ * @param file
+ * The file to write the transcript to.
+ *
+ * @param block_size
+ * The number of bytes of lines in a block, or 0 for the default.
+ *
+ * @param allocator
+ * The allocator to allocate the writer with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new writer or NULL on error.
+ */
+struct gdbwire_transcript_writer *
+gdbwire_transcript_writer_create_with_allocator(FILE *file,
+        size_t block_size, const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the transcript writer instance.
+ *
+ * The transcript is finished first if it has not been, but without a
+ * way to report an error. Call gdbwire_transcript_writer_finish to know
+ * that it was written.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param writer
+ * The instance to destroy.
+ */
+void gdbwire_transcript_writer_destroy(
+        struct gdbwire_transcript_writer *writer);
+
+/**
+ * Add output of GDB to the transcript, at the current time.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param data
+ * The output of GDB.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the transcript is finished or a line is larger than
+ * 2 GiB.
+ */
+enum gdbwire_result gdbwire_transcript_writer_push_data(
+        struct gdbwire_transcript_writer *writer,
+        const char *data, size_t size);
+
+/**
+ * Add output of GDB to the transcript, at the given time.
+ *
+ * This turns a log of gdbwire_recorder into a transcript, by pushing
+ * each of its chunks with its time.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @param time
+ * The time of the output, in nanoseconds. Times may not go backwards.
+ *
+ * @param data
+ * The output of GDB.
+ *
+ * @param size
+ * The number of bytes in data.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the transcript is finished, the time is earlier than
+ * the time of an earlier push or a line is larger than 2 GiB.
+ */
+enum gdbwire_result gdbwire_transcript_writer_push_data_at(
+        struct gdbwire_transcript_writer *writer, uint64_t time,
+        const char *data, size_t size);
+
+/**
+ * Finish the transcript.
+ *
+ * A line that has not ended is written without a newline, then the
+ * last block and the index are written and the file is flushed. Nothing
+ * can be pushed after this.
+ *
+ * @param writer
+ * The writer.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if the transcript is already finished.
+ */
+enum gdbwire_result gdbwire_transcript_writer_finish(
+        struct gdbwire_transcript_writer *writer);
+
+/**
+ * Create a transcript reader.
+ *
+ * The blocks of the transcript are found before this returns, from the
+ * index or, if the transcript was not finished, from the headers of the
+ * blocks. A block cut short at the end of an unfinished transcript is
+ * left out.
+ *
+ * @param file
+ * The transcript. It belongs to the caller, who closes it after
+ * destroying the reader.
+ *
+ * @return
+ * A new reader or NULL on error or if the file is not a transcript.
+ */
+struct gdbwire_transcript_reader *gdbwire_transcript_reader_create(
+        FILE *file);
+
+/**
+ * Create a transcript reader that allocates with the given allocator.
+ *
+ * @param file
+ * The transcript.
+ *
+ * @param allocator
+ * The allocator to allocate the reader with, or NULL for the default
+ * allocator.
+ *
+ * @return
+ * A new reader or NULL on error or if the file is not a transcript.
+ */
+struct gdbwire_transcript_reader *
+gdbwire_transcript_reader_create_with_allocator(FILE *file,
+        const struct gdbwire_allocator *allocator);
+
+/**
+ * Destroy the transcript reader instance.
+ *
+ * This function will do nothing if the instance is NULL.
+ *
+ * @param reader
+ * The instance to destroy.
+ */
+void gdbwire_transcript_reader_destroy(
+        struct gdbwire_transcript_reader *reader);
+
+/**
+ * Get the number of blocks of the transcript.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @return
+ * The number of blocks.
+ */
+size_t gdbwire_transcript_reader_count(
+        const struct gdbwire_transcript_reader *reader);
+
+/**
+ * Get a block of the transcript.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param index
+ * The number of the block.
+ *
+ * @param block
+ * Set to the block on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_LOGIC if there is no such block.
+ */
+enum gdbwire_result gdbwire_transcript_reader_block(
+        const struct gdbwire_transcript_reader *reader, size_t index,
+        struct gdbwire_transcript_block *block);
+
+/**
+ * Find the block holding a line.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param line
+ * The number of the line, 0 for the first line of the transcript.
+ *
+ * @param index
+ * Set to the number of the block on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_LOGIC if there is no such line.
+ */
+enum gdbwire_result gdbwire_transcript_reader_find_line(
+        const struct gdbwire_transcript_reader *reader, uint64_t line,
+        size_t *index);
+
+/**
+ * Find the block holding the first line at or after a time.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param time
+ * The time.
+ *
+ * @param index
+ * Set to the number of the block on success.
+ *
+ * @return
+ * GDBWIRE_OK on success or GDBWIRE_LOGIC if no line is that late.
+ */
+enum gdbwire_result gdbwire_transcript_reader_find_time(
+        const struct gdbwire_transcript_reader *reader, uint64_t time,
+        size_t *index);
+
+/**
+ * Decode a block of the transcript.
+ *
+ * This may be called from several threads at once. Only the reads of
+ * the file are made one at a time.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param index
+ * The number of the block.
+ *
+ * @param lines
+ * Set to the lines of the block. It must hold the block's size bytes.
+ *
+ * @param times
+ * Set to the times of the lines of the block. It must hold the block's
+ * lines times.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if there is no such block or it is corrupt.
+ */
+enum gdbwire_result gdbwire_transcript_reader_decode(
+        struct gdbwire_transcript_reader *reader, size_t index,
+        char *lines, uint64_t *times);
+
+/**
+ * Decode blocks of the transcript on several threads.
+ *
+ * The blocks are divided between a pool of worker threads, which claim
+ * them one at a time and pass each to the callback once decoded. The
+ * blocks are handled in no particular order. A block that can not be
+ * decoded is not passed to the callback, the others still are.
+ *
+ * @param reader
+ * The reader.
+ *
+ * @param first
+ * The number of the first block to decode.
+ *
+ * @param count
+ * The number of blocks to decode, from the first.
+ *
+ * @param threads
+ * The number of worker threads to use, or 0 to use one per online
+ * processor. The calling thread is one of the workers.
+ *
+ * @param callback
+ * Called with each block once it is decoded.
+ *
+ * @param context
+ * Passed to the callback.
+ *
+ * @return
+ * GDBWIRE_OK on success or appropriate error result on failure.
+ * GDBWIRE_LOGIC if there are not count blocks from the first or a block
+ * could not be decoded.
+ */
+enum gdbwire_result gdbwire_transcript_reader_decode_parallel(
+        struct gdbwire_transcript_reader *reader, size_t first,
+        size_t count, size_t threads, gdbwire_transcript_block_fn callback,
+        void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GDBWIRE_TRANSCRIPT_H */
@@ -0,0 +1,700 @@
+/**
+ * The gdbwire benchmark program.
+ *
+ * This program measures the performance of the gdbwire parser. It replays
+ * the test suite corpus (every file under src/progs/test_suite/data) and a
+ * set of parameterized synthetic GDB/MI inputs through both
+ * gdbwire_push_data and gdbwire_mi_parser_push_data. Each input is pushed
+ * in chunks of several sizes, from 1 byte up to 1 MB at a time.
+ *
+ * The inputs are also converted to JSON, both by parsing each line into
+ * a tree and writing the JSON of the tree, and by the transcoder that
+ * writes the JSON straight from the tokens of each line.
+ *
+ * Each measurement is written to stdout as a single line JSON object, so
+ * that results can be collected and compared between revisions to track
+ * regressions. The fields are,
+ *   bench           - the name of the input
+ *   target          - gdbwire, gdbwire_mi_parser, json_tree or json_stream
+ *   chunk           - the number of bytes pushed per call
+ *   bytes, lines    - the size of the input
+ *   iterations      - the number of times the input was replayed
+ *   seconds         - the total time spent pushing data
+ *   mb_per_s        - throughput in megabytes (2^20) per second
+ *   lines_per_s     - throughput in GDB/MI lines per second
+ *   allocs_per_line - calls to malloc, calloc and realloc per line
+ *   p50_ns .. max_ns - the latency distribution of a single push call
+ *
+ * Usage,
+ *   bench [-d data_dir] [-t min_seconds] [-f filter] [-q]
+ *
+ *   -d The test suite data directory to replay.
+ *   -t The minimum number of seconds to spend on each measurement.
+ *   -f Only run the measurements whose bench name contains filter.
+ *   -q Quick mode, only use the smallest and largest chunk sizes.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "gdbwire.h"
+#include "gdbwire_mi_parser.h"
+
+/**
+ * Counting allocations.
+ *
+ * The allocation counter replaces the C library allocation functions for
+ * the entire program, including the gdbwire library, and forwards each
+ * request to the glibc implementation. The counter is only active while
+ * a measurement is being timed. On systems without glibc the allocation
+ * counts are reported as -1.
+ */
+static int bench_counting;
+static unsigned long bench_allocations;
+
+#ifdef __GLIBC__
+#define BENCH_HAVE_ALLOCATION_COUNTER 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *
+malloc(size_t size)
+{
+    if (bench_counting) {
+        ++bench_allocations;
+    }
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    if (bench_counting) {
+        ++bench_allocations;
+    }
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    if (bench_counting) {
+        ++bench_allocations;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+    __libc_free(ptr);
+}
+#else
+#define BENCH_HAVE_ALLOCATION_COUNTER 0
+#endif
+
+/** A growable byte buffer used to build the benchmark inputs. */
+struct bench_buffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+static void
+bench_buffer_append(struct bench_buffer *buffer, const char *data,
+    size_t size)
+{
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (buffer->size + size > capacity) {
+            capacity *= 2;
+        }
+        buffer->data = realloc(buffer->data, capacity);
+        if (!buffer->data) {
+            fprintf(stderr, "bench: out of memory\n");
+            exit(1);
+        }
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void
+bench_buffer_append_cstr(struct bench_buffer *buffer, const char *cstr)
+{
+    bench_buffer_append(buffer, cstr, strlen(cstr));
+}
+
+/** A single benchmark input. */
+struct bench_input {
+    /** The name of the input, reported as the bench field. */
+    char name[128];
+    /** The GDB/MI data to push. */
+    struct bench_buffer buffer;
+    /** The number of GDB/MI lines in the buffer. */
+    unsigned long lines;
+};
+
+/** The options provided on the command line. */
+struct bench_options {
+    const char *data_dir;
+    double min_seconds;
+    const char *filter;
+    int quick;
+};
+
+/** The chunk sizes each input is pushed with. */
+static const size_t bench_chunk_sizes[] = {
+    1, 64, 4096, 65536, 1048576
+};
+
+#define BENCH_CHUNK_SIZES \
+    (sizeof(bench_chunk_sizes) / sizeof(bench_chunk_sizes[0]))
+
+/** The targets each input is pushed through. */
+enum bench_target {
+    BENCH_GDBWIRE,
+    BENCH_GDBWIRE_MI_PARSER,
+    /* Parse into trees, then write the JSON of each tree */
+    BENCH_JSON_TREE,
+    /* Transcode to JSON without building trees */
+    BENCH_JSON_STREAM
+};
+
+static const char *bench_target_names[] = {
+    "gdbwire",
+    "gdbwire_mi_parser",
+    "json_tree",
+    "json_stream"
+};
+
+static unsigned long long
+bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long
+bench_count_lines(const char *data, size_t size)
+{
+    unsigned long lines = 0;
+    size_t i;
+
+    for (i = 0; i < size; ++i) {
+        if (data[i] == '\n') {
+            ++lines;
+        }
+    }
+
+    return lines;
+}
+
+/**
+ * Recursively append every file under path to the corpus buffer.
+ *
+ * The files are visited in sorted order so the corpus is identical
+ * from run to run. Each file is terminated with a newline if it
+ * does not already end with one.
+ *
+ * @param buffer
+ * The corpus buffer to append to.
+ *
+ * @param path
+ * The file or directory to append.
+ *
+ * @return
+ * The number of files appended.
+ */
+static int
+bench_load_corpus(struct bench_buffer *buffer, const char *path)
+{
+    struct stat st;
+    int files = 0;
+
+    if (stat(path, &st) != 0) {
+        return 0;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        struct dirent **entries;
+        int count, i;
+
+        count = scandir(path, &entries, NULL, alphasort);
+        for (i = 0; i < count; ++i) {
+            if (entries[i]->d_name[0] != '.') {
+                size_t length = strlen(path) + strlen(entries[i]->d_name) + 2;
+                char *child = malloc(length);
+                snprintf(child, length, "%s/%s", path, entries[i]->d_name);
+                files += bench_load_corpus(buffer, child);
+                free(child);
+            }
+            free(entries[i]);
+        }
+        if (count >= 0) {
+            free(entries);
+        }
+    } else if (S_ISREG(st.st_mode)) {
+        FILE *fd = fopen(path, "rb");
+        char data[4096];
+        size_t size, total = 0;
+
+        if (fd) {
+            while ((size = fread(data, 1, sizeof(data), fd)) > 0) {
+                bench_buffer_append(buffer, data, size);
+                total += size;
+            }
+            fclose(fd);
+
+            if (total > 0 && buffer->data[buffer->size - 1] != '\n') {
+                bench_buffer_append(buffer, "\n", 1);
+            }
+            files = 1;
+        }
+    }
+
+    return files;
+}
+
+/**
+ * Repeat line in the input until it holds at least min_size bytes.
+ *
+ * @param input
+ * The input to fill.
+ *
+ * @param line
+ * The GDB/MI line to repeat, including the newline.
+ *
+ * @param size
+ * The size of the line.
+ *
+ * @param min_size
+ * The minimum size of the input. The line is always added at least once.
+ */
+static void
+bench_input_repeat(struct bench_input *input, const char *line, size_t size,
+    size_t min_size)
+{
+    do {
+        bench_buffer_append(&input->buffer, line, size);
+    } while (input->buffer.size < min_size);
+
+    input->lines = bench_count_lines(input->buffer.data, input->buffer.size);
+}
+
+/* The minimum size of each synthetic input. */
+#define BENCH_SYNTHETIC_SIZE (256 * 1024)
+
+/* A list with count elements, ^done,list=[elem="0",elem="1",...] */
+static void
+bench_synthetic_list(struct bench_input *input, int count)
+{
+    struct bench_buffer line = { 0, 0, 0 };
+    char elem[64];
+    int i;
+
+    bench_buffer_append_cstr(&line, "^done,list=[");
+    for (i = 0; i < count; ++i) {
+        snprintf(elem, sizeof(elem), "%selem=\"%d\"", i ? "," : "", i);
+        bench_buffer_append_cstr(&line, elem);
+    }
+    bench_buffer_append_cstr(&line, "]\n");
+
+    snprintf(input->name, sizeof(input->name), "synthetic/list/%d", count);
+    bench_input_repeat(input, line.data, line.size, BENCH_SYNTHETIC_SIZE);
+    free(line.data);
+}
+
+/* A tuple nested depth times, ^done,a={a={...a={leaf="value"}...}} */
+static void
+bench_synthetic_nesting(struct bench_input *input, int depth)
+{
+    struct bench_buffer line = { 0, 0, 0 };
+    int i;
+
+    bench_buffer_append_cstr(&line, "^done");
+    for (i = 0; i < depth; ++i) {
+        bench_buffer_append_cstr(&line, i ? "a={" : ",a={");
+    }
+    bench_buffer_append_cstr(&line, "leaf=\"value\"");
+    for (i = 0; i < depth; ++i) {
+        bench_buffer_append_cstr(&line, "}");
+    }
+    bench_buffer_append_cstr(&line, "\n");
+
+    snprintf(input->name, sizeof(input->name), "synthetic/nesting/%d", depth);
+    bench_input_repeat(input, line.data, line.size, BENCH_SYNTHETIC_SIZE);
+    free(line.data);
+}
+
+/* A console stream record with a cstring of length bytes. */
+static void
+bench_synthetic_cstring(struct bench_input *input, size_t length)
+{
+    struct bench_buffer line = { 0, 0, 0 };
+    size_t i;
+
+    bench_buffer_append_cstr(&line, "~\"");
+    for (i = 0; i < length; ++i) {
+        char c = 'a' + (i % 26);
+        bench_buffer_append(&line, &c, 1);
+    }
+    bench_buffer_append_cstr(&line, "\"\n");
+
+    snprintf(input->name, sizeof(input->name), "synthetic/cstring/%lu",
+        (unsigned long)length);
+    bench_input_repeat(input, line.data, line.size, BENCH_SYNTHETIC_SIZE);
+    free(line.data);
+}
+
+/* A console stream record where every character is escaped. */
+static void
+bench_synthetic_escaping(struct bench_input *input, size_t length)
+{
+    static const char *escapes[] = { "\\\"", "\\\\", "\\n", "\\t", "\\r" };
+    struct bench_buffer line = { 0, 0, 0 };
+    size_t i;
+
+    bench_buffer_append_cstr(&line, "~\"");
+    for (i = 0; i < length; ++i) {
+        bench_buffer_append_cstr(&line, escapes[i % 5]);
+    }
+    bench_buffer_append_cstr(&line, "\"\n");
+
+    snprintf(input->name, sizeof(input->name), "synthetic/escaping/%lu",
+        (unsigned long)length);
+    bench_input_repeat(input, line.data, line.size, BENCH_SYNTHETIC_SIZE);
+    free(line.data);
+}
+
+/* A typical session, a mix of the most common record shapes. */
+static void
+bench_synthetic_session(struct bench_input *input)
+{
+    static const char *session =
+        "=thread-group-added,id=\"i1\"\n"
+        "~\"Reading symbols from ./a.out...\\n\"\n"
+        "(gdb) \n"
+        "1^done,bkpt={number=\"1\",type=\"breakpoint\",disp=\"keep\","
+            "enabled=\"y\",addr=\"0x00000000004004fa\",func=\"main\","
+            "file=\"main.c\",fullname=\"/home/user/main.c\",line=\"3\","
+            "thread-groups=[\"i1\"],times=\"0\","
+            "original-location=\"main\"}\n"
+        "(gdb) \n"
+        "=library-loaded,id=\"/lib64/ld-linux-x86-64.so.2\","
+            "target-name=\"/lib64/ld-linux-x86-64.so.2\","
+            "host-name=\"/lib64/ld-linux-x86-64.so.2\","
+            "symbols-loaded=\"0\",thread-group=\"i1\"\n"
+        "2^running\n"
+        "*running,thread-id=\"all\"\n"
+        "(gdb) \n"
+        "*stopped,reason=\"breakpoint-hit\",disp=\"keep\",bkptno=\"1\","
+            "frame={addr=\"0x00000000004004fa\",func=\"main\",args=[],"
+            "file=\"main.c\",fullname=\"/home/user/main.c\",line=\"3\"},"
+            "thread-id=\"1\",stopped-threads=\"all\",core=\"0\"\n"
+        "(gdb) \n"
+        "3^done\n"
+        "(gdb) \n";
+
+    snprintf(input->name, sizeof(input->name), "synthetic/session");
+    bench_input_repeat(input, session, strlen(session), BENCH_SYNTHETIC_SIZE);
+}
+
+static int
+bench_compare_ull(const void *lhs, const void *rhs)
+{
+    unsigned long long l = *(const unsigned long long *)lhs;
+    unsigned long long r = *(const unsigned long long *)rhs;
+    return (l > r) - (l < r);
+}
+
+static unsigned long long
+bench_percentile(unsigned long long *sorted, size_t count, double p)
+{
+    size_t index = (size_t)(p * (count - 1));
+    return count ? sorted[index] : 0;
+}
+
+static void
+bench_mi_output_callback(void *context, struct gdbwire_mi_output *output)
+{
+    gdbwire_mi_output_free(output);
+}
+
+static void
+bench_json_callback(void *context, const char *json, size_t size)
+{
+    *(size_t *)context += size;
+}
+
+static void
+bench_mi_json_output_callback(void *context, struct gdbwire_mi_output *output)
+{
+    gdbwire_mi_json_output((struct gdbwire_mi_json *)context, output);
+    gdbwire_mi_output_free(output);
+}
+
+/**
+ * Push the input through the target in chunks and print the results.
+ *
+ * The target is created once and warmed up with a single untimed pass
+ * over the input. The input is then replayed until at least min_seconds
+ * have been spent pushing data.
+ *
+ * @param input
+ * The input to replay.
+ *
+ * @param target
+ * The gdbwire interface to push the input through.
+ *
+ * @param chunk
+ * The number of bytes to push per call.
+ *
+ * @param min_seconds
+ * The minimum amount of time to spend on the measurement.
+ */
+static void
+bench_run(struct bench_input *input, enum bench_target target, size_t chunk,
+    double min_seconds)
+{
+    struct gdbwire_callbacks wire_callbacks = { 0, 0, 0, 0, 0, 0 };
+    struct gdbwire_mi_parser_callbacks parser_callbacks =
+        { 0, bench_mi_output_callback };
+    struct gdbwire *wire = 0;
+    struct gdbwire_mi_parser *parser = 0;
+    struct gdbwire_mi_json *json = 0;
+    size_t json_bytes = 0;
+    size_t calls = (input->buffer.size + chunk - 1) / chunk;
+    unsigned long long *samples, *all_samples = 0;
+    size_t all_count = 0, all_capacity = 0;
+    unsigned long long total_ns = 0;
+    unsigned long iterations = 0, allocations;
+    double seconds, total_lines;
+    int pass;
+
+    samples = malloc(sizeof(unsigned long long) * calls);
+
+    if (target == BENCH_GDBWIRE) {
+        wire = gdbwire_create(wire_callbacks);
+    } else if (target == BENCH_GDBWIRE_MI_PARSER) {
+        parser = gdbwire_mi_parser_create(parser_callbacks);
+    } else {
+        json = gdbwire_mi_json_create(bench_json_callback, &json_bytes);
+        if (target == BENCH_JSON_TREE) {
+            parser_callbacks.context = json;
+            parser_callbacks.gdbwire_mi_output_callback =
+                bench_mi_json_output_callback;
+            parser = gdbwire_mi_parser_create(parser_callbacks);
+        }
+    }
+
+    /* The first pass is an untimed warm up */
+    for (pass = 0; pass == 0 || total_ns < min_seconds * 1e9; ++pass) {
+        size_t offset, call = 0;
+
+        if (pass == 1) {
+            bench_allocations = 0;
+        }
+
+        bench_counting = (pass > 0);
+        for (offset = 0; offset < input->buffer.size; offset += chunk) {
+            size_t size = input->buffer.size - offset;
+            unsigned long long start;
+            size = size < chunk ? size : chunk;
+
+            start = bench_now_ns();
+            if (wire) {
+                gdbwire_push_data(wire, input->buffer.data + offset, size);
+            } else if (parser) {
+                gdbwire_mi_parser_push_data(parser,
+                    input->buffer.data + offset, size);
+            } else {
+                gdbwire_mi_json_push_data(json,
+                    input->buffer.data + offset, size);
+            }
+            samples[call++] = bench_now_ns() - start;
+        }
+        bench_counting = 0;
+
+        if (pass > 0) {
+            size_t i;
+            ++iterations;
+            for (i = 0; i < call; ++i) {
+                total_ns += samples[i];
+            }
+
+            /* Keep the latency samples of a bounded number of passes */
+            if (all_count + call <= 4 * 1048576) {
+                if (all_count + call > all_capacity) {
+                    all_capacity = (all_count + call) * 2;
+                    all_samples = realloc(all_samples,
+                        sizeof(unsigned long long) * all_capacity);
+                }
+                memcpy(all_samples + all_count, samples,
+                    sizeof(unsigned long long) * call);
+                all_count += call;
+            }
+        }
+    }
+
+    allocations = bench_allocations;
+
+    gdbwire_destroy(wire);
+    gdbwire_mi_parser_destroy(parser);
+    gdbwire_mi_json_destroy(json);
+
+    qsort(all_samples, all_count, sizeof(unsigned long long),
+        bench_compare_ull);
+
+    seconds = total_ns / 1e9;
+    total_lines = (double)input->lines * iterations;
+
+    printf("{\"bench\":\"%s\",\"target\":\"%s\",\"chunk\":%lu,"
+        "\"bytes\":%lu,\"lines\":%lu,\"iterations\":%lu,"
+        "\"seconds\":%.6f,\"mb_per_s\":%.3f,\"lines_per_s\":%.1f,"
+        "\"allocs_per_line\":%.3f,\"p50_ns\":%llu,\"p90_ns\":%llu,"
+        "\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+        input->name, bench_target_names[target], (unsigned long)chunk,
+        (unsigned long)input->buffer.size, input->lines, iterations,
+        seconds,
+        seconds > 0 ? input->buffer.size * (double)iterations /
+            (1024.0 * 1024.0) / seconds : 0.0,
+        seconds > 0 ? total_lines / seconds : 0.0,
+        BENCH_HAVE_ALLOCATION_COUNTER && total_lines > 0 ?
+            allocations / total_lines : -1.0,
+        bench_percentile(all_samples, all_count, 0.50),
+        bench_percentile(all_samples, all_count, 0.90),
+        bench_percentile(all_samples, all_count, 0.99),
+        bench_percentile(all_samples, all_count, 0.999),
+        all_count ? all_samples[all_count - 1] : 0ULL);
+    fflush(stdout);
+
+    free(all_samples);
+    free(samples);
+}
+
+/**
+ * Run the input through every target and chunk size.
+ *
+ * The input is released when this function returns.
+ */
+static void
+bench_input_run(struct bench_input *input, struct bench_options *options)
+{
+    size_t chunk_index;
+    int target;
+
+    if (!options->filter || strstr(input->name, options->filter)) {
+        for (target = BENCH_GDBWIRE; target <= BENCH_JSON_STREAM;
+                ++target) {
+            for (chunk_index = 0; chunk_index < BENCH_CHUNK_SIZES;
+                    ++chunk_index) {
+                if (options->quick && chunk_index != 0 &&
+                        chunk_index != BENCH_CHUNK_SIZES - 1) {
+                    continue;
+                }
+                bench_run(input, (enum bench_target)target,
+                    bench_chunk_sizes[chunk_index], options->min_seconds);
+            }
+        }
+    }
+
+    free(input->buffer.data);
+    memset(input, 0, sizeof(struct bench_input));
+}
+
+static void
+bench_usage(void)
+{
+    fprintf(stderr,
+        "usage: bench [-d data_dir] [-t min_seconds] [-f filter] [-q]\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct bench_options options = {
+        GDBWIRE_ABS_TOP_SRCDIR "/src/progs/test_suite/data", 0.2, 0, 0
+    };
+    struct bench_input input;
+    int opt, files;
+    size_t i;
+
+    static const int list_sizes[] = { 1, 10, 100, 1000 };
+    static const int nesting_depths[] = { 1, 10, 100 };
+    static const size_t cstring_lengths[] = { 16, 1024, 65536, 1048576 };
+    static const size_t escaping_lengths[] = { 1024, 65536 };
+
+    while ((opt = getopt(argc, argv, "d:t:f:q")) != -1) {
+        switch (opt) {
+            case 'd':
+                options.data_dir = optarg;
+                break;
+            case 't':
+                options.min_seconds = atof(optarg);
+                break;
+            case 'f':
+                options.filter = optarg;
+                break;
+            case 'q':
+                options.quick = 1;
+                break;
+            default:
+                bench_usage();
+                return 1;
+        }
+    }
+
+    memset(&input, 0, sizeof(struct bench_input));
+
+    /* The test suite corpus, all files replayed as a single stream */
+    files = bench_load_corpus(&input.buffer, options.data_dir);
+    if (files == 0) {
+        fprintf(stderr, "bench: no corpus files found in %s\n",
+            options.data_dir);
+        return 1;
+    }
+    snprintf(input.name, sizeof(input.name), "corpus");
+    input.lines = bench_count_lines(input.buffer.data, input.buffer.size);
+    bench_input_run(&input, &options);
+
+    for (i = 0; i < sizeof(list_sizes) / sizeof(list_sizes[0]); ++i) {
+        bench_synthetic_list(&input, list_sizes[i]);
+        bench_input_run(&input, &options);
+    }
+
+    for (i = 0; i < sizeof(nesting_depths) / sizeof(nesting_depths[0]); ++i) {
+        bench_synthetic_nesting(&input, nesting_depths[i]);
+        bench_input_run(&input, &options);
+    }
+
+    for (i = 0; i < sizeof(cstring_lengths) / sizeof(cstring_lengths[0]); ++i) {
+        bench_synthetic_cstring(&input, cstring_lengths[i]);
+        bench_input_run(&input, &options);
+    }
+
+    for (i = 0; i < sizeof(escaping_lengths) / sizeof(escaping_lengths[0]);
+            ++i) {
+        bench_synthetic_escaping(&input, escaping_lengths[i]);
+        bench_input_run(&input, &options);
+    }
+
+    bench_synthetic_session(&input);
+    bench_input_run(&input, &options);
+
+    return 0;
+}
@@ -0,0 +1,1347 @@
+/**
+ * The gdbwire_stat program.
+ *
+ * This program gathers statistics about the output of GDB in one or
+ * more files, to find out what a debugging session spent its time and
+ * bytes on. Each file may be,
+ *   - GDB/MI output as it came from GDB,
+ *   - a log written by gdbwire_recorder, or
+ *   - a transcript written by gdbwire_transcript_writer.
+ *
+ * The files are divided into units, a range of lines of plain output,
+ * a block of a transcript or a whole log, and the units are divided
+ * between a pool of worker threads. Each worker parses its units with
+ * its own GDB/MI parser, the same parser the front ends use, so the
+ * statistics count the records the front ends saw. The statistics of
+ * the workers are merged once every unit is parsed.
+ *
+ * The report holds,
+ *   - the number of lines, bytes and records of each kind and class,
+ *   - the bytes of each stream, before and after unescaping,
+ *   - the time from each command to its result, by command,
+ *   - the largest records, and
+ *   - the first parse errors, with their line and column.
+ *
+ * The time from a command to its result is only known for logs and
+ * transcripts that also hold the commands sent to GDB, as lines of a
+ * token followed by an MI command, like "12-exec-next". A command is
+ * paired with the next result record of its token. Plain output has no
+ * times, so its commands and results are only counted.
+ *
+ * Line numbers start at 1 and count every line of a file, including the
+ * lines of commands and empty lines.
+ *
+ * Usage,
+ *   gdbwire_stat [-j threads] [-n largest] [-e errors] file...
+ *
+ *   -j The number of worker threads, by default one per processor.
+ *   -n The number of largest records to report, 10 by default.
+ *   -e The number of parse errors to report, 10 by default.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gdbwire.h"
+#include "gdbwire_atomic.h"
+#include "gdbwire_mi_parser.h"
+
+/* The number of bytes of plain output in a unit */
+#define STAT_UNIT_SIZE (8 * 1024 * 1024)
+
+/* The number of bytes read from a file of plain output at once */
+#define STAT_READ_SIZE (1024 * 1024)
+
+/* The number of bytes kept of the description of a record */
+#define STAT_WHAT_SIZE 80
+
+/* The number of bytes kept of the name of a command */
+#define STAT_NAME_SIZE 32
+
+/* The number of each kind of record */
+#define STAT_STREAMS (GDBWIRE_MI_LOG + 1)
+#define STAT_ASYNC_KINDS (GDBWIRE_MI_NOTIFY + 1)
+#define STAT_ASYNC_CLASSES (GDBWIRE_MI_ASYNC_UNSUPPORTED + 1)
+#define STAT_RESULTS (GDBWIRE_MI_UNSUPPORTED + 1)
+
+/* The names of the stream records, by gdbwire_mi_stream_record_kind */
+static const char *const stat_stream_names[] = {
+    "console", "target", "log"
+};
+
+/* The characters of the async records, by gdbwire_mi_async_record_kind */
+static const char stat_async_chars[] = { '+', '*', '=' };
+
+/* The kinds of files */
+enum stat_format {
+    STAT_TEXT,
+    STAT_LOG,
+    STAT_TRANSCRIPT
+};
+
+static const char *const stat_format_names[] = {
+    "text", "log", "transcript"
+};
+
+/* A file to gather statistics about */
+struct stat_file {
+    const char *path;
+    enum stat_format format;
+
+    /* The file of plain output, read with pread from any thread */
+    int fd;
+    uint64_t size;
+
+    /* The transcript and its reader */
+    FILE *stream;
+    struct gdbwire_transcript_reader *reader;
+};
+
+/* A part of a file parsed by one worker */
+struct stat_unit {
+    size_t file;
+
+    /**
+     * The lines of plain output that start in the bytes from start to
+     * end, or the block of a transcript numbered start.
+     */
+    uint64_t start;
+    uint64_t end;
+
+    /* The number of lines of the unit, set by its worker */
+    uint64_t lines;
+    /* The number of lines in the file before the unit, set once merged */
+    uint64_t first_line;
+    /* The times of the first and last lines, if has_time is set */
+    uint64_t first_time;
+    uint64_t last_time;
+    int has_time;
+    /* True if the unit could not be read */
+    int failed;
+};
+
+/* The number and size of some lines */
+struct stat_count {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+/* The statistics of the lines of any number of units */
+struct stat_counts {
+    uint64_t lines;
+    uint64_t bytes;
+    struct stat_count blank;
+    struct stat_count commands;
+    struct stat_count prompts;
+    struct stat_count errors;
+    struct stat_count streams[STAT_STREAMS];
+    /* The bytes of the text of the streams, with the escaping undone */
+    uint64_t stream_text[STAT_STREAMS];
+    struct stat_count async[STAT_ASYNC_KINDS][STAT_ASYNC_CLASSES];
+    struct stat_count results[STAT_RESULTS];
+};
+
+/* A record worth reporting, one of the largest or a parse error */
+struct stat_record {
+    size_t unit;
+    /* The line in the unit, and once merged, in the file */
+    uint64_t line;
+    uint64_t size;
+    char what[STAT_WHAT_SIZE];
+};
+
+/* A command or a result record with a token */
+struct stat_event {
+    size_t unit;
+    /* The line in the unit, and once merged, in the file */
+    uint64_t line;
+    uint64_t token;
+    uint64_t time;
+    int has_time;
+    /* The name of the command, or empty for a result record */
+    char name[STAT_NAME_SIZE];
+};
+
+/* A growing array */
+struct stat_array {
+    void *data;
+    size_t size;
+    size_t capacity;
+};
+
+/* The work shared by all of the workers */
+struct stat_work {
+    struct stat_file *files;
+    struct stat_unit *units;
+    size_t unit_count;
+    size_t largest;
+    size_t errors;
+
+    /* The number of units claimed by a worker so far */
+    size_t next;
+};
+
+/* A worker and the statistics of the units it parsed */
+struct stat_worker {
+    struct stat_work *work;
+    pthread_t thread;
+    struct gdbwire_mi_parser *parser;
+
+    struct stat_counts counts;
+    /* The largest records, from largest to smallest */
+    struct stat_record *largest;
+    size_t largest_count;
+    /* The parse errors, at most work->errors of each unit */
+    struct stat_array errors;
+    /* The commands and result records with tokens */
+    struct stat_array events;
+
+    /* The unit being parsed and the line being parsed in it */
+    size_t unit;
+    uint64_t line;
+    uint64_t time;
+    int has_time;
+    size_t unit_errors;
+
+    /* A line that is read in several pieces */
+    char *buffer;
+    size_t buffer_size;
+    size_t buffer_capacity;
+    /* The data read from a file */
+    char *data;
+    size_t data_capacity;
+    uint64_t *times;
+    size_t times_capacity;
+};
+
+static void *
+stat_reserve(void *data, size_t *capacity, size_t size)
+{
+    size_t grown = (*capacity > 0) ? *capacity : 64;
+
+    if (size <= *capacity) {
+        return data;
+    }
+    while (grown < size) {
+        grown *= 2;
+    }
+    data = realloc(data, grown);
+    if (!data) {
+        fprintf(stderr, "gdbwire_stat: out of memory\n");
+        exit(1);
+    }
+    *capacity = grown;
+
+    return data;
+}
+
+/* Append an element to an array, returning it */
+static void *
+stat_array_push(struct stat_array *array, size_t element_size)
+{
+    size_t bytes = array->capacity * element_size;
+
+    array->data = stat_reserve(array->data, &bytes,
+        (array->size + 1) * element_size);
+    array->capacity = bytes / element_size;
+
+    return (char *)array->data + array->size++ * element_size;
+}
+
+/**
+ * Parse a token.
+ *
+ * @param token
+ * The digits of the token.
+ *
+ * @param size
+ * The number of digits.
+ *
+ * @param value
+ * Set to the token.
+ *
+ * @return
+ * 1 if the token fits in 64 bits, 0 otherwise.
+ */
+static int
+stat_token(const char *token, size_t size, uint64_t *value)
+{
+    size_t index;
+
+    *value = 0;
+    for (index = 0; index < size; ++index) {
+        unsigned digit = (unsigned)(token[index] - '0');
+        if (*value > (UINT64_MAX - digit) / 10) {
+            return 0;
+        }
+        *value = *value * 10 + digit;
+    }
+
+    return size > 0;
+}
+
+/* Describe a record in a few words, for the report */
+static void
+stat_describe(const struct gdbwire_mi_output *output, char *what)
+{
+    const struct gdbwire_mi_oob_record *oob;
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            oob = output->variant.oob_record;
+            if (oob->kind == GDBWIRE_MI_STREAM) {
+                snprintf(what, STAT_WHAT_SIZE, "stream %s",
+                    stat_stream_names[oob->variant.stream_record->kind]);
+            } else {
+                snprintf(what, STAT_WHAT_SIZE, "async %c%s",
+                    stat_async_chars[oob->variant.async_record->kind],
+                    gdbwire_mi_async_class_name(
+                        oob->variant.async_record->async_class));
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            snprintf(what, STAT_WHAT_SIZE, "result ^%s",
+                gdbwire_mi_result_class_name(
+                    output->variant.result_record->result_class));
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            snprintf(what, STAT_WHAT_SIZE, "prompt");
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            snprintf(what, STAT_WHAT_SIZE, "parse error");
+            break;
+    }
+}
+
+/* Keep a record if it is one of the largest the worker has seen */
+static void
+stat_keep_largest(struct stat_worker *worker,
+        const struct gdbwire_mi_output *output, size_t size)
+{
+    size_t limit = worker->work->largest, index;
+
+    if (limit == 0 || (worker->largest_count == limit &&
+            worker->largest[limit - 1].size >= size)) {
+        return;
+    }
+
+    if (worker->largest_count < limit) {
+        ++worker->largest_count;
+    }
+    index = worker->largest_count - 1;
+    while (index > 0 && worker->largest[index - 1].size < size) {
+        worker->largest[index] = worker->largest[index - 1];
+        --index;
+    }
+
+    worker->largest[index].unit = worker->unit;
+    worker->largest[index].line = worker->line;
+    worker->largest[index].size = size;
+    stat_describe(output, worker->largest[index].what);
+}
+
+/* Keep a parse error, if the unit has not had too many */
+static void
+stat_keep_error(struct stat_worker *worker,
+        const struct gdbwire_mi_output *output, size_t size)
+{
+    struct stat_record *error;
+    const char *token = output->variant.error.token;
+    size_t index, count = 0;
+
+    if (worker->unit_errors++ >= worker->work->errors) {
+        return;
+    }
+
+    error = (struct stat_record *)stat_array_push(&worker->errors,
+        sizeof (struct stat_record));
+    error->unit = worker->unit;
+    error->line = worker->line;
+    error->size = size;
+
+    count = (size_t)snprintf(error->what, STAT_WHAT_SIZE,
+        "column %d-%d, at \"", output->variant.error.pos.start_column,
+        output->variant.error.pos.end_column);
+    for (index = 0; token && token[index] && count + 5 < STAT_WHAT_SIZE;
+            ++index) {
+        unsigned char c = (unsigned char)token[index];
+        error->what[count++] = (c >= ' ' && c < 127) ? (char)c : '?';
+    }
+    if (token && token[index]) {
+        error->what[count++] = '.';
+        error->what[count++] = '.';
+        error->what[count++] = '.';
+    }
+    error->what[count++] = '"';
+    error->what[count] = 0;
+}
+
+/* Keep a command or result record with a token, to pair them */
+static void
+stat_keep_event(struct stat_worker *worker, uint64_t token,
+        const char *name, size_t name_size)
+{
+    struct stat_event *event = (struct stat_event *)stat_array_push(
+        &worker->events, sizeof (struct stat_event));
+
+    event->unit = worker->unit;
+    event->line = worker->line;
+    event->token = token;
+    event->time = worker->time;
+    event->has_time = worker->has_time;
+    if (name_size >= STAT_NAME_SIZE) {
+        name_size = STAT_NAME_SIZE - 1;
+    }
+    memcpy(event->name, name, name_size);
+    event->name[name_size] = 0;
+}
+
+static void
+stat_output_callback(void *context, struct gdbwire_mi_output *output)
+{
+    struct stat_worker *worker = (struct stat_worker *)context;
+    struct stat_counts *counts = &worker->counts;
+    const struct gdbwire_mi_oob_record *oob;
+    const struct gdbwire_mi_async_record *async;
+    const struct gdbwire_mi_result_record *result;
+    const struct gdbwire_mi_stream_record *stream;
+    size_t size = strlen(output->line);
+    struct stat_count *count = 0;
+    uint64_t token;
+
+    /* The line of an output has its newline */
+    while (size > 0 && (output->line[size - 1] == '\n' ||
+            output->line[size - 1] == '\r')) {
+        --size;
+    }
+
+    switch (output->kind) {
+        case GDBWIRE_MI_OUTPUT_OOB:
+            oob = output->variant.oob_record;
+            if (oob->kind == GDBWIRE_MI_STREAM) {
+                stream = oob->variant.stream_record;
+                count = &counts->streams[stream->kind];
+                counts->stream_text[stream->kind] += strlen(stream->cstring);
+            } else {
+                async = oob->variant.async_record;
+                count = &counts->async[async->kind][async->async_class];
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_RESULT:
+            result = output->variant.result_record;
+            count = &counts->results[result->result_class];
+            if (result->token && stat_token(result->token,
+                    strlen(result->token), &token)) {
+                stat_keep_event(worker, token, "", 0);
+            }
+            break;
+        case GDBWIRE_MI_OUTPUT_PROMPT:
+            count = &counts->prompts;
+            break;
+        case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+            count = &counts->errors;
+            stat_keep_error(worker, output, size);
+            break;
+    }
+
+    ++count->count;
+    count->bytes += size;
+    stat_keep_largest(worker, output, size);
+
+    gdbwire_mi_output_free(output);
+}
+
+/**
+ * Gather the statistics of a line.
+ *
+ * @param worker
+ * The worker.
+ *
+ * @param line
+ * The line, with its newline unless it is the last line of a file.
+ *
+ * @param size
+ * The number of bytes in line.
+ */
+static void
+stat_line(struct stat_worker *worker, const char *line, size_t size)
+{
+    struct stat_counts *counts = &worker->counts;
+    size_t content = size, digits = 0, name;
+    struct stat_unit *unit = &worker->work->units[worker->unit];
+    uint64_t token;
+
+    worker->line = unit->lines++;
+    if (worker->has_time) {
+        if (!unit->has_time) {
+            unit->first_time = worker->time;
+            unit->has_time = 1;
+        }
+        unit->last_time = worker->time;
+    }
+
+    ++counts->lines;
+    counts->bytes += size;
+
+    while (content > 0 && (line[content - 1] == '\n' ||
+            line[content - 1] == '\r')) {
+        --content;
+    }
+    if (content == 0) {
+        ++counts->blank.count;
+        return;
+    }
+
+    /* A command sent to GDB, which GDB/MI output never looks like */
+    while (digits < content && line[digits] >= '0' && line[digits] <= '9') {
+        ++digits;
+    }
+    if (digits < content && line[digits] == '-') {
+        ++counts->commands.count;
+        counts->commands.bytes += content;
+        for (name = digits + 1; name < content && line[name] != ' ' &&
+                line[name] != '\t'; ++name) {
+        }
+        if (stat_token(line, digits, &token)) {
+            stat_keep_event(worker, token, line + digits, name - digits);
+        }
+        return;
+    }
+
+    gdbwire_mi_parser_push_data(worker->parser, line, size);
+    if (line[size - 1] != '\n') {
+        gdbwire_mi_parser_push_data(worker->parser, "\n", 1);
+    }
+}
+
+/**
+ * Gather the statistics of the lines of some data.
+ *
+ * A line that does not end in the data is kept in the worker's buffer,
+ * to be continued by the next data.
+ *
+ * @param worker
+ * The worker.
+ *
+ * @param data
+ * The data.
+ *
+ * @param size
+ * The number of bytes in data.
+ */
+static void
+stat_lines(struct stat_worker *worker, const char *data, size_t size)
+{
+    const char *newline;
+    size_t count;
+
+    while (size > 0) {
+        newline = (const char *)memchr(data, '\n', size);
+        count = (newline) ? (size_t)(newline - data) + 1 : size;
+
+        if (newline && worker->buffer_size == 0) {
+            stat_line(worker, data, count);
+        } else {
+            worker->buffer = (char *)stat_reserve(worker->buffer,
+                &worker->buffer_capacity, worker->buffer_size + count);
+            memcpy(worker->buffer + worker->buffer_size, data, count);
+            worker->buffer_size += count;
+            if (newline) {
+                stat_line(worker, worker->buffer, worker->buffer_size);
+                worker->buffer_size = 0;
+            }
+        }
+
+        data += count;
+        size -= count;
+    }
+}
+
+/* Finish the line a unit ends with, if it did not end with a newline */
+static void
+stat_end_unit(struct stat_worker *worker)
+{
+    if (worker->buffer_size > 0) {
+        stat_line(worker, worker->buffer, worker->buffer_size);
+        worker->buffer_size = 0;
+    }
+}
+
+/**
+ * Parse the lines of plain output that start in a range of bytes.
+ *
+ * A line that starts before the range is skipped, a line that starts in
+ * the range and ends after it is read to its end.
+ *
+ * @return
+ * 0 on success or -1 if the file could not be read.
+ */
+static int
+stat_parse_text(struct stat_worker *worker, const struct stat_file *file,
+        const struct stat_unit *unit)
+{
+    uint64_t position = unit->start;
+    const char *newline;
+    ssize_t size;
+    char previous;
+
+    worker->has_time = 0;
+    worker->data = (char *)stat_reserve(worker->data,
+        &worker->data_capacity, STAT_READ_SIZE);
+
+    if (unit->start > 0) {
+        if (pread(file->fd, &previous, 1, (off_t)unit->start - 1) != 1) {
+            return -1;
+        }
+
+        /* Skip to the start of the first line in the range */
+        while (previous != '\n') {
+            size = pread(file->fd, worker->data, STAT_READ_SIZE,
+                (off_t)position);
+            if (size < 0) {
+                return -1;
+            } else if (size == 0) {
+                return 0;
+            }
+            newline = (const char *)memchr(worker->data, '\n', (size_t)size);
+            if (newline) {
+                position += (uint64_t)(newline - worker->data) + 1;
+                previous = '\n';
+            } else {
+                position += (uint64_t)size;
+            }
+        }
+    }
+
+    /* Read to the end of the range and then to the end of its last line */
+    while (position < unit->end || worker->buffer_size > 0) {
+        size_t count;
+
+        size = pread(file->fd, worker->data, STAT_READ_SIZE, (off_t)position);
+        if (size < 0) {
+            return -1;
+        } else if (size == 0) {
+            break;
+        }
+
+        count = (size_t)size;
+        if (position + count > unit->end) {
+            /* Stop after the newline of the last line in the range */
+            size_t inside = (position < unit->end) ?
+                (size_t)(unit->end - position) : 0;
+            newline = (const char *)memchr(worker->data + inside, '\n',
+                count - inside);
+            if (inside > 0 && worker->data[inside - 1] == '\n') {
+                count = inside;
+            } else if (newline) {
+                count = (size_t)(newline - worker->data) + 1;
+            }
+        }
+
+        stat_lines(worker, worker->data, count);
+        position += count;
+        if (count < (size_t)size) {
+            break;
+        }
+    }
+
+    stat_end_unit(worker);
+
+    return 0;
+}
+
+/**
+ * Parse a block of a transcript.
+ *
+ * @return
+ * 0 on success or -1 if the block could not be decoded.
+ */
+static int
+stat_parse_block(struct stat_worker *worker, const struct stat_file *file,
+        const struct stat_unit *unit)
+{
+    struct gdbwire_transcript_block block;
+    size_t line = 0, count, offset;
+    const char *newline;
+
+    if (gdbwire_transcript_reader_block(file->reader, (size_t)unit->start,
+            &block) != GDBWIRE_OK) {
+        return -1;
+    }
+
+    worker->data = (char *)stat_reserve(worker->data,
+        &worker->data_capacity, block.size);
+    worker->times = (uint64_t *)stat_reserve(worker->times,
+        &worker->times_capacity, block.lines * sizeof (uint64_t));
+    if (gdbwire_transcript_reader_decode(file->reader, (size_t)unit->start,
+            worker->data, worker->times) != GDBWIRE_OK) {
+        return -1;
+    }
+
+    worker->has_time = 1;
+    for (offset = 0; offset < block.size && line < block.lines;
+            offset += count) {
+        newline = (const char *)memchr(worker->data + offset, '\n',
+            block.size - offset);
+        count = (newline) ? (size_t)(newline - worker->data) + 1 - offset :
+            block.size - offset;
+        worker->time = worker->times[line++];
+        stat_line(worker, worker->data + offset, count);
+    }
+
+    return 0;
+}
+
+/**
+ * Parse a log of gdbwire_recorder.
+ *
+ * Each line has the time of the chunk it ended in.
+ *
+ * @return
+ * 0 on success or -1 if the log could not be read.
+ */
+static int
+stat_parse_log(struct stat_worker *worker, const struct stat_file *file)
+{
+    enum gdbwire_result result;
+    FILE *log = fopen(file->path, "rb");
+    size_t size;
+
+    if (!log) {
+        return -1;
+    }
+
+    worker->has_time = 1;
+    worker->data = (char *)stat_reserve(worker->data,
+        &worker->data_capacity, GDBWIRE_RECORDER_CHUNK_MAX);
+    while ((result = gdbwire_recorder_read_chunk(log, &worker->time,
+            worker->data, &size)) == GDBWIRE_OK && size > 0) {
+        stat_lines(worker, worker->data, size);
+    }
+    stat_end_unit(worker);
+
+    fclose(log);
+
+    return (result == GDBWIRE_OK) ? 0 : -1;
+}
+
+static void *
+stat_worker_run(void *arg)
+{
+    struct stat_worker *worker = (struct stat_worker *)arg;
+    struct stat_work *work = worker->work;
+    struct stat_unit *unit;
+    const struct stat_file *file;
+    int status;
+
+    for (;;) {
+        worker->unit = gdbwire_atomic_fetch_add(&work->next, 1);
+        if (worker->unit >= work->unit_count) {
+            break;
+        }
+        unit = &work->units[worker->unit];
+        file = &work->files[unit->file];
+
+        worker->unit_errors = 0;
+        worker->buffer_size = 0;
+        gdbwire_mi_parser_reset(worker->parser);
+
+        switch (file->format) {
+            case STAT_TEXT:
+                status = stat_parse_text(worker, file, unit);
+                break;
+            case STAT_LOG:
+                status = stat_parse_log(worker, file);
+                break;
+            default:
+                status = stat_parse_block(worker, file, unit);
+                break;
+        }
+        unit->failed = (status != 0);
+    }
+
+    return NULL;
+}
+
+/**
+ * Open a file and divide it into units.
+ *
+ * @return
+ * 0 on success or -1 if the file could not be opened.
+ */
+static int
+stat_open(struct stat_file *file, size_t index, struct stat_array *units)
+{
+    char magic[8];
+    struct stat info;
+    struct stat_unit *unit;
+    uint64_t start;
+    size_t count, block;
+
+    file->fd = open(file->path, O_RDONLY);
+    if (file->fd < 0 || fstat(file->fd, &info) != 0) {
+        fprintf(stderr, "gdbwire_stat: %s: %s\n", file->path,
+            strerror(errno));
+        return -1;
+    }
+    if (!S_ISREG(info.st_mode)) {
+        fprintf(stderr, "gdbwire_stat: %s: not a regular file\n", file->path);
+        return -1;
+    }
+    file->size = (uint64_t)info.st_size;
+
+    file->format = STAT_TEXT;
+    if (pread(file->fd, magic, sizeof (magic), 0) == sizeof (magic)) {
+        if (memcmp(magic, "GDBWLOG\1", sizeof (magic)) == 0) {
+            file->format = STAT_LOG;
+        } else if (memcmp(magic, "GDBWTRS\1", sizeof (magic)) == 0) {
+            file->format = STAT_TRANSCRIPT;
+        }
+    }
+
+    switch (file->format) {
+        case STAT_TEXT:
+            for (start = 0; start < file->size; start += STAT_UNIT_SIZE) {
+                unit = (struct stat_unit *)stat_array_push(units,
+                    sizeof (struct stat_unit));
+                memset(unit, 0, sizeof (struct stat_unit));
+                unit->file = index;
+                unit->start = start;
+                unit->end = start + STAT_UNIT_SIZE;
+            }
+            break;
+        case STAT_LOG:
+            unit = (struct stat_unit *)stat_array_push(units,
+                sizeof (struct stat_unit));
+            memset(unit, 0, sizeof (struct stat_unit));
+            unit->file = index;
+            break;
+        case STAT_TRANSCRIPT:
+            file->stream = fopen(file->path, "rb");
+            file->reader = (file->stream) ?
+                gdbwire_transcript_reader_create(file->stream) : NULL;
+            if (!file->reader) {
+                fprintf(stderr, "gdbwire_stat: %s: not a valid transcript\n",
+                    file->path);
+                return -1;
+            }
+            count = gdbwire_transcript_reader_count(file->reader);
+            for (block = 0; block < count; ++block) {
+                unit = (struct stat_unit *)stat_array_push(units,
+                    sizeof (struct stat_unit));
+                memset(unit, 0, sizeof (struct stat_unit));
+                unit->file = index;
+                unit->start = block;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+static void
+stat_close(struct stat_file *file)
+{
+    if (file->reader) {
+        gdbwire_transcript_reader_destroy(file->reader);
+    }
+    if (file->stream) {
+        fclose(file->stream);
+    }
+    if (file->fd >= 0) {
+        close(file->fd);
+    }
+}
+
+static void
+stat_add(struct stat_count *to, const struct stat_count *from)
+{
+    to->count += from->count;
+    to->bytes += from->bytes;
+}
+
+/* Add the statistics of a worker to the totals */
+static void
+stat_merge_counts(struct stat_counts *to, const struct stat_counts *from)
+{
+    size_t kind, index;
+
+    to->lines += from->lines;
+    to->bytes += from->bytes;
+    stat_add(&to->blank, &from->blank);
+    stat_add(&to->commands, &from->commands);
+    stat_add(&to->prompts, &from->prompts);
+    stat_add(&to->errors, &from->errors);
+    for (index = 0; index < STAT_STREAMS; ++index) {
+        stat_add(&to->streams[index], &from->streams[index]);
+        to->stream_text[index] += from->stream_text[index];
+    }
+    for (kind = 0; kind < STAT_ASYNC_KINDS; ++kind) {
+        for (index = 0; index < STAT_ASYNC_CLASSES; ++index) {
+            stat_add(&to->async[kind][index], &from->async[kind][index]);
+        }
+    }
+    for (index = 0; index < STAT_RESULTS; ++index) {
+        stat_add(&to->results[index], &from->results[index]);
+    }
+}
+
+/* The units, for the comparison functions of qsort */
+static const struct stat_unit *stat_sort_units;
+
+static int
+stat_compare_largest(const void *lhs, const void *rhs)
+{
+    const struct stat_record *left = (const struct stat_record *)lhs;
+    const struct stat_record *right = (const struct stat_record *)rhs;
+
+    if (left->size != right->size) {
+        return (left->size > right->size) ? -1 : 1;
+    }
+    if (left->unit != right->unit) {
+        return (left->unit < right->unit) ? -1 : 1;
+    }
+    return (left->line < right->line) ? -1 : (left->line > right->line);
+}
+
+static int
+stat_compare_errors(const void *lhs, const void *rhs)
+{
+    const struct stat_record *left = (const struct stat_record *)lhs;
+    const struct stat_record *right = (const struct stat_record *)rhs;
+
+    if (left->unit != right->unit) {
+        return (left->unit < right->unit) ? -1 : 1;
+    }
+    return (left->line < right->line) ? -1 : (left->line > right->line);
+}
+
+static int
+stat_compare_events(const void *lhs, const void *rhs)
+{
+    const struct stat_event *left = (const struct stat_event *)lhs;
+    const struct stat_event *right = (const struct stat_event *)rhs;
+    size_t left_file = stat_sort_units[left->unit].file;
+    size_t right_file = stat_sort_units[right->unit].file;
+
+    /* The events of a token of a file, in the order of the file */
+    if (left_file != right_file) {
+        return (left_file < right_file) ? -1 : 1;
+    }
+    if (left->token != right->token) {
+        return (left->token < right->token) ? -1 : 1;
+    }
+    if (left->unit != right->unit) {
+        return (left->unit < right->unit) ? -1 : 1;
+    }
+    return (left->line < right->line) ? -1 : (left->line > right->line);
+}
+
+/* The time from the commands of a name to their results */
+struct stat_command {
+    char name[STAT_NAME_SIZE];
+    struct gdbwire_histogram *times;
+    uint64_t count;
+};
+
+static void
+stat_print_count(const char *kind, const char *name,
+        const struct stat_count *count, uint64_t total)
+{
+    if (count->count > 0) {
+        printf("  %-8s %-24s %12" PRIu64 " %14" PRIu64 " %6.2f%%\n", kind,
+            name, count->count, count->bytes,
+            (total > 0) ? 100.0 * (double)count->bytes / (double)total : 0.0);
+    }
+}
+
+static void
+stat_print_counts(const struct stat_counts *counts)
+{
+    size_t kind, index;
+    char name[32];
+
+    printf("\nrecords\n");
+    printf("  %-8s %-24s %12s %14s %7s\n", "kind", "class", "count", "bytes",
+        "share");
+    for (index = 0; index < STAT_STREAMS; ++index) {
+        stat_print_count("stream", stat_stream_names[index],
+            &counts->streams[index], counts->bytes);
+    }
+    for (kind = 0; kind < STAT_ASYNC_KINDS; ++kind) {
+        for (index = 0; index < STAT_ASYNC_CLASSES; ++index) {
+            snprintf(name, sizeof (name), "%c%s", stat_async_chars[kind],
+                gdbwire_mi_async_class_name(
+                    (enum gdbwire_mi_async_class)index));
+            stat_print_count("async", name, &counts->async[kind][index],
+                counts->bytes);
+        }
+    }
+    for (index = 0; index < STAT_RESULTS; ++index) {
+        snprintf(name, sizeof (name), "^%s", gdbwire_mi_result_class_name(
+            (enum gdbwire_mi_result_class)index));
+        stat_print_count("result", name, &counts->results[index],
+            counts->bytes);
+    }
+    stat_print_count("prompt", "(gdb)", &counts->prompts, counts->bytes);
+    stat_print_count("error", "parse error", &counts->errors, counts->bytes);
+    stat_print_count("command", "sent to gdb", &counts->commands,
+        counts->bytes);
+    stat_print_count("blank", "empty line", &counts->blank, counts->bytes);
+
+    printf("\nstreams\n");
+    printf("  %-8s %12s %14s %14s %7s\n", "stream", "count", "bytes",
+        "text bytes", "share");
+    for (index = 0; index < STAT_STREAMS; ++index) {
+        printf("  %-8s %12" PRIu64 " %14" PRIu64 " %14" PRIu64 " %6.2f%%\n",
+            stat_stream_names[index], counts->streams[index].count,
+            counts->streams[index].bytes, counts->stream_text[index],
+            (counts->bytes > 0) ? 100.0 *
+                (double)counts->streams[index].bytes /
+                    (double)counts->bytes : 0.0);
+    }
+}
+
+/* Find the time of a command, by its name */
+static struct stat_command *
+stat_find_command(struct stat_array *commands, const char *name)
+{
+    struct stat_command *command = (struct stat_command *)commands->data;
+    size_t index;
+
+    for (index = 0; index < commands->size; ++index) {
+        if (strcmp(command[index].name, name) == 0) {
+            return &command[index];
+        }
+    }
+
+    command = (struct stat_command *)stat_array_push(commands,
+        sizeof (struct stat_command));
+    memcpy(command->name, name, STAT_NAME_SIZE);
+    command->times = gdbwire_histogram_create();
+    command->count = 0;
+    if (!command->times) {
+        fprintf(stderr, "gdbwire_stat: out of memory\n");
+        exit(1);
+    }
+
+    return command;
+}
+
+static void
+stat_print_times(const char *name, const struct gdbwire_histogram *times)
+{
+    printf("  %-24s %10" PRIu64 " %12.3f %12.3f %12.3f %12.3f %12.3f\n",
+        name, gdbwire_histogram_count(times),
+        gdbwire_histogram_min(times) / 1e6,
+        gdbwire_histogram_percentile(times, 50) / 1e6,
+        gdbwire_histogram_percentile(times, 90) / 1e6,
+        gdbwire_histogram_percentile(times, 99) / 1e6,
+        gdbwire_histogram_max(times) / 1e6);
+}
+
+/**
+ * Pair each command with the next result record of its token, and
+ * report the time between them.
+ */
+static void
+stat_print_round_trips(struct stat_event *events, size_t count,
+        const struct stat_unit *units)
+{
+    struct stat_array commands = { 0, 0, 0 };
+    struct stat_command *command;
+    struct gdbwire_histogram *all = gdbwire_histogram_create();
+    const struct stat_event *pending = 0;
+    uint64_t unanswered = 0, unasked = 0, untimed = 0;
+    size_t index;
+
+    if (!all) {
+        fprintf(stderr, "gdbwire_stat: out of memory\n");
+        exit(1);
+    }
+
+    stat_sort_units = units;
+    qsort(events, count, sizeof (struct stat_event), stat_compare_events);
+
+    for (index = 0; index < count; ++index) {
+        const struct stat_event *event = &events[index];
+
+        /* A command whose result is not next in its token's events */
+        if (pending && (event->name[0] || event->token != pending->token ||
+                units[event->unit].file != units[pending->unit].file)) {
+            ++unanswered;
+            pending = 0;
+        }
+
+        if (event->name[0]) {
+            pending = event;
+        } else if (!pending) {
+            ++unasked;
+        } else {
+            command = stat_find_command(&commands, pending->name);
+            ++command->count;
+            if (pending->has_time && event->has_time &&
+                    event->time >= pending->time) {
+                gdbwire_histogram_record(command->times,
+                    event->time - pending->time);
+                gdbwire_histogram_record(all, event->time - pending->time);
+            } else {
+                ++untimed;
+            }
+            pending = 0;
+        }
+    }
+    if (pending) {
+        ++unanswered;
+    }
+
+    printf("\ncommand round trips (ms)\n");
+    printf("  %-24s %10s %12s %12s %12s %12s %12s\n", "command", "count",
+        "min", "p50", "p90", "p99", "max");
+    command = (struct stat_command *)commands.data;
+    for (index = 0; index < commands.size; ++index) {
+        if (gdbwire_histogram_count(command[index].times) > 0) {
+            stat_print_times(command[index].name, command[index].times);
+        }
+    }
+    if (gdbwire_histogram_count(all) > 0) {
+        stat_print_times("all", all);
+    }
+    printf("  commands without a result: %" PRIu64 "\n", unanswered);
+    printf("  results without a command: %" PRIu64 "\n", unasked);
+    printf("  pairs without times:       %" PRIu64 "\n", untimed);
+
+    for (index = 0; index < commands.size; ++index) {
+        gdbwire_histogram_destroy(command[index].times);
+    }
+    free(commands.data);
+    gdbwire_histogram_destroy(all);
+}
+
+static void
+stat_usage(void)
+{
+    fprintf(stderr, "usage: gdbwire_stat [-j threads] [-n largest] "
+        "[-e errors] file...\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct stat_work work;
+    struct stat_array units = { 0, 0, 0 };
+    struct stat_array largest = { 0, 0, 0 };
+    struct stat_array errors = { 0, 0, 0 };
+    struct stat_array events = { 0, 0, 0 };
+    struct gdbwire_mi_parser_callbacks callbacks = { 0, 0 };
+    struct stat_worker *workers;
+    struct stat_counts totals;
+    struct stat_file *files;
+    struct stat_record *records;
+    size_t threads = 0, file_count, index, started, unit;
+    uint64_t lines;
+    int opt, status = 0;
+
+    memset(&work, 0, sizeof (work));
+    work.largest = 10;
+    work.errors = 10;
+
+    while ((opt = getopt(argc, argv, "j:n:e:")) != -1) {
+        switch (opt) {
+            case 'j':
+                threads = (size_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                work.largest = (size_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'e':
+                work.errors = (size_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                stat_usage();
+                return 1;
+        }
+    }
+    if (optind == argc) {
+        stat_usage();
+        return 1;
+    }
+
+    file_count = (size_t)(argc - optind);
+    files = (struct stat_file *)calloc(file_count, sizeof (struct stat_file));
+    if (!files) {
+        fprintf(stderr, "gdbwire_stat: out of memory\n");
+        return 1;
+    }
+    for (index = 0; index < file_count; ++index) {
+        files[index].path = argv[optind + index];
+        files[index].fd = -1;
+        if (stat_open(&files[index], index, &units) != 0) {
+            status = 1;
+        }
+    }
+
+    work.files = files;
+    work.units = (struct stat_unit *)units.data;
+    work.unit_count = units.size;
+
+    if (threads == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (processors > 0) ? (size_t)processors : 1;
+    }
+    if (threads > work.unit_count) {
+        threads = (work.unit_count > 0) ? work.unit_count : 1;
+    }
+
+    workers = (struct stat_worker *)calloc(threads,
+        sizeof (struct stat_worker));
+    if (!workers) {
+        fprintf(stderr, "gdbwire_stat: out of memory\n");
+        return 1;
+    }
+    callbacks.gdbwire_mi_output_callback = stat_output_callback;
+    for (index = 0; index < threads; ++index) {
+        workers[index].work = &work;
+        workers[index].largest = (struct stat_record *)calloc(
+            work.largest + 1, sizeof (struct stat_record));
+        callbacks.context = &workers[index];
+        workers[index].parser = gdbwire_mi_parser_create(callbacks);
+        if (!workers[index].largest || !workers[index].parser) {
+            fprintf(stderr, "gdbwire_stat: out of memory\n");
+            return 1;
+        }
+    }
+
+    /* The calling thread is the first worker */
+    for (started = 1; started < threads; ++started) {
+        if (pthread_create(&workers[started].thread, NULL, stat_worker_run,
+                &workers[started]) != 0) {
+            break;
+        }
+    }
+    stat_worker_run(&workers[0]);
+    for (index = 1; index < started; ++index) {
+        pthread_join(workers[index].thread, NULL);
+    }
+
+    /* Number the lines of each unit from the start of its file */
+    for (unit = 0, lines = 0; unit < work.unit_count; ++unit) {
+        if (unit > 0 && work.units[unit].file != work.units[unit - 1].file) {
+            lines = 0;
+        }
+        work.units[unit].first_line = lines;
+        lines += work.units[unit].lines;
+        if (work.units[unit].failed) {
+            fprintf(stderr, "gdbwire_stat: %s: could not read past line "
+                "%" PRIu64 "\n", files[work.units[unit].file].path, lines);
+            status = 1;
+        }
+    }
+
+    memset(&totals, 0, sizeof (totals));
+    for (index = 0; index < threads; ++index) {
+        struct stat_worker *worker = &workers[index];
+
+        stat_merge_counts(&totals, &worker->counts);
+        for (unit = 0; unit < worker->largest_count; ++unit) {
+            *(struct stat_record *)stat_array_push(&largest,
+                sizeof (struct stat_record)) = worker->largest[unit];
+        }
+        for (unit = 0; unit < worker->errors.size; ++unit) {
+            *(struct stat_record *)stat_array_push(&errors,
+                sizeof (struct stat_record)) =
+                    ((struct stat_record *)worker->errors.data)[unit];
+        }
+        for (unit = 0; unit < worker->events.size; ++unit) {
+            *(struct stat_event *)stat_array_push(&events,
+                sizeof (struct stat_event)) =
+                    ((struct stat_event *)worker->events.data)[unit];
+        }
+    }
+
+    printf("files\n");
+    printf("  %-10s %12s %14s %12s  %s\n", "format", "lines", "bytes",
+        "seconds", "file");
+    for (index = 0, unit = 0; index < file_count; ++index) {
+        uint64_t file_lines = 0, first = 0, last = 0;
+        int has_time = 0;
+
+        for (; unit < work.unit_count && work.units[unit].file == index;
+                ++unit) {
+            file_lines += work.units[unit].lines;
+            if (work.units[unit].has_time) {
+                first = (has_time) ? first : work.units[unit].first_time;
+                last = work.units[unit].last_time;
+                has_time = 1;
+            }
+        }
+        printf("  %-10s %12" PRIu64 " %14" PRIu64,
+            stat_format_names[files[index].format], file_lines,
+            files[index].size);
+        if (has_time) {
+            printf(" %12.3f", (double)(last - first) / 1e9);
+        } else {
+            printf(" %12s", "-");
+        }
+        printf("  %s\n", files[index].path);
+    }
+    printf("  %-10s %12" PRIu64 " %14" PRIu64 " %12s  %s\n", "", totals.lines,
+        totals.bytes, "", "total");
+
+    stat_print_counts(&totals);
+    stat_print_round_trips((struct stat_event *)events.data, events.size,
+        work.units);
+
+    records = (struct stat_record *)largest.data;
+    qsort(records, largest.size, sizeof (struct stat_record),
+        stat_compare_largest);
+    printf("\nlargest records\n");
+    for (index = 0; index < largest.size && index < work.largest; ++index) {
+        printf("  %12" PRIu64 " bytes  %s:%" PRIu64 "  %s\n",
+            records[index].size,
+            files[work.units[records[index].unit].file].path,
+            work.units[records[index].unit].first_line +
+                records[index].line + 1, records[index].what);
+    }
+
+    records = (struct stat_record *)errors.data;
+    qsort(records, errors.size, sizeof (struct stat_record),
+        stat_compare_errors);
+    printf("\nparse errors (%" PRIu64 ")\n", totals.errors.count);
+    for (index = 0; index < errors.size && index < work.errors; ++index) {
+        printf("  %s:%" PRIu64 ": %s\n",
+            files[work.units[records[index].unit].file].path,
+            work.units[records[index].unit].first_line +
+                records[index].line + 1, records[index].what);
+    }
+
+    for (index = 0; index < threads; ++index) {
+        gdbwire_mi_parser_destroy(workers[index].parser);
+        free(workers[index].largest);
+        free(workers[index].errors.data);
+        free(workers[index].events.data);
+        free(workers[index].buffer);
+        free(workers[index].data);
+        free(workers[index].times);
+    }
+    for (index = 0; index < file_count; ++index) {
+        stat_close(&files[index]);
+    }
+    free(workers);
+    free(files);
+    free(units.data);
+    free(largest.data);
+    free(errors.data);
+    free(events.data);
+
+    return status;
+}
@@ -0,0 +1,88 @@
+/**
+ * Only include headers that do not declare malloc and friends here.
+ * The system declarations have exception specifications in C++
+ * that the replacements below would conflict with.
+ *
+ * limits.h is included to define __GLIBC__ on systems that have it.
+ */
+#include <limits.h>
+#include <stddef.h>
+#include "allocation_counter.h"
+
+namespace {
+    /* The number of AllocationCounter objects currently alive */
+    int counters_alive;
+
+    /* The number of allocations made while a counter was alive */
+    size_t allocations;
+}
+
+#ifdef __GLIBC__
+
+/**
+ * Replace the system allocator by forwarding to the GNU C library's
+ * internal entry points, counting the calls along the way.
+ */
+extern "C" {
+    extern void *__libc_malloc(size_t size);
+    extern void *__libc_calloc(size_t nmemb, size_t size);
+    extern void *__libc_realloc(void *ptr, size_t size);
+    extern void __libc_free(void *ptr);
+
+    void *malloc(size_t size)
+    {
+        if (counters_alive) {
+            ++allocations;
+        }
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t nmemb, size_t size)
+    {
+        if (counters_alive) {
+            ++allocations;
+        }
+        return __libc_calloc(nmemb, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        if (counters_alive) {
+            ++allocations;
+        }
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+
+#endif
+
+AllocationCounter::AllocationCounter() : m_start(allocations)
+{
+    ++counters_alive;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    --counters_alive;
+}
+
+size_t
+AllocationCounter::count() const
+{
+    return allocations - m_start;
+}
+
+bool
+AllocationCounter::supported()
+{
+#ifdef __GLIBC__
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,54 @@
+#ifndef __ALLOCATION_COUNTER_H__
+#define __ALLOCATION_COUNTER_H__
+
+#include <stddef.h>
+
+/**
+ * Counts the calls made to the system allocator.
+ *
+ * The test suite replaces malloc, calloc and realloc with versions that
+ * count each call while an AllocationCounter is alive. This allows a
+ * unit test to verify that a piece of code does not allocate memory,
+ * for instance that the parser reaches a steady state where pushing
+ * more data does not allocate.
+ *
+ * Do not call into the test framework (REQUIRE, etc) while a counter
+ * is alive, the test framework allocates memory itself.
+ *
+ * Replacing the allocator requires the GNU C library. When it is not
+ * available supported() returns false and count() is always 0.
+ */
+class AllocationCounter {
+    public:
+        /**
+         * Start counting allocations.
+         */
+        AllocationCounter();
+
+        /**
+         * Stop counting allocations.
+         */
+        ~AllocationCounter();
+
+        /**
+         * Get the number of allocations made while this counter is alive.
+         *
+         * @return
+         * The number of calls to malloc, calloc and realloc.
+         */
+        size_t count() const;
+
+        /**
+         * Determine if the allocations can be counted on this system.
+         *
+         * @return
+         * True if allocations are counted, false otherwise.
+         */
+        static bool supported();
+
+    private:
+        /* The global allocation count when this counter was created */
+        size_t m_start;
+};
+
+#endif /* __ALLOCATION_COUNTER_H__ */
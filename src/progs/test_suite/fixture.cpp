@@ -1,6 +1,8 @@
+#include <dirent.h>
 #include "config.h"
 #include "catch.hpp"
 #include "fixture.h"
+#include "gdbwire_mi_parser.h"
 
 std::string
 Fixture::testName()
@@ -33,3 +35,75 @@ Fixture::sourceTestPath()
     resultPath = resultPath + "/" + testName();
     return resultPath;
 }
+
+void
+Fixture::findMiFiles(const std::string &path, std::vector<std::string> &files)
+{
+    DIR *dir = opendir(path.c_str());
+    struct dirent *entry;
+    std::string name;
+
+    REQUIRE(dir);
+    while ((entry = readdir(dir))) {
+        name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        if (name.size() > 3 &&
+                name.compare(name.size() - 3, 3, ".mi") == 0) {
+            files.push_back(path + "/" + name);
+        } else if (entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN) {
+            DIR *child = opendir((path + "/" + name).c_str());
+            if (child) {
+                closedir(child);
+                findMiFiles(path + "/" + name, files);
+            }
+        }
+    }
+    closedir(dir);
+}
+
+MiParserFixture::MiParserFixture() : m_output(0)
+{
+    gdbwire_mi_parser_callbacks callbacks = { 0, 0 };
+    callbacks.context = this;
+    callbacks.gdbwire_mi_output_callback = outputCallback;
+    parser = gdbwire_mi_parser_create(callbacks);
+    REQUIRE(parser);
+}
+
+MiParserFixture::~MiParserFixture()
+{
+    gdbwire_mi_parser_destroy(parser);
+    gdbwire_mi_output_free(m_output);
+}
+
+gdbwire_mi_output *
+MiParserFixture::parse(const std::string &data)
+{
+    gdbwire_mi_output *last = m_output;
+
+    while (last && last->next) {
+        last = last->next;
+    }
+
+    REQUIRE(gdbwire_mi_parser_push_data(parser, data.data(), data.size()) ==
+        GDBWIRE_OK);
+
+    return (last) ? last->next : m_output;
+}
+
+gdbwire_mi_output *
+MiParserFixture::takeOutputs()
+{
+    gdbwire_mi_output *output = m_output;
+    m_output = 0;
+    return output;
+}
+
+void
+MiParserFixture::outputCallback(void *context, gdbwire_mi_output *output)
+{
+    MiParserFixture *fixture = (MiParserFixture *)context;
+    fixture->m_output = append_gdbwire_mi_output(fixture->m_output, output);
+}
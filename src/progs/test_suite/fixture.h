@@ -2,6 +2,10 @@
 #define __FIXTURE_H__
 
 #include <string>
+#include <vector>
+
+struct gdbwire_mi_output;
+struct gdbwire_mi_parser;
 
 /**
  * Provides functionality above and beyond the normal Test.
@@ -78,6 +82,57 @@ class Fixture {
          * This may be read-only.
          */
         std::string sourceTestPath();
+
+        /**
+         * Find the MI files in a directory and the directories below it.
+         *
+         * @param path
+         * The directory to search, for example data().
+         *
+         * @param files
+         * The paths of the MI files found are added to this.
+         */
+        void findMiFiles(const std::string &path,
+            std::vector<std::string> &files);
+};
+
+/**
+ * A test fixture with a GDB/MI parser that collects what it parses.
+ *
+ * The outputs parsed are appended to m_output and freed with the
+ * fixture, unless the test takes them with takeOutputs().
+ */
+class MiParserFixture : public Fixture {
+    public:
+
+        MiParserFixture();
+        virtual ~MiParserFixture();
+
+        /**
+         * Parse data, collecting the outputs it holds.
+         *
+         * @param data
+         * The data to parse.
+         *
+         * @return
+         * The first output parsed from data or NULL if it held none.
+         */
+        gdbwire_mi_output *parse(const std::string &data);
+
+        /**
+         * Take the outputs collected so far.
+         *
+         * @return
+         * The outputs, to be freed by the caller with gdbwire_mi_output_free.
+         */
+        gdbwire_mi_output *takeOutputs();
+
+        gdbwire_mi_parser *parser;
+        gdbwire_mi_output *m_output;
+
+    private:
+
+        static void outputCallback(void *context, gdbwire_mi_output *output);
 };
 
 // A convience macro for creating unit tests.
@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <vector>
 #include "catch.hpp"
 #include "fixture.h"
+#include "allocation_counter.h"
 #include "gdbwire.h"
 
 /**
@@ -151,6 +154,17 @@ namespace {
 
     struct GdbwireBasicTest: public Fixture {};
 
+    void gdbwire_oversized_line(void *context,
+            gdbwire_mi_parser_limit_action action, size_t size) {
+        *(size_t *)context = size;
+    }
+
+    void gdbwire_stream_chunk(void *context,
+            gdbwire_mi_stream_record_kind kind, const char *data,
+            size_t size, int last) {
+        ((std::string *)context)->append(data, size);
+    }
+
     std::string get_file_contents(const std::string &path) {
         std::string result;
         FILE *fd;
@@ -280,3 +294,311 @@ TEST_CASE_METHOD_N(GdbwireBasicTest, interpreter_exec/command_and_prompt.mi)
     REQUIRE(result == GDBWIRE_LOGIC);
     REQUIRE(!mi_command);
 }
+
+/**
+ * Ensure a context gives the same results as gdbwire_interpreter_exec
+ * when reused for one output after another.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, interpreter_exec_ctx/reuse)
+{
+    const char *files[] = { "basic.mi", "error.mi", "command_and_stream.mi",
+        "command_and_prompt.mi", "basic.mi" };
+    const gdbwire_result expected[] = { GDBWIRE_OK, GDBWIRE_ASSERT,
+        GDBWIRE_LOGIC, GDBWIRE_LOGIC, GDBWIRE_OK };
+    gdbwire_interpreter_exec_ctx *ctx;
+    struct gdbwire_mi_command *mi_command;
+    gdbwire_result result;
+    size_t index;
+
+    ctx = gdbwire_interpreter_exec_ctx_create();
+    REQUIRE(ctx);
+
+    for (index = 0; index < sizeof(files) / sizeof(files[0]); ++index) {
+        std::string mi = get_file_contents(data() +
+            "/GdbwireBasicTest/interpreter_exec/" + files[index]);
+        mi_command = 0;
+        result = gdbwire_interpreter_exec_with_ctx(ctx, mi.c_str(),
+            GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE, &mi_command);
+        REQUIRE(result == expected[index]);
+        REQUIRE((mi_command != 0) == (result == GDBWIRE_OK));
+        gdbwire_mi_command_free(mi_command);
+    }
+
+    gdbwire_interpreter_exec_ctx_destroy(ctx);
+}
+
+/**
+ * Ensure an incomplete line does not leak into the next output.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, interpreter_exec_ctx/incomplete_line)
+{
+    std::string mi = get_file_contents(data() +
+        "/GdbwireBasicTest/interpreter_exec/basic.mi");
+    gdbwire_interpreter_exec_ctx *ctx;
+    struct gdbwire_mi_command *mi_command = 0;
+
+    ctx = gdbwire_interpreter_exec_ctx_create();
+    REQUIRE(ctx);
+
+    REQUIRE(gdbwire_interpreter_exec_with_ctx(ctx, "^done,line=",
+        GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE, &mi_command) == GDBWIRE_LOGIC);
+    REQUIRE(!mi_command);
+
+    REQUIRE(gdbwire_interpreter_exec_with_ctx(ctx, mi.c_str(),
+        GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE, &mi_command) == GDBWIRE_OK);
+    REQUIRE(mi_command);
+    gdbwire_mi_command_free(mi_command);
+
+    gdbwire_interpreter_exec_ctx_destroy(ctx);
+}
+
+/**
+ * Ensure a warmed up context only allocates the resulting command.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, interpreter_exec_ctx/allocations)
+{
+    std::string mi = get_file_contents(data() +
+        "/GdbwireBasicTest/interpreter_exec/basic.mi");
+    struct gdbwire_mi_command *mi_command = 0;
+    gdbwire_interpreter_exec_ctx *ctx;
+    gdbwire_result result;
+    size_t reused, created, prompt;
+    int index;
+
+    ctx = gdbwire_interpreter_exec_ctx_create();
+    REQUIRE(ctx);
+
+    for (index = 0; index < 2; ++index) {
+        REQUIRE(gdbwire_interpreter_exec_with_ctx(ctx, mi.c_str(),
+            GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE, &mi_command) ==
+                GDBWIRE_OK);
+        gdbwire_mi_command_free(mi_command);
+    }
+
+    if (AllocationCounter::supported()) {
+        {
+            AllocationCounter counter;
+            result = gdbwire_interpreter_exec_with_ctx(ctx, "(gdb)\n",
+                GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE, &mi_command);
+            prompt = counter.count();
+        }
+        REQUIRE(result == GDBWIRE_LOGIC);
+        REQUIRE(prompt == 0);
+
+        {
+            AllocationCounter counter;
+            result = gdbwire_interpreter_exec_with_ctx(ctx, mi.c_str(),
+                GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE, &mi_command);
+            reused = counter.count();
+        }
+        REQUIRE(result == GDBWIRE_OK);
+        gdbwire_mi_command_free(mi_command);
+
+        {
+            AllocationCounter counter;
+            result = gdbwire_interpreter_exec(mi.c_str(),
+                GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE, &mi_command);
+            created = counter.count();
+        }
+        REQUIRE(result == GDBWIRE_OK);
+        gdbwire_mi_command_free(mi_command);
+
+        REQUIRE(reused > 0);
+        REQUIRE(reused < created);
+    }
+
+    gdbwire_interpreter_exec_ctx_destroy(ctx);
+}
+
+/**
+ * Ensure a batch gives each output the result gdbwire_interpreter_exec
+ * gives it, in input order, however many workers handle it.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, interpreter_exec_batch/results)
+{
+    const char *files[] = { "basic.mi", "error.mi", "command_and_stream.mi",
+        "command_and_prompt.mi" };
+    const size_t file_count = sizeof(files) / sizeof(files[0]);
+    const size_t threads[] = { 1, 3, 0 };
+    std::vector<std::string> mis;
+    std::vector<const char *> outputs;
+    std::vector<gdbwire_mi_command_kind> kinds;
+    std::vector<gdbwire_result> expected, results;
+    std::vector<gdbwire_mi_command *> mi_commands;
+    gdbwire_mi_command *mi_command;
+    size_t index, run;
+
+    for (index = 0; index < file_count; ++index) {
+        mis.push_back(get_file_contents(data() +
+            "/GdbwireBasicTest/interpreter_exec/" + files[index]));
+    }
+
+    /* Mix in an output that is not the expected command kind */
+    for (index = 0; index < 1000; ++index) {
+        outputs.push_back(mis[(index * 7) % file_count].c_str());
+        kinds.push_back((index % 5 == 0) ? GDBWIRE_MI_BREAK_INFO :
+            GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE);
+        mi_command = 0;
+        expected.push_back(gdbwire_interpreter_exec(outputs[index],
+            kinds[index], &mi_command));
+        gdbwire_mi_command_free(mi_command);
+    }
+
+    for (run = 0; run < sizeof(threads) / sizeof(threads[0]); ++run) {
+        results.assign(outputs.size(), GDBWIRE_OK);
+        mi_commands.assign(outputs.size(), (gdbwire_mi_command *)0);
+
+        REQUIRE(gdbwire_interpreter_exec_batch(&outputs[0], &kinds[0],
+            outputs.size(), threads[run], NULL, &results[0],
+            &mi_commands[0]) == GDBWIRE_OK);
+
+        for (index = 0; index < outputs.size(); ++index) {
+            REQUIRE(results[index] == expected[index]);
+            REQUIRE((mi_commands[index] != 0) ==
+                (results[index] == GDBWIRE_OK));
+            if (mi_commands[index]) {
+                REQUIRE(mi_commands[index]->kind == kinds[index]);
+            }
+            gdbwire_mi_command_free(mi_commands[index]);
+        }
+    }
+}
+
+/**
+ * Ensure an empty batch is handled.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, interpreter_exec_batch/empty)
+{
+    REQUIRE(gdbwire_interpreter_exec_batch(NULL, NULL, 0, 0, NULL,
+        NULL, NULL) == GDBWIRE_OK);
+}
+
+/**
+ * Ensure gdbwire stops allocating memory once it has warmed up.
+ *
+ * gdbwire frees each output after invoking the callbacks, so the arenas
+ * the outputs were allocated from are reused line after line.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, steady_state/common_records.mi)
+{
+    std::string mi = get_file_contents(sourceTestPath());
+    gdbwire_callbacks c = {};
+    gdbwire_result result;
+    size_t allocations;
+
+    struct gdbwire *wire = gdbwire_create(c);
+    REQUIRE(wire);
+
+    REQUIRE(gdbwire_push_data(wire, mi.data(), mi.size()) == GDBWIRE_OK);
+
+    if (AllocationCounter::supported()) {
+        {
+            AllocationCounter counter;
+            result = gdbwire_push_data(wire, mi.data(), mi.size());
+            allocations = counter.count();
+        }
+
+        REQUIRE(result == GDBWIRE_OK);
+        REQUIRE(allocations == 0);
+    }
+
+    gdbwire_destroy(wire);
+}
+
+/**
+ * Ensure the limits and stats are forwarded to the parser.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, limits/oversized_line)
+{
+    gdbwire_mi_parser_limits limits = { 0, 1, GDBWIRE_MI_LIMIT_SKIP };
+    std::string line = "~\"" + std::string(10000, 'a') + "\"\n";
+    gdbwire_callbacks c = {};
+    gdbwire_mi_parser_stats stats;
+    size_t size = 0;
+
+    struct gdbwire *wire = gdbwire_create(c);
+    REQUIRE(wire);
+
+    REQUIRE(gdbwire_set_oversized_line_callback(wire,
+        gdbwire_oversized_line, &size) == GDBWIRE_OK);
+    REQUIRE(gdbwire_set_limits(wire, limits) == GDBWIRE_OK);
+    REQUIRE(gdbwire_push_data(wire, line.data(), line.size()) == GDBWIRE_OK);
+    REQUIRE(size == 10003);
+
+    REQUIRE(gdbwire_get_stats(wire, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.lines == 0);
+    REQUIRE(stats.lines_skipped == 1);
+
+    gdbwire_destroy(wire);
+}
+
+/**
+ * Ensure large stream records are forwarded in chunks.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, stream/chunks)
+{
+    std::string data = std::string(100, 'c');
+    gdbwire_callbacks c = {};
+    std::string chunks;
+
+    struct gdbwire *wire = gdbwire_create(c);
+    REQUIRE(wire);
+
+    REQUIRE(gdbwire_set_stream_chunk_callback(wire, gdbwire_stream_chunk,
+        &chunks) == GDBWIRE_OK);
+    REQUIRE(gdbwire_set_stream_threshold(wire, 16) == GDBWIRE_OK);
+    REQUIRE(gdbwire_push_data(wire, "~\"", 2) == GDBWIRE_OK);
+    REQUIRE(gdbwire_push_data(wire, data.data(), data.size()) == GDBWIRE_OK);
+    REQUIRE(chunks == data);
+    REQUIRE(gdbwire_push_data(wire, "\"\n", 2) == GDBWIRE_OK);
+
+    gdbwire_destroy(wire);
+}
+
+/**
+ * Ensure the latency of each record class is measured.
+ */
+TEST_CASE_METHOD_N(GdbwireBasicTest, latency/histograms)
+{
+    gdbwire_callbacks c = {};
+    const gdbwire_histogram *histogram;
+    struct gdbwire *wire = gdbwire_create(c);
+    REQUIRE(wire);
+
+    REQUIRE(!gdbwire_get_latency(wire, GDBWIRE_LATENCY_ASYNC,
+        GDBWIRE_MI_ASYNC_STOPPED, GDBWIRE_LATENCY_TOTAL));
+
+    REQUIRE(gdbwire_set_timestamps(wire, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_push_data(wire, "*stop", 5) == GDBWIRE_OK);
+    usleep(1000);
+    REQUIRE(gdbwire_push_data(wire, "ped\n^done\n(gdb)\n", 16) == GDBWIRE_OK);
+
+    /* The *stopped record took the sleep to arrive */
+    histogram = gdbwire_get_latency(wire, GDBWIRE_LATENCY_ASYNC,
+        GDBWIRE_MI_ASYNC_STOPPED, GDBWIRE_LATENCY_ARRIVAL);
+    REQUIRE(gdbwire_histogram_count(histogram) == 1);
+    REQUIRE(gdbwire_histogram_min(histogram) >= 1000000);
+    histogram = gdbwire_get_latency(wire, GDBWIRE_LATENCY_ASYNC,
+        GDBWIRE_MI_ASYNC_STOPPED, GDBWIRE_LATENCY_TOTAL);
+    REQUIRE(gdbwire_histogram_min(histogram) >= 1000000);
+
+    /* The ^done record arrived whole */
+    histogram = gdbwire_get_latency(wire, GDBWIRE_LATENCY_RESULT,
+        GDBWIRE_MI_DONE, GDBWIRE_LATENCY_ARRIVAL);
+    REQUIRE(gdbwire_histogram_count(histogram) == 1);
+    REQUIRE(gdbwire_histogram_max(histogram) == 0);
+    REQUIRE(gdbwire_get_latency(wire, GDBWIRE_LATENCY_RESULT,
+        GDBWIRE_MI_DONE, GDBWIRE_LATENCY_PARSE));
+    REQUIRE(gdbwire_histogram_count(gdbwire_get_latency(wire,
+        GDBWIRE_LATENCY_PROMPT, 0, GDBWIRE_LATENCY_TOTAL)) == 1);
+
+    /* The classes not seen and the classes out of range have none */
+    REQUIRE(!gdbwire_get_latency(wire, GDBWIRE_LATENCY_RESULT,
+        GDBWIRE_MI_ERROR, GDBWIRE_LATENCY_TOTAL));
+    REQUIRE(!gdbwire_get_latency(wire, GDBWIRE_LATENCY_PROMPT, 1,
+        GDBWIRE_LATENCY_TOTAL));
+    REQUIRE(!gdbwire_get_latency(wire, GDBWIRE_LATENCY_STREAM, -1,
+        GDBWIRE_LATENCY_TOTAL));
+
+    gdbwire_destroy(wire);
+}
@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire.h"
+#include "gdbwire_allocator.h"
+#include "gdbwire_mi_parser.h"
+#include "gdbwire_string.h"
+#include "gdbwire_sys.h"
+
+namespace {
+    /**
+     * An allocator that counts the allocations made through it.
+     */
+    struct CountingAllocator {
+        CountingAllocator() : allocations(0), frees(0) {
+            allocator.context = (void*)this;
+            allocator.malloc_fn = CountingAllocator::malloc_fn;
+            allocator.realloc_fn = CountingAllocator::realloc_fn;
+            allocator.free_fn = CountingAllocator::free_fn;
+        }
+
+        static void *malloc_fn(void *context, size_t size) {
+            CountingAllocator *counter = (CountingAllocator *)context;
+            counter->allocations++;
+            return malloc(size);
+        }
+
+        static void *realloc_fn(void *context, void *ptr, size_t size) {
+            CountingAllocator *counter = (CountingAllocator *)context;
+            if (!ptr) {
+                counter->allocations++;
+            }
+            return realloc(ptr, size);
+        }
+
+        static void free_fn(void *context, void *ptr) {
+            CountingAllocator *counter = (CountingAllocator *)context;
+            counter->frees++;
+            free(ptr);
+        }
+
+        /**
+         * The number of allocations not yet freed.
+         */
+        size_t outstanding() const {
+            return allocations - frees;
+        }
+
+        gdbwire_allocator allocator;
+        size_t allocations;
+        size_t frees;
+    };
+
+    /**
+     * An allocator that is out of memory.
+     */
+    void *failing_malloc_fn(void *context, size_t size) {
+        return NULL;
+    }
+
+    void *failing_realloc_fn(void *context, void *ptr, size_t size) {
+        return NULL;
+    }
+
+    void failing_free_fn(void *context, void *ptr) {
+    }
+
+    struct GdbwireMiParserCallback {
+        GdbwireMiParserCallback() : m_output(0) {
+            callbacks.context = (void*)this;
+            callbacks.gdbwire_mi_output_callback =
+                    GdbwireMiParserCallback::gdbwire_mi_output_callback;
+        }
+
+        ~GdbwireMiParserCallback() {
+            gdbwire_mi_output_free(m_output);
+        }
+
+        static void gdbwire_mi_output_callback(void *context,
+            gdbwire_mi_output *output) {
+            GdbwireMiParserCallback *callback =
+                (GdbwireMiParserCallback *)context;
+            callback->m_output =
+                append_gdbwire_mi_output(callback->m_output, output);
+        }
+
+        gdbwire_mi_parser_callbacks callbacks;
+        gdbwire_mi_output *m_output;
+    };
+
+    struct GdbwireAllocatorTest : public Fixture {
+        GdbwireAllocatorTest() {
+            mi = "=thread-group-added,id=\"i1\"\n"
+                 "~\"GNU gdb (GDB) 13.1\\n\"\n"
+                 "1^done,bkpt={number=\"1\",type=\"breakpoint\","
+                     "thread-groups=[\"i1\"],times=\"0\"}\n"
+                 "(gdb)\n"
+                 "2^error,msg=\"No symbol \\\"foo\\\" in current context.\"\n"
+                 "bad\n";
+        }
+
+        std::string mi;
+        CountingAllocator counter;
+    };
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, default/system)
+{
+    gdbwire_allocator allocator = gdbwire_get_default_allocator();
+    REQUIRE(allocator.malloc_fn);
+    REQUIRE(allocator.realloc_fn);
+    REQUIRE(allocator.free_fn);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, default/set)
+{
+    char *str;
+
+    REQUIRE(gdbwire_set_default_allocator(&counter.allocator) == 0);
+    str = gdbwire_strdup("hello");
+    gdbwire_free(NULL, str);
+    REQUIRE(gdbwire_set_default_allocator(NULL) == 0);
+
+    REQUIRE(counter.allocations == 1);
+    REQUIRE(counter.outstanding() == 0);
+    REQUIRE(gdbwire_get_default_allocator().context != (void*)&counter);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, default/set_invalid)
+{
+    counter.allocator.realloc_fn = NULL;
+    REQUIRE(gdbwire_set_default_allocator(&counter.allocator) == -1);
+    REQUIRE(gdbwire_get_default_allocator().context != (void*)&counter);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, calloc/zeroed)
+{
+    size_t index;
+    unsigned char *data = (unsigned char *)gdbwire_calloc(
+        &counter.allocator, 16, 4);
+    REQUIRE(data);
+    for (index = 0; index < 64; ++index) {
+        REQUIRE(data[index] == 0);
+    }
+    gdbwire_free(&counter.allocator, data);
+    REQUIRE(counter.allocations == 1);
+    REQUIRE(counter.outstanding() == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, calloc/overflow)
+{
+    REQUIRE(!gdbwire_calloc(&counter.allocator, (size_t)-1, 2));
+    REQUIRE(counter.allocations == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, realloc/zero_size)
+{
+    void *data = gdbwire_realloc(&counter.allocator, NULL, 8);
+    REQUIRE(data);
+    REQUIRE(!gdbwire_realloc(&counter.allocator, data, 0));
+    REQUIRE(counter.allocations == 1);
+    REQUIRE(counter.outstanding() == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, string/allocations)
+{
+    gdbwire_string *string =
+        gdbwire_string_create_with_allocator(&counter.allocator);
+    REQUIRE(string);
+    REQUIRE(gdbwire_string_append_cstr(string, mi.c_str()) == 0);
+    REQUIRE(counter.allocations > 0);
+    gdbwire_string_destroy(string);
+    REQUIRE(counter.outstanding() == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, parser/allocations)
+{
+    GdbwireMiParserCallback callback;
+    gdbwire_mi_parser *parser;
+    size_t allocations;
+
+    parser = gdbwire_mi_parser_create_with_allocator(callback.callbacks,
+        &counter.allocator);
+    REQUIRE(parser);
+    allocations = counter.allocations;
+    REQUIRE(allocations > 0);
+
+    REQUIRE(gdbwire_mi_parser_push(parser, mi.c_str()) == GDBWIRE_OK);
+    REQUIRE(callback.m_output);
+    REQUIRE(counter.allocations > allocations);
+
+    /* The outputs keep using the allocator after the parser is gone */
+    gdbwire_mi_parser_destroy(parser);
+    REQUIRE(counter.outstanding() > 0);
+
+    gdbwire_mi_output_free(callback.m_output);
+    callback.m_output = 0;
+    REQUIRE(counter.outstanding() == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, parser/invalid)
+{
+    GdbwireMiParserCallback callback;
+    counter.allocator.free_fn = NULL;
+    REQUIRE(!gdbwire_mi_parser_create_with_allocator(callback.callbacks,
+        &counter.allocator));
+    REQUIRE(counter.allocations == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, gdbwire/allocations)
+{
+    gdbwire_callbacks c = {};
+    gdbwire *wire = gdbwire_create_with_allocator(c, &counter.allocator);
+    REQUIRE(wire);
+    REQUIRE(counter.allocations > 0);
+
+    REQUIRE(gdbwire_push_data(wire, mi.data(), mi.size()) == GDBWIRE_OK);
+
+    gdbwire_destroy(wire);
+    REQUIRE(counter.outstanding() == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, gdbwire/invalid)
+{
+    gdbwire_callbacks c = {};
+    counter.allocator.malloc_fn = NULL;
+    REQUIRE(!gdbwire_create_with_allocator(c, &counter.allocator));
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, interpreter_exec_batch/allocators)
+{
+    std::string output = "^done,line=\"33\",file=\"test.cpp\","
+        "fullname=\"/home/foo/test.cpp\",macro-info=\"0\"\n";
+    std::vector<const char *> outputs(100, output.c_str());
+    std::vector<gdbwire_mi_command_kind> kinds(outputs.size(),
+        GDBWIRE_MI_FILE_LIST_EXEC_SOURCE_FILE);
+    std::vector<gdbwire_result> results(outputs.size());
+    std::vector<gdbwire_mi_command *> mi_commands(outputs.size());
+    CountingAllocator counters[2];
+    gdbwire_allocator allocators[2] =
+        { counters[0].allocator, counters[1].allocator };
+    size_t index;
+
+    REQUIRE(gdbwire_interpreter_exec_batch(&outputs[0], &kinds[0],
+        outputs.size(), 2, allocators, &results[0],
+        &mi_commands[0]) == GDBWIRE_OK);
+
+    for (index = 0; index < outputs.size(); ++index) {
+        REQUIRE(results[index] == GDBWIRE_OK);
+        gdbwire_mi_command_free(mi_commands[index]);
+    }
+
+    /* Each worker's parser allocated with its own allocator */
+    REQUIRE(counters[0].allocations > 0);
+    REQUIRE(counters[0].outstanding() == 0);
+    REQUIRE(counters[1].outstanding() == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, interpreter_exec_batch/nomem)
+{
+    const char *output = "^done\n";
+    gdbwire_mi_command_kind kind = GDBWIRE_MI_BREAK_INFO;
+    gdbwire_result result = GDBWIRE_OK;
+    gdbwire_mi_command *mi_command = 0;
+    gdbwire_allocator failing = { 0, failing_malloc_fn,
+        failing_realloc_fn, failing_free_fn };
+
+    /* The workers are allocated with the calling thread's allocator */
+    REQUIRE(gdbwire_interpreter_exec_batch(&output, &kind, 1, 1,
+        &failing, &result, &mi_command) == GDBWIRE_NOMEM);
+    REQUIRE(result == GDBWIRE_NOMEM);
+    REQUIRE(!mi_command);
+}
+
+TEST_CASE_METHOD_N(GdbwireAllocatorTest, interpreter_exec_batch/invalid)
+{
+    const char *output = "^done\n";
+    gdbwire_mi_command_kind kind = GDBWIRE_MI_BREAK_INFO;
+    gdbwire_result result;
+    gdbwire_mi_command *mi_command;
+
+    /* The allocators can not be given without the number of workers */
+    REQUIRE(gdbwire_interpreter_exec_batch(&output, &kind, 1, 0,
+        &counter.allocator, &result, &mi_command) == GDBWIRE_ASSERT);
+}
@@ -0,0 +1,90 @@
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_histogram.h"
+
+namespace {
+    struct GdbwireHistogramTest : public Fixture {
+        GdbwireHistogramTest() {
+            histogram = gdbwire_histogram_create();
+            REQUIRE(histogram);
+        }
+
+        ~GdbwireHistogramTest() {
+            gdbwire_histogram_destroy(histogram);
+        }
+
+        gdbwire_histogram *histogram;
+    };
+}
+
+TEST_CASE_METHOD_N(GdbwireHistogramTest, destroy/null_instance)
+{
+    gdbwire_histogram_destroy(NULL);
+}
+
+TEST_CASE_METHOD_N(GdbwireHistogramTest, empty)
+{
+    REQUIRE(gdbwire_histogram_count(histogram) == 0);
+    REQUIRE(gdbwire_histogram_min(histogram) == 0);
+    REQUIRE(gdbwire_histogram_max(histogram) == 0);
+    REQUIRE(gdbwire_histogram_percentile(histogram, 50) == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireHistogramTest, record/exact)
+{
+    uint64_t value;
+
+    /* The small values are counted exactly */
+    for (value = 1; value <= 10; ++value) {
+        gdbwire_histogram_record(histogram, value);
+    }
+
+    REQUIRE(gdbwire_histogram_count(histogram) == 10);
+    REQUIRE(gdbwire_histogram_min(histogram) == 1);
+    REQUIRE(gdbwire_histogram_max(histogram) == 10);
+    REQUIRE(gdbwire_histogram_percentile(histogram, 0) == 1);
+    REQUIRE(gdbwire_histogram_percentile(histogram, 50) == 5);
+    REQUIRE(gdbwire_histogram_percentile(histogram, 90) == 9);
+    REQUIRE(gdbwire_histogram_percentile(histogram, 100) == 10);
+}
+
+TEST_CASE_METHOD_N(GdbwireHistogramTest, record/precision)
+{
+    uint64_t values[] = { 16, 17, 100, 1000, 123456789,
+        (uint64_t)1 << 40, ((uint64_t)1 << 63) + 12345, (uint64_t)-1 };
+    size_t index;
+    uint64_t value;
+
+    /* A value read back is no less and at most 1/16 more */
+    for (index = 0; index < sizeof(values) / sizeof(values[0]); ++index) {
+        gdbwire_histogram_clear(histogram);
+        gdbwire_histogram_record(histogram, values[index]);
+        gdbwire_histogram_record(histogram, (uint64_t)-1);
+        value = gdbwire_histogram_percentile(histogram, 50);
+        REQUIRE(value >= values[index]);
+        REQUIRE(value - values[index] <= values[index] / 16);
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireHistogramTest, percentile/max)
+{
+    gdbwire_histogram_record(histogram, 1000);
+    gdbwire_histogram_record(histogram, 1001);
+
+    /* The bucket holding both reaches past them, the max does not */
+    REQUIRE(gdbwire_histogram_percentile(histogram, 100) == 1001);
+    REQUIRE(gdbwire_histogram_percentile(histogram, 200) == 1001);
+    REQUIRE(gdbwire_histogram_min(histogram) == 1000);
+}
+
+TEST_CASE_METHOD_N(GdbwireHistogramTest, clear)
+{
+    gdbwire_histogram_record(histogram, 42);
+    gdbwire_histogram_clear(histogram);
+    REQUIRE(gdbwire_histogram_count(histogram) == 0);
+    REQUIRE(gdbwire_histogram_max(histogram) == 0);
+
+    gdbwire_histogram_record(histogram, 7);
+    REQUIRE(gdbwire_histogram_min(histogram) == 7);
+    REQUIRE(gdbwire_histogram_percentile(histogram, 99) == 7);
+}
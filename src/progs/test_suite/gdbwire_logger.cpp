@@ -0,0 +1,135 @@
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "allocation_counter.h"
+#include "gdbwire_mi_parser.h"
+
+/* Remove the debug statements from this file, see compile_time/min_level */
+#define GDBWIRE_LOGGER_MIN_LEVEL 1
+#include "gdbwire_logger.h"
+
+namespace {
+    struct GdbwireLoggerTest : public Fixture {
+        GdbwireLoggerTest() {
+            sink.context = (void*)this;
+            sink.log_fn = GdbwireLoggerTest::log_fn;
+            sink.log_args_fn = 0;
+            REQUIRE(gdbwire_logger_set_sink(&sink) == 0);
+            level = gdbwire_logger_get_level();
+        }
+
+        ~GdbwireLoggerTest() {
+            gdbwire_logger_set_sink(NULL);
+            gdbwire_logger_set_level(level);
+        }
+
+        static void log_fn(void *context, gdbwire_logger_level level,
+                const char *file, int line, const char *message) {
+            GdbwireLoggerTest *test = (GdbwireLoggerTest *)context;
+            test->levels.push_back(level);
+            test->messages.push_back(message);
+        }
+
+        gdbwire_logger_sink sink;
+        gdbwire_logger_level level;
+        std::vector<gdbwire_logger_level> levels;
+        std::vector<std::string> messages;
+    };
+
+    int increment(int *count) {
+        return ++*count;
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerTest, set_sink/invalid)
+{
+    gdbwire_logger_sink invalid = { 0, 0, 0 };
+    REQUIRE(gdbwire_logger_set_sink(&invalid) == -1);
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerTest, level/filter)
+{
+    gdbwire_logger_set_level(GDBWIRE_LOGGER_WARN);
+    REQUIRE(gdbwire_logger_get_level() == GDBWIRE_LOGGER_WARN);
+    REQUIRE(!gdbwire_logger_enabled(GDBWIRE_LOGGER_INFO));
+    REQUIRE(gdbwire_logger_enabled(GDBWIRE_LOGGER_ERROR));
+
+    gdbwire_info("info %d", 1);
+    gdbwire_warn("warn %d", 2);
+    gdbwire_error("error %s", "three");
+
+    REQUIRE(messages.size() == 2);
+    REQUIRE(levels[0] == GDBWIRE_LOGGER_WARN);
+    REQUIRE(messages[0] == "warn 2");
+    REQUIRE(levels[1] == GDBWIRE_LOGGER_ERROR);
+    REQUIRE(messages[1] == "error three");
+}
+
+/**
+ * Ensure the format arguments are not evaluated for dropped messages.
+ */
+TEST_CASE_METHOD_N(GdbwireLoggerTest, level/off)
+{
+    int count = 0;
+
+    gdbwire_logger_set_level(GDBWIRE_LOGGER_OFF);
+    REQUIRE(!gdbwire_logger_enabled(GDBWIRE_LOGGER_ERROR));
+    gdbwire_error("error %d", increment(&count));
+
+    REQUIRE(count == 0);
+    REQUIRE(messages.empty());
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerTest, log/truncated)
+{
+    std::string longstr(GDBWIRE_LOGGER_MESSAGE_SIZE * 2, 'a');
+
+    gdbwire_logger_set_level(GDBWIRE_LOGGER_DEBUG);
+    gdbwire_info("%s", longstr.c_str());
+
+    REQUIRE(messages.size() == 1);
+    REQUIRE(messages[0] == longstr.substr(0, GDBWIRE_LOGGER_MESSAGE_SIZE - 1));
+}
+
+/**
+ * Ensure the statements below the compile time minimum level are removed.
+ */
+TEST_CASE_METHOD_N(GdbwireLoggerTest, compile_time/min_level)
+{
+    int count = 0;
+
+    gdbwire_logger_set_level(GDBWIRE_LOGGER_DEBUG);
+    gdbwire_debug("debug %d", increment(&count));
+    gdbwire_info("info %d", increment(&count));
+
+    REQUIRE(count == 1);
+    REQUIRE(messages.size() == 1);
+    REQUIRE(messages[0] == "info 1");
+}
+
+/**
+ * Ensure a failed assertion does not allocate when logging is off,
+ * and reaches the sink when it is on.
+ */
+TEST_CASE_METHOD_N(GdbwireLoggerTest, assert/allocations)
+{
+    gdbwire_result result[2];
+    size_t allocations[2];
+    int index;
+
+    for (index = 0; index < 2; ++index) {
+        gdbwire_logger_set_level((index == 0) ?
+            GDBWIRE_LOGGER_OFF : GDBWIRE_LOGGER_ERROR);
+
+        AllocationCounter counter;
+        result[index] = gdbwire_mi_parser_push(NULL, "^done\n");
+        allocations[index] = counter.count();
+    }
+
+    REQUIRE(result[0] == GDBWIRE_ASSERT);
+    REQUIRE(result[1] == GDBWIRE_ASSERT);
+    REQUIRE(allocations[0] == 0);
+    REQUIRE(messages.size() == 1);
+    REQUIRE(levels[0] == GDBWIRE_LOGGER_ERROR);
+}
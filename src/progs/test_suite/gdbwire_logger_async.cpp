@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_logger.h"
+#include "gdbwire_logger_async.h"
+
+namespace {
+    struct GdbwireLoggerAsyncTest : public Fixture {
+        GdbwireLoggerAsyncTest() : async(0) {
+            pthread_mutex_init(&mutex, NULL);
+            output.context = (void*)this;
+            output.log_fn = GdbwireLoggerAsyncTest::log_fn;
+            output.log_args_fn = 0;
+            level = gdbwire_logger_get_level();
+            gdbwire_logger_set_level(GDBWIRE_LOGGER_DEBUG);
+        }
+
+        ~GdbwireLoggerAsyncTest() {
+            gdbwire_logger_set_sink(NULL);
+            gdbwire_logger_async_destroy(async);
+            gdbwire_logger_set_level(level);
+            pthread_mutex_destroy(&mutex);
+        }
+
+        /**
+         * Create the asynchronous sink and log to it.
+         *
+         * @param ring_size
+         * The size of each thread's ring.
+         */
+        void start(size_t ring_size) {
+            gdbwire_logger_sink sink;
+            async = gdbwire_logger_async_create(ring_size, &output);
+            REQUIRE(async);
+            sink = gdbwire_logger_async_get_sink(async);
+            REQUIRE(gdbwire_logger_set_sink(&sink) == 0);
+        }
+
+        /**
+         * Stop logging and wait for the queued messages to be output.
+         */
+        void stop() {
+            gdbwire_logger_set_sink(NULL);
+            gdbwire_logger_async_destroy(async);
+            async = 0;
+        }
+
+        /**
+         * Wait for messages to be output while the sink is running.
+         *
+         * @param count
+         * The number of messages to wait for.
+         *
+         * @return
+         * The number of messages output, less than count on timeout.
+         */
+        size_t wait_for(size_t count) {
+            size_t size = 0;
+            int tries;
+            for (tries = 0; tries < 5000; ++tries) {
+                pthread_mutex_lock(&mutex);
+                size = messages.size();
+                pthread_mutex_unlock(&mutex);
+                if (size >= count) {
+                    break;
+                }
+                usleep(1000);
+            }
+            return size;
+        }
+
+        static void log_fn(void *context, gdbwire_logger_level level,
+                const char *file, int line, const char *message) {
+            GdbwireLoggerAsyncTest *test = (GdbwireLoggerAsyncTest *)context;
+            pthread_mutex_lock(&test->mutex);
+            test->messages.push_back(message);
+            pthread_mutex_unlock(&test->mutex);
+        }
+
+        gdbwire_logger_async *async;
+        gdbwire_logger_sink output;
+        gdbwire_logger_level level;
+        pthread_mutex_t mutex;
+        std::vector<std::string> messages;
+    };
+
+    /* The number of messages each thread logs in threads/order */
+    const int THREAD_MESSAGES = 20000;
+
+    void *log_thread(void *data) {
+        int id = *(int *)data, index;
+        for (index = 0; index < THREAD_MESSAGES; ++index) {
+            gdbwire_info("%d %d", id, index);
+        }
+        return NULL;
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerAsyncTest, format/snprintf)
+{
+    char expected[GDBWIRE_LOGGER_MESSAGE_SIZE];
+    long double ld = 2.5L;
+    void *ptr = (void*)this;
+
+    start(0);
+    gdbwire_info("%d|%5i|%-5u|%x|%#o|%hhd|%hd", -3, 42, 7u, 255u, 8u,
+        300, 70000);
+    gdbwire_info("%ld|%lld|%zu|%td|%jd|%llx", -5L, 1LL << 40,
+        (size_t)12, (ptrdiff_t)-9, (intmax_t)99, 0xabcdefULL);
+    gdbwire_info("%f|%.2e|%g|%10.3f|%Lf", 1.5, 12345.678, 0.0001, -2.25, ld);
+    gdbwire_info("%c|%s|%.3s|%-6s|%*d|%.*s|%%|%p", 'x', "str", "abcdef",
+        "ab", 4, 7, 2, "xyz", ptr);
+    gdbwire_info("%s", (const char *)NULL);
+    stop();
+
+    REQUIRE(messages.size() == 5);
+    snprintf(expected, sizeof(expected), "%d|%5i|%-5u|%x|%#o|%hhd|%hd",
+        -3, 42, 7u, 255u, 8u, 300, 70000);
+    REQUIRE(messages[0] == expected);
+    snprintf(expected, sizeof(expected), "%ld|%lld|%zu|%td|%jd|%llx", -5L,
+        1LL << 40, (size_t)12, (ptrdiff_t)-9, (intmax_t)99, 0xabcdefULL);
+    REQUIRE(messages[1] == expected);
+    snprintf(expected, sizeof(expected), "%f|%.2e|%g|%10.3f|%Lf", 1.5,
+        12345.678, 0.0001, -2.25, ld);
+    REQUIRE(messages[2] == expected);
+    snprintf(expected, sizeof(expected), "%c|%s|%.3s|%-6s|%*d|%.*s|%%|%p",
+        'x', "str", "abcdef", "ab", 4, 7, 2, "xyz", ptr);
+    REQUIRE(messages[3] == expected);
+    REQUIRE(messages[4] == "(null)");
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerAsyncTest, format/string_copied)
+{
+    char buffer[16];
+
+    start(0);
+    strcpy(buffer, "before");
+    gdbwire_info("buffer=%s", buffer);
+    strcpy(buffer, "after");
+    stop();
+
+    REQUIRE(messages.size() == 1);
+    REQUIRE(messages[0] == "buffer=before");
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerAsyncTest, format/truncated)
+{
+    std::string value(2 * GDBWIRE_LOGGER_MESSAGE_SIZE, 'a');
+
+    start(0);
+    gdbwire_info("%s%s", value.c_str(), value.c_str());
+    stop();
+
+    /* Like the synchronous sink, long messages are truncated */
+    REQUIRE(messages.size() == 1);
+    REQUIRE(messages[0] ==
+        std::string(GDBWIRE_LOGGER_MESSAGE_SIZE - 1, 'a'));
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerAsyncTest, format/unsupported)
+{
+    start(0);
+    /* Positional arguments are formatted right away instead */
+    gdbwire_info("%2$s %1$s", "world", "hello");
+    gdbwire_info("%d", 1);
+    stop();
+
+    REQUIRE(messages.size() == 2);
+    REQUIRE(messages[0] == "hello world");
+    REQUIRE(messages[1] == "1");
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerAsyncTest, level/filter)
+{
+    start(0);
+    gdbwire_logger_set_level(GDBWIRE_LOGGER_WARN);
+    gdbwire_info("dropped");
+    gdbwire_warn("kept");
+    REQUIRE(gdbwire_logger_async_get_dropped(async) == 0);
+    stop();
+
+    REQUIRE(messages.size() == 1);
+    REQUIRE(messages[0] == "kept");
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerAsyncTest, threads/order)
+{
+    const int THREADS = 4;
+    pthread_t threads[THREADS];
+    int ids[THREADS], next[THREADS], index, id, value;
+    size_t dropped, count;
+
+    start(0);
+    for (index = 0; index < THREADS; ++index) {
+        ids[index] = index;
+        next[index] = 0;
+        REQUIRE(pthread_create(&threads[index], NULL, log_thread,
+            &ids[index]) == 0);
+    }
+    for (index = 0; index < THREADS; ++index) {
+        pthread_join(threads[index], NULL);
+    }
+
+    dropped = gdbwire_logger_async_get_dropped(async);
+    stop();
+
+    /* Every message is either output or counted as dropped */
+    REQUIRE(messages.size() + dropped == (size_t)THREADS * THREAD_MESSAGES);
+
+    /* Each thread's messages are output in the order they were logged */
+    for (count = 0; count < messages.size(); ++count) {
+        REQUIRE(sscanf(messages[count].c_str(), "%d %d", &id, &value) == 2);
+        REQUIRE(id >= 0);
+        REQUIRE(id < THREADS);
+        REQUIRE(value >= next[id]);
+        next[id] = value + 1;
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireLoggerAsyncTest, threads/wake)
+{
+    start(0);
+    gdbwire_info("first");
+    REQUIRE(wait_for(1) == 1);
+
+    /* Log again once the background thread went back to sleep */
+    usleep(10000);
+    gdbwire_info("second");
+    REQUIRE(wait_for(2) == 2);
+    stop();
+
+    REQUIRE(messages[0] == "first");
+    REQUIRE(messages[1] == "second");
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_lz.h"
+
+namespace {
+    struct GdbwireLzTest : public Fixture {
+        GdbwireLzTest() : seed(12345) {}
+
+        /* Bytes that do not compress */
+        std::string random(size_t size) {
+            std::string result(size, 0);
+
+            for (size_t index = 0; index < size; ++index) {
+                seed = seed * 1103515245 + 12345;
+                result[index] = (char)(seed >> 16);
+            }
+            return result;
+        }
+
+        /* Output of GDB, which repeats itself a great deal */
+        std::string mi(size_t lines) {
+            std::string result;
+            char line[256];
+
+            for (size_t index = 0; index < lines; ++index) {
+                snprintf(line, sizeof (line),
+                    "*stopped,reason=\"breakpoint-hit\",bkptno=\"%lu\","
+                    "frame={addr=\"0x%08lx\",func=\"main\",args=[],"
+                    "file=\"main.c\",line=\"%lu\"}\n",
+                    (unsigned long)(index % 7), (unsigned long)index * 16,
+                    (unsigned long)index);
+                result += line;
+            }
+            return result;
+        }
+
+        std::string compress(const std::string &data) {
+            std::vector<char> out(gdbwire_lz_bound(data.size()));
+            size_t size;
+
+            REQUIRE(gdbwire_lz_compress(data.data(), data.size(), &out[0],
+                out.size(), &size) == GDBWIRE_OK);
+            REQUIRE(size <= out.size());
+            return std::string(&out[0], size);
+        }
+
+        std::string round_trip(const std::string &data) {
+            std::string compressed = compress(data);
+            std::vector<char> out(data.size() + 1);
+            size_t size;
+
+            REQUIRE(gdbwire_lz_decompress(compressed.data(),
+                compressed.size(), &out[0], data.size(),
+                &size) == GDBWIRE_OK);
+            return std::string(&out[0], size);
+        }
+
+        unsigned long seed;
+    };
+}
+
+TEST_CASE_METHOD_N(GdbwireLzTest, round_trip/mi)
+{
+    std::string data = mi(1000);
+
+    REQUIRE(round_trip(data) == data);
+    REQUIRE(compress(data).size() * 4 < data.size());
+}
+
+TEST_CASE_METHOD_N(GdbwireLzTest, round_trip/sizes)
+{
+    for (size_t size = 0; size < 300; ++size) {
+        std::string data = random(size);
+        REQUIRE(round_trip(data) == data);
+
+        data = mi(1).substr(0, size % 100) + std::string(size, 'a');
+        REQUIRE(round_trip(data) == data);
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireLzTest, round_trip/incompressible)
+{
+    std::string data = random(100000);
+    std::string compressed = compress(data);
+
+    REQUIRE(round_trip(data) == data);
+    REQUIRE(compressed.size() <= gdbwire_lz_bound(data.size()));
+}
+
+TEST_CASE_METHOD_N(GdbwireLzTest, round_trip/runs)
+{
+    std::string data = std::string(100000, 'x') + random(1000) +
+        std::string(70000, 'y') + mi(10) + std::string(3, 'z');
+
+    REQUIRE(round_trip(data) == data);
+    REQUIRE(compress(data).size() < 2000);
+}
+
+TEST_CASE_METHOD_N(GdbwireLzTest, compress/capacity)
+{
+    std::string data = mi(10);
+    std::vector<char> out(gdbwire_lz_bound(data.size()));
+    size_t size;
+
+    REQUIRE(gdbwire_lz_compress(data.data(), data.size(), &out[0],
+        out.size() - 1, &size) == GDBWIRE_LOGIC);
+}
+
+TEST_CASE_METHOD_N(GdbwireLzTest, decompress/capacity)
+{
+    std::string data = mi(10);
+    std::string compressed = compress(data);
+    std::vector<char> out(data.size());
+    size_t size;
+
+    REQUIRE(gdbwire_lz_decompress(compressed.data(), compressed.size(),
+        &out[0], data.size() - 1, &size) == GDBWIRE_LOGIC);
+}
+
+TEST_CASE_METHOD_N(GdbwireLzTest, decompress/corrupt)
+{
+    std::string data = mi(10);
+    std::string compressed = compress(data);
+    std::vector<char> out(data.size());
+    size_t size, cut;
+
+    /* Data cut short is never decompressed to the original */
+    for (cut = 0; cut < compressed.size(); ++cut) {
+        enum gdbwire_result result = gdbwire_lz_decompress(
+            compressed.data(), cut, &out[0], out.size(), &size);
+        REQUIRE((result == GDBWIRE_LOGIC || size < data.size()));
+    }
+
+    /* A match before the start of the data */
+    REQUIRE(gdbwire_lz_decompress("\x10" "a\x02\x00", 4, &out[0],
+        out.size(), &size) == GDBWIRE_LOGIC);
+    /* A match with no offset */
+    REQUIRE(gdbwire_lz_decompress("\x10" "a\x00\x00", 4, &out[0],
+        out.size(), &size) == GDBWIRE_LOGIC);
+    /* A match that overlaps itself, repeating the byte before it */
+    REQUIRE(gdbwire_lz_decompress("\x10" "a\x01\x00\x00", 5, &out[0],
+        out.size(), &size) == GDBWIRE_OK);
+    REQUIRE(std::string(&out[0], size) == "aaaaa");
+    /* A literal length that goes on past the end */
+    REQUIRE(gdbwire_lz_decompress("\xf0\xff", 2, &out[0],
+        out.size(), &size) == GDBWIRE_LOGIC);
+    /* No data at all */
+    REQUIRE(gdbwire_lz_decompress("", 0, &out[0],
+        out.size(), &size) == GDBWIRE_LOGIC);
+}
@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_mi_binary.h"
+#include "gdbwire_mi_parser.h"
+
+namespace {
+    struct GdbwireMiBinaryTest : public MiParserFixture {
+        GdbwireMiBinaryTest() {
+            encoder = gdbwire_mi_binary_encoder_create();
+            REQUIRE(encoder);
+        }
+
+        ~GdbwireMiBinaryTest() {
+            gdbwire_mi_binary_encoder_destroy(encoder);
+        }
+
+        std::string get_file_contents(const std::string &path) {
+            std::string result;
+            FILE *fd;
+            int c;
+
+            fd = fopen(path.c_str(), "r");
+            REQUIRE(fd);
+
+            while ((c = fgetc(fd)) != EOF) {
+                result.push_back((char)c);
+            }
+            fclose(fd);
+
+            return result;
+        }
+
+        /* Encode an output, returning a copy of the encoding */
+        std::string encode(const gdbwire_mi_output *output) {
+            const void *data;
+            size_t size;
+
+            REQUIRE(gdbwire_mi_binary_encode(encoder, output, &data, &size) ==
+                GDBWIRE_OK);
+            return std::string((const char *)data, size);
+        }
+
+        gdbwire_mi_binary_encoder *encoder;
+    };
+
+    /* Compare two strings that may be NULL */
+    bool same_string(const char *lhs, const char *rhs) {
+        return (!lhs && !rhs) || (lhs && rhs && strcmp(lhs, rhs) == 0);
+    }
+
+    /* Ensure a string read in place lies within the encoded buffer */
+    void require_within(const std::string &buffer, const char *str,
+        size_t size) {
+        REQUIRE(str >= buffer.data());
+        REQUIRE(str + size < buffer.data() + buffer.size());
+        REQUIRE(str[size] == 0);
+    }
+
+    /* Ensure the results read in place match the results of a tree */
+    void require_results(const std::string &buffer,
+        gdbwire_mi_binary_result *view, int has_view,
+        const gdbwire_mi_result *result) {
+        gdbwire_mi_binary_result child;
+
+        for (; result; result = result->next) {
+            REQUIRE(has_view);
+            REQUIRE(view->kind == result->kind);
+            REQUIRE(same_string(view->variable, result->variable));
+            if (view->variable) {
+                require_within(buffer, view->variable,
+                    strlen(view->variable));
+            }
+
+            if (result->kind == GDBWIRE_MI_CSTRING) {
+                require_within(buffer, view->cstring, view->cstring_size);
+                REQUIRE(std::string(view->cstring, view->cstring_size) ==
+                    result->variant.cstring);
+                REQUIRE(!gdbwire_mi_binary_result_children(view, &child));
+            } else {
+                require_results(buffer, &child,
+                    gdbwire_mi_binary_result_children(view, &child),
+                    result->variant.result);
+            }
+            has_view = gdbwire_mi_binary_result_next(view);
+        }
+        REQUIRE(!has_view);
+    }
+
+    /* Ensure an encoded output, read in place, matches the output */
+    void require_view(const std::string &buffer,
+        const gdbwire_mi_output *output) {
+        gdbwire_mi_binary_output view;
+        gdbwire_mi_binary_result result;
+        const gdbwire_mi_result *results = 0;
+        const char *token = 0;
+
+        REQUIRE(gdbwire_mi_binary_read(buffer.data(), buffer.size(),
+            &view) == GDBWIRE_OK);
+        REQUIRE(view.kind == output->kind);
+        require_within(buffer, view.line, view.line_size);
+        REQUIRE(std::string(view.line, view.line_size) == output->line);
+
+        switch (output->kind) {
+            case GDBWIRE_MI_OUTPUT_OOB:
+                REQUIRE(view.oob_kind == output->variant.oob_record->kind);
+                if (view.oob_kind == GDBWIRE_MI_ASYNC) {
+                    gdbwire_mi_async_record *record =
+                        output->variant.oob_record->variant.async_record;
+                    REQUIRE(view.async_kind == record->kind);
+                    REQUIRE(view.async_class == record->async_class);
+                    token = record->token;
+                    results = record->result;
+                } else {
+                    gdbwire_mi_stream_record *record =
+                        output->variant.oob_record->variant.stream_record;
+                    REQUIRE(view.stream_kind == record->kind);
+                    require_within(buffer, view.cstring, view.cstring_size);
+                    REQUIRE(std::string(view.cstring, view.cstring_size) ==
+                        record->cstring);
+                }
+                break;
+            case GDBWIRE_MI_OUTPUT_RESULT:
+                REQUIRE(view.result_class ==
+                    output->variant.result_record->result_class);
+                token = output->variant.result_record->token;
+                results = output->variant.result_record->result;
+                break;
+            case GDBWIRE_MI_OUTPUT_PROMPT:
+                break;
+            case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+                token = output->variant.error.token;
+                REQUIRE(view.pos.start_column ==
+                    output->variant.error.pos.start_column);
+                REQUIRE(view.pos.end_column ==
+                    output->variant.error.pos.end_column);
+                break;
+        }
+
+        REQUIRE(same_string(view.token, token));
+        require_results(buffer, &result,
+            gdbwire_mi_binary_output_results(&view, &result), results);
+    }
+
+    /* Ensure a decoded output matches the output it was encoded from */
+    void require_decoded(const gdbwire_mi_output *decoded,
+        const gdbwire_mi_output *output) {
+        REQUIRE(decoded);
+        REQUIRE(!decoded->next);
+        REQUIRE(decoded->kind == output->kind);
+        REQUIRE(std::string(decoded->line) == output->line);
+
+        switch (output->kind) {
+            case GDBWIRE_MI_OUTPUT_OOB:
+                if (output->variant.oob_record->kind == GDBWIRE_MI_ASYNC) {
+                    gdbwire_mi_async_record *lhs = decoded->variant.
+                        oob_record->variant.async_record;
+                    gdbwire_mi_async_record *rhs = output->variant.
+                        oob_record->variant.async_record;
+                    REQUIRE(lhs->kind == rhs->kind);
+                    REQUIRE(lhs->async_class == rhs->async_class);
+                    REQUIRE(same_string(lhs->token, rhs->token));
+                    REQUIRE(gdbwire_mi_result_equal(lhs->result,
+                        rhs->result) == 1);
+                } else {
+                    gdbwire_mi_stream_record *lhs = decoded->variant.
+                        oob_record->variant.stream_record;
+                    gdbwire_mi_stream_record *rhs = output->variant.
+                        oob_record->variant.stream_record;
+                    REQUIRE(lhs->kind == rhs->kind);
+                    REQUIRE(std::string(lhs->cstring) == rhs->cstring);
+                }
+                break;
+            case GDBWIRE_MI_OUTPUT_RESULT:
+                REQUIRE(decoded->variant.result_record->result_class ==
+                    output->variant.result_record->result_class);
+                REQUIRE(same_string(decoded->variant.result_record->token,
+                    output->variant.result_record->token));
+                REQUIRE(gdbwire_mi_result_equal(
+                    decoded->variant.result_record->result,
+                    output->variant.result_record->result) == 1);
+                break;
+            case GDBWIRE_MI_OUTPUT_PROMPT:
+                break;
+            case GDBWIRE_MI_OUTPUT_PARSE_ERROR:
+                REQUIRE(same_string(decoded->variant.error.token,
+                    output->variant.error.token));
+                REQUIRE(decoded->variant.error.pos.start_column ==
+                    output->variant.error.pos.start_column);
+                REQUIRE(decoded->variant.error.pos.end_column ==
+                    output->variant.error.pos.end_column);
+                break;
+        }
+    }
+
+    /* Walk every result of an output read in place */
+    size_t walk(gdbwire_mi_binary_result *result, int has_result) {
+        gdbwire_mi_binary_result child;
+        size_t count = 0;
+
+        for (; has_result; has_result = gdbwire_mi_binary_result_next(result)) {
+            count += 1 + walk(&child,
+                gdbwire_mi_binary_result_children(result, &child));
+        }
+        return count;
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireMiBinaryTest, destroy/null_instance)
+{
+    gdbwire_mi_binary_encoder_destroy(NULL);
+}
+
+/**
+ * Ensure every output of the MI files of the test suite round trips.
+ */
+TEST_CASE_METHOD_N(GdbwireMiBinaryTest, round_trip/corpus)
+{
+    std::vector<std::string> files;
+    gdbwire_mi_output *output, *decoded;
+    std::string buffer;
+    size_t index, outputs = 0;
+
+    findMiFiles(data(), files);
+    REQUIRE(files.size() > 50);
+
+    for (index = 0; index < files.size(); ++index) {
+        for (output = parse(get_file_contents(files[index])); output;
+                output = output->next) {
+            buffer = encode(output);
+            require_view(buffer, output);
+
+            REQUIRE(gdbwire_mi_binary_decode(buffer.data(), buffer.size(),
+                &decoded) == GDBWIRE_OK);
+            require_decoded(decoded, output);
+
+            /* The decoded output encodes to the same bytes */
+            REQUIRE(encode(decoded) == buffer);
+            gdbwire_mi_output_free(decoded);
+            outputs++;
+        }
+
+        gdbwire_mi_output_free(takeOutputs());
+    }
+
+    REQUIRE(outputs > files.size());
+}
+
+/**
+ * Ensure the variables are written once and the encoding is compact.
+ */
+TEST_CASE_METHOD_N(GdbwireMiBinaryTest, encode/interned_keys)
+{
+    std::string line = "^done,BreakpointTable={body=[";
+    std::string buffer;
+    size_t index, position, count = 0;
+    char bkpt[128];
+
+    for (index = 0; index < 20; ++index) {
+        snprintf(bkpt, sizeof(bkpt), "%sbkpt={number=\"%d\",type=\"breakpoint\","
+            "enabled=\"y\",func=\"main\",line=\"%d\"}",
+            index ? "," : "", (int)index + 1, (int)index + 10);
+        line += bkpt;
+    }
+    line += "]}\n";
+
+    buffer = encode(parse(line));
+
+    for (position = buffer.find("number"); position != std::string::npos;
+            position = buffer.find("number", position + 1)) {
+        count++;
+    }
+
+    /* Once in each breakpoint of the line and once in the dictionary */
+    REQUIRE(count == 21);
+
+    /* The line is part of the output, the rest is well under its size */
+    REQUIRE(buffer.size() - line.size() < line.size() * 3 / 4);
+}
+
+/**
+ * Ensure tuples and lists nested too deeply are refused.
+ */
+TEST_CASE_METHOD_N(GdbwireMiBinaryTest, encode/max_depth)
+{
+    std::string line;
+    const void *data;
+    size_t size;
+    int depth;
+
+    for (depth = GDBWIRE_MI_BINARY_MAX_DEPTH;
+            depth <= GDBWIRE_MI_BINARY_MAX_DEPTH + 1; ++depth) {
+        line = "^done,a=" + std::string(depth, '[') + "\"x\"" +
+            std::string(depth, ']') + "\n";
+        parse(line);
+    }
+
+    REQUIRE(gdbwire_mi_binary_encode(encoder, m_output, &data, &size) ==
+        GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_binary_encode(encoder, m_output->next, &data,
+        &size) == GDBWIRE_LOGIC);
+}
+
+/**
+ * Ensure a damaged buffer is refused rather than read out of bounds.
+ */
+TEST_CASE_METHOD_N(GdbwireMiBinaryTest, read/malformed)
+{
+    gdbwire_mi_binary_output view;
+    gdbwire_mi_binary_result result;
+    gdbwire_mi_output *decoded;
+    std::string buffer, damaged;
+    size_t index;
+    int bit;
+
+    buffer = encode(parse(
+        "7*stopped,reason=\"breakpoint-hit\",frame={addr=\"0x1\","
+        "args=[{name=\"argc\",value=\"1\"}]},thread-id=\"1\"\n"));
+
+    /* Every prefix is cut off and anything after the output is extra */
+    for (index = 0; index < buffer.size(); ++index) {
+        damaged = buffer.substr(0, index);
+        REQUIRE(gdbwire_mi_binary_read(damaged.data(), damaged.size(),
+            &view) == GDBWIRE_LOGIC);
+    }
+    damaged = buffer + '\0';
+    REQUIRE(gdbwire_mi_binary_read(damaged.data(), damaged.size(),
+        &view) == GDBWIRE_LOGIC);
+
+    /* Another version of the encoding is refused */
+    damaged = buffer;
+    damaged[2] = GDBWIRE_MI_BINARY_VERSION + 1;
+    REQUIRE(gdbwire_mi_binary_decode(damaged.data(), damaged.size(),
+        &decoded) == GDBWIRE_LOGIC);
+
+    /* A flipped bit is refused or still reads within the buffer */
+    for (index = 0; index < buffer.size(); ++index) {
+        for (bit = 0; bit < 8; ++bit) {
+            damaged = buffer;
+            damaged[index] ^= (char)(1 << bit);
+            if (gdbwire_mi_binary_read(damaged.data(), damaged.size(),
+                    &view) == GDBWIRE_OK) {
+                walk(&result, gdbwire_mi_binary_output_results(&view,
+                    &result));
+                REQUIRE(gdbwire_mi_binary_decode(damaged.data(),
+                    damaged.size(), &decoded) == GDBWIRE_OK);
+                gdbwire_mi_output_free(decoded);
+            }
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_mi_cache.h"
+#include "gdbwire_mi_pt_alloc.h"
+
+namespace {
+    struct GdbwireMiCacheTest : public Fixture {
+        GdbwireMiCacheTest() {
+            cache = gdbwire_mi_cache_create(2, NULL);
+            REQUIRE(cache);
+        }
+
+        ~GdbwireMiCacheTest() {
+            gdbwire_mi_cache_destroy(cache);
+        }
+
+        /**
+         * Create an output for a line, in an arena of its own.
+         *
+         * @param line
+         * The line.
+         *
+         * @return
+         * The output.
+         */
+        gdbwire_mi_output *create_output(const char *line) {
+            gdbwire_mi_arena *arena = gdbwire_mi_arena_acquire(NULL);
+            gdbwire_mi_output *output;
+
+            REQUIRE(arena);
+            output = gdbwire_mi_output_alloc(arena);
+            REQUIRE(output);
+            output->kind = GDBWIRE_MI_OUTPUT_PROMPT;
+            output->line = gdbwire_mi_arena_strdup(arena, line);
+            REQUIRE(output->line);
+            return output;
+        }
+
+        /**
+         * Add a line to the cache.
+         *
+         * @param line
+         * The line.
+         *
+         * @return
+         * The output of the line, owned by the cache.
+         */
+        const gdbwire_mi_output *insert(const char *line) {
+            gdbwire_mi_output *output = create_output(line);
+            gdbwire_mi_cache_insert(cache, output, strlen(line));
+            return output;
+        }
+
+        /**
+         * Find a line in the cache.
+         *
+         * @param line
+         * The line.
+         *
+         * @return
+         * The output of the line, or NULL if not found.
+         */
+        const gdbwire_mi_output *find(const char *line) {
+            return gdbwire_mi_cache_find(cache, line, strlen(line));
+        }
+
+        gdbwire_mi_cache *cache;
+    };
+}
+
+TEST_CASE_METHOD_N(GdbwireMiCacheTest, create/zero_capacity)
+{
+    REQUIRE(!gdbwire_mi_cache_create(0, NULL));
+}
+
+TEST_CASE_METHOD_N(GdbwireMiCacheTest, destroy/null_instance)
+{
+    gdbwire_mi_cache_destroy(NULL);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiCacheTest, find/bytes)
+{
+    const gdbwire_mi_output *done = insert("^done\n");
+    size_t hits, misses;
+
+    REQUIRE(find("^done\n") == done);
+
+    /* A prefix or a different newline is a different line */
+    REQUIRE(!find("^done"));
+    REQUIRE(!find("^done\r\n"));
+    REQUIRE(!find("^exit\n"));
+
+    gdbwire_mi_cache_get_stats(cache, &hits, &misses);
+    REQUIRE(hits == 1);
+    REQUIRE(misses == 3);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiCacheTest, insert/clock)
+{
+    const gdbwire_mi_output *done, *prompt, *running;
+
+    done = insert("^done\n");
+    prompt = insert("(gdb)\n");
+
+    /* The line found since the hand passed it gets another turn */
+    REQUIRE(find("^done\n") == done);
+    running = insert("^running\n");
+
+    REQUIRE(find("^done\n") == done);
+    REQUIRE(!find("(gdb)\n"));
+    REQUIRE(find("^running\n") == running);
+    (void)prompt;
+}
+
+TEST_CASE_METHOD_N(GdbwireMiCacheTest, clear/keeps_stats)
+{
+    size_t hits, misses;
+
+    insert("^done\n");
+    REQUIRE(find("^done\n"));
+    gdbwire_mi_cache_clear(cache);
+    REQUIRE(!find("^done\n"));
+
+    /* The cache is usable after it is cleared */
+    insert("^done\n");
+    REQUIRE(find("^done\n"));
+
+    gdbwire_mi_cache_get_stats(cache, &hits, &misses);
+    REQUIRE(hits == 2);
+    REQUIRE(misses == 1);
+}
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_mi_diff.h"
+#include "gdbwire_mi_parser.h"
+
+namespace {
+    /* The number of reallocations left before running out of memory */
+    size_t reallocs_left;
+
+    void *limited_malloc_fn(void *context, size_t size) {
+        return malloc(size);
+    }
+
+    void *limited_realloc_fn(void *context, void *ptr, size_t size) {
+        if (reallocs_left == 0) {
+            return NULL;
+        }
+        --reallocs_left;
+        return realloc(ptr, size);
+    }
+
+    void limited_free_fn(void *context, void *ptr) {
+        free(ptr);
+    }
+
+    struct GdbwireMiDiffTest : public MiParserFixture {
+        GdbwireMiDiffTest() {
+            diff = gdbwire_mi_diff_create();
+            REQUIRE(diff);
+        }
+
+        ~GdbwireMiDiffTest() {
+            gdbwire_mi_diff_destroy(diff);
+        }
+
+        static void diff_callback(void *context, gdbwire_mi_diff_kind kind,
+            const char *path, const gdbwire_mi_result *before,
+            const gdbwire_mi_result *after) {
+            GdbwireMiDiffTest *test = (GdbwireMiDiffTest *)context;
+            const char *prefix[] = { "+", "-", "~" };
+            test->m_diffs.push_back(std::string(prefix[kind]) + path);
+            REQUIRE((before != 0) == (kind != GDBWIRE_MI_DIFF_ADDED));
+            REQUIRE((after != 0) == (kind != GDBWIRE_MI_DIFF_REMOVED));
+        }
+
+        /**
+         * Parse a result record line.
+         *
+         * @param line
+         * The line, including the newline.
+         *
+         * @return
+         * The results of the record, freed with the fixture.
+         */
+        gdbwire_mi_result *parse_results(const char *line) {
+            gdbwire_mi_output *output = parse(line);
+
+            REQUIRE(output);
+            REQUIRE(output->kind == GDBWIRE_MI_OUTPUT_RESULT);
+            return output->variant.result_record->result;
+        }
+
+        /**
+         * Diff two result record lines.
+         *
+         * @return
+         * Each difference as its kind, +, - or ~, followed by its path.
+         */
+        std::vector<std::string> run(const char *before, const char *after) {
+            gdbwire_mi_result *lhs = parse_results(before),
+                *rhs = parse_results(after);
+            m_diffs.clear();
+            REQUIRE(gdbwire_mi_diff_results(diff, lhs, rhs, diff_callback,
+                this) == GDBWIRE_OK);
+            return m_diffs;
+        }
+
+        gdbwire_mi_diff *diff;
+        std::vector<std::string> m_diffs;
+    };
+
+    /* The differences expected from GdbwireMiDiffTest::run */
+    std::vector<std::string> diffs(const char *first = 0,
+        const char *second = 0, const char *third = 0,
+        const char *fourth = 0) {
+        const char *all[] = { first, second, third, fourth };
+        std::vector<std::string> result;
+        size_t index;
+
+        for (index = 0; index < 4 && all[index]; ++index) {
+            result.push_back(all[index]);
+        }
+        return result;
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, destroy/null_instance)
+{
+    gdbwire_mi_diff_destroy(NULL);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, results/equal)
+{
+    REQUIRE(run("^done,frame={level=\"0\",args=[]}\n",
+        "^done,frame={level=\"0\",args=[]}\n") == diffs());
+    REQUIRE(run("^done\n", "^done\n") == diffs());
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, results/tuple)
+{
+    REQUIRE(run("^done,frame={addr=\"0x1\",func=\"main\"},a=\"1\"\n",
+        "^done,frame={addr=\"0x2\",func=\"main\",line=\"7\"},b=\"1\"\n") ==
+        diffs("-a", "~frame.addr", "+frame.line", "+b"));
+
+    /* A result changing between kinds is changed as a whole */
+    REQUIRE(run("^done,value=\"1\"\n", "^done,value={a=\"1\"}\n") ==
+        diffs("~value"));
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, results/repeated_variable)
+{
+    REQUIRE(run("^done,bkpt={number=\"1\"},bkpt={number=\"2\"}\n",
+        "^done,bkpt={number=\"1\"},bkpt={number=\"3\"},bkpt={}\n") ==
+        diffs("~bkpt#1.number", "+bkpt#2"));
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, list/keys)
+{
+    /* The threads after the one that went away are not changed */
+    REQUIRE(run(
+        "^done,threads=[{id=\"1\",state=\"stopped\"},"
+            "{id=\"2\",state=\"stopped\"},{id=\"3\",state=\"stopped\"}]\n",
+        "^done,threads=[{id=\"1\",state=\"running\"},"
+            "{id=\"3\",state=\"stopped\"},{id=\"4\",state=\"stopped\"}]\n") ==
+        diffs("-threads[id=2]", "~threads[id=1].state", "+threads[id=4]"));
+
+    /* The elements of a list may have variables */
+    REQUIRE(run(
+        "^done,body=[bkpt={number=\"1\",times=\"0\"},bkpt={number=\"2\"}]\n",
+        "^done,body=[bkpt={number=\"2\"},bkpt={number=\"1\",times=\"1\"}]\n")
+        == diffs("~body[number=1].times"));
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, list/positions)
+{
+    REQUIRE(run("^done,args=[\"a\",\"b\"]\n",
+        "^done,args=[\"a\",\"c\",\"d\"]\n") ==
+        diffs("~args[1]", "+args[2]"));
+    REQUIRE(run("^done,args=[\"a\",\"b\"]\n", "^done,args=[]\n") ==
+        diffs("-args[0]", "-args[1]"));
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, list/set_keys)
+{
+    const char *keys[] = { "addr", NULL };
+
+    REQUIRE(gdbwire_mi_diff_set_keys(diff, keys) == GDBWIRE_OK);
+    REQUIRE(run("^done,stack=[frame={addr=\"0x1\",level=\"0\"}]\n",
+        "^done,stack=[frame={addr=\"0x1\",level=\"1\"}]\n") ==
+        diffs("~stack[addr=0x1].level"));
+
+    /* The default keys match by level instead */
+    REQUIRE(gdbwire_mi_diff_set_keys(diff, NULL) == GDBWIRE_OK);
+    REQUIRE(run("^done,stack=[frame={addr=\"0x1\",level=\"0\"}]\n",
+        "^done,stack=[frame={addr=\"0x1\",level=\"1\"}]\n") ==
+        diffs("-stack[level=0]", "+stack[level=1]"));
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, hashes/collision)
+{
+    gdbwire_mi_result *before, *after;
+
+    /* Equal cached hashes are confirmed before the subtree is skipped */
+    REQUIRE(gdbwire_mi_parser_set_hashes(parser, 1) == GDBWIRE_OK);
+    before = parse_results("^done,frame={addr=\"0x1\"},a=\"1\"\n");
+    after = parse_results("^done,frame={addr=\"0x2\"},a=\"2\"\n");
+    REQUIRE(before->hash != after->hash);
+    after->hash = before->hash;
+
+    m_diffs.clear();
+    REQUIRE(gdbwire_mi_diff_results(diff, before, after, diff_callback,
+        this) == GDBWIRE_OK);
+    REQUIRE(m_diffs == diffs("~frame.addr", "~a"));
+
+    /* The results shared by both lists are skipped */
+    m_diffs.clear();
+    REQUIRE(gdbwire_mi_diff_results(diff, before, before, diff_callback,
+        this) == GDBWIRE_OK);
+    REQUIRE(m_diffs.empty());
+}
+
+TEST_CASE_METHOD_N(GdbwireMiDiffTest, results/nomem)
+{
+    gdbwire_allocator limited = { 0, limited_malloc_fn, limited_realloc_fn,
+        limited_free_fn };
+    gdbwire_mi_diff *limited_diff;
+    gdbwire_mi_result *before, *after;
+    enum gdbwire_result result = GDBWIRE_NOMEM;
+    size_t limit;
+
+    before = parse_results("^done,threads=[{id=\"1\",frame={level=\"0\"}}]\n");
+    after = parse_results("^done,threads=[{id=\"2\",frame={level=\"0\"}}]\n");
+
+    /* Each allocation the diff needs reports running out of memory */
+    for (limit = 0; result == GDBWIRE_NOMEM; ++limit) {
+        limited_diff = gdbwire_mi_diff_create_with_allocator(&limited);
+        REQUIRE(limited_diff);
+        reallocs_left = limit;
+        m_diffs.clear();
+        result = gdbwire_mi_diff_results(limited_diff, before, after,
+            diff_callback, this);
+        gdbwire_mi_diff_destroy(limited_diff);
+    }
+
+    REQUIRE(limit > 1);
+    REQUIRE(result == GDBWIRE_OK);
+    REQUIRE(m_diffs == diffs("-threads[id=1]", "+threads[id=2]"));
+}
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_mi_json.h"
+#include "gdbwire_mi_parser.h"
+
+namespace {
+    struct GdbwireMiJsonTest : public MiParserFixture {
+        GdbwireMiJsonTest() {
+            json = gdbwire_mi_json_create(json_callback, this);
+            REQUIRE(json);
+        }
+
+        ~GdbwireMiJsonTest() {
+            gdbwire_mi_json_destroy(json);
+        }
+
+        static void json_callback(void *context, const char *data,
+            size_t size) {
+            GdbwireMiJsonTest *test = (GdbwireMiJsonTest *)context;
+            REQUIRE(data[size] == 0);
+            test->m_json.push_back(std::string(data, size));
+        }
+
+        std::string get_file_contents(const std::string &path) {
+            std::string result;
+            FILE *fd;
+            int c;
+
+            fd = fopen(path.c_str(), "r");
+            REQUIRE(fd);
+
+            while ((c = fgetc(fd)) != EOF) {
+                result.push_back((char)c);
+            }
+            fclose(fd);
+
+            return result;
+        }
+
+        /**
+         * Transcode data, pushed in chunks.
+         *
+         * @return
+         * The JSON of each line.
+         */
+        std::vector<std::string> transcode(const std::string &data,
+            size_t chunk = (size_t)-1) {
+            size_t offset, size;
+
+            m_json.clear();
+            for (offset = 0; offset < data.size(); offset += size) {
+                size = std::min(chunk, data.size() - offset);
+                REQUIRE(gdbwire_mi_json_push_data(json, data.data() + offset,
+                    size) == GDBWIRE_OK);
+            }
+            return m_json;
+        }
+
+        /**
+         * Parse data into trees and write the JSON of each tree.
+         *
+         * @return
+         * The JSON of each line.
+         */
+        std::vector<std::string> serialize(const std::string &data) {
+            gdbwire_mi_output *output;
+
+            m_json.clear();
+            for (output = parse(data); output; output = output->next) {
+                REQUIRE(gdbwire_mi_json_output(json, output) == GDBWIRE_OK);
+            }
+            gdbwire_mi_output_free(takeOutputs());
+            return m_json;
+        }
+
+        /* Transcode a single line, both ways, and return its JSON */
+        std::string run(const std::string &line) {
+            std::vector<std::string> streamed = transcode(line);
+            REQUIRE(streamed.size() == 1);
+            REQUIRE(serialize(line) == streamed);
+            return streamed[0];
+        }
+
+        gdbwire_mi_json *json;
+        std::vector<std::string> m_json;
+    };
+}
+
+TEST_CASE_METHOD_N(GdbwireMiJsonTest, destroy/null_instance)
+{
+    gdbwire_mi_json_destroy(NULL);
+}
+
+/**
+ * Ensure the transcoder writes the same JSON as the parse trees for
+ * every line of the MI files of the test suite, however it is pushed.
+ */
+TEST_CASE_METHOD_N(GdbwireMiJsonTest, corpus/matches_tree)
+{
+    std::vector<std::string> files, streamed;
+    std::string contents;
+    size_t index, lines = 0;
+
+    findMiFiles(data(), files);
+    REQUIRE(files.size() > 50);
+
+    for (index = 0; index < files.size(); ++index) {
+        contents = get_file_contents(files[index]);
+        streamed = transcode(contents);
+        REQUIRE(serialize(contents) == streamed);
+        REQUIRE(transcode(contents, 1 + index % 7) == streamed);
+        lines += streamed.size();
+    }
+
+    REQUIRE(lines > files.size());
+}
+
+TEST_CASE_METHOD_N(GdbwireMiJsonTest, records/kinds)
+{
+    REQUIRE(run("12^done,value=\"1\"\n") ==
+        "{\"type\":\"result\",\"token\":\"12\",\"class\":\"done\","
+        "\"results\":{\"value\":\"1\"}}");
+    REQUIRE(run("^running\n") ==
+        "{\"type\":\"result\",\"class\":\"running\",\"results\":{}}");
+    REQUIRE(run("*stopped,reason=\"exited-normally\"\n") ==
+        "{\"type\":\"exec\",\"class\":\"stopped\","
+        "\"results\":{\"reason\":\"exited-normally\"}}");
+    REQUIRE(run("+download,section=\".text\"\n") ==
+        "{\"type\":\"status\",\"class\":\"download\","
+        "\"results\":{\"section\":\".text\"}}");
+    REQUIRE(run("=thread-group-added,id=\"i1\"\r\n") ==
+        "{\"type\":\"notify\",\"class\":\"thread-group-added\","
+        "\"results\":{\"id\":\"i1\"}}");
+    REQUIRE(run("~\"text\"\n") == "{\"type\":\"console\",\"text\":\"text\"}");
+    REQUIRE(run("@\"text\"\n") == "{\"type\":\"target\",\"text\":\"text\"}");
+    REQUIRE(run("&\"text\"\n") == "{\"type\":\"log\",\"text\":\"text\"}");
+    REQUIRE(run("(gdb) \n") == "{\"type\":\"prompt\"}");
+
+    /* The parse tree does not keep the name of an unknown class */
+    REQUIRE(run("=new-ui-created,id=\"2\"\n") ==
+        "{\"type\":\"notify\",\"class\":\"unsupported\","
+        "\"results\":{\"id\":\"2\"}}");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiJsonTest, quirks/repeated_variable)
+{
+    REQUIRE(run("^done,thread-ids={thread-id=\"3\",thread-id=\"2\","
+        "thread-id=\"1\"},number-of-threads=\"3\"\n") ==
+        "{\"type\":\"result\",\"class\":\"done\",\"results\":{"
+        "\"thread-ids\":{\"thread-id\":\"3\",\"thread-id#1\":\"2\","
+        "\"thread-id#2\":\"1\"},\"number-of-threads\":\"3\"}}");
+
+    /* The keys of nested tuples are numbered on their own */
+    REQUIRE(run("^done,bkpt={number=\"1\",locations={number=\"1.1\"}},"
+        "bkpt={number=\"2\"}\n") ==
+        "{\"type\":\"result\",\"class\":\"done\",\"results\":{"
+        "\"bkpt\":{\"number\":\"1\",\"locations\":{\"number\":\"1.1\"}},"
+        "\"bkpt#1\":{\"number\":\"2\"}}}");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiJsonTest, quirks/lists)
+{
+    /* The elements of a list with a variable are wrapped in an object */
+    REQUIRE(run("^done,stack=[frame={level=\"0\"},frame={level=\"1\"}]\n") ==
+        "{\"type\":\"result\",\"class\":\"done\",\"results\":{"
+        "\"stack\":[{\"frame\":{\"level\":\"0\"}},"
+        "{\"frame\":{\"level\":\"1\"}}]}}");
+    REQUIRE(run("^done,args=[\"a\",[],{},name=\"b\"]\n") ==
+        "{\"type\":\"result\",\"class\":\"done\",\"results\":{"
+        "\"args\":[\"a\",[],{},{\"name\":\"b\"}]}}");
+
+    /* The results without a variable are numbered among themselves */
+    REQUIRE(run("^done,t={\"a\",x=\"1\",\"b\"},\"c\"\n") ==
+        "{\"type\":\"result\",\"class\":\"done\",\"results\":{"
+        "\"t\":{\"[0]\":\"a\",\"x\":\"1\",\"[1]\":\"b\"},\"[0]\":\"c\"}}");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiJsonTest, strings/escapes)
+{
+    /* Unescaped as the parser does, then escaped for JSON */
+    REQUIRE(run("~\"a\\\"b\\\\c\\n\\t\\r\\x\"\n") ==
+        "{\"type\":\"console\",\"text\":\"a\\\"b\\\\c\\n\\t\\r\\\\x\"}");
+    REQUIRE(run("~\"\x01\x1f\x7f\xc3\xa9\"\n") ==
+        "{\"type\":\"console\",\"text\":\"\\u0001\\u001f\x7f\xc3\xa9\"}");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiJsonTest, parse_error/matches_tree)
+{
+    const char *lines[] = {
+        "\n", "^\n", "*\n", "123\n", "12~\"x\"\n", "^done,\n",
+        "^done,a\n", "^done,a=\n", "^done,a={\n", "^done,a={b=\"1\",}\n",
+        "^done,a=[\"1\"]]\n", "^done,a=\"1\"\"2\"\n", "(gdb\n", "(foo)\n",
+        "(gdb) x\n", "~\"x\" y\n", "~x\n", "^done,a=b\n", "^done,\"a\n",
+        "^done,a={\"1\",b}\n"
+    };
+    size_t index;
+
+    for (index = 0; index < sizeof (lines) / sizeof (lines[0]); ++index) {
+        INFO(lines[index]);
+        REQUIRE(run(lines[index]).compare(0, 22,
+            "{\"type\":\"parse-error\",") == 0);
+    }
+
+    REQUIRE(run("^done,a={b=\"1\",}\r\n") ==
+        "{\"type\":\"parse-error\",\"token\":\"}\",\"start_column\":16,"
+        "\"end_column\":16,\"line\":\"^done,a={b=\\\"1\\\",}\"}");
+
+    /* The line after an error is transcoded as usual */
+    REQUIRE(transcode("^done,\n(gdb)\n").size() == 2);
+    REQUIRE(m_json[1] == "{\"type\":\"prompt\"}");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiJsonTest, push/partial_lines)
+{
+    std::vector<std::string> whole = transcode("~\"a\"\r\n^done\r(gdb)\n");
+
+    REQUIRE(whole.size() == 3);
+    REQUIRE(transcode("~\"a\"\n^done\r(gdb)\n", 1) == whole);
+
+    /* Nothing is written until the newline */
+    REQUIRE(transcode("^do").empty());
+    REQUIRE(transcode("ne,a=\"1\"").empty());
+    REQUIRE(transcode("\n").size() == 1);
+    REQUIRE(m_json[0] ==
+        "{\"type\":\"result\",\"class\":\"done\",\"results\":{\"a\":\"1\"}}");
+}
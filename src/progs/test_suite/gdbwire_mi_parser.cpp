@@ -1,7 +1,14 @@
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
 #include "catch.hpp"
 #include "fixture.h"
+#include "allocation_counter.h"
 #include "gdbwire_mi_pt.h"
 #include "gdbwire_mi_parser.h"
 
@@ -11,6 +18,7 @@ namespace {
             callbacks.context = (void*)this;
             callbacks.gdbwire_mi_output_callback =
                     GdbwireMiParserCallback::gdbwire_mi_output_callback;
+            m_chunks_last = 0;
         }
 
         ~GdbwireMiParserCallback() {
@@ -28,14 +36,50 @@ namespace {
             m_output = append_gdbwire_mi_output(m_output, output);
         }
 
+        static void gdbwire_mi_oversized_line_callback(void *context,
+            gdbwire_mi_parser_limit_action action, size_t size) {
+            GdbwireMiParserCallback *callback =
+                (GdbwireMiParserCallback *)context;
+            callback->m_oversized.push_back(std::make_pair(action, size));
+        }
+
+        static void gdbwire_mi_stream_chunk_callback(void *context,
+            gdbwire_mi_stream_record_kind kind, const char *data,
+            size_t size, int last) {
+            GdbwireMiParserCallback *callback =
+                (GdbwireMiParserCallback *)context;
+            callback->m_chunks_kind = kind;
+            callback->m_chunks.append(data, size);
+            callback->m_chunks_last += last;
+        }
+
+        /* Free the outputs received so far */
+        void clear() {
+            gdbwire_mi_output_free(m_output);
+            m_output = 0;
+        }
+
         gdbwire_mi_parser_callbacks callbacks;
         gdbwire_mi_output *m_output;
+        std::vector<std::pair<gdbwire_mi_parser_limit_action, size_t> >
+            m_oversized;
+
+        /* The stream record chunks received so far */
+        gdbwire_mi_stream_record_kind m_chunks_kind;
+        std::string m_chunks;
+        int m_chunks_last;
     };
 
     struct GdbwireMiParserTest : public Fixture {
         GdbwireMiParserTest() {
             parser = gdbwire_mi_parser_create(parserCallback.callbacks);
             REQUIRE(parser);
+            REQUIRE(gdbwire_mi_parser_set_oversized_line_callback(parser,
+                GdbwireMiParserCallback::gdbwire_mi_oversized_line_callback,
+                &parserCallback) == GDBWIRE_OK);
+            REQUIRE(gdbwire_mi_parser_set_stream_chunk_callback(parser,
+                GdbwireMiParserCallback::gdbwire_mi_stream_chunk_callback,
+                &parserCallback) == GDBWIRE_OK);
         }
         
         ~GdbwireMiParserTest() {
@@ -58,6 +102,22 @@ namespace {
             REQUIRE(!output->next);
         }
 
+        std::string get_file_contents(const std::string &path) {
+            std::string result;
+            FILE *fd;
+            int c;
+
+            fd = fopen(path.c_str(), "r");
+            REQUIRE(fd);
+
+            while ((c = fgetc(fd)) != EOF) {
+                result.push_back((char)c);
+            }
+            fclose(fd);
+
+            return result;
+        }
+
         std::string oneHundredPrompts() {
             int i;
             std::string data;
@@ -68,6 +128,32 @@ namespace {
             return data;
         }
 
+        /**
+         * Set a hard limit that leaves the buffer about size bytes.
+         *
+         * The parser is warmed up first so that the memory it keeps
+         * between lines is already allocated.
+         *
+         * @return
+         * The hard limit set.
+         */
+        size_t set_hard_limit(size_t size,
+                gdbwire_mi_parser_limit_action action) {
+            gdbwire_mi_parser_limits limits = { 0, 0, action };
+            gdbwire_mi_parser_stats stats;
+
+            REQUIRE(gdbwire_mi_parser_push(parser, "(gdb)\n") == GDBWIRE_OK);
+            parserCallback.clear();
+
+            REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) ==
+                GDBWIRE_OK);
+            limits.hard_limit = stats.total_bytes + size;
+            REQUIRE(gdbwire_mi_parser_set_limits(parser, limits) ==
+                GDBWIRE_OK);
+
+            return limits.hard_limit;
+        }
+
         GdbwireMiParserCallback parserCallback;
         gdbwire_mi_parser *parser;
     };
@@ -268,3 +354,1125 @@ TEST_CASE_METHOD_N(GdbwireMiParserTest, push/syntax_error)
     REQUIRE(output);
     REQUIRE(output->kind == GDBWIRE_MI_OUTPUT_PARSE_ERROR);
 }
+
+/**
+ * Ensure the parser stops allocating memory once it has warmed up.
+ *
+ * The first pass over the data grows the parser's buffers and fills the
+ * pool of parse tree arenas. Parsing the same kind of data again, after
+ * the outputs of the first pass are freed, should not allocate at all.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, steady_state/common_records.mi)
+{
+    std::string mi = get_file_contents(sourceTestPath());
+    gdbwire_result result;
+    size_t index, allocations;
+
+    REQUIRE(gdbwire_mi_parser_push(parser, mi.c_str()) == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_output);
+    gdbwire_mi_output_free(parserCallback.m_output);
+    parserCallback.m_output = 0;
+
+    if (!AllocationCounter::supported()) {
+        return;
+    }
+
+    SECTION("all_at_once") {
+        AllocationCounter counter;
+        result = gdbwire_mi_parser_push(parser, mi.c_str());
+        allocations = counter.count();
+    }
+
+    SECTION("char_at_a_time") {
+        AllocationCounter counter;
+        result = GDBWIRE_OK;
+        for (index = 0; index < mi.size() && result == GDBWIRE_OK; ++index) {
+            result = gdbwire_mi_parser_push_data(parser, &mi[index], 1);
+        }
+        allocations = counter.count();
+    }
+
+    REQUIRE(result == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(allocations == 0);
+}
+
+namespace {
+    /* Free a list of outputs, on a thread other than the parser's */
+    void *free_outputs(void *data) {
+        gdbwire_mi_output_free((gdbwire_mi_output *)data);
+        return NULL;
+    }
+}
+
+/**
+ * Ensure outputs may be freed on another thread while the parser runs.
+ *
+ * The arenas of the freed outputs are handed back to the parser's pool,
+ * which takes them back for reuse on the parser's thread.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, steady_state/free_on_other_thread)
+{
+    std::string mi = get_file_contents(
+        data() + "/GdbwireMiParserTest/steady_state/common_records.mi");
+    gdbwire_mi_parser_stats stats;
+    gdbwire_mi_output *outputs;
+    pthread_t thread;
+    int round;
+
+    for (round = 0; round < 50; ++round) {
+        REQUIRE(gdbwire_mi_parser_push(parser, mi.c_str()) == GDBWIRE_OK);
+        outputs = parserCallback.m_output;
+        REQUIRE(outputs);
+        parserCallback.m_output = 0;
+
+        REQUIRE(pthread_create(&thread, NULL, free_outputs, outputs) == 0);
+        REQUIRE(gdbwire_mi_parser_push(parser, mi.c_str()) == GDBWIRE_OK);
+        parserCallback.clear();
+        pthread_join(thread, NULL);
+    }
+
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes == 0);
+    REQUIRE(stats.cache_bytes > 0);
+}
+
+/**
+ * Ensure the stats account for the buffer, the trees and the cache.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, stats/memory)
+{
+    gdbwire_mi_parser_stats stats;
+
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes == 0);
+    REQUIRE(stats.cache_bytes == 0);
+    REQUIRE(stats.lines == 0);
+
+    /* The trees are in use until the outputs are freed */
+    REQUIRE(gdbwire_mi_parser_push(parser, "^done\n(gdb)\n") == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes > 0);
+    REQUIRE(stats.lines == 2);
+    REQUIRE(stats.total_bytes ==
+        stats.buffer_bytes + stats.tree_bytes + stats.cache_bytes);
+    REQUIRE(stats.peak_bytes == stats.total_bytes);
+
+    /* The freed trees are held for reuse */
+    parserCallback.clear();
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes == 0);
+    REQUIRE(stats.cache_bytes > 0);
+    REQUIRE(stats.peak_bytes >= stats.total_bytes);
+    REQUIRE(stats.soft_limit_exceeded == 0);
+}
+
+/**
+ * Ensure the memory held for reuse is freed past the soft limit.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, limits/soft_limit)
+{
+    gdbwire_mi_parser_limits limits = { 1, 0, GDBWIRE_MI_LIMIT_TRUNCATE };
+    gdbwire_mi_parser_stats stats;
+
+    REQUIRE(gdbwire_mi_parser_push(parser, "^done\n") == GDBWIRE_OK);
+    parserCallback.clear();
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.cache_bytes > 0);
+
+    REQUIRE(gdbwire_mi_parser_set_limits(parser, limits) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "(gdb)") == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.cache_bytes == 0);
+    REQUIRE(stats.soft_limit_exceeded == 1);
+
+    /* Exceeding the soft limit is otherwise harmless */
+    REQUIRE(gdbwire_mi_parser_push(parser, "\n") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(parserCallback.m_output->kind == GDBWIRE_MI_OUTPUT_PROMPT);
+}
+
+/**
+ * Ensure an invalid limit action is rejected.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, limits/invalid_action)
+{
+    gdbwire_mi_parser_limits limits =
+        { 0, 0, (gdbwire_mi_parser_limit_action)-1 };
+    REQUIRE(gdbwire_mi_parser_set_limits(parser, limits) == GDBWIRE_ASSERT);
+}
+
+/**
+ * Ensure a line past the hard limit is truncated.
+ *
+ * The truncated stream record is closed so that the start of
+ * the console output is still delivered.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, limits/truncate)
+{
+    std::string line = "~\"" + std::string(100000, 'a') + "\"";
+    gdbwire_mi_parser_stats stats;
+    gdbwire_mi_output *output;
+    std::string cstring;
+
+    set_hard_limit(4096, GDBWIRE_MI_LIMIT_TRUNCATE);
+    line += "\n";
+    REQUIRE(gdbwire_mi_parser_push(parser, line.c_str()) == GDBWIRE_OK);
+
+    REQUIRE(parserCallback.m_oversized.size() == 1);
+    REQUIRE(parserCallback.m_oversized[0].first ==
+        GDBWIRE_MI_LIMIT_TRUNCATE);
+    REQUIRE(parserCallback.m_oversized[0].second == 100003);
+
+    output = parserCallback.m_output;
+    REQUIRE(output);
+    REQUIRE(output->kind == GDBWIRE_MI_OUTPUT_OOB);
+    REQUIRE(output->variant.oob_record->kind == GDBWIRE_MI_STREAM);
+    cstring = output->variant.oob_record->variant.stream_record->cstring;
+    REQUIRE(cstring.size() > 0);
+    REQUIRE(cstring.size() < 4096);
+    REQUIRE(cstring == std::string(cstring.size(), 'a'));
+    REQUIRE(!output->next);
+
+    /**
+     * The lines after the oversized line are parsed as usual,
+     * once the truncated line's tree no longer takes up the memory.
+     */
+    parserCallback.clear();
+    REQUIRE(gdbwire_mi_parser_push(parser, "(gdb)\n") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_oversized.size() == 1);
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(parserCallback.m_output->kind == GDBWIRE_MI_OUTPUT_PROMPT);
+
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.lines_truncated == 1);
+    REQUIRE(stats.lines_skipped == 0);
+}
+
+/**
+ * Ensure a stream record truncated in the middle of an escape sequence
+ * still parses.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, limits/truncate_escape)
+{
+    std::string line = "@\"";
+    gdbwire_mi_output *output;
+    std::string cstring;
+    size_t index;
+
+    for (index = 0; index < 10000; ++index) {
+        line += "\\n";
+    }
+    line += "\"\n";
+
+    set_hard_limit(1024, GDBWIRE_MI_LIMIT_TRUNCATE);
+    REQUIRE(gdbwire_mi_parser_push(parser, line.c_str()) == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_oversized.size() == 1);
+
+    output = parserCallback.m_output;
+    REQUIRE(output);
+    REQUIRE(output->kind == GDBWIRE_MI_OUTPUT_OOB);
+    REQUIRE(output->variant.oob_record->kind == GDBWIRE_MI_STREAM);
+    cstring = output->variant.oob_record->variant.stream_record->cstring;
+    REQUIRE(cstring.size() > 0);
+    REQUIRE(cstring == std::string(cstring.size(), '\n'));
+}
+
+/**
+ * Ensure a line past the hard limit is skipped, even when it arrives
+ * over many pushes.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, limits/skip)
+{
+    std::string chunk(1000, 'x');
+    gdbwire_mi_parser_stats stats;
+    size_t index, hard_limit;
+
+    hard_limit = set_hard_limit(4096, GDBWIRE_MI_LIMIT_SKIP);
+    REQUIRE(gdbwire_mi_parser_push(parser, "^done\n^err") == GDBWIRE_OK);
+    for (index = 0; index < 100; ++index) {
+        REQUIRE(gdbwire_mi_parser_push(parser, chunk.c_str()) == GDBWIRE_OK);
+    }
+    REQUIRE(parserCallback.m_oversized.empty());
+
+    /* The parser did not buffer past the hard limit */
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.peak_bytes <= hard_limit);
+
+    REQUIRE(gdbwire_mi_parser_push(parser, "\r\n(gdb)\n") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_oversized.size() == 1);
+    REQUIRE(parserCallback.m_oversized[0].first == GDBWIRE_MI_LIMIT_SKIP);
+    REQUIRE(parserCallback.m_oversized[0].second == 100004);
+
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(parserCallback.m_output->kind == GDBWIRE_MI_OUTPUT_RESULT);
+    REQUIRE(parserCallback.m_output->next);
+    REQUIRE(parserCallback.m_output->next->kind == GDBWIRE_MI_OUTPUT_PROMPT);
+    REQUIRE(!parserCallback.m_output->next->next);
+
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.lines_skipped == 1);
+    REQUIRE(stats.lines == 3);
+}
+
+/**
+ * Ensure a large stream record is delivered in chunks as it arrives.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, stream/chunks)
+{
+    std::string x(20, 'x');
+    gdbwire_mi_parser_stats stats;
+
+    REQUIRE(gdbwire_mi_parser_set_stream_threshold(parser, 16) ==
+        GDBWIRE_OK);
+
+    /* The record is buffered until it reaches the threshold */
+    REQUIRE(gdbwire_mi_parser_push(parser, "~\"abc") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_chunks.empty());
+    REQUIRE(gdbwire_mi_parser_push(parser, x.c_str()) == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_chunks == "abc" + x);
+    REQUIRE(parserCallback.m_chunks_kind == GDBWIRE_MI_CONSOLE);
+
+    /* Escape sequences may be split across pushes */
+    REQUIRE(gdbwire_mi_parser_push(parser, "\\") == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "n\\q\\\"") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_chunks_last == 0);
+
+    REQUIRE(gdbwire_mi_parser_push(parser, "\"\n(gdb)\n") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_chunks == "abc" + x + "\n\\q\"");
+    REQUIRE(parserCallback.m_chunks_last == 1);
+
+    /* The streamed record is not delivered as an output */
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(parserCallback.m_output->kind == GDBWIRE_MI_OUTPUT_PROMPT);
+    REQUIRE(!parserCallback.m_output->next);
+
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.lines == 2);
+    REQUIRE(stats.lines_streamed == 1);
+}
+
+/**
+ * Ensure a stream record that arrives whole is delivered whole.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, stream/whole)
+{
+    std::string line = "&\"" + std::string(100, 'z') + "\"\n";
+
+    REQUIRE(gdbwire_mi_parser_set_stream_threshold(parser, 16) ==
+        GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, line.c_str()) == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_chunks.empty());
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(parserCallback.m_output->kind == GDBWIRE_MI_OUTPUT_OOB);
+}
+
+/**
+ * Ensure a streamed record ending in a \r\n split across pushes
+ * does not leave an empty line behind.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, stream/crnl)
+{
+    std::string y(32, 'y');
+
+    REQUIRE(gdbwire_mi_parser_set_stream_threshold(parser, 16) ==
+        GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "@\"") == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, y.c_str()) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "\"\r") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_chunks_last == 1);
+    REQUIRE(gdbwire_mi_parser_push(parser, "\n(gdb)\r\n") == GDBWIRE_OK);
+
+    REQUIRE(parserCallback.m_chunks == y);
+    REQUIRE(parserCallback.m_chunks_kind == GDBWIRE_MI_TARGET);
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(parserCallback.m_output->kind == GDBWIRE_MI_OUTPUT_PROMPT);
+    REQUIRE(!parserCallback.m_output->next);
+}
+
+/**
+ * Ensure streaming a large stream record uses bounded memory.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, stream/bounded_memory)
+{
+    std::string chunk(1000, 'm');
+    gdbwire_mi_parser_stats before, after;
+    size_t index;
+
+    REQUIRE(gdbwire_mi_parser_set_stream_threshold(parser, 1024) ==
+        GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "~\"") == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, chunk.c_str()) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, chunk.c_str()) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &before) == GDBWIRE_OK);
+
+    for (index = 0; index < 1000; ++index) {
+        REQUIRE(gdbwire_mi_parser_push(parser, chunk.c_str()) == GDBWIRE_OK);
+    }
+    REQUIRE(gdbwire_mi_parser_push(parser, "\"\n") == GDBWIRE_OK);
+
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &after) == GDBWIRE_OK);
+    REQUIRE(after.buffer_bytes == before.buffer_bytes);
+    REQUIRE(parserCallback.m_chunks.size() == 1002000);
+    REQUIRE(parserCallback.m_chunks_last == 1);
+}
+
+/**
+ * Ensure the timestamps tell when each line arrived.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, timestamps/lines)
+{
+    const gdbwire_mi_timestamps *first, *second, *third;
+    gdbwire_mi_output *output;
+
+    /* The timestamps are not taken by default */
+    REQUIRE(gdbwire_mi_parser_push(parser, "^done\n") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_output);
+    first = gdbwire_mi_output_get_timestamps(parserCallback.m_output);
+    REQUIRE(first);
+    REQUIRE(first->first_byte == 0);
+    REQUIRE(first->dispatch == 0);
+    REQUIRE(!gdbwire_mi_output_get_timestamps(NULL));
+    parserCallback.clear();
+
+    REQUIRE(gdbwire_mi_parser_set_timestamps(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "^do") == GDBWIRE_OK);
+    usleep(1000);
+    REQUIRE(gdbwire_mi_parser_push(parser, "ne\n^running\n(gd") == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "b)\n") == GDBWIRE_OK);
+
+    /* The first line began in an earlier push than its newline */
+    output = parserCallback.m_output;
+    REQUIRE(output);
+    first = gdbwire_mi_output_get_timestamps(output);
+    REQUIRE(first->first_byte > 0);
+    REQUIRE(first->newline - first->first_byte >= 1000000);
+    REQUIRE(first->dispatch >= first->newline);
+
+    /* The second line arrived whole in the push that ended the first */
+    REQUIRE(output->next);
+    second = gdbwire_mi_output_get_timestamps(output->next);
+    REQUIRE(second->first_byte == first->newline);
+    REQUIRE(second->newline == first->newline);
+
+    /* The prompt began in that push too and ended in the next */
+    REQUIRE(output->next->next);
+    third = gdbwire_mi_output_get_timestamps(output->next->next);
+    REQUIRE(third->first_byte == first->newline);
+    REQUIRE(third->newline > first->newline);
+}
+
+namespace {
+    /* Records the thread the output callback is invoked on */
+    struct GdbwireMiParserThreadCallback {
+        static void gdbwire_mi_output_callback(void *context,
+            gdbwire_mi_output *output) {
+            *(pthread_t *)context = pthread_self();
+            gdbwire_mi_output_free(output);
+        }
+    };
+
+    struct GdbwireMiParserSlowCallback {
+        /* Count the outputs in order, slowly at first */
+        static void gdbwire_mi_output_callback(void *context,
+            gdbwire_mi_output *output) {
+            int *count = (int *)context;
+            if (*count == 0) {
+                usleep(20000);
+            }
+            if (output->kind == GDBWIRE_MI_OUTPUT_RESULT &&
+                    atoi(output->variant.result_record->token) == *count) {
+                ++*count;
+            }
+            gdbwire_mi_output_free(output);
+        }
+    };
+}
+
+/**
+ * Ensure a pipelined parser produces the outputs a serial one does.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, pipelined/matches_serial)
+{
+    const char *lines[] = {
+        "=thread-group-added,id=\"i1\"\n",
+        "~\"GNU gdb (GDB) 13.1\\n\"\n",
+        "4^done,bkpt={number=\"1\",thread-groups=[\"i1\"]}\r\n",
+        "error\n",
+        "5^done,value=\n",
+        "*stopped,reason=\"breakpoint-hit\",frame={args=[]}\r",
+        "(gdb)\n"
+    };
+    GdbwireMiParserCallback serialCallback;
+    gdbwire_mi_parser *serial;
+    gdbwire_mi_output *output, *expected;
+    std::string data;
+    size_t count, index, size;
+
+    /* Enough lines to fill the queue between the stages many times */
+    for (count = 0; count < 1000; ++count) {
+        data += lines[count % (sizeof(lines) / sizeof(lines[0]))];
+    }
+
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_OK);
+
+    serial = gdbwire_mi_parser_create(serialCallback.callbacks);
+    REQUIRE(serial);
+    for (index = 0; index < data.size(); index += 7) {
+        size = std::min((size_t)7, data.size() - index);
+        REQUIRE(gdbwire_mi_parser_push_data(serial, &data[index], size) ==
+            GDBWIRE_OK);
+        REQUIRE(gdbwire_mi_parser_push_data(parser, &data[index], size) ==
+            GDBWIRE_OK);
+    }
+    gdbwire_mi_parser_destroy(serial);
+
+    /* Stopping waits for every line lexed to be built */
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 0) == GDBWIRE_OK);
+
+    output = parserCallback.m_output;
+    expected = serialCallback.m_output;
+    for (count = 0; output && expected; ++count) {
+        REQUIRE(output->kind == expected->kind);
+        REQUIRE(std::string(output->line) == expected->line);
+        if (output->kind == GDBWIRE_MI_OUTPUT_PARSE_ERROR) {
+            REQUIRE(std::string(output->variant.error.token) ==
+                expected->variant.error.token);
+            REQUIRE(output->variant.error.pos.start_column ==
+                expected->variant.error.pos.start_column);
+            REQUIRE(output->variant.error.pos.end_column ==
+                expected->variant.error.pos.end_column);
+        }
+        output = output->next;
+        expected = expected->next;
+    }
+    REQUIRE(!output);
+    REQUIRE(!expected);
+    REQUIRE(count >= 1000);
+}
+
+/**
+ * Ensure a pipelined parser invokes the callback on a thread of its own.
+ */
+TEST_CASE("GdbwireMiParserTest/pipelined/callback_thread")
+{
+    gdbwire_mi_parser_callbacks callbacks = { 0, 0 };
+    gdbwire_mi_parser_stats stats;
+    gdbwire_mi_parser *parser;
+    pthread_t thread = pthread_self();
+
+    callbacks.context = &thread;
+    callbacks.gdbwire_mi_output_callback =
+        GdbwireMiParserThreadCallback::gdbwire_mi_output_callback;
+    parser = gdbwire_mi_parser_create(callbacks);
+    REQUIRE(parser);
+
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "^done\n") == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 0) == GDBWIRE_OK);
+    REQUIRE(!pthread_equal(thread, pthread_self()));
+
+    /* The lines are counted as they are lexed */
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.lines == 1);
+
+    /* Destroying the parser stops the pipeline */
+    thread = pthread_self();
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "(gdb)\n") == GDBWIRE_OK);
+    gdbwire_mi_parser_destroy(parser);
+    REQUIRE(!pthread_equal(thread, pthread_self()));
+}
+
+/**
+ * Ensure the first stage of a pipelined parser waits while the queue
+ * between the stages is full.
+ */
+TEST_CASE("GdbwireMiParserTest/pipelined/full")
+{
+    gdbwire_mi_parser_callbacks callbacks = { 0, 0 };
+    gdbwire_mi_parser *parser;
+    std::string data;
+    char line[32];
+    int count;
+
+    for (count = 0; count < 1000; ++count) {
+        snprintf(line, sizeof(line), "%d^done\n", count);
+        data += line;
+    }
+
+    count = 0;
+    callbacks.context = &count;
+    callbacks.gdbwire_mi_output_callback =
+        GdbwireMiParserSlowCallback::gdbwire_mi_output_callback;
+    parser = gdbwire_mi_parser_create(callbacks);
+    REQUIRE(parser);
+
+    /* The second stage is slow at first, so the lines fill the queue */
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push_data(parser, data.data(), data.size()) ==
+        GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 0) == GDBWIRE_OK);
+    REQUIRE(count == 1000);
+
+    gdbwire_mi_parser_destroy(parser);
+}
+
+/**
+ * Ensure the features whose callbacks can not be pipelined are refused.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, pipelined/limits)
+{
+    gdbwire_mi_parser_limits limits = { 0, 4096, GDBWIRE_MI_LIMIT_SKIP };
+    gdbwire_mi_parser_limits none = { 0, 0, GDBWIRE_MI_LIMIT_SKIP };
+
+    REQUIRE(gdbwire_mi_parser_set_limits(parser, limits) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_mi_parser_set_limits(parser, none) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_stream_threshold(parser, 64) ==
+        GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_mi_parser_set_stream_threshold(parser, 0) == GDBWIRE_OK);
+
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_limits(parser, limits) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_mi_parser_set_stream_threshold(parser, 64) ==
+        GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_mi_parser_set_limits(parser, none) == GDBWIRE_OK);
+}
+
+namespace {
+    /* The number of threads sharing an output in refcount/threads */
+    const int REFCOUNT_THREADS = 4;
+
+    /* Read a shared output and drop the thread's reference to it */
+    void *read_and_release(void *data) {
+        const gdbwire_mi_output *output = (const gdbwire_mi_output *)data;
+        size_t *length = new size_t(std::string(output->line).size());
+        gdbwire_mi_output_release(output);
+        return length;
+    }
+}
+
+/**
+ * Ensure a retained output outlives the reference the callback handed out.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, refcount/retain_release)
+{
+    const gdbwire_mi_output *shared;
+    gdbwire_mi_parser_stats stats;
+
+    REQUIRE(gdbwire_mi_parser_push(parser, "^done,value=\"1\"\n") ==
+        GDBWIRE_OK);
+    REQUIRE(parserCallback.m_output);
+    shared = gdbwire_mi_output_retain(parserCallback.m_output);
+    REQUIRE(shared == parserCallback.m_output);
+    REQUIRE(gdbwire_mi_output_retain(NULL) == NULL);
+    gdbwire_mi_output_release(NULL);
+
+    /* Freeing drops the callback's reference, the tree is still held */
+    parserCallback.clear();
+    REQUIRE(std::string(shared->line) == "^done,value=\"1\"\n");
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes > 0);
+
+    /* The last reference hands the memory back for the next line */
+    gdbwire_mi_output_retain(shared);
+    gdbwire_mi_output_release(shared);
+    gdbwire_mi_output_release(shared);
+    REQUIRE(gdbwire_mi_parser_push(parser, "(gdb)\n") == GDBWIRE_OK);
+    parserCallback.clear();
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes == 0);
+    REQUIRE(stats.cache_bytes > 0);
+}
+
+/**
+ * Ensure an output can be shared with and released by other threads.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, refcount/threads)
+{
+    pthread_t threads[REFCOUNT_THREADS];
+    gdbwire_mi_output *output;
+    void *length;
+    int round, index;
+
+    for (round = 0; round < 100; ++round) {
+        REQUIRE(gdbwire_mi_parser_push(parser, "*running,thread-id=\"all\"\n")
+            == GDBWIRE_OK);
+        output = parserCallback.m_output;
+        REQUIRE(output);
+        parserCallback.m_output = 0;
+
+        for (index = 0; index < REFCOUNT_THREADS; ++index) {
+            gdbwire_mi_output_retain(output);
+            REQUIRE(pthread_create(&threads[index], NULL, read_and_release,
+                output) == 0);
+        }
+        gdbwire_mi_output_free(output);
+
+        for (index = 0; index < REFCOUNT_THREADS; ++index) {
+            pthread_join(threads[index], &length);
+            REQUIRE(*(size_t *)length == 25);
+            delete (size_t *)length;
+        }
+    }
+
+    /* The outputs released by the other threads outlive the parser */
+    REQUIRE(gdbwire_mi_parser_push(parser, "(gdb)\n") == GDBWIRE_OK);
+    output = parserCallback.m_output;
+    parserCallback.m_output = 0;
+    gdbwire_mi_output_retain(output);
+    gdbwire_mi_output_free(output);
+    gdbwire_mi_parser_destroy(parser);
+    parser = gdbwire_mi_parser_create(parserCallback.callbacks);
+    REQUIRE(parser);
+    REQUIRE(pthread_create(&threads[0], NULL, read_and_release, output) == 0);
+    pthread_join(threads[0], &length);
+    REQUIRE(*(size_t *)length == 6);
+    delete (size_t *)length;
+}
+
+/**
+ * Ensure a repeated line shares the parse tree of the cached line.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, cache/hits)
+{
+    gdbwire_mi_parser_stats stats;
+    gdbwire_mi_output *first, *second;
+
+    REQUIRE(gdbwire_mi_parser_set_cache(parser, 4) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser,
+        "^done,value=\"1\"\n(gdb)\n^done,value=\"1\"\n") == GDBWIRE_OK);
+
+    first = parserCallback.m_output;
+    REQUIRE(first);
+    REQUIRE(first->next);
+    second = first->next->next;
+    REQUIRE(second);
+    REQUIRE(!second->next);
+
+    /* Each line has an output of its own sharing the one parse tree */
+    REQUIRE(first != second);
+    REQUIRE(second->kind == GDBWIRE_MI_OUTPUT_RESULT);
+    REQUIRE(second->variant.result_record == first->variant.result_record);
+    REQUIRE(std::string(second->line) == "^done,value=\"1\"\n");
+    REQUIRE(std::string(second->variant.result_record->result->variant.cstring)
+        == "1");
+
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.cache_hits == 1);
+    REQUIRE(stats.cache_misses == 2);
+
+    /* The cache holds its trees after the outputs are freed */
+    parserCallback.clear();
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes > 0);
+
+    /* Turning the cache off frees them and keeps the counts */
+    REQUIRE(gdbwire_mi_parser_set_cache(parser, 0) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes == 0);
+    REQUIRE(stats.cache_hits == 1);
+    REQUIRE(stats.cache_misses == 2);
+}
+
+/**
+ * Ensure the cache is bounded and only holds short lines.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, cache/bounded)
+{
+    gdbwire_mi_parser_stats stats;
+    size_t tree_bytes = 0;
+    std::string line;
+    char token[32];
+    int index;
+
+    REQUIRE(gdbwire_mi_parser_set_cache(parser, 2) == GDBWIRE_OK);
+
+    /* Many distinct lines hold no more trees than the capacity */
+    for (index = 0; index < 100; ++index) {
+        snprintf(token, sizeof(token), "%d^done\n", index);
+        REQUIRE(gdbwire_mi_parser_push(parser, token) == GDBWIRE_OK);
+        parserCallback.clear();
+        if (index == 1) {
+            REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) ==
+                GDBWIRE_OK);
+            tree_bytes = stats.tree_bytes;
+        }
+    }
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.cache_hits == 0);
+    REQUIRE(stats.cache_misses == 100);
+    REQUIRE(tree_bytes > 0);
+    REQUIRE(stats.tree_bytes == tree_bytes);
+
+    /* A long line is parsed every time */
+    line = "~\"" + std::string(300, 'x') + "\"\n";
+    REQUIRE(gdbwire_mi_parser_push(parser, line.c_str()) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, line.c_str()) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.cache_hits == 0);
+    REQUIRE(stats.cache_misses == 100);
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(parserCallback.m_output->next);
+    REQUIRE(parserCallback.m_output->variant.oob_record !=
+        parserCallback.m_output->next->variant.oob_record);
+}
+
+/**
+ * Ensure the shared outputs outlive the parser and its cache.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, cache/outlives_parser)
+{
+    gdbwire_mi_output *output;
+
+    REQUIRE(gdbwire_mi_parser_set_cache(parser, 4) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, "*running,thread-id=\"all\"\n"
+        "*running,thread-id=\"all\"\n") == GDBWIRE_OK);
+    output = parserCallback.m_output;
+    parserCallback.m_output = 0;
+
+    gdbwire_mi_parser_destroy(parser);
+    parser = gdbwire_mi_parser_create(parserCallback.callbacks);
+    REQUIRE(parser);
+
+    REQUIRE(output);
+    REQUIRE(output->next);
+    REQUIRE(output->next->kind == GDBWIRE_MI_OUTPUT_OOB);
+    REQUIRE(std::string(output->next->variant.oob_record->variant.
+        async_record->result->variable) == "thread-id");
+    gdbwire_mi_output_free(output);
+}
+
+/**
+ * Ensure a pipelined parser uses the cache on its second stage.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, cache/pipelined)
+{
+    gdbwire_mi_parser_stats stats;
+    int index;
+
+    REQUIRE(gdbwire_mi_parser_set_cache(parser, 4) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_cache(parser, 8) == GDBWIRE_LOGIC);
+
+    for (index = 0; index < 100; ++index) {
+        REQUIRE(gdbwire_mi_parser_push(parser, "^done\n(gdb)\n") ==
+            GDBWIRE_OK);
+    }
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 0) == GDBWIRE_OK);
+
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.cache_hits == 198);
+    REQUIRE(stats.cache_misses == 2);
+    parserCallback.clear();
+}
+
+namespace {
+    /* Get the results of a result record output */
+    gdbwire_mi_result *get_results(gdbwire_mi_output *output) {
+        REQUIRE(output);
+        REQUIRE(output->kind == GDBWIRE_MI_OUTPUT_RESULT);
+        return output->variant.result_record->result;
+    }
+}
+
+/**
+ * Ensure results compare and hash by structure, not by identity.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, hash/equal)
+{
+    const char *lines[] = {
+        "1^done,a={b=\"1\",c=[\"x\",\"y\"]}\n",
+        "2^done,a={b=\"1\",c=[\"x\",\"y\"]}\n",
+        "3^done,a={b=\"1\",c=[\"x\",\"z\"]}\n",
+        "4^done,a={b=\"1\",d=[\"x\",\"y\"]}\n",
+        "5^done,a={b=\"1\",c={\"x\",\"y\"}}\n",
+        "6^done,a={b=\"1\",c=[\"x\",\"y\"]},e=\"\"\n",
+        "7^done\n"
+    };
+    gdbwire_mi_output *output;
+    gdbwire_mi_result *results[7];
+    int hashes, index, other;
+
+    /* The outcome is the same with and without the cached hashes */
+    for (hashes = 0; hashes < 2; ++hashes) {
+        REQUIRE(gdbwire_mi_parser_set_hashes(parser, hashes) == GDBWIRE_OK);
+        for (index = 0; index < 7; ++index) {
+            REQUIRE(gdbwire_mi_parser_push(parser, lines[index]) ==
+                GDBWIRE_OK);
+        }
+
+        output = parserCallback.m_output;
+        for (index = 0; index < 7; ++index, output = output->next) {
+            results[index] = get_results(output);
+            if (results[index]) {
+                REQUIRE((results[index]->hash != 0) == (hashes != 0));
+            }
+        }
+
+        for (index = 0; index < 7; ++index) {
+            for (other = 0; other < 7; ++other) {
+                bool same = index == other ||
+                    (index < 2 && other < 2);
+                REQUIRE(gdbwire_mi_result_equal(results[index],
+                    results[other]) == (same ? 1 : 0));
+                REQUIRE((gdbwire_mi_result_hash(results[index]) ==
+                    gdbwire_mi_result_hash(results[other])) == same);
+            }
+        }
+
+        parserCallback.clear();
+    }
+
+    REQUIRE(gdbwire_mi_result_equal(NULL, NULL) == 1);
+    REQUIRE(gdbwire_mi_result_hash(NULL) == gdbwire_mi_result_hash(NULL));
+}
+
+/**
+ * Ensure each class name is parsed as the class it names.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, class_name/parsed)
+{
+    gdbwire_mi_output *output;
+    std::string line;
+    int index;
+
+    for (index = 0; index <= GDBWIRE_MI_UNSUPPORTED; ++index) {
+        line = std::string("^") + gdbwire_mi_result_class_name(
+            (gdbwire_mi_result_class)index) + "\n";
+        REQUIRE(gdbwire_mi_parser_push(parser, line.c_str()) == GDBWIRE_OK);
+        output = parserCallback.m_output;
+        REQUIRE(output);
+        REQUIRE(output->kind == GDBWIRE_MI_OUTPUT_RESULT);
+        REQUIRE(output->variant.result_record->result_class == index);
+        parserCallback.clear();
+    }
+
+    for (index = 0; index <= GDBWIRE_MI_ASYNC_UNSUPPORTED; ++index) {
+        line = std::string("=") + gdbwire_mi_async_class_name(
+            (gdbwire_mi_async_class)index) + "\n";
+        REQUIRE(gdbwire_mi_parser_push(parser, line.c_str()) == GDBWIRE_OK);
+        output = parserCallback.m_output;
+        REQUIRE(output);
+        REQUIRE(output->kind == GDBWIRE_MI_OUTPUT_OOB);
+        REQUIRE(output->variant.oob_record->variant.async_record->
+            async_class == index);
+        parserCallback.clear();
+    }
+
+    REQUIRE(!gdbwire_mi_result_class_name(
+        (gdbwire_mi_result_class)(GDBWIRE_MI_UNSUPPORTED + 1)));
+    REQUIRE(!gdbwire_mi_async_class_name(
+        (gdbwire_mi_async_class)(GDBWIRE_MI_ASYNC_UNSUPPORTED + 1)));
+}
+
+/**
+ * Ensure the cached hashes match the hashes computed by walking the tree.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, hash/cached)
+{
+    const char *line =
+        "*stopped,reason=\"breakpoint-hit\",frame={addr=\"0x1\","
+        "args=[{name=\"argc\",value=\"1\"}]},thread-id=\"1\"\n";
+    gdbwire_mi_output *output;
+    gdbwire_mi_result *plain, *hashed;
+
+    REQUIRE(gdbwire_mi_parser_push(parser, line) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_hashes(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, line) == GDBWIRE_OK);
+
+    output = parserCallback.m_output;
+    REQUIRE(output);
+    REQUIRE(output->next);
+    plain = output->variant.oob_record->variant.async_record->result;
+    hashed = output->next->variant.oob_record->variant.async_record->result;
+
+    REQUIRE(plain->hash == 0);
+    REQUIRE(hashed->hash != 0);
+    REQUIRE(hashed->next->variant.result->next->variant.result->hash != 0);
+    REQUIRE(gdbwire_mi_result_hash(plain) == gdbwire_mi_result_hash(hashed));
+    REQUIRE(gdbwire_mi_result_equal(plain, hashed) == 1);
+
+    /* Hashing a tree after the fact gives the same hashes */
+    gdbwire_mi_result_cache_hashes(plain);
+    REQUIRE(plain->hash == hashed->hash);
+    REQUIRE(plain->next->hash == hashed->next->hash);
+
+    /* The trees are built on the second stage of a pipelined parser */
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_set_hashes(parser, 0) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_mi_parser_set_pipelined(parser, 0) == GDBWIRE_OK);
+}
+
+namespace {
+    /* Ensure a clone matches the output it was cloned from */
+    void require_clone(const gdbwire_mi_output *output,
+        const gdbwire_mi_output *clone) {
+        const gdbwire_mi_oob_record *oob, *oob_clone;
+        const gdbwire_mi_result_record *record, *record_clone;
+
+        REQUIRE(clone);
+        REQUIRE(clone != output);
+        REQUIRE(!clone->next);
+        REQUIRE(clone->kind == output->kind);
+        REQUIRE(clone->line != output->line);
+        REQUIRE(std::string(clone->line) == output->line);
+
+        switch (output->kind) {
+            case GDBWIRE_MI_OUTPUT_OOB:
+                oob = output->variant.oob_record;
+                oob_clone = clone->variant.oob_record;
+                REQUIRE(oob_clone != oob);
+                REQUIRE(oob_clone->kind == oob->kind);
+                if (oob->kind == GDBWIRE_MI_ASYNC) {
+                    REQUIRE(oob_clone->variant.async_record->async_class ==
+                        oob->variant.async_record->async_class);
+                    REQUIRE(gdbwire_mi_result_equal(
+                        oob_clone->variant.async_record->result,
+                        oob->variant.async_record->result) == 1);
+                } else {
+                    REQUIRE(std::string(
+                        oob_clone->variant.stream_record->cstring) ==
+                        oob->variant.stream_record->cstring);
+                }
+                break;
+            case GDBWIRE_MI_OUTPUT_RESULT:
+                record = output->variant.result_record;
+                record_clone = clone->variant.result_record;
+                REQUIRE(record_clone != record);
+                REQUIRE(record_clone->result_class == record->result_class);
+                REQUIRE(std::string(record_clone->token ?
+                    record_clone->token : "") ==
+                    (record->token ? record->token : ""));
+                if (record->result) {
+                    REQUIRE(record_clone->result != record->result);
+                }
+                REQUIRE(gdbwire_mi_result_equal(record_clone->result,
+                    record->result) == 1);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * Ensure a clone copies the whole parse tree and outlives the parser.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, clone/outlives_parser)
+{
+    const char *lines =
+        "12^done,stack=[frame={level=\"0\",addr=\"0x1\",args=[]},"
+            "frame={level=\"1\",addr=\"0x2\"}]\n"
+        "*stopped,reason=\"exited\",exit-code=\"01\"\n"
+        "~\"hello\\n\"\n"
+        "(gdb)\n"
+        "^done,bad\n";
+    std::vector<gdbwire_mi_output *> clones;
+    gdbwire_mi_output *output;
+    size_t index;
+
+    REQUIRE(gdbwire_mi_parser_set_hashes(parser, 1) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser, lines) == GDBWIRE_OK);
+    for (output = parserCallback.m_output; output; output = output->next) {
+        clones.push_back(gdbwire_mi_output_clone(output));
+        require_clone(output, clones.back());
+    }
+    REQUIRE(clones.size() == 5);
+    REQUIRE(clones[4]->kind == GDBWIRE_MI_OUTPUT_PARSE_ERROR);
+    REQUIRE(clones[4]->variant.error.token !=
+        parserCallback.m_output->next->next->next->next->variant.error.token);
+
+    /* The hashes are kept, the clones need no parser */
+    REQUIRE(clones[0]->variant.result_record->result->hash ==
+        parserCallback.m_output->variant.result_record->result->hash);
+    parserCallback.clear();
+    gdbwire_mi_parser_destroy(parser);
+    parser = gdbwire_mi_parser_create(parserCallback.callbacks);
+    REQUIRE(parser);
+
+    REQUIRE(std::string(clones[0]->variant.result_record->token) == "12");
+    REQUIRE(std::string(clones[0]->variant.result_record->result->variant.
+        result->next->variant.result->next->variant.cstring) == "0x2");
+    REQUIRE(std::string(clones[2]->variant.oob_record->variant.
+        stream_record->cstring) == "hello\n");
+
+    /* A clone of a clone is a clone too */
+    output = gdbwire_mi_output_clone(clones[1]);
+    require_clone(clones[1], output);
+    REQUIRE(gdbwire_mi_output_retain(output) == output);
+    gdbwire_mi_output_release(output);
+    gdbwire_mi_output_free(output);
+
+    for (index = 0; index < clones.size(); ++index) {
+        gdbwire_mi_output_free(clones[index]);
+    }
+    REQUIRE(gdbwire_mi_output_clone(NULL) == NULL);
+}
+
+/**
+ * Ensure a clone of an output that shares a cached tree is its own.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, clone/shared)
+{
+    gdbwire_mi_output *clone;
+
+    REQUIRE(gdbwire_mi_parser_set_cache(parser, 4) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_push(parser,
+        "=thread-created,id=\"1\"\n=thread-created,id=\"1\"\n") ==
+        GDBWIRE_OK);
+    REQUIRE(parserCallback.m_output);
+    REQUIRE(parserCallback.m_output->next);
+
+    clone = gdbwire_mi_output_clone(parserCallback.m_output->next);
+    require_clone(parserCallback.m_output->next, clone);
+
+    /* Nothing of the clone is left once the parser and its cache are */
+    parserCallback.clear();
+    gdbwire_mi_parser_destroy(parser);
+    parser = gdbwire_mi_parser_create(parserCallback.callbacks);
+    REQUIRE(parser);
+    REQUIRE(std::string(clone->variant.oob_record->variant.async_record->
+        result->variant.cstring) == "1");
+    gdbwire_mi_output_free(clone);
+}
+
+/**
+ * Ensure a clone fits in a buffer of the size it asks for.
+ */
+TEST_CASE_METHOD_N(GdbwireMiParserTest, clone/into_buffer)
+{
+    std::vector<uint64_t> buffer;
+    gdbwire_mi_output *clone;
+    size_t needed = 0, size;
+
+    REQUIRE(gdbwire_mi_parser_push(parser,
+        "^done,value=\"42\",frame={func=\"main\"}\n") == GDBWIRE_OK);
+    REQUIRE(parserCallback.m_output);
+
+    REQUIRE(!gdbwire_mi_output_clone_into(parserCallback.m_output, NULL, 0,
+        &needed));
+    REQUIRE(needed > 0);
+
+    buffer.resize(needed / sizeof(uint64_t) + 1);
+    size = buffer.size() * sizeof(uint64_t);
+    REQUIRE(!gdbwire_mi_output_clone_into(parserCallback.m_output,
+        &buffer[0], needed - 1, 0));
+
+    clone = gdbwire_mi_output_clone_into(parserCallback.m_output,
+        &buffer[0], size, &needed);
+    require_clone(parserCallback.m_output, clone);
+    REQUIRE((char *)clone >= (char *)&buffer[0]);
+    REQUIRE((char *)clone < (char *)&buffer[0] + needed);
+    parserCallback.clear();
+
+    /* The clone is the caller's memory, freeing it does nothing */
+    REQUIRE(std::string(clone->variant.result_record->result->next->
+        variant.result->variable) == "func");
+    REQUIRE(gdbwire_mi_output_retain(clone) == clone);
+    gdbwire_mi_output_release(clone);
+    gdbwire_mi_output_free(clone);
+}
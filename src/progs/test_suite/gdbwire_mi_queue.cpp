@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_mi_queue.h"
+
+namespace {
+    struct GdbwireMiQueueTest : public Fixture {
+        GdbwireMiQueueTest() {
+            queue = gdbwire_mi_queue_create(2);
+            REQUIRE(queue);
+        }
+
+        ~GdbwireMiQueueTest() {
+            gdbwire_mi_queue_destroy(queue);
+        }
+
+        /**
+         * Determine if the queue's file descriptor is readable.
+         *
+         * @param timeout
+         * The number of milliseconds to wait for it.
+         */
+        bool readable(int timeout) {
+            struct pollfd fd;
+            fd.fd = gdbwire_mi_queue_get_fd(queue);
+            fd.events = POLLIN;
+            fd.revents = 0;
+            return poll(&fd, 1, timeout) == 1 && (fd.revents & POLLIN);
+        }
+
+        gdbwire_mi_queue *queue;
+    };
+
+    /* The number of lines pushed in threads/order */
+    const int THREAD_LINES = 20000;
+
+    void *produce(void *data) {
+        gdbwire_mi_queue *queue = (gdbwire_mi_queue *)data;
+        std::string lines;
+        size_t index, size;
+        char line[32];
+        int count;
+
+        for (count = 0; count < THREAD_LINES; ++count) {
+            snprintf(line, sizeof(line), "%d^done\n", count);
+            lines += line;
+        }
+
+        /* Push in uneven chunks, splitting lines between pushes */
+        for (index = 0; index < lines.size(); index += size) {
+            size = 1 + (index * 7) % 61;
+            if (size > lines.size() - index) {
+                size = lines.size() - index;
+            }
+            gdbwire_mi_queue_push_data(queue, lines.data() + index, size);
+        }
+
+        return NULL;
+    }
+
+    void *produce_one(void *data) {
+        gdbwire_mi_queue *queue = (gdbwire_mi_queue *)data;
+        gdbwire_mi_queue_push_data(queue, "3^done\n", 7);
+        return NULL;
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireMiQueueTest, destroy/null_instance)
+{
+    gdbwire_mi_queue_destroy(NULL);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiQueueTest, pop/empty)
+{
+    REQUIRE(!gdbwire_mi_queue_pop(queue));
+    REQUIRE(!readable(0));
+}
+
+TEST_CASE_METHOD_N(GdbwireMiQueueTest, pop/batch)
+{
+    gdbwire_mi_output *batch;
+
+    /* An incomplete line queues nothing */
+    REQUIRE(gdbwire_mi_queue_push_data(queue, "^do", 3) == GDBWIRE_OK);
+    REQUIRE(!readable(0));
+    REQUIRE(!gdbwire_mi_queue_pop(queue));
+
+    /* The lines completed by a push are a batch */
+    REQUIRE(gdbwire_mi_queue_push_data(queue, "ne\n(gdb)\n", 9) ==
+        GDBWIRE_OK);
+    REQUIRE(readable(0));
+    batch = gdbwire_mi_queue_pop(queue);
+    REQUIRE(batch);
+    REQUIRE(batch->kind == GDBWIRE_MI_OUTPUT_RESULT);
+    REQUIRE(batch->next);
+    REQUIRE(batch->next->kind == GDBWIRE_MI_OUTPUT_PROMPT);
+    REQUIRE(!batch->next->next);
+
+    /* Finding the queue empty clears the signal */
+    REQUIRE(!gdbwire_mi_queue_pop(queue));
+    REQUIRE(!readable(0));
+
+    gdbwire_mi_queue_release(queue, batch);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiQueueTest, release/reclaim)
+{
+    gdbwire_mi_parser *parser = gdbwire_mi_queue_get_parser(queue);
+    gdbwire_mi_parser_stats stats;
+    gdbwire_mi_output *batch;
+
+    REQUIRE(gdbwire_mi_queue_push_data(queue, "^done\n", 6) == GDBWIRE_OK);
+    batch = gdbwire_mi_queue_pop(queue);
+    REQUIRE(batch);
+    gdbwire_mi_queue_release(queue, batch);
+
+    /* The producer reclaims the released outputs on its next push */
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes > 0);
+    REQUIRE(gdbwire_mi_queue_push_data(queue, "(gd", 3) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_parser_get_stats(parser, &stats) == GDBWIRE_OK);
+    REQUIRE(stats.tree_bytes == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiQueueTest, destroy/pending)
+{
+    gdbwire_mi_output *batch;
+
+    /* The queued and released outputs are freed with the queue */
+    REQUIRE(gdbwire_mi_queue_push_data(queue, "^done\n", 6) == GDBWIRE_OK);
+    batch = gdbwire_mi_queue_pop(queue);
+    REQUIRE(gdbwire_mi_queue_push_data(queue, "(gdb)\n", 6) == GDBWIRE_OK);
+    gdbwire_mi_queue_release(queue, batch);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiQueueTest, push/full)
+{
+    gdbwire_mi_output *batch;
+    pthread_t producer;
+
+    REQUIRE(gdbwire_mi_queue_push_data(queue, "1^done\n", 7) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_queue_push_data(queue, "2^done\n", 7) == GDBWIRE_OK);
+
+    /* The producer waits for a slot until the consumer pops a batch */
+    REQUIRE(pthread_create(&producer, NULL, produce_one, queue) == 0);
+    usleep(10000);
+    batch = gdbwire_mi_queue_pop(queue);
+    REQUIRE(batch);
+    REQUIRE(std::string(batch->variant.result_record->token) == "1");
+    gdbwire_mi_queue_release(queue, batch);
+    pthread_join(producer, NULL);
+
+    batch = gdbwire_mi_queue_pop(queue);
+    REQUIRE(batch);
+    REQUIRE(std::string(batch->variant.result_record->token) == "2");
+    gdbwire_mi_queue_release(queue, batch);
+    batch = gdbwire_mi_queue_pop(queue);
+    REQUIRE(batch);
+    REQUIRE(std::string(batch->variant.result_record->token) == "3");
+    gdbwire_mi_queue_release(queue, batch);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiQueueTest, threads/order)
+{
+    gdbwire_mi_output *batch, *output;
+    pthread_t producer;
+    int count = 0;
+
+    REQUIRE(pthread_create(&producer, NULL, produce, queue) == 0);
+
+    /* Each line arrives once, in order, through a queue of 2 batches */
+    while (count < THREAD_LINES) {
+        batch = gdbwire_mi_queue_pop(queue);
+        if (!batch) {
+            readable(100);
+            continue;
+        }
+        for (output = batch; output; output = output->next) {
+            REQUIRE(output->kind == GDBWIRE_MI_OUTPUT_RESULT);
+            REQUIRE(atoi(output->variant.result_record->token) == count);
+            ++count;
+        }
+        gdbwire_mi_queue_release(queue, batch);
+    }
+
+    pthread_join(producer, NULL);
+    REQUIRE(!gdbwire_mi_queue_pop(queue));
+}
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_mi_writer.h"
+#include "gdbwire_mi_parser.h"
+
+namespace {
+    struct GdbwireMiWriterTest : public MiParserFixture {
+        GdbwireMiWriterTest() {
+            writer = gdbwire_mi_writer_create();
+            REQUIRE(writer);
+            encoder = gdbwire_mi_binary_encoder_create();
+            REQUIRE(encoder);
+        }
+
+        ~GdbwireMiWriterTest() {
+            gdbwire_mi_binary_encoder_destroy(encoder);
+            gdbwire_mi_writer_destroy(writer);
+        }
+
+        std::string get_file_contents(const std::string &path) {
+            std::string result;
+            FILE *fd;
+            int c;
+
+            fd = fopen(path.c_str(), "r");
+            REQUIRE(fd);
+
+            while ((c = fgetc(fd)) != EOF) {
+                result.push_back((char)c);
+            }
+            fclose(fd);
+
+            return result;
+        }
+
+        /**
+         * Parse data, taking ownership of the outputs parsed.
+         *
+         * @return
+         * The outputs parsed, to be freed by the caller.
+         */
+        gdbwire_mi_output *parse_owned(const std::string &data) {
+            parse(data);
+            return takeOutputs();
+        }
+
+        /* The lines written since the buffer was last cleared */
+        std::string written() {
+            const char *data;
+            size_t size;
+
+            gdbwire_mi_writer_get_data(writer, &data, &size);
+            REQUIRE(data[size] == 0);
+            return std::string(data, size);
+        }
+
+        /* Parse a single line and write it again */
+        std::string rewrite(const std::string &line, const char *token = 0,
+            bool with_token = false) {
+            gdbwire_mi_output *output = parse_owned(line);
+            std::string result;
+
+            REQUIRE(output);
+            REQUIRE(!output->next);
+            gdbwire_mi_writer_clear(writer);
+            if (with_token) {
+                REQUIRE(gdbwire_mi_writer_write_with_token(writer, output,
+                    token) == GDBWIRE_OK);
+            } else {
+                REQUIRE(gdbwire_mi_writer_write(writer, output) == GDBWIRE_OK);
+            }
+            result = written();
+            gdbwire_mi_output_free(output);
+            return result;
+        }
+
+        /* Write an output from its binary encoding */
+        std::string write_binary(gdbwire_mi_output *output) {
+            gdbwire_mi_binary_output view;
+            const void *data;
+            size_t size;
+
+            REQUIRE(gdbwire_mi_binary_encode(encoder, output, &data, &size) ==
+                GDBWIRE_OK);
+            REQUIRE(gdbwire_mi_binary_read(data, size, &view) == GDBWIRE_OK);
+            gdbwire_mi_writer_clear(writer);
+            REQUIRE(gdbwire_mi_writer_write_binary(writer, &view) ==
+                GDBWIRE_OK);
+            return written();
+        }
+
+        /**
+         * The line an output was parsed from, written the way GDB writes it.
+         *
+         * The lines of the MI files of the test suite only differ from the
+         * way GDB writes them in the blanks between tokens and in the
+         * prompt, written without its trailing space. A parse error is
+         * written as its line.
+         */
+        std::string canonical(gdbwire_mi_output *output) {
+            std::string line(output->line), result;
+            bool quoted = false;
+            size_t index;
+
+            if (output->kind == GDBWIRE_MI_OUTPUT_PROMPT) {
+                return "(gdb) \n";
+            } else if (output->kind == GDBWIRE_MI_OUTPUT_PARSE_ERROR) {
+                return line;
+            }
+
+            for (index = 0; index < line.size(); ++index) {
+                if (quoted && line[index] == '\\') {
+                    result.push_back(line[index++]);
+                } else if (line[index] == '"') {
+                    quoted = !quoted;
+                } else if (!quoted && (line[index] == ' ' || line[index] == '\t')) {
+                    continue;
+                }
+                result.push_back(line[index]);
+            }
+            return result;
+        }
+
+        /* Check two outputs have the same record, ignoring their lines */
+        void require_same(gdbwire_mi_output *lhs, gdbwire_mi_output *rhs) {
+            REQUIRE(lhs->kind == rhs->kind);
+            if (lhs->kind == GDBWIRE_MI_OUTPUT_RESULT) {
+                gdbwire_mi_result_record *l = lhs->variant.result_record;
+                gdbwire_mi_result_record *r = rhs->variant.result_record;
+                REQUIRE(std::string(l->token ? l->token : "-") ==
+                    std::string(r->token ? r->token : "-"));
+                REQUIRE(l->result_class == r->result_class);
+                REQUIRE(gdbwire_mi_result_equal(l->result, r->result));
+            } else if (lhs->kind == GDBWIRE_MI_OUTPUT_OOB) {
+                gdbwire_mi_oob_record *l = lhs->variant.oob_record;
+                gdbwire_mi_oob_record *r = rhs->variant.oob_record;
+                REQUIRE(l->kind == r->kind);
+                if (l->kind == GDBWIRE_MI_ASYNC) {
+                    gdbwire_mi_async_record *la = l->variant.async_record;
+                    gdbwire_mi_async_record *ra = r->variant.async_record;
+                    REQUIRE(std::string(la->token ? la->token : "-") ==
+                        std::string(ra->token ? ra->token : "-"));
+                    REQUIRE(la->kind == ra->kind);
+                    REQUIRE(la->async_class == ra->async_class);
+                    REQUIRE(gdbwire_mi_result_equal(la->result, ra->result));
+                } else {
+                    REQUIRE(l->variant.stream_record->kind ==
+                        r->variant.stream_record->kind);
+                    REQUIRE(std::string(l->variant.stream_record->cstring) ==
+                        std::string(r->variant.stream_record->cstring));
+                }
+            }
+        }
+
+        gdbwire_mi_writer *writer;
+        gdbwire_mi_binary_encoder *encoder;
+    };
+}
+
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, destroy/null_instance)
+{
+    gdbwire_mi_writer_destroy(NULL);
+}
+
+/**
+ * Ensure every output of the MI files of the test suite is written as a
+ * line that parses back into the same output, and is written again as
+ * the same line, from its tree or from its binary encoding.
+ */
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, corpus/round_trip)
+{
+    std::vector<std::string> files;
+    gdbwire_mi_output *outputs, *output, *reparsed;
+    std::string line, contents;
+    size_t index, lines = 0;
+
+    findMiFiles(data(), files);
+    REQUIRE(files.size() > 50);
+
+    for (index = 0; index < files.size(); ++index) {
+        outputs = parse_owned(get_file_contents(files[index]));
+        for (output = outputs; output; output = output->next) {
+            INFO(files[index] << ": " << output->line);
+            gdbwire_mi_writer_clear(writer);
+            REQUIRE(gdbwire_mi_writer_write(writer, output) == GDBWIRE_OK);
+            line = written();
+            REQUIRE(write_binary(output) == line);
+
+            reparsed = parse_owned(line);
+            REQUIRE(reparsed);
+            REQUIRE(!reparsed->next);
+            require_same(output, reparsed);
+
+            gdbwire_mi_writer_clear(writer);
+            REQUIRE(gdbwire_mi_writer_write(writer, reparsed) == GDBWIRE_OK);
+            REQUIRE(written() == line);
+            gdbwire_mi_output_free(reparsed);
+
+            REQUIRE(line == canonical(output));
+            ++lines;
+        }
+        gdbwire_mi_output_free(outputs);
+    }
+
+    REQUIRE(lines > files.size());
+}
+
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, records/kinds)
+{
+    REQUIRE(rewrite("12^done,value=\"1\"\n") == "12^done,value=\"1\"\n");
+    REQUIRE(rewrite("^running\r\n") == "^running\n");
+    REQUIRE(rewrite("*stopped, reason = \"exited\"\n") ==
+        "*stopped,reason=\"exited\"\n");
+    REQUIRE(rewrite("+download,{section=\".text\"}\n") ==
+        "+download,{section=\".text\"}\n");
+    REQUIRE(rewrite("=thread-group-added,id=\"i1\"\n") ==
+        "=thread-group-added,id=\"i1\"\n");
+    REQUIRE(rewrite("~\"text\"\n") == "~\"text\"\n");
+    REQUIRE(rewrite("@\"text\"\n") == "@\"text\"\n");
+    REQUIRE(rewrite("&\"text\"\n") == "&\"text\"\n");
+    REQUIRE(rewrite("(gdb)\n") == "(gdb) \n");
+    REQUIRE(rewrite("^done,a=[],b={},c=[\"1\",d={}]\n") ==
+        "^done,a=[],b={},c=[\"1\",d={}]\n");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, records/unsupported_class)
+{
+    gdbwire_mi_output *output = parse_owned("3=new-ui-created , id=\"2\"\n");
+    char *line;
+
+    /* The name of the class is taken from the line */
+    REQUIRE(output);
+    REQUIRE(gdbwire_mi_writer_write(writer, output) == GDBWIRE_OK);
+    REQUIRE(written() == "3=new-ui-created,id=\"2\"\n");
+    REQUIRE(write_binary(output) == "3=new-ui-created,id=\"2\"\n");
+
+    /* Without the line there is no name to write */
+    line = output->line;
+    output->line = 0;
+    gdbwire_mi_writer_clear(writer);
+    REQUIRE(gdbwire_mi_writer_write(writer, output) == GDBWIRE_LOGIC);
+    REQUIRE(written() == "");
+    output->line = line;
+    gdbwire_mi_output_free(output);
+
+    REQUIRE(rewrite("^unknown\n") == "^unknown\n");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, tokens/rewrite)
+{
+    gdbwire_mi_output *output;
+
+    REQUIRE(rewrite("12^done\n", "4096", true) == "4096^done\n");
+    REQUIRE(rewrite("12*running,thread-id=\"all\"\n", 0, true) ==
+        "*running,thread-id=\"all\"\n");
+    REQUIRE(rewrite("=library-loaded,id=\"a\"\n", "7", true) ==
+        "7=library-loaded,id=\"a\"\n");
+
+    /* The records without a token are written as they are */
+    REQUIRE(rewrite("~\"text\"\n", "7", true) == "~\"text\"\n");
+    REQUIRE(rewrite("(gdb)\n", "7", true) == "(gdb) \n");
+
+    /* A token that is not made of digits is not written */
+    output = parse_owned("12^done\n");
+    gdbwire_mi_writer_clear(writer);
+    REQUIRE(gdbwire_mi_writer_write(writer, output) == GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_writer_write_with_token(writer, output, "") ==
+        GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_mi_writer_write_with_token(writer, output, "1a") ==
+        GDBWIRE_LOGIC);
+    REQUIRE(written() == "12^done\n");
+    gdbwire_mi_output_free(output);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, tokens/binary)
+{
+    gdbwire_mi_output *output = parse_owned("12^done,a=\"1\"\n");
+    gdbwire_mi_binary_output view;
+    const void *data;
+    size_t size;
+
+    REQUIRE(gdbwire_mi_binary_encode(encoder, output, &data, &size) ==
+        GDBWIRE_OK);
+    REQUIRE(gdbwire_mi_binary_read(data, size, &view) == GDBWIRE_OK);
+
+    view.token = "345";
+    REQUIRE(gdbwire_mi_writer_write_binary(writer, &view) == GDBWIRE_OK);
+    view.token = 0;
+    REQUIRE(gdbwire_mi_writer_write_binary(writer, &view) == GDBWIRE_OK);
+    view.token = "x";
+    REQUIRE(gdbwire_mi_writer_write_binary(writer, &view) == GDBWIRE_LOGIC);
+    REQUIRE(written() == "345^done,a=\"1\"\n^done,a=\"1\"\n");
+    gdbwire_mi_output_free(output);
+}
+
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, strings/escapes)
+{
+    REQUIRE(rewrite("~\"a\\\"b\\\\c\\n\\t\\r\"\n") ==
+        "~\"a\\\"b\\\\c\\n\\t\\r\"\n");
+
+    /* The escapes the parser keeps as they are get their backslash escaped */
+    REQUIRE(rewrite("~\"\\x\"\n") == "~\"\\\\x\"\n");
+    REQUIRE(rewrite("~\"\\\\x\"\n") == "~\"\\\\x\"\n");
+
+    /* Other bytes are written as they are */
+    REQUIRE(rewrite("~\"\x01\x7f\xc3\xa9\"\n") == "~\"\x01\x7f\xc3\xa9\"\n");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, parse_error/line)
+{
+    REQUIRE(rewrite("^done,a=\n") == "^done,a=\n");
+    REQUIRE(rewrite("^done,a={b=\"1\",}\r\n") == "^done,a={b=\"1\",}\r\n");
+}
+
+TEST_CASE_METHOD_N(GdbwireMiWriterTest, buffer/batch)
+{
+    gdbwire_mi_output *outputs = parse_owned("~\"a\"\n^done\n(gdb)\n");
+    gdbwire_mi_output *output;
+    const char *data;
+    size_t size;
+
+    gdbwire_mi_writer_get_data(writer, &data, &size);
+    REQUIRE(std::string(data, size) == "");
+    REQUIRE(data[0] == 0);
+
+    for (output = outputs; output; output = output->next) {
+        REQUIRE(gdbwire_mi_writer_write(writer, output) == GDBWIRE_OK);
+    }
+    REQUIRE(written() == "~\"a\"\n^done\n(gdb) \n");
+
+    gdbwire_mi_writer_clear(writer);
+    REQUIRE(written() == "");
+    REQUIRE(gdbwire_mi_writer_write(writer, outputs) == GDBWIRE_OK);
+    REQUIRE(written() == "~\"a\"\n");
+    gdbwire_mi_output_free(outputs);
+}
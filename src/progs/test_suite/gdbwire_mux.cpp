@@ -0,0 +1,298 @@
+#include <string.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_mux.h"
+
+namespace {
+    struct GdbwireMuxTest : public Fixture {
+        GdbwireMuxTest() {
+            gdbwire_mux_callbacks callbacks = { 0, 0, 0 };
+            callbacks.context = this;
+            callbacks.gdbwire_mux_write_fn = write_callback;
+            callbacks.gdbwire_mux_ready_fn = ready_callback;
+            mux = gdbwire_mux_create(callbacks);
+            REQUIRE(mux);
+            writer = gdbwire_mi_writer_create();
+            REQUIRE(writer);
+        }
+
+        ~GdbwireMuxTest() {
+            gdbwire_mux_destroy(mux);
+            gdbwire_mi_writer_destroy(writer);
+        }
+
+        static void write_callback(void *context, const char *data,
+            size_t size) {
+            GdbwireMuxTest *test = (GdbwireMuxTest *)context;
+            test->m_written.push_back(std::string(data, size));
+        }
+
+        static void ready_callback(void *context, gdbwire_mux_client *client) {
+            GdbwireMuxTest *test = (GdbwireMuxTest *)context;
+            test->m_ready.push_back(client);
+        }
+
+        void push(const std::string &data) {
+            REQUIRE(gdbwire_mux_push_data(mux, data.data(), data.size()) ==
+                GDBWIRE_OK);
+        }
+
+        enum gdbwire_result send(gdbwire_mux_client *client,
+            const std::string &command) {
+            return gdbwire_mux_send(client, command.data(), command.size());
+        }
+
+        /**
+         * Pop the records of a client and write each with the client's
+         * token, the way a proxy hands them to its front end.
+         *
+         * @return
+         * The line of each record.
+         */
+        std::vector<std::string> drain(gdbwire_mux_client *client) {
+            std::vector<std::string> lines;
+            gdbwire_mux_event event;
+            const char *data;
+            size_t size;
+
+            while (gdbwire_mux_client_pop(client, &event)) {
+                gdbwire_mi_writer_clear(writer);
+                REQUIRE(gdbwire_mi_writer_write_with_token(writer,
+                    event.output, event.token) == GDBWIRE_OK);
+                gdbwire_mi_writer_get_data(writer, &data, &size);
+                lines.push_back(std::string(data, size));
+                gdbwire_mi_output_release(event.output);
+            }
+            return lines;
+        }
+
+        gdbwire_mux *mux;
+        gdbwire_mi_writer *writer;
+        std::vector<std::string> m_written;
+        std::vector<gdbwire_mux_client *> m_ready;
+    };
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, destroy/null_instance)
+{
+    gdbwire_mux_destroy(NULL);
+    gdbwire_mux_client_destroy(NULL);
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, create/requires_write)
+{
+    gdbwire_mux_callbacks callbacks = { 0, 0, 0 };
+
+    REQUIRE(!gdbwire_mux_create(callbacks));
+    REQUIRE(!gdbwire_mux_client_create(mux, 0, GDBWIRE_MUX_ALL, 0));
+    REQUIRE(gdbwire_mux_get_gdbwire(mux));
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, send/rewrites_tokens)
+{
+    int a_context, b_context;
+    gdbwire_mux_client *a = gdbwire_mux_client_create(mux, 8, 0, &a_context);
+    gdbwire_mux_client *b = gdbwire_mux_client_create(mux, 8, 0, &b_context);
+    std::vector<std::string> lines;
+
+    REQUIRE(gdbwire_mux_client_get_context(a) == &a_context);
+    REQUIRE(gdbwire_mux_client_get_context(b) == &b_context);
+
+    /* Both clients use the same token */
+    REQUIRE(send(a, "1-exec-next\n") == GDBWIRE_OK);
+    REQUIRE(send(b, "1-break-list") == GDBWIRE_OK);
+    REQUIRE(send(b, "-stack-list-frames\r\n") == GDBWIRE_OK);
+    REQUIRE(send(a, "42info frame\n") == GDBWIRE_OK);
+    REQUIRE(m_written.size() == 4);
+    REQUIRE(m_written[0] == "1-exec-next\n");
+    REQUIRE(m_written[1] == "2-break-list\n");
+    REQUIRE(m_written[2] == "3-stack-list-frames\n");
+    REQUIRE(m_written[3] == "4info frame\n");
+
+    /* Each result goes back to its client, with the client's token */
+    push("2^done,BreakpointTable={}\n3^done,stack=[]\n1^running\n"
+        "4^done\n");
+    lines = drain(a);
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0] == "1^running\n");
+    REQUIRE(lines[1] == "42^done\n");
+    lines = drain(b);
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0] == "1^done,BreakpointTable={}\n");
+    REQUIRE(lines[1] == "^done,stack=[]\n");
+
+    /* A result comes once */
+    push("1^done\n");
+    REQUIRE(drain(a).empty());
+    REQUIRE(drain(b).empty());
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, send/invalid)
+{
+    gdbwire_mux_client *client = gdbwire_mux_client_create(mux, 2, 0, 0);
+
+    REQUIRE(send(client, "") == GDBWIRE_LOGIC);
+    REQUIRE(send(client, "\n") == GDBWIRE_LOGIC);
+    REQUIRE(send(client, "12\n") == GDBWIRE_LOGIC);
+    REQUIRE(send(client, "-exec-next\n-exec-next\n") == GDBWIRE_LOGIC);
+    REQUIRE(send(client, "-exec-next\r-exec-next") == GDBWIRE_LOGIC);
+    REQUIRE(send(client, "123456789012345678901-exec-next") ==
+        GDBWIRE_LOGIC);
+    REQUIRE(m_written.empty());
+
+    /* The client may not have more commands in flight than it can hold */
+    REQUIRE(send(client, "12345678901234567890-exec-next") == GDBWIRE_OK);
+    REQUIRE(send(client, "-exec-next") == GDBWIRE_OK);
+    REQUIRE(send(client, "-exec-next") == GDBWIRE_LOGIC);
+    REQUIRE(m_written.size() == 2);
+
+    push("1^done\n");
+    REQUIRE(send(client, "-exec-next") == GDBWIRE_LOGIC);
+    REQUIRE(drain(client) ==
+        std::vector<std::string>(1, "12345678901234567890^done\n"));
+    REQUIRE(send(client, "-exec-next") == GDBWIRE_OK);
+    REQUIRE(m_written.back() == "3-exec-next\n");
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, fanout/subscriptions)
+{
+    gdbwire_mux_client *all = gdbwire_mux_client_create(mux, 8,
+        GDBWIRE_MUX_ALL, 0);
+    gdbwire_mux_client *streams = gdbwire_mux_client_create(mux, 8,
+        GDBWIRE_MUX_STREAM, 0);
+    gdbwire_mux_client *asyncs = gdbwire_mux_client_create(mux, 8,
+        GDBWIRE_MUX_ASYNC | GDBWIRE_MUX_PROMPT, 0);
+    gdbwire_mux_event all_event, streams_event;
+    std::vector<std::string> lines;
+
+    push("~\"text\"\n=thread-created,id=\"1\"\n(gdb)\n");
+
+    /* The clients share the same output */
+    REQUIRE(gdbwire_mux_client_pop(all, &all_event));
+    REQUIRE(gdbwire_mux_client_pop(streams, &streams_event));
+    REQUIRE(all_event.output == streams_event.output);
+    REQUIRE(!all_event.token);
+    REQUIRE(all_event.dropped == 0);
+    gdbwire_mi_output_release(all_event.output);
+    gdbwire_mi_output_release(streams_event.output);
+
+    lines = drain(all);
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0] == "=thread-created,id=\"1\"\n");
+    REQUIRE(lines[1] == "(gdb) \n");
+    REQUIRE(drain(streams).empty());
+    lines = drain(asyncs);
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0] == "=thread-created,id=\"1\"\n");
+    REQUIRE(lines[1] == "(gdb) \n");
+
+    /* The ready callback is called as each queue stops being empty */
+    REQUIRE(m_ready.size() == 3);
+    push("~\"a\"\n~\"b\"\n");
+    REQUIRE(m_ready.size() == 5);
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, fanout/async_token)
+{
+    gdbwire_mux_client *a = gdbwire_mux_client_create(mux, 8,
+        GDBWIRE_MUX_ASYNC, 0);
+    gdbwire_mux_client *b = gdbwire_mux_client_create(mux, 8,
+        GDBWIRE_MUX_ASYNC, 0);
+    std::vector<std::string> lines;
+
+    REQUIRE(send(a, "9-exec-run") == GDBWIRE_OK);
+
+    /* Only the client that sent the command gets its token */
+    push("1*running,thread-id=\"all\"\n1^running\n1*stopped\n");
+    lines = drain(a);
+    REQUIRE(lines.size() == 3);
+    REQUIRE(lines[0] == "9*running,thread-id=\"all\"\n");
+    REQUIRE(lines[1] == "9^running\n");
+    REQUIRE(lines[2] == "*stopped\n");
+    lines = drain(b);
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0] == "*running,thread-id=\"all\"\n");
+    REQUIRE(lines[1] == "*stopped\n");
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, fanout/other)
+{
+    gdbwire_mux_client *other = gdbwire_mux_client_create(mux, 8,
+        GDBWIRE_MUX_OTHER, 0);
+    gdbwire_mux_client *rest = gdbwire_mux_client_create(mux, 8,
+        GDBWIRE_MUX_ALL & ~GDBWIRE_MUX_OTHER, 0);
+    std::vector<std::string> lines;
+
+    /* Results no client sent keep the token GDB wrote */
+    push("77^done\n^error,msg=\"x\"\n^done,\n");
+    lines = drain(other);
+    REQUIRE(lines.size() == 3);
+    REQUIRE(lines[0] == "77^done\n");
+    REQUIRE(lines[1] == "^error,msg=\"x\"\n");
+    REQUIRE(lines[2] == "^done,\n");
+    REQUIRE(drain(rest).empty());
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, queue/bounded)
+{
+    gdbwire_mux_client *fast = gdbwire_mux_client_create(mux, 8,
+        GDBWIRE_MUX_STREAM, 0);
+    gdbwire_mux_client *slow = gdbwire_mux_client_create(mux, 2,
+        GDBWIRE_MUX_STREAM, 0);
+    std::vector<std::string> lines;
+    gdbwire_mux_event event;
+
+    /* A full queue drops records without holding the others back */
+    push("~\"1\"\n~\"2\"\n~\"3\"\n~\"4\"\n~\"5\"\n");
+    REQUIRE(drain(fast).size() == 5);
+    REQUIRE(drain(slow).size() == 2);
+
+    push("~\"6\"\n");
+    REQUIRE(gdbwire_mux_client_pop(slow, &event));
+    REQUIRE(event.dropped == 3);
+    REQUIRE(std::string(event.output->variant.oob_record->variant.
+        stream_record->cstring) == "6");
+    gdbwire_mi_output_release(event.output);
+    REQUIRE(!gdbwire_mux_client_pop(slow, &event));
+
+    /* The slot of a command in flight is kept for its result */
+    REQUIRE(send(slow, "5-exec-next") == GDBWIRE_OK);
+    push("~\"7\"\n~\"8\"\n1^done\n");
+    lines = drain(slow);
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0] == "~\"7\"\n");
+    REQUIRE(lines[1] == "5^done\n");
+}
+
+TEST_CASE_METHOD_N(GdbwireMuxTest, client/destroy)
+{
+    gdbwire_mux_client *leaving = gdbwire_mux_client_create(mux, 4,
+        GDBWIRE_MUX_ALL, 0);
+    gdbwire_mux_client *staying = gdbwire_mux_client_create(mux, 4,
+        GDBWIRE_MUX_ALL, 0);
+    std::vector<std::string> lines;
+    gdbwire_mux_event event;
+
+    REQUIRE(send(leaving, "-exec-next") == GDBWIRE_OK);
+    REQUIRE(send(staying, "-exec-next") == GDBWIRE_OK);
+    push("~\"a\"\n");
+    REQUIRE(gdbwire_mux_client_pop(leaving, &event));
+
+    /* The queued records are released, the popped ones stay valid */
+    gdbwire_mux_client_destroy(leaving);
+    push("1^done\n2^done\n");
+    REQUIRE(std::string(event.output->variant.oob_record->variant.
+        stream_record->cstring) == "a");
+    gdbwire_mi_output_release(event.output);
+
+    /* The result of the command of the client is dropped */
+    lines = drain(staying);
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0] == "~\"a\"\n");
+    REQUIRE(lines[1] == "^done\n");
+
+    /* The clients left are destroyed with the multiplexer */
+    push("~\"b\"\n");
+}
@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire.h"
+#include "gdbwire_recorder.h"
+
+namespace {
+    struct GdbwireRecorderTest : public Fixture {
+        GdbwireRecorderTest() {
+            log = tmpfile();
+            REQUIRE(log);
+            index = tmpfile();
+            REQUIRE(index);
+            recorder = gdbwire_recorder_create(log, index);
+            REQUIRE(recorder);
+        }
+
+        ~GdbwireRecorderTest() {
+            gdbwire_recorder_destroy(recorder);
+            fclose(index);
+            fclose(log);
+        }
+
+        void push(const std::string &data, size_t chunk = (size_t)-1) {
+            size_t offset, size;
+
+            /* The files are read through the same streams in between */
+            REQUIRE(fseek(log, 0, SEEK_END) == 0);
+            REQUIRE(fseek(index, 0, SEEK_END) == 0);
+            for (offset = 0; offset < data.size(); offset += size) {
+                size = std::min(chunk, data.size() - offset);
+                REQUIRE(gdbwire_recorder_push_data(recorder,
+                    data.data() + offset, size) == GDBWIRE_OK);
+            }
+            REQUIRE(gdbwire_recorder_flush(recorder) == GDBWIRE_OK);
+        }
+
+        /* Read the entries of the index */
+        std::vector<gdbwire_recorder_entry> entries() {
+            std::vector<gdbwire_recorder_entry> result;
+            gdbwire_recorder_entry entry;
+
+            while (gdbwire_recorder_read_entry(index, result.size(),
+                    &entry) == GDBWIRE_OK) {
+                result.push_back(entry);
+            }
+            return result;
+        }
+
+        /* Read the line of an entry from the log */
+        std::string line(const gdbwire_recorder_entry &entry) {
+            std::string result(entry.size, 0);
+
+            REQUIRE(gdbwire_recorder_read_line(log, &entry,
+                &result[0]) == GDBWIRE_OK);
+            return result;
+        }
+
+        /* Replay the log from the start, returning the bytes recorded */
+        std::string replay(std::vector<uint64_t> *times = 0) {
+            std::vector<char> data(GDBWIRE_RECORDER_CHUNK_MAX);
+            std::string result;
+            uint64_t time;
+            size_t size;
+
+            REQUIRE(fseek(log, 0, SEEK_SET) == 0);
+            for (;;) {
+                REQUIRE(gdbwire_recorder_read_chunk(log, &time, &data[0],
+                    &size) == GDBWIRE_OK);
+                if (size == 0) {
+                    break;
+                }
+                result.append(&data[0], size);
+                if (times) {
+                    times->push_back(time);
+                }
+            }
+            return result;
+        }
+
+        FILE *log;
+        FILE *index;
+        gdbwire_recorder *recorder;
+    };
+}
+
+TEST_CASE_METHOD_N(GdbwireRecorderTest, destroy/null_instance)
+{
+    gdbwire_recorder_destroy(NULL);
+}
+
+TEST_CASE_METHOD_N(GdbwireRecorderTest, log/chunks)
+{
+    std::string large(GDBWIRE_RECORDER_CHUNK_MAX * 2 + 10, 'x');
+    std::vector<uint64_t> times;
+    size_t position;
+
+    push("~\"a\"\n");
+    push("^do");
+    push("ne\n");
+    push("");
+    push(large);
+
+    REQUIRE(replay(&times) == "~\"a\"\n^done\n" + large);
+
+    /* A large push is split into chunks with the same time */
+    REQUIRE(times.size() == 6);
+    for (position = 1; position < times.size(); ++position) {
+        REQUIRE(times[position - 1] <= times[position]);
+    }
+    REQUIRE(times[3] == times[5]);
+}
+
+TEST_CASE_METHOD_N(GdbwireRecorderTest, log/invalid)
+{
+    std::vector<char> data(GDBWIRE_RECORDER_CHUNK_MAX);
+    gdbwire_recorder_entry entry;
+    uint64_t time;
+    size_t size;
+
+    push("~\"a\"\n");
+
+    /* The index is not a log and the log is not an index */
+    REQUIRE(fseek(index, 0, SEEK_SET) == 0);
+    REQUIRE(gdbwire_recorder_read_chunk(index, &time, &data[0], &size) ==
+        GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_recorder_read_entry(log, 0, &entry) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_recorder_read_entry(index, 1, &entry) == GDBWIRE_LOGIC);
+
+    /* A chunk cut short */
+    REQUIRE(fseek(log, 0, SEEK_END) == 0);
+    REQUIRE(fwrite("\1\2\3", 3, 1, log) == 1);
+    REQUIRE(fseek(log, GDBWIRE_RECORDER_HEADER_SIZE, SEEK_SET) == 0);
+    REQUIRE(gdbwire_recorder_read_chunk(log, &time, &data[0], &size) ==
+        GDBWIRE_OK);
+    REQUIRE(size == 5);
+    REQUIRE(gdbwire_recorder_read_chunk(log, &time, &data[0], &size) ==
+        GDBWIRE_LOGIC);
+}
+
+TEST_CASE_METHOD_N(GdbwireRecorderTest, index/kinds)
+{
+    std::vector<gdbwire_recorder_entry> lines;
+
+    push("~\"text\"\n@\"target\"\n&\"log\"\n12^done,value=\"1\"\n"
+        "^error,msg=\"x\"\n*stopped,reason=\"exited\"\n"
+        "+download\n7=thread-group-added,id=\"i1\"\n(gdb) \n"
+        "=new-ui-created\n^unknown\nrandom\n3~\"x\"\n"
+        "123456789012345678901^done\n");
+
+    lines = entries();
+    REQUIRE(lines.size() == 14);
+
+    REQUIRE(lines[0].kind == GDBWIRE_RECORDER_STREAM);
+    REQUIRE(lines[0].record_class == GDBWIRE_MI_CONSOLE);
+    REQUIRE(!lines[0].has_token);
+    REQUIRE(lines[1].record_class == GDBWIRE_MI_TARGET);
+    REQUIRE(lines[2].record_class == GDBWIRE_MI_LOG);
+
+    REQUIRE(lines[3].kind == GDBWIRE_RECORDER_RESULT);
+    REQUIRE(lines[3].record_class == GDBWIRE_MI_DONE);
+    REQUIRE(lines[3].has_token);
+    REQUIRE(lines[3].token == 12);
+    REQUIRE(lines[4].record_class == GDBWIRE_MI_ERROR);
+    REQUIRE(!lines[4].has_token);
+
+    REQUIRE(lines[5].kind == GDBWIRE_RECORDER_ASYNC);
+    REQUIRE(lines[5].record_class == GDBWIRE_MI_ASYNC_STOPPED);
+    REQUIRE(lines[6].record_class == GDBWIRE_MI_ASYNC_DOWNLOAD);
+    REQUIRE(lines[7].record_class == GDBWIRE_MI_ASYNC_THREAD_GROUP_ADDED);
+    REQUIRE(lines[7].token == 7);
+
+    REQUIRE(lines[8].kind == GDBWIRE_RECORDER_PROMPT);
+    REQUIRE(lines[9].kind == GDBWIRE_RECORDER_ASYNC);
+    REQUIRE(lines[9].record_class == GDBWIRE_MI_ASYNC_UNSUPPORTED);
+    REQUIRE(lines[10].kind == GDBWIRE_RECORDER_RESULT);
+    REQUIRE(lines[10].record_class == GDBWIRE_MI_UNSUPPORTED);
+    REQUIRE(lines[11].kind == GDBWIRE_RECORDER_OTHER);
+    REQUIRE(lines[12].kind == GDBWIRE_RECORDER_OTHER);
+
+    /* A token too large for 64 bits is not indexed */
+    REQUIRE(lines[13].kind == GDBWIRE_RECORDER_RESULT);
+    REQUIRE(!lines[13].has_token);
+
+    REQUIRE(line(lines[0]) == "~\"text\"");
+    REQUIRE(line(lines[7]) == "7=thread-group-added,id=\"i1\"");
+    REQUIRE(line(lines[8]) == "(gdb) ");
+}
+
+TEST_CASE_METHOD_N(GdbwireRecorderTest, index/split_lines)
+{
+    const std::string data = "~\"a\"\r\n\n\n^done\r(gdb)\n"
+        "*stopped,reason=\"breakpoint-hit\",frame={func=\"main\"}\n";
+    std::vector<gdbwire_recorder_entry> lines;
+
+    /* Lines across chunks, and empty lines, pushed a byte at a time */
+    push(data, 1);
+    lines = entries();
+    REQUIRE(lines.size() == 4);
+    REQUIRE(line(lines[0]) == "~\"a\"");
+    REQUIRE(line(lines[1]) == "^done");
+    REQUIRE(lines[1].record_class == GDBWIRE_MI_DONE);
+    REQUIRE(line(lines[2]) == "(gdb)");
+    REQUIRE(lines[2].kind == GDBWIRE_RECORDER_PROMPT);
+    REQUIRE(line(lines[3]) ==
+        "*stopped,reason=\"breakpoint-hit\",frame={func=\"main\"}");
+    REQUIRE(lines[3].record_class == GDBWIRE_MI_ASYNC_STOPPED);
+
+    /* A line that has not ended is not indexed */
+    push("~\"b\"");
+    REQUIRE(entries().size() == 4);
+    REQUIRE(replay() == data + "~\"b\"");
+}
+
+TEST_CASE_METHOD_N(GdbwireRecorderTest, index/long_line)
+{
+    std::string name(100, 'a');
+    std::vector<gdbwire_recorder_entry> lines;
+
+    /* A class name longer than the start kept is unknown */
+    push("*stopped" + name + "\n^done," + name + "=\"1\"\n");
+    lines = entries();
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0].record_class == GDBWIRE_MI_ASYNC_UNSUPPORTED);
+    REQUIRE(lines[1].record_class == GDBWIRE_MI_DONE);
+    REQUIRE(line(lines[1]) == "^done," + name + "=\"1\"");
+}
+
+TEST_CASE_METHOD_N(GdbwireRecorderTest, find/nth)
+{
+    std::vector<char> data(GDBWIRE_RECORDER_CHUNK_MAX);
+    gdbwire_recorder_entry entry;
+    uint64_t token = 5, time;
+    std::string session;
+    size_t count, size;
+    char number[32];
+
+    for (count = 0; count < 200; ++count) {
+        snprintf(number, sizeof (number), "%d", (int)count);
+        session += "~\"step\"\n" + std::string(number) + "^running\n"
+            "*stopped,n=\"" + number + "\"\n(gdb)\n";
+    }
+    push(session, 4096);
+
+    REQUIRE(gdbwire_recorder_find(index, GDBWIRE_RECORDER_ASYNC,
+        GDBWIRE_MI_ASYNC_STOPPED, NULL, 150, &entry) == GDBWIRE_OK);
+    REQUIRE(line(entry) == "*stopped,n=\"150\"");
+
+    REQUIRE(gdbwire_recorder_find(index, -1, -1, &token, 0, &entry) ==
+        GDBWIRE_OK);
+    REQUIRE(line(entry) == "5^running");
+    REQUIRE(gdbwire_recorder_find(index, GDBWIRE_RECORDER_PROMPT, -1, NULL,
+        199, &entry) == GDBWIRE_OK);
+    REQUIRE(gdbwire_recorder_find(index, GDBWIRE_RECORDER_PROMPT, -1, NULL,
+        200, &entry) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_recorder_find(index, GDBWIRE_RECORDER_RESULT,
+        GDBWIRE_MI_DONE, NULL, 0, &entry) == GDBWIRE_LOGIC);
+
+    /* Replay from the chunk of a line onwards */
+    REQUIRE(gdbwire_recorder_find(index, GDBWIRE_RECORDER_ASYNC,
+        GDBWIRE_MI_ASYNC_STOPPED, NULL, 100, &entry) == GDBWIRE_OK);
+    REQUIRE(fseek(log, (long)entry.chunk_offset, SEEK_SET) == 0);
+    REQUIRE(gdbwire_recorder_read_chunk(log, &time, &data[0], &size) ==
+        GDBWIRE_OK);
+    REQUIRE(size > entry.offset);
+    REQUIRE(std::string(&data[entry.offset], size - entry.offset) ==
+        session.substr(session.find("*stopped,n=\"100\""),
+            size - entry.offset));
+    REQUIRE(time <= entry.time);
+}
+
+TEST_CASE_METHOD_N(GdbwireRecorderTest, gdbwire/set_recorder)
+{
+    gdbwire_callbacks callbacks = {};
+    gdbwire *wire = gdbwire_create(callbacks);
+    std::vector<gdbwire_recorder_entry> lines;
+    const std::string data = "^done\n(gdb)\n";
+
+    REQUIRE(wire);
+    REQUIRE(gdbwire_set_recorder(wire, recorder) == GDBWIRE_OK);
+    REQUIRE(gdbwire_push_data(wire, data.data(), data.size()) == GDBWIRE_OK);
+    REQUIRE(gdbwire_set_recorder(wire, NULL) == GDBWIRE_OK);
+    REQUIRE(gdbwire_push_data(wire, data.data(), data.size()) == GDBWIRE_OK);
+    gdbwire_destroy(wire);
+
+    REQUIRE(gdbwire_recorder_flush(recorder) == GDBWIRE_OK);
+    REQUIRE(replay() == data);
+    lines = entries();
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0].kind == GDBWIRE_RECORDER_RESULT);
+    REQUIRE(lines[1].kind == GDBWIRE_RECORDER_PROMPT);
+}
@@ -229,6 +229,48 @@ TEST_CASE_METHOD_N(GdbwireStringTest, capacity)
     }
 }
 
+TEST_CASE_METHOD_N(GdbwireStringTest, capacity_for/standard)
+{
+    REQUIRE(gdbwire_string_append_cstr(string, "abc") == 0);
+    REQUIRE(gdbwire_string_capacity_for(string, 4097) == 8192);
+    REQUIRE(gdbwire_string_capacity_for(string, 20000) == 20480);
+
+    // The capacity is unchanged while the data fits
+    REQUIRE(gdbwire_string_capacity_for(string, 0) == 128);
+    REQUIRE(gdbwire_string_capacity_for(string, 128) == 128);
+    REQUIRE(gdbwire_string_capacity_for(string, 129) == 256);
+    REQUIRE(gdbwire_string_capacity(string) == 128);
+}
+
+TEST_CASE_METHOD_N(GdbwireStringTest, shrink/null_instance)
+{
+    REQUIRE(gdbwire_string_shrink(NULL) == -1);
+}
+
+TEST_CASE_METHOD_N(GdbwireStringTest, shrink/standard)
+{
+    std::string longstr(20000, 'a');
+    REQUIRE(gdbwire_string_append_cstr(string, longstr.c_str()) == 0);
+    validate(string, 20000, 20480, longstr);
+
+    // The capacity follows the growth sequence, leaving room for the NUL
+    REQUIRE(gdbwire_string_erase(string, 5000, 15000) == 0);
+    REQUIRE(gdbwire_string_shrink(string) == 0);
+    validate(string, 5000, 8192, longstr.substr(0, 5000));
+
+    REQUIRE(gdbwire_string_erase(string, 255, 4745) == 0);
+    REQUIRE(gdbwire_string_shrink(string) == 0);
+    validate(string, 255, 256, longstr.substr(0, 255));
+
+    gdbwire_string_clear(string);
+    REQUIRE(gdbwire_string_shrink(string) == 0);
+    validate(string, 0, 128, "");
+
+    // The string grows again after shrinking
+    REQUIRE(gdbwire_string_append_cstr(string, longstr.c_str()) == 0);
+    validate(string, 20000, 20480, longstr);
+}
+
 TEST_CASE_METHOD_N(GdbwireStringTest, find_first_of/null_instance)
 {
     REQUIRE(gdbwire_string_find_first_of(NULL, NULL) == (size_t)0);
@@ -373,3 +415,17 @@ TEST_CASE_METHOD_N(GdbwireStringTest, erase/standard)
         }
     }
 }
+
+TEST_CASE_METHOD_N(GdbwireStringTest, fnv1a/known_values)
+{
+    REQUIRE(gdbwire_fnv1a(GDBWIRE_FNV1A_BASIS, "", 0) ==
+        GDBWIRE_FNV1A_BASIS);
+    REQUIRE(gdbwire_fnv1a(GDBWIRE_FNV1A_BASIS, "a", 1) ==
+        0xaf63dc4c8601ec8cULL);
+    REQUIRE(gdbwire_fnv1a(GDBWIRE_FNV1A_BASIS, "foobar", 6) ==
+        0x85944171f73967e8ULL);
+
+    /* Hashing in pieces is the same as hashing at once */
+    REQUIRE(gdbwire_fnv1a(gdbwire_fnv1a(GDBWIRE_FNV1A_BASIS, "foo", 3),
+        "bar", 3) == 0x85944171f73967e8ULL);
+}
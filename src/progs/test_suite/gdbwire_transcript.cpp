@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "catch.hpp"
+#include "fixture.h"
+#include "gdbwire_recorder.h"
+#include "gdbwire_transcript.h"
+
+namespace {
+    struct GdbwireTranscriptTest : public Fixture {
+        GdbwireTranscriptTest() : reader(0) {
+            file = tmpfile();
+            REQUIRE(file);
+            writer = gdbwire_transcript_writer_create(file, 256);
+            REQUIRE(writer);
+        }
+
+        ~GdbwireTranscriptTest() {
+            gdbwire_transcript_reader_destroy(reader);
+            gdbwire_transcript_writer_destroy(writer);
+            fclose(file);
+        }
+
+        /* A line of output, different for each number */
+        static std::string line(size_t number) {
+            char data[128];
+
+            snprintf(data, sizeof (data), "*stopped,reason=\"end-stepping-"
+                "range\",frame={func=\"main\",line=\"%lu\"}\n",
+                (unsigned long)number);
+            return data;
+        }
+
+        /* Push the data in chunks of the given size, at the given time */
+        void push(const std::string &data, uint64_t time, size_t chunk) {
+            for (size_t offset = 0; offset < data.size(); offset += chunk) {
+                size_t size = std::min(chunk, data.size() - offset);
+                REQUIRE(gdbwire_transcript_writer_push_data_at(writer, time,
+                    data.data() + offset, size) == GDBWIRE_OK);
+            }
+        }
+
+        void finish() {
+            REQUIRE(gdbwire_transcript_writer_finish(writer) == GDBWIRE_OK);
+            open();
+        }
+
+        void open() {
+            reader = gdbwire_transcript_reader_create(file);
+            REQUIRE(reader);
+        }
+
+        /* Decode a block, appending its lines and times */
+        void decode(size_t index, std::string &lines,
+                std::vector<uint64_t> &times) {
+            gdbwire_transcript_block block;
+
+            REQUIRE(gdbwire_transcript_reader_block(reader, index,
+                &block) == GDBWIRE_OK);
+            std::vector<char> data(block.size);
+            std::vector<uint64_t> block_times(block.lines);
+            REQUIRE(gdbwire_transcript_reader_decode(reader, index,
+                &data[0], &block_times[0]) == GDBWIRE_OK);
+            lines.append(&data[0], data.size());
+            times.insert(times.end(), block_times.begin(), block_times.end());
+        }
+
+        /* Decode the whole transcript */
+        std::string decode_all(std::vector<uint64_t> &times) {
+            std::string result;
+            size_t index;
+
+            for (index = 0; index < gdbwire_transcript_reader_count(reader);
+                    ++index) {
+                decode(index, result, times);
+            }
+            return result;
+        }
+
+        /* Read the whole file */
+        std::string contents() {
+            std::string result;
+            char data[4096];
+            size_t size;
+
+            REQUIRE(fseek(file, 0, SEEK_SET) == 0);
+            while ((size = fread(data, 1, sizeof (data), file)) > 0) {
+                result.append(data, size);
+            }
+            return result;
+        }
+
+        /* Replace the file with the given bytes, closing the writer first */
+        void replace(const std::string &data) {
+            gdbwire_transcript_reader_destroy(reader);
+            reader = 0;
+            gdbwire_transcript_writer_destroy(writer);
+            writer = 0;
+            fclose(file);
+            file = tmpfile();
+            REQUIRE(file);
+            REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+            REQUIRE(fflush(file) == 0);
+        }
+
+        FILE *file;
+        gdbwire_transcript_writer *writer;
+        gdbwire_transcript_reader *reader;
+    };
+
+    /* The blocks decoded in parallel, each by its number */
+    struct GdbwireTranscriptDecoded {
+        std::vector<std::string> lines;
+        std::vector<size_t> workers;
+    };
+
+    void decoded_callback(void *context, size_t worker, size_t index,
+            const gdbwire_transcript_block *block, const char *lines,
+            const uint64_t *times) {
+        GdbwireTranscriptDecoded *decoded =
+            (GdbwireTranscriptDecoded *)context;
+
+        /* Each block is written by one worker, to its own slot */
+        decoded->lines[index].assign(lines, block->size);
+        decoded->workers[index] = worker;
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, round_trip/blocks)
+{
+    std::vector<uint64_t> expected, times;
+    gdbwire_transcript_block block;
+    std::string data;
+    size_t index;
+
+    for (index = 0; index < 100; ++index) {
+        data += line(index);
+        expected.push_back(1000 + index / 10);
+        if (index % 10 == 9) {
+            push(data, 1000 + index / 10, 7);
+            data.clear();
+        }
+    }
+    finish();
+
+    REQUIRE(gdbwire_transcript_reader_count(reader) > 10);
+    data.clear();
+    for (index = 0; index < 100; ++index) {
+        data += line(index);
+    }
+    REQUIRE(decode_all(times) == data);
+    REQUIRE(times == expected);
+
+    /* Each block but the last fills up with whole lines, and compresses */
+    for (index = 0; index < gdbwire_transcript_reader_count(reader);
+            ++index) {
+        REQUIRE(gdbwire_transcript_reader_block(reader, index,
+            &block) == GDBWIRE_OK);
+        REQUIRE((block.size >= 256 || block.first_line + block.lines == 100));
+        REQUIRE(block.size < 256 + line(99).size());
+        REQUIRE(block.stored_size < block.size);
+    }
+    REQUIRE(block.first_line + block.lines == 100);
+    REQUIRE(gdbwire_transcript_reader_block(reader, index,
+        &block) == GDBWIRE_LOGIC);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, round_trip/unfinished_line)
+{
+    std::vector<uint64_t> times;
+
+    push("^done\n(gdb) ", 5, 3);
+    push("\n~\"x", 6, 100);
+    finish();
+
+    REQUIRE(gdbwire_transcript_reader_count(reader) == 1);
+    REQUIRE(decode_all(times) == "^done\n(gdb) \n~\"x");
+    REQUIRE(times.size() == 3);
+    REQUIRE(times[0] == 5);
+    REQUIRE(times[1] == 6);
+    REQUIRE(times[2] == 6);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, round_trip/long_line)
+{
+    std::vector<uint64_t> times;
+    gdbwire_transcript_block block;
+    std::string data = "^done\n~\"" + std::string(5000, 'x') + "\"\n^done\n";
+
+    push(data, 1, 1000);
+    finish();
+
+    REQUIRE(decode_all(times) == data);
+    REQUIRE(gdbwire_transcript_reader_count(reader) == 2);
+    REQUIRE(gdbwire_transcript_reader_block(reader, 0, &block) == GDBWIRE_OK);
+    REQUIRE(block.lines == 2);
+    REQUIRE(block.stored_size < 100);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, round_trip/incompressible)
+{
+    std::vector<uint64_t> times;
+    gdbwire_transcript_block block;
+    std::string data;
+    unsigned long seed = 1;
+    size_t index;
+
+    for (index = 0; index < 300; ++index) {
+        seed = seed * 1103515245 + 12345;
+        data += (char)('!' + (seed >> 16) % 90);
+    }
+    data += '\n';
+    push(data, 1, data.size());
+    finish();
+
+    REQUIRE(decode_all(times) == data);
+    REQUIRE(gdbwire_transcript_reader_block(reader, 0, &block) == GDBWIRE_OK);
+    REQUIRE(block.stored_size == block.size);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, round_trip/empty)
+{
+    size_t index;
+
+    finish();
+
+    REQUIRE(gdbwire_transcript_reader_count(reader) == 0);
+    REQUIRE(gdbwire_transcript_reader_find_line(reader, 0,
+        &index) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_transcript_reader_find_time(reader, 0,
+        &index) == GDBWIRE_LOGIC);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, writer/time)
+{
+    push("^done\n", 10, 6);
+
+    REQUIRE(gdbwire_transcript_writer_push_data_at(writer, 9, "^done\n",
+        6) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_transcript_writer_push_data_at(writer, 10, "^done\n",
+        6) == GDBWIRE_OK);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, writer/finished)
+{
+    REQUIRE(gdbwire_transcript_writer_finish(writer) == GDBWIRE_OK);
+
+    REQUIRE(gdbwire_transcript_writer_finish(writer) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_transcript_writer_push_data(writer, "^done\n",
+        6) == GDBWIRE_LOGIC);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, writer/block_size)
+{
+    REQUIRE(!gdbwire_transcript_writer_create(file, 1u << 29));
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, reader/not_transcript)
+{
+    replace("GDBWLOG\1");
+    REQUIRE(!gdbwire_transcript_reader_create(file));
+
+    replace("");
+    REQUIRE(!gdbwire_transcript_reader_create(file));
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, reader/unfinished)
+{
+    std::vector<uint64_t> times;
+    gdbwire_transcript_block block;
+    std::string data, finished, lines;
+    size_t index, count;
+
+    for (index = 0; index < 50; ++index) {
+        data += line(index);
+    }
+    push(data, 1, data.size());
+    finish();
+    count = gdbwire_transcript_reader_count(reader);
+    finished = contents();
+
+    /* Without the index the blocks are found from their headers */
+    REQUIRE(gdbwire_transcript_reader_block(reader, count - 1,
+        &block) == GDBWIRE_OK);
+    replace(finished.substr(0, block.offset + 48 + block.stored_size +
+        block.times_size));
+    open();
+    REQUIRE(gdbwire_transcript_reader_count(reader) == count);
+    REQUIRE(decode_all(times) == data);
+
+    /* A block cut short is left out */
+    replace(finished.substr(0, block.offset + 48 + block.stored_size));
+    open();
+    REQUIRE(gdbwire_transcript_reader_count(reader) == count - 1);
+    times.clear();
+    lines = decode_all(times);
+    REQUIRE(lines.size() < data.size());
+    REQUIRE(data.compare(0, lines.size(), lines) == 0);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, reader/corrupt)
+{
+    gdbwire_transcript_block block;
+    std::string data, finished;
+    size_t index;
+
+    for (index = 0; index < 20; ++index) {
+        data += line(index);
+    }
+    push(data, 1, data.size());
+    finish();
+    finished = contents();
+
+    REQUIRE(gdbwire_transcript_reader_block(reader, 0, &block) == GDBWIRE_OK);
+    std::vector<char> lines(block.size);
+    std::vector<uint64_t> times(block.lines);
+
+    /* Every byte of the compressed lines and times is checked */
+    for (index = block.offset + 48; index < block.offset + 48 +
+            block.stored_size + block.times_size; ++index) {
+        std::string corrupt = finished;
+        corrupt[index] = (char)(corrupt[index] ^ 0x20);
+        replace(corrupt);
+        open();
+        REQUIRE(gdbwire_transcript_reader_decode(reader, 0, &lines[0],
+            &times[0]) == GDBWIRE_LOGIC);
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, find/line)
+{
+    gdbwire_transcript_block block;
+    size_t index, found;
+
+    for (index = 0; index < 100; ++index) {
+        push(line(index), index, 1000);
+    }
+    finish();
+
+    for (index = 0; index < 100; ++index) {
+        REQUIRE(gdbwire_transcript_reader_find_line(reader, index,
+            &found) == GDBWIRE_OK);
+        REQUIRE(gdbwire_transcript_reader_block(reader, found,
+            &block) == GDBWIRE_OK);
+        REQUIRE(block.first_line <= index);
+        REQUIRE(index < block.first_line + block.lines);
+    }
+    REQUIRE(gdbwire_transcript_reader_find_line(reader, 100,
+        &found) == GDBWIRE_LOGIC);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, find/time)
+{
+    std::vector<uint64_t> times;
+    std::string lines;
+    size_t index, found;
+
+    for (index = 0; index < 100; ++index) {
+        push(line(index), index * 10, 1000);
+    }
+    finish();
+
+    /* The first line at or after the time is in the block found */
+    for (index = 0; index < 100; ++index) {
+        REQUIRE(gdbwire_transcript_reader_find_time(reader,
+            (index > 0) ? index * 10 - 5 : 0, &found) == GDBWIRE_OK);
+        times.clear();
+        decode(found, lines, times);
+        REQUIRE(times.front() <= index * 10);
+        REQUIRE(index * 10 <= times.back());
+    }
+    REQUIRE(gdbwire_transcript_reader_find_time(reader, 991,
+        &found) == GDBWIRE_LOGIC);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, decode_parallel/blocks)
+{
+    GdbwireTranscriptDecoded decoded;
+    std::vector<uint64_t> times;
+    std::string data, expected;
+    size_t index, count;
+
+    for (index = 0; index < 1000; ++index) {
+        data += line(index);
+    }
+    push(data, 1, 4096);
+    finish();
+
+    count = gdbwire_transcript_reader_count(reader);
+    REQUIRE(count > 100);
+    decoded.lines.resize(count);
+    decoded.workers.resize(count);
+    REQUIRE(gdbwire_transcript_reader_decode_parallel(reader, 0, count, 4,
+        decoded_callback, &decoded) == GDBWIRE_OK);
+
+    for (index = 0; index < count; ++index) {
+        expected.clear();
+        decode(index, expected, times);
+        REQUIRE(decoded.lines[index] == expected);
+        REQUIRE(decoded.workers[index] < 4);
+    }
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, decode_parallel/range)
+{
+    GdbwireTranscriptDecoded decoded;
+    size_t index, count;
+
+    for (index = 0; index < 100; ++index) {
+        push(line(index), 1, 1000);
+    }
+    finish();
+
+    count = gdbwire_transcript_reader_count(reader);
+    decoded.lines.resize(count);
+    decoded.workers.resize(count);
+    REQUIRE(gdbwire_transcript_reader_decode_parallel(reader, 2, count - 3,
+        0, decoded_callback, &decoded) == GDBWIRE_OK);
+    REQUIRE(decoded.lines[0].empty());
+    REQUIRE(!decoded.lines[2].empty());
+    REQUIRE(!decoded.lines[count - 2].empty());
+    REQUIRE(decoded.lines[count - 1].empty());
+
+    REQUIRE(gdbwire_transcript_reader_decode_parallel(reader, 2, count - 1,
+        0, decoded_callback, &decoded) == GDBWIRE_LOGIC);
+    REQUIRE(gdbwire_transcript_reader_decode_parallel(reader, count, 0,
+        0, decoded_callback, &decoded) == GDBWIRE_OK);
+}
+
+TEST_CASE_METHOD_N(GdbwireTranscriptTest, recorder/convert)
+{
+    std::vector<char> chunk(GDBWIRE_RECORDER_CHUNK_MAX);
+    std::vector<uint64_t> times;
+    gdbwire_recorder *recorder;
+    FILE *log = tmpfile();
+    uint64_t time;
+    size_t size;
+
+    REQUIRE(log);
+    recorder = gdbwire_recorder_create(log, NULL);
+    REQUIRE(recorder);
+    REQUIRE(gdbwire_recorder_push_data(recorder, "^done\n(gd", 9) ==
+        GDBWIRE_OK);
+    REQUIRE(gdbwire_recorder_push_data(recorder, "b) \n", 4) == GDBWIRE_OK);
+    gdbwire_recorder_destroy(recorder);
+
+    /* Each chunk of the log is pushed with its time */
+    REQUIRE(fseek(log, 0, SEEK_SET) == 0);
+    for (;;) {
+        REQUIRE(gdbwire_recorder_read_chunk(log, &time, &chunk[0],
+            &size) == GDBWIRE_OK);
+        if (size == 0) {
+            break;
+        }
+        REQUIRE(gdbwire_transcript_writer_push_data_at(writer, time,
+            &chunk[0], size) == GDBWIRE_OK);
+    }
+    fclose(log);
+    finish();
+
+    REQUIRE(decode_all(times) == "^done\n(gdb) \n");
+    REQUIRE(times.size() == 2);
+    REQUIRE(times[0] <= times[1]);
+}